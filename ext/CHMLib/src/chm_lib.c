@@ -96,6 +96,12 @@
 #define CHM_RELEASE_LOCK(a) do {                        \
         LeaveCriticalSection(&(a));                     \
     } while(0)
+#define CHM_WAIT(c, a) do {                             \
+        SleepConditionVariableCS(&(c), &(a), INFINITE); \
+    } while(0)
+#define CHM_WAKE_ALL(c) do {                            \
+        WakeAllConditionVariable(&(c));                 \
+    } while(0)
 
 #else
 #include <pthread.h>
@@ -106,11 +112,19 @@
 #define CHM_RELEASE_LOCK(a) do {                        \
         pthread_mutex_unlock(&(a));                     \
     } while(0)
+#define CHM_WAIT(c, a) do {                             \
+        pthread_cond_wait(&(c), &(a));                  \
+    } while(0)
+#define CHM_WAKE_ALL(c) do {                            \
+        pthread_cond_broadcast(&(c));                   \
+    } while(0)
 
 #endif
 #else
 #define CHM_ACQUIRE_LOCK(a) /* do nothing */
 #define CHM_RELEASE_LOCK(a) /* do nothing */
+#define CHM_WAIT(c, a) /* do nothing */
+#define CHM_WAKE_ALL(c) /* do nothing */
 #endif
 
 #ifdef WIN32
@@ -125,9 +139,14 @@
 /*
  * defines related to tuning
  */
-#ifndef CHM_MAX_BLOCKS_CACHED
-#define CHM_MAX_BLOCKS_CACHED 5
+#ifndef CHM_MAX_BYTES_CACHED
+#define CHM_MAX_BYTES_CACHED (16 * 1024 * 1024)
+#endif
+/* upper limit for CHM_PARAM_DECOMPRESS_THREADS (the default is 0) */
+#ifndef CHM_MAX_DECOMPRESS_THREADS
+#define CHM_MAX_DECOMPRESS_THREADS 8
 #endif
+#define CHM_CACHE_HASH_SIZE 64
 
 /*
  * architecture specific defines
@@ -653,6 +672,27 @@ static int _unmarshal_lzxc_control_data(unsigned char **pData,
     return 1;
 }
 
+/* a decompressed reset interval (or the part of a long one read last) */
+#define CHM_INTERVAL_QUEUED         0
+#define CHM_INTERVAL_DECOMPRESSING  1
+#define CHM_INTERVAL_DONE           2
+
+struct chmCachedInterval
+{
+    UInt64              index;
+    UChar              *data;
+    UInt64              first;      /* the block data starts with          */
+    UInt64              len;
+    UInt64              bytes;      /* counted against cache_max_bytes     */
+    UInt64              bad_block;  /* the first block failing to decompress */
+    struct LZXstate    *lzx;        /* for continuing after data (or NULL) */
+    int                 state;
+    struct chmCachedInterval *hash_next;
+    struct chmCachedInterval *lru_prev;
+    struct chmCachedInterval *lru_next;
+    struct chmCachedInterval *queue_next;
+};
+
 /* the structure used for chm file handles */
 struct chmFile
 {
@@ -665,12 +705,16 @@ struct chmFile
 #ifdef CHM_MT
 #ifdef WIN32
     CRITICAL_SECTION    mutex;
-    CRITICAL_SECTION    lzx_mutex;
     CRITICAL_SECTION    cache_mutex;
+    CONDITION_VARIABLE  interval_done;
+    CONDITION_VARIABLE  interval_queued;
+    HANDLE              threads[CHM_MAX_DECOMPRESS_THREADS];
 #else
     pthread_mutex_t     mutex;
-    pthread_mutex_t     lzx_mutex;
     pthread_mutex_t     cache_mutex;
+    pthread_cond_t      interval_done;
+    pthread_cond_t      interval_queued;
+    pthread_t           threads[CHM_MAX_DECOMPRESS_THREADS];
 #endif
 #endif
 
@@ -692,14 +736,21 @@ struct chmFile
     UInt32              reset_interval;
     UInt32              reset_blkcount;
 
-    /* decompressor state */
-    struct LZXstate    *lzx_state;
-    int                 lzx_last_block;
-
-    /* cache for decompressed blocks */
-    UChar             **cache_blocks;
-    UInt64             *cache_block_indices;
-    Int32               cache_num_blocks;
+    /* cache for decompressed reset intervals (protected by cache_mutex) */
+    struct chmCachedInterval *cache_hash[CHM_CACHE_HASH_SIZE];
+    struct chmCachedInterval *cache_lru_head;
+    struct chmCachedInterval *cache_lru_tail;
+    UInt64              cache_bytes;
+    UInt64              cache_max_bytes;
+    UInt64              cache_last_interval;
+
+    /* intervals to be decompressed ahead by the decompression threads */
+    struct chmCachedInterval *queue_head;
+    struct chmCachedInterval *queue_tail;
+    int                 max_threads;
+    int                 num_threads;
+    int                 threads_failed;
+    int                 stop_threads;
 };
 
 /*
@@ -792,11 +843,9 @@ struct chmFile *chm_open(const char *filename)
     newHandle = (struct chmFile *)malloc(sizeof(struct chmFile));
     if (newHandle == NULL)
         return NULL;
+    memset(newHandle, 0, sizeof(struct chmFile));
     newHandle->fd = CHM_NULL_FD;
-    newHandle->lzx_state = NULL;
-    newHandle->cache_blocks = NULL;
-    newHandle->cache_block_indices = NULL;
-    newHandle->cache_num_blocks = 0;
+    newHandle->cache_max_bytes = CHM_MAX_BYTES_CACHED;
 
     /* open file */
 #ifdef WIN32
@@ -837,12 +886,14 @@ struct chmFile *chm_open(const char *filename)
 #ifdef CHM_MT
 #ifdef WIN32
     InitializeCriticalSection(&newHandle->mutex);
-    InitializeCriticalSection(&newHandle->lzx_mutex);
     InitializeCriticalSection(&newHandle->cache_mutex);
+    InitializeConditionVariable(&newHandle->interval_done);
+    InitializeConditionVariable(&newHandle->interval_queued);
 #else
     pthread_mutex_init(&newHandle->mutex, NULL);
-    pthread_mutex_init(&newHandle->lzx_mutex, NULL);
     pthread_mutex_init(&newHandle->cache_mutex, NULL);
+    pthread_cond_init(&newHandle->interval_done, NULL);
+    pthread_cond_init(&newHandle->interval_queued, NULL);
 #endif
 #endif
 
@@ -981,57 +1032,50 @@ struct chmFile *chm_open(const char *filename)
                                     (newHandle->window_size / 2) *
                                     ctlData.windowsPerReset;
 #endif
+        /* SumatraPDF: intervals are cached by reset_blkcount */
+        if (newHandle->reset_blkcount == 0  ||
+            newHandle->reset_table.block_len == 0)
+            newHandle->compression_enabled = 0;
         }
     }
 
-    /* initialize cache */
-    chm_set_param(newHandle, CHM_PARAM_MAX_BLOCKS_CACHED,
-                  CHM_MAX_BLOCKS_CACHED);
-
     return newHandle;
 }
 
+static void _chm_stop_threads(struct chmFile *h);
+static void _chm_drop_interval(struct chmFile *h, struct chmCachedInterval *e);
+
 /* close an ITS archive */
 void chm_close(struct chmFile *h)
 {
     if (h != NULL)
     {
+        int i;
+
+        _chm_stop_threads(h);
+
         if (h->fd != CHM_NULL_FD)
             CHM_CLOSE_FILE(h->fd);
         h->fd = CHM_NULL_FD;
 
+        for (i=0; i<CHM_CACHE_HASH_SIZE; i++)
+        {
+            while (h->cache_hash[i])
+                _chm_drop_interval(h, h->cache_hash[i]);
+        }
+
 #ifdef CHM_MT
 #ifdef WIN32
         DeleteCriticalSection(&h->mutex);
-        DeleteCriticalSection(&h->lzx_mutex);
         DeleteCriticalSection(&h->cache_mutex);
 #else
         pthread_mutex_destroy(&h->mutex);
-        pthread_mutex_destroy(&h->lzx_mutex);
         pthread_mutex_destroy(&h->cache_mutex);
+        pthread_cond_destroy(&h->interval_done);
+        pthread_cond_destroy(&h->interval_queued);
 #endif
 #endif
 
-        if (h->lzx_state)
-            LZXteardown(h->lzx_state);
-        h->lzx_state = NULL;
-
-        if (h->cache_blocks)
-        {
-            int i;
-            for (i=0; i<h->cache_num_blocks; i++)
-            {
-                if (h->cache_blocks[i])
-                    free(h->cache_blocks[i]);
-            }
-            free(h->cache_blocks);
-            h->cache_blocks = NULL;
-        }
-
-        if (h->cache_block_indices)
-            free(h->cache_block_indices);
-        h->cache_block_indices = NULL;
-
         free(h);
     }
 }
@@ -1040,75 +1084,47 @@ void chm_close(struct chmFile *h)
  * set a parameter on the file handle.
  * valid parameter types:
  *          CHM_PARAM_MAX_BLOCKS_CACHED:
- *                 how many decompressed blocks should be cached?  A simple
- *                 caching scheme is used, wherein the index of the block is
- *                 used as a hash value, and hash collision results in the
- *                 invalidation of the previously cached block.
+ *                 how many decompressed blocks should be cached?  (the same
+ *                 as CHM_PARAM_MAX_BYTES_CACHED for that many blocks)
+ *          CHM_PARAM_MAX_BYTES_CACHED:
+ *                 how many bytes of decompressed reset intervals should be
+ *                 cached?  the least recently used intervals are evicted.
+ *          CHM_PARAM_DECOMPRESS_THREADS:
+ *                 on how many threads (at most) should reset intervals be
+ *                 decompressed ahead while reading sequentially?  (must be
+ *                 set before reading compressed data, 0 disables this and
+ *                 is the default)
  */
 void chm_set_param(struct chmFile *h,
                    int paramType,
                    int paramVal)
 {
+    if (paramVal < 0)
+        return;
+
+    CHM_ACQUIRE_LOCK(h->cache_mutex);
     switch (paramType)
     {
         case CHM_PARAM_MAX_BLOCKS_CACHED:
-            CHM_ACQUIRE_LOCK(h->cache_mutex);
-            if (paramVal != h->cache_num_blocks)
-            {
-                UChar **newBlocks;
-                UInt64 *newIndices;
-                int     i;
-
-                /* allocate new cached blocks */
-                newBlocks = (UChar **)malloc(paramVal * sizeof (UChar *));
-                if (newBlocks == NULL) return;
-                newIndices = (UInt64 *)malloc(paramVal * sizeof (UInt64));
-                if (newIndices == NULL) { free(newBlocks); return; }
-                for (i=0; i<paramVal; i++)
-                {
-                    newBlocks[i] = NULL;
-                    newIndices[i] = 0;
-                }
+            h->cache_max_bytes = (UInt64)paramVal * h->reset_table.block_len;
+            break;
 
-                /* re-distribute old cached blocks */
-                if (h->cache_blocks)
-                {
-                    for (i=0; i<h->cache_num_blocks; i++)
-                    {
-                        int newSlot = (int)(h->cache_block_indices[i] % paramVal);
-
-                        if (h->cache_blocks[i])
-                        {
-                            /* in case of collision, destroy newcomer */
-                            if (newBlocks[newSlot])
-                            {
-                                free(h->cache_blocks[i]);
-                                h->cache_blocks[i] = NULL;
-                            }
-                            else
-                            {
-                                newBlocks[newSlot] = h->cache_blocks[i];
-                                newIndices[newSlot] =
-                                            h->cache_block_indices[i];
-                            }
-                        }
-                    }
-
-                    free(h->cache_blocks);
-                    free(h->cache_block_indices);
-                }
+        case CHM_PARAM_MAX_BYTES_CACHED:
+            h->cache_max_bytes = (UInt64)paramVal;
+            break;
 
-                /* now, set new values */
-                h->cache_blocks = newBlocks;
-                h->cache_block_indices = newIndices;
-                h->cache_num_blocks = paramVal;
-            }
-            CHM_RELEASE_LOCK(h->cache_mutex);
+        case CHM_PARAM_DECOMPRESS_THREADS:
+            if (paramVal > CHM_MAX_DECOMPRESS_THREADS)
+                paramVal = CHM_MAX_DECOMPRESS_THREADS;
+            h->max_threads = paramVal;
             break;
 
         default:
             break;
     }
+    while (h->cache_bytes > h->cache_max_bytes)
+        _chm_drop_interval(h, h->cache_lru_tail);
+    CHM_RELEASE_LOCK(h->cache_mutex);
 }
 
 /*
@@ -1407,125 +1423,408 @@ static int _chm_get_cmpblock_bounds(struct chmFile *h,
     return 1;
 }
 
-/* decompress the block.  must have lzx_mutex. */
-static Int64 _chm_decompress_block(struct chmFile *h,
-                                   UInt64 block,
-                                   UChar **ubuffer)
+/* decompress the blocks [from, to) with state (which must have decompressed
+ * all the blocks of the reset interval preceding from) and store the blocks
+ * [keepFrom, to) in ubuffer.  nDone is set to the number of blocks
+ * decompressed before a failure.  returns 0 if out of memory */
+static int _chm_decompress_blocks(struct chmFile *h,
+                                  struct LZXstate *state,
+                                  UInt64 from,
+                                  UInt64 to,
+                                  UInt64 keepFrom,
+                                  UChar *ubuffer,
+                                  UInt64 *nDone)
 {
-    UChar *cbuffer = malloc(((unsigned int)h->reset_table.block_len + 6144));
+    /* blocks preceding keepFrom are decompressed into scratch and dropped */
+    UChar *cbuffer = malloc(((unsigned int)h->reset_table.block_len * 2 + 6144));
+    UChar *scratch, *out;
     UInt64 cmpStart;                                    /* compressed start  */
     Int64 cmpLen;                                       /* compressed len    */
-    int indexSlot;                                      /* cache index slot  */
-    UChar *lbuffer;                                     /* local buffer ptr  */
-    UInt32 blockAlign = (UInt32)(block % h->reset_blkcount); /* reset intvl. aln. */
-    UInt32 i;                                           /* local loop index  */
+    UInt64 i;
 
     if (cbuffer == NULL)
-        return -1;
-
-    /* let the caching system pull its weight! */
-    if (block - blockAlign <= h->lzx_last_block  &&
-        block              >= h->lzx_last_block)
-        blockAlign = (block - h->lzx_last_block);
+        return 0;
+    scratch = cbuffer + h->reset_table.block_len + 6144;
 
-    /* check if we need previous blocks */
-    if (blockAlign != 0)
+    for (i = from; i < to; i++)
     {
-        /* fetch all required previous blocks since last reset */
-        for (i = blockAlign; i > 0; i--)
+#ifdef CHM_DEBUG
+        fprintf(stderr, "Decompressing block #%4d\n", (int)i);
+#endif
+        out = i < keepFrom ? scratch : ubuffer + (i - keepFrom) * h->reset_table.block_len;
+        if (!_chm_get_cmpblock_bounds(h, i, &cmpStart, &cmpLen)              ||
+            cmpLen < 0                                                       ||
+            cmpLen > h->reset_table.block_len + 6144                         ||
+            _chm_fetch_bytes(h, cbuffer, cmpStart, cmpLen) != cmpLen         ||
+            LZXdecompress(state, cbuffer, out, (int)cmpLen,
+                          (int)h->reset_table.block_len) != DECR_OK)
         {
-            UInt32 curBlockIdx = block - i;
-
-            /* check if we most recently decompressed the previous block */
-            if (h->lzx_last_block != (int)curBlockIdx)
-            {
-                if ((curBlockIdx % h->reset_blkcount) == 0)
-                {
 #ifdef CHM_DEBUG
-                    fprintf(stderr, "***RESET (1)***\n");
+            fprintf(stderr, "   (DECOMPRESS FAILED!)\n");
 #endif
-                    LZXreset(h->lzx_state);
-                }
+            break;
+        }
+    }
 
-                indexSlot = (int)((curBlockIdx) % h->cache_num_blocks);
-                if (! h->cache_blocks[indexSlot])
-                    h->cache_blocks[indexSlot] = (UChar *)malloc((unsigned int)(h->reset_table.block_len));
-                if (! h->cache_blocks[indexSlot])
-                {
-                    free(cbuffer);
-                    return -1;
-                }
-                h->cache_block_indices[indexSlot] = curBlockIdx;
-                lbuffer = h->cache_blocks[indexSlot];
+    /* XXX: modify LZX routines to return the length of the data they
+     * decompressed and return that instead, for an extra sanity check.
+     */
+    free(cbuffer);
+    *nDone = i - from;
+    return 1;
+}
 
-                /* decompress the previous block */
-#ifdef CHM_DEBUG
-                fprintf(stderr, "Decompressing block #%4d (EXTRA)\n", curBlockIdx);
-#endif
-                if (!_chm_get_cmpblock_bounds(h, curBlockIdx, &cmpStart, &cmpLen) ||
-                    cmpLen < 0                                                    ||
-                    cmpLen > h->reset_table.block_len + 6144                      ||
-                    _chm_fetch_bytes(h, cbuffer, cmpStart, cmpLen) != cmpLen      ||
-                    LZXdecompress(h->lzx_state, cbuffer, lbuffer, (int)cmpLen,
-                                  (int)h->reset_table.block_len) != DECR_OK)
-                {
-#ifdef CHM_DEBUG
-                    fprintf(stderr, "   (DECOMPRESS FAILED!)\n");
-#endif
-                    free(cbuffer);
-                    return (Int64)0;
-                }
+/* the block following the given reset interval */
+static UInt64 _chm_interval_end(struct chmFile *h,
+                                UInt64 interval)
+{
+    UInt64 end = (interval + 1) * h->reset_blkcount;
+    if (end > h->reset_table.block_count)
+        end = h->reset_table.block_count;
+    return end;
+}
 
-                h->lzx_last_block = (int)curBlockIdx;
-            }
+/* the blocks [keepFrom, to) to cache for a request for the given block.
+ * whole intervals are cached, unless they'd take too much of the cache */
+static void _chm_interval_blocks(struct chmFile *h,
+                                 UInt64 interval,
+                                 UInt64 block,
+                                 UInt64 *keepFrom,
+                                 UInt64 *to)
+{
+    UInt64 maxBlocks = h->cache_max_bytes / 4 / h->reset_table.block_len;
+
+    if (maxBlocks == 0)
+        maxBlocks = 1;
+    *keepFrom = interval * h->reset_blkcount;
+    *to = _chm_interval_end(h, interval);
+    if (*to - *keepFrom > maxBlocks)
+    {
+        *keepFrom = block;
+        if (*to - block > maxBlocks)
+            *to = block + maxBlocks;
+    }
+}
+
+/* the remaining helpers for the interval cache must have cache_mutex */
+
+static struct chmCachedInterval *_chm_find_interval(struct chmFile *h,
+                                                    UInt64 interval)
+{
+    struct chmCachedInterval *e;
+    e = h->cache_hash[interval % CHM_CACHE_HASH_SIZE];
+    while (e != NULL  &&  e->index != interval)
+        e = e->hash_next;
+    return e;
+}
+
+static void _chm_lru_unlink(struct chmFile *h, struct chmCachedInterval *e)
+{
+    if (e->lru_prev)
+        e->lru_prev->lru_next = e->lru_next;
+    else
+        h->cache_lru_head = e->lru_next;
+    if (e->lru_next)
+        e->lru_next->lru_prev = e->lru_prev;
+    else
+        h->cache_lru_tail = e->lru_prev;
+    e->lru_prev = e->lru_next = NULL;
+}
+
+/* make e the most recently used interval */
+static void _chm_lru_touch(struct chmFile *h, struct chmCachedInterval *e)
+{
+    if (h->cache_lru_head == e)
+        return;
+    if (e->lru_prev  ||  e->lru_next  ||  h->cache_lru_tail == e)
+        _chm_lru_unlink(h, e);
+    e->lru_next = h->cache_lru_head;
+    if (h->cache_lru_head)
+        h->cache_lru_head->lru_prev = e;
+    h->cache_lru_head = e;
+    if (! h->cache_lru_tail)
+        h->cache_lru_tail = e;
+}
+
+static void _chm_unqueue_interval(struct chmFile *h,
+                                  struct chmCachedInterval *e)
+{
+    struct chmCachedInterval **slot = &h->queue_head;
+    h->queue_tail = NULL;
+    while (*slot)
+    {
+        if (*slot == e)
+            *slot = e->queue_next;
+        else
+        {
+            h->queue_tail = *slot;
+            slot = &(*slot)->queue_next;
+        }
+    }
+    e->queue_next = NULL;
+}
+
+/* remove e from the cache and free it (e must not be queued) */
+static void _chm_drop_interval(struct chmFile *h,
+                               struct chmCachedInterval *e)
+{
+    struct chmCachedInterval **slot;
+    slot = &h->cache_hash[e->index % CHM_CACHE_HASH_SIZE];
+    while (*slot != e)
+        slot = &(*slot)->hash_next;
+    *slot = e->hash_next;
+    if (e->state == CHM_INTERVAL_DONE)
+    {
+        _chm_lru_unlink(h, e);
+        h->cache_bytes -= e->bytes;
+    }
+    free(e->data);
+    if (e->lzx)
+        LZXteardown(e->lzx);
+    free(e);
+}
+
+static struct chmCachedInterval *_chm_new_interval(struct chmFile *h,
+                                                   UInt64 interval,
+                                                   int state)
+{
+    struct chmCachedInterval *e;
+    e = (struct chmCachedInterval *)calloc(1, sizeof(struct chmCachedInterval));
+    if (e == NULL)
+        return NULL;
+    e->index = interval;
+    e->bad_block = (UInt64)-1;
+    e->state = state;
+    e->hash_next = h->cache_hash[interval % CHM_CACHE_HASH_SIZE];
+    h->cache_hash[interval % CHM_CACHE_HASH_SIZE] = e;
+    return e;
+}
+
+/* decompress the part of e's interval to cache for a request for the given
+ * block (continuing after what's cached for a long interval, if possible),
+ * evict least recently used intervals (other than e) which don't fit into
+ * the budget and wake up the threads waiting for e.  e must be being
+ * decompressed by the caller.  releases cache_mutex while decompressing */
+static void _chm_fill_interval(struct chmFile *h,
+                               struct chmCachedInterval *e,
+                               UInt64 block)
+{
+    UInt64 from = e->index * h->reset_blkcount;
+    UInt64 cachedEnd = e->first + e->len / h->reset_table.block_len;
+    struct LZXstate *lzx = e->lzx;
+    UInt64 keepFrom, to, nDone = 0;
+    UChar *ubuffer;
+    int ok;
+
+    if (lzx != NULL  &&  block >= cachedEnd  &&  e->len > 0)
+        from = cachedEnd;
+    else if (lzx != NULL)
+    {
+        LZXteardown(lzx);
+        lzx = NULL;
+    }
+    e->lzx = NULL;
+    free(e->data);
+    e->data = NULL;
+    e->len = 0;
+    _chm_interval_blocks(h, e->index, block, &keepFrom, &to);
+    CHM_RELEASE_LOCK(h->cache_mutex);
+
+    if (lzx == NULL)
+        lzx = LZXinit(ffs(h->window_size) - 1);
+    ubuffer = malloc((size_t)((to - keepFrom) * h->reset_table.block_len));
+    ok = lzx != NULL  &&  ubuffer != NULL  &&
+         _chm_decompress_blocks(h, lzx, from, to, keepFrom, ubuffer, &nDone);
+
+    CHM_ACQUIRE_LOCK(h->cache_mutex);
+    /* remember corrupted blocks so that they aren't tried again and again */
+    if (ok  &&  from + nDone < to  &&  from + nDone < e->bad_block)
+        e->bad_block = from + nDone;
+    if (ok  &&  from + nDone > keepFrom)
+    {
+        e->data = ubuffer;
+        e->first = keepFrom;
+        e->len = (from + nDone - keepFrom) * h->reset_table.block_len;
+        e->bytes = e->len;
+        /* the next part of a long interval is likely to be read next */
+        if (nDone == to - from  &&  to < _chm_interval_end(h, e->index))
+        {
+            e->lzx = lzx;
+            e->bytes += h->window_size;
+            lzx = NULL;
         }
     }
     else
     {
-        if ((block % h->reset_blkcount) == 0)
+        free(ubuffer);
+        e->bytes = 0;
+    }
+    if (lzx)
+        LZXteardown(lzx);
+
+    e->state = CHM_INTERVAL_DONE;
+    h->cache_bytes += e->bytes;
+    _chm_lru_touch(h, e);
+    while (h->cache_bytes > h->cache_max_bytes  &&
+           h->cache_lru_tail != e)
+        _chm_drop_interval(h, h->cache_lru_tail);
+    CHM_WAKE_ALL(h->interval_done);
+}
+
+#ifdef CHM_MT
+/* decompresses the intervals queued by _chm_read_ahead */
+#ifdef WIN32
+static DWORD WINAPI _chm_decompress_thread(void *data)
+#else
+static void *_chm_decompress_thread(void *data)
+#endif
+{
+    struct chmFile *h = (struct chmFile *)data;
+    struct chmCachedInterval *e;
+
+    CHM_ACQUIRE_LOCK(h->cache_mutex);
+    while (! h->stop_threads)
+    {
+        e = h->queue_head;
+        if (e == NULL)
         {
-#ifdef CHM_DEBUG
-            fprintf(stderr, "***RESET (2)***\n");
+            CHM_WAIT(h->interval_queued, h->cache_mutex);
+            continue;
+        }
+        _chm_unqueue_interval(h, e);
+        e->state = CHM_INTERVAL_DECOMPRESSING;
+        _chm_fill_interval(h, e, e->index * h->reset_blkcount);
+    }
+    CHM_RELEASE_LOCK(h->cache_mutex);
+    return 0;
+}
+
+/* while a read continues past interval (up to lastBlock), decompress the
+ * following intervals it needs in parallel on (up to) max_threads threads */
+static void _chm_read_ahead(struct chmFile *h, UInt64 interval, UInt64 lastBlock)
+{
+    UInt64 intervalBytes = h->reset_blkcount * h->reset_table.block_len;
+    UInt64 lastInterval = lastBlock / h->reset_blkcount;
+    UInt64 next;
+    int n;
+
+    if (lastInterval <= interval)
+        return;
+
+    /* start the threads on the first read spanning several intervals */
+    if (h->num_threads == 0  &&  ! h->threads_failed)
+    {
+        for (; h->num_threads < h->max_threads; h->num_threads++)
+        {
+#ifdef WIN32
+            h->threads[h->num_threads] = CreateThread(NULL, 0, _chm_decompress_thread, h, 0, NULL);
+            if (h->threads[h->num_threads] == NULL)
+                break;
+#else
+            if (pthread_create(&h->threads[h->num_threads], NULL, _chm_decompress_thread, h) != 0)
+                break;
 #endif
-            LZXreset(h->lzx_state);
         }
+        h->threads_failed = h->max_threads > 0  &&  h->num_threads == 0;
     }
 
-    /* allocate slot in cache */
-    indexSlot = (int)(block % h->cache_num_blocks);
-    if (! h->cache_blocks[indexSlot])
-        h->cache_blocks[indexSlot] = (UChar *)malloc(((unsigned int)h->reset_table.block_len));
-    if (! h->cache_blocks[indexSlot])
+    /* only read as far ahead as half the cache allows */
+    for (n = 0, next = interval + 1; n < h->num_threads  &&  next <= lastInterval  &&
+            (UInt64)(n + 1) * intervalBytes <= h->cache_max_bytes / 2; n++, next++)
     {
-        free(cbuffer);
-        return -1;
+        struct chmCachedInterval *e;
+        if (_chm_find_interval(h, next))
+            continue;
+        e = _chm_new_interval(h, next, CHM_INTERVAL_QUEUED);
+        if (e == NULL)
+            break;
+        if (h->queue_tail)
+            h->queue_tail->queue_next = e;
+        else
+            h->queue_head = e;
+        h->queue_tail = e;
+        CHM_WAKE_ALL(h->interval_queued);
     }
-    h->cache_block_indices[indexSlot] = block;
-    lbuffer = h->cache_blocks[indexSlot];
-    *ubuffer = lbuffer;
+}
 
-    /* decompress the block we actually want */
-#ifdef CHM_DEBUG
-    fprintf(stderr, "Decompressing block #%4d (REAL )\n", block);
-#endif
-    if (! _chm_get_cmpblock_bounds(h, block, &cmpStart, &cmpLen)          ||
-        _chm_fetch_bytes(h, cbuffer, cmpStart, cmpLen) != cmpLen          ||
-        LZXdecompress(h->lzx_state, cbuffer, lbuffer, (int)cmpLen,
-                      (int)h->reset_table.block_len) != DECR_OK)
+static void _chm_stop_threads(struct chmFile *h)
+{
+    int i;
+    /* (chm_close is also called while chm_open fails) */
+    if (h->num_threads == 0)
+        return;
+    CHM_ACQUIRE_LOCK(h->cache_mutex);
+    h->stop_threads = 1;
+    CHM_WAKE_ALL(h->interval_queued);
+    CHM_RELEASE_LOCK(h->cache_mutex);
+    for (i = 0; i < h->num_threads; i++)
     {
-#ifdef CHM_DEBUG
-        fprintf(stderr, "   (DECOMPRESS FAILED!)\n");
+#ifdef WIN32
+        WaitForSingleObject(h->threads[i], INFINITE);
+        CloseHandle(h->threads[i]);
+#else
+        pthread_join(h->threads[i], NULL);
 #endif
-        free(cbuffer);
-        return (Int64)0;
     }
-    h->lzx_last_block = (int)block;
+    h->num_threads = 0;
+}
+#else
+#define _chm_read_ahead(h, interval, lastBlock) /* do nothing */
+static void _chm_stop_threads(struct chmFile *h)
+{
+    (void)h;
+}
+#endif
 
-    /* XXX: modify LZX routines to return the length of the data they
-     * decompressed and return that instead, for an extra sanity check.
-     */
-    free(cbuffer);
-    return h->reset_table.block_len;
+/* returns the cached interval containing block (decompressing it if needed,
+ * or waiting for another thread doing so) or NULL on failure.  must have
+ * cache_mutex */
+static struct chmCachedInterval *_chm_get_interval(struct chmFile *h,
+                                                   UInt64 block)
+{
+    UInt64 interval = block / h->reset_blkcount;
+    struct chmCachedInterval *e;
+
+    for (;;)
+    {
+        e = _chm_find_interval(h, interval);
+        if (e == NULL)
+        {
+            e = _chm_new_interval(h, interval, CHM_INTERVAL_DECOMPRESSING);
+            if (e == NULL)
+                return NULL;
+            break;
+        }
+        if (e->state == CHM_INTERVAL_DONE)
+        {
+            _chm_lru_touch(h, e);
+            if (block >= e->bad_block)
+                return NULL;
+            if (block >= e->first  &&
+                block < e->first + e->len / h->reset_table.block_len)
+                return e;
+            /* only another part of a long (or corrupted) interval is cached */
+            _chm_lru_unlink(h, e);
+            h->cache_bytes -= e->bytes;
+            e->bytes = 0;
+            e->state = CHM_INTERVAL_DECOMPRESSING;
+            break;
+        }
+        if (e->state == CHM_INTERVAL_QUEUED)
+        {
+            /* don't wait for a read-ahead thread to get to it */
+            _chm_unqueue_interval(h, e);
+            e->state = CHM_INTERVAL_DECOMPRESSING;
+            break;
+        }
+        CHM_WAIT(h->interval_done, h->cache_mutex);
+    }
+
+    _chm_fill_interval(h, e, block);
+    if (block < e->first  ||
+        block >= e->first + e->len / h->reset_table.block_len)
+        return NULL;
+    return e;
 }
 
 /* grab a region from a compressed block */
@@ -1536,54 +1835,38 @@ static Int64 _chm_decompress_region(struct chmFile *h,
 {
     UInt64 nBlock, nOffset;
     UInt64 nLen;
-    UInt64 gotLen;
-    UChar *ubuffer;
+    struct chmCachedInterval *e;
 
     if (len <= 0)
         return (Int64)0;
 
     /* figure out what we need to read */
     nBlock = start / h->reset_table.block_len;
-    nOffset = start % h->reset_table.block_len;
-    nLen = len;
-    if (nLen > (h->reset_table.block_len - nOffset))
-        nLen = h->reset_table.block_len - nOffset;
+    if (nBlock >= h->reset_table.block_count)
+        return (Int64)0;
 
-    /* if block is cached, return data from it. */
-    CHM_ACQUIRE_LOCK(h->lzx_mutex);
     CHM_ACQUIRE_LOCK(h->cache_mutex);
-    if (h->cache_block_indices[nBlock % h->cache_num_blocks] == nBlock    &&
-        h->cache_blocks[nBlock % h->cache_num_blocks] != NULL)
+    e = _chm_get_interval(h, nBlock);
+    if (e == NULL)
     {
-        memcpy(buf,
-               h->cache_blocks[nBlock % h->cache_num_blocks] + nOffset,
-               (unsigned int)nLen);
         CHM_RELEASE_LOCK(h->cache_mutex);
-        CHM_RELEASE_LOCK(h->lzx_mutex);
-        return nLen;
+        return (Int64)0;
     }
-    CHM_RELEASE_LOCK(h->cache_mutex);
 
-    /* data request not satisfied, so... start up the decompressor machine */
-    if (! h->lzx_state)
-    {
-        int window_size = ffs(h->window_size) - 1;
-        h->lzx_last_block = -1;
-        h->lzx_state = LZXinit(window_size);
-    }
+    /* copy as much of the interval as requested */
+    nOffset = start - e->first * h->reset_table.block_len;
+    nLen = len;
+    if (nLen > e->len - nOffset)
+        nLen = e->len - nOffset;
+    memcpy(buf, e->data + nOffset, (size_t)nLen);
 
-    /* decompress some data */
-    gotLen = _chm_decompress_block(h, nBlock, &ubuffer);
-    /* SumatraPDF: check return value */
-    if (gotLen == (UInt64)-1)
+    if (e->index != h->cache_last_interval)
     {
-        CHM_RELEASE_LOCK(h->lzx_mutex);
-        return 0;
+        if ((UInt64)len > nLen)
+            _chm_read_ahead(h, e->index, (start + len - 1) / h->reset_table.block_len);
+        h->cache_last_interval = e->index;
     }
-    if (gotLen < nLen)
-        nLen = gotLen;
-    memcpy(buf, ubuffer+nOffset, (unsigned int)nLen);
-    CHM_RELEASE_LOCK(h->lzx_mutex);
+    CHM_RELEASE_LOCK(h->cache_mutex);
     return nLen;
 }
 
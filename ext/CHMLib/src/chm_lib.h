@@ -95,6 +95,8 @@ void chm_close(struct chmFile *h);
 
 /* methods for ssetting tuning parameters for particular file */
 #define CHM_PARAM_MAX_BLOCKS_CACHED 0
+#define CHM_PARAM_MAX_BYTES_CACHED 1
+#define CHM_PARAM_DECOMPRESS_THREADS 2
 void chm_set_param(struct chmFile *h,
                    int paramType,
                    int paramVal);
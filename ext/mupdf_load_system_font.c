@@ -27,11 +27,10 @@
 
 #define MAX_FACENAME 128
 
-// Note: the font face must be the first field so that the structure
-//       can be treated like a simple string for searching
+// fontface and fontpath point into the font index (cf. fontindex)
 typedef struct {
-    char fontface[MAX_FACENAME];
-    char fontpath[MAX_PATH];
+    const char* fontface;
+    const char* fontpath;
     int index;
 } sys_font_info;
 
@@ -41,6 +40,50 @@ typedef struct {
     int cap;
 } pdf_fontlistMS;
 
+// The names of all system fonts are collected in an index which can be saved to a file
+// (cf. pdf_set_system_font_index_path) and is memory-mapped on the next start. Font files
+// are only parsed again if they have been added or modified in the meantime.
+// The index consists of a font_index_header followed by the font_index_file records
+// (sorted by path), the font_index_face records (sorted by name) and the strings.
+#define FONT_INDEX_MAGIC 0x58444946 /* 'FIDX' */
+#define FONT_INDEX_VERSION 1
+
+typedef struct {
+    DWORD magic;
+    DWORD version;
+    DWORD nfiles;
+    DWORD nfaces;
+    DWORD strings_len;
+} font_index_header;
+
+typedef struct {
+    DWORD path; // offset into the strings
+    FILETIME mtime;
+    DWORD size_high;
+    DWORD size_low;
+} font_index_file;
+
+typedef struct {
+    DWORD name; // offset into the strings
+    DWORD file; // index into the font_index_file records
+    int index;  // index of the face in a TrueType collection
+} font_index_face;
+
+// an index being put together from the font directory's listing
+typedef struct {
+    font_index_file* files;
+    int nfiles;
+    int files_cap;
+    font_index_face* faces;
+    int nfaces;
+    int faces_cap;
+    char* strings;
+    int strings_len;
+    int strings_cap;
+    // the file whose faces are currently being parsed
+    int curr_file;
+} font_index_builder;
+
 typedef struct {
     ULONG uVersion;
     USHORT uNumOfTables;
@@ -102,6 +145,21 @@ static pdf_fontlistMS fontlistMS = {
     0,
 };
 
+// the index the entries of fontlistMS point into, either
+// a view of the index file or a malloc'd copy of it
+static struct {
+    const char* data;
+    size_t len;
+    HANDLE mapping;
+} fontindex = {
+    NULL,
+    0,
+    NULL,
+};
+
+static WCHAR font_dir[MAX_PATH];
+static WCHAR font_index_path[MAX_PATH];
+
 static int did_init = 0;
 static CRITICAL_SECTION cs_fonts;
 
@@ -148,8 +206,13 @@ static int str_ends_with(const char* str, const char* end) {
     return len1 >= len2 && !strcmp(str + len1 - len2, end);
 }
 
+static int lookup_font_info(const void* fontname, const void* elem) {
+    return lookup_compare(fontname, ((const sys_font_info*)elem)->fontface);
+}
+
 static sys_font_info* pdf_find_windows_font_path(const char* fontname) {
-    return (sys_font_info*)bsearch(fontname, fontlistMS.fontmap, fontlistMS.len, sizeof(sys_font_info), lookup_compare);
+    return (sys_font_info*)bsearch(fontname, fontlistMS.fontmap, fontlistMS.len, sizeof(sys_font_info),
+                                   lookup_font_info);
 }
 
 /* source and dest can be same */
@@ -207,38 +270,57 @@ static void decode_platform_string(fz_context* ctx, int platform, int enctype, c
     }
 }
 
-static void grow_system_font_list(fz_context* ctx, pdf_fontlistMS* fl) {
-    int newcap;
-    sys_font_info* newitems;
-
-    if (fl->cap == 0)
-        newcap = 1024;
-    else
-        newcap = fl->cap * 2;
-
-    // use realloc/free for the fontmap, since the list can
-    // remain in memory even with all fz_contexts destroyed
-    newitems = (sys_font_info*)realloc(fl->fontmap, newcap * sizeof(sys_font_info));
-    if (!newitems)
-        fz_throw(ctx, FZ_ERROR_GENERIC, "OOM in grow_system_font_list");
-    memset(newitems + fl->cap, 0, sizeof(sys_font_info) * (newcap - fl->cap));
-
-    fl->fontmap = newitems;
-    fl->cap = newcap;
+static int add_index_string(fz_context* ctx, font_index_builder* fib, const char* str) {
+    int len = (int)strlen(str) + 1;
+    int offset = fib->strings_len;
+    if (fib->strings_len + len > fib->strings_cap) {
+        int newcap = fz_maxi(fib->strings_cap * 2, fib->strings_len + len + 4096);
+        fib->strings = fz_realloc_array(ctx, fib->strings, newcap, char);
+        fib->strings_cap = newcap;
+    }
+    memcpy(fib->strings + offset, str, len);
+    fib->strings_len += len;
+    return offset;
 }
 
-static void append_mapping(fz_context* ctx, pdf_fontlistMS* fl, const char* facename, const char* path, int index) {
-    if (fl->len == fl->cap)
-        grow_system_font_list(ctx, fl);
+static void add_index_file(fz_context* ctx, font_index_builder* fib, const char* path, WIN32_FIND_DATA* data) {
+    font_index_file* file;
+    if (fib->nfiles == fib->files_cap) {
+        int newcap = fz_maxi(fib->files_cap * 2, 256);
+        fib->files = fz_realloc_array(ctx, fib->files, newcap, font_index_file);
+        fib->files_cap = newcap;
+    }
+    file = &fib->files[fib->nfiles];
+    file->path = add_index_string(ctx, fib, path);
+    file->mtime = data->ftLastWriteTime;
+    file->size_high = data->nFileSizeHigh;
+    file->size_low = data->nFileSizeLow;
+    fib->nfiles++;
+}
 
-    if (fl->len >= fl->cap)
-        fz_throw(ctx, FZ_ERROR_GENERIC, "fonterror : fontlist overflow");
+static void add_index_face(fz_context* ctx, font_index_builder* fib, const char* facename, int file, int index) {
+    font_index_face* face;
+    if (fib->nfaces == fib->faces_cap) {
+        int newcap = fz_maxi(fib->faces_cap * 2, 1024);
+        fib->faces = fz_realloc_array(ctx, fib->faces, newcap, font_index_face);
+        fib->faces_cap = newcap;
+    }
+    face = &fib->faces[fib->nfaces];
+    face->name = add_index_string(ctx, fib, facename);
+    face->file = file;
+    face->index = index;
+    fib->nfaces++;
+}
 
-    fz_strlcpy(fl->fontmap[fl->len].fontface, facename, sizeof(fl->fontmap[0].fontface));
-    fz_strlcpy(fl->fontmap[fl->len].fontpath, path, sizeof(fl->fontmap[0].fontpath));
-    fl->fontmap[fl->len].index = index;
+static void drop_font_index_builder(fz_context* ctx, font_index_builder* fib) {
+    fz_free(ctx, fib->files);
+    fz_free(ctx, fib->faces);
+    fz_free(ctx, fib->strings);
+    memset(fib, 0, sizeof(*fib));
+}
 
-    ++fl->len;
+static void append_mapping(fz_context* ctx, font_index_builder* fib, const char* facename, int index) {
+    add_index_face(ctx, fib, facename, fib->curr_file, index);
 }
 
 static void safe_read(fz_context* ctx, fz_stream* file, int offset, char* buf, int size) {
@@ -271,7 +353,8 @@ static void makeFakePSName(char szName[MAX_FACENAME], const char* szStyle) {
     remove_spaces(szName);
 }
 
-static void parseTTF(fz_context* ctx, fz_stream* file, int offset, int index, const char* path) {
+static void parseTTF(fz_context* ctx, font_index_builder* fib, fz_stream* file, int offset, int index,
+                     const char* path) {
     TT_OFFSET_TABLE ttOffsetTableBE;
     TT_TABLE_DIRECTORY tblDirBE;
     TT_NAME_TABLE_HEADER ttNTHeaderBE;
@@ -352,27 +435,27 @@ static void parseTTF(fz_context* ctx, fz_stream* file, int offset, int index, co
     }
 
     if (szPSName[0])
-        append_mapping(ctx, &fontlistMS, szPSName, path, index);
+        append_mapping(ctx, fib, szPSName, index);
     if (szTTName[0]) {
         // derive a PostScript-like name and add it, if it's different from the font's
         // included PostScript name; cf. http://code.google.com/p/sumatrapdf/issues/detail?id=376
         makeFakePSName(szTTName, szStyle);
         // compare the two names before adding this one
         if (lookup_compare(szTTName, szPSName))
-            append_mapping(ctx, &fontlistMS, szTTName, path, index);
+            append_mapping(ctx, fib, szTTName, index);
     }
     if (szCJKName[0]) {
         makeFakePSName(szCJKName, szStyle);
         if (lookup_compare(szCJKName, szPSName) && lookup_compare(szCJKName, szTTName))
-            append_mapping(ctx, &fontlistMS, szCJKName, path, index);
+            append_mapping(ctx, fib, szCJKName, index);
     }
 }
 
-static void parseTTFs(fz_context* ctx, const char* path) {
+static void parseTTFs(fz_context* ctx, font_index_builder* fib, const char* path) {
     fz_stream* file = fz_open_file(ctx, path);
     /* "fonterror : %s not found", path */
     fz_try(ctx) {
-        parseTTF(ctx, file, 0, 0, path);
+        parseTTF(ctx, fib, file, 0, 0, path);
     }
     fz_always(ctx) {
         fz_drop_stream(ctx, file);
@@ -382,7 +465,7 @@ static void parseTTFs(fz_context* ctx, const char* path) {
     }
 }
 
-static void parseTTCs(fz_context* ctx, const char* path) {
+static void parseTTCs(fz_context* ctx, font_index_builder* fib, const char* path) {
     FONT_COLLECTION fontcollectionBE;
     ULONG i, numFonts, *offsettableBE = NULL;
 
@@ -405,7 +488,7 @@ static void parseTTCs(fz_context* ctx, const char* path) {
         int offset = (int)sizeof(FONT_COLLECTION);
         safe_read(ctx, file, offset, (char*)offsettableBE, numFonts * sizeof(ULONG));
         for (i = 0; i < numFonts; i++) {
-            parseTTF(ctx, file, BEtoHl(offsettableBE[i]), i, path);
+            parseTTF(ctx, fib, file, BEtoHl(offsettableBE[i]), i, path);
         }
     }
     fz_always(ctx) {
@@ -417,43 +500,312 @@ static void parseTTCs(fz_context* ctx, const char* path) {
     }
 }
 
-static void extend_system_font_list(fz_context* ctx, const WCHAR* path) {
+// adds all font files matching the pattern (e.g. "C:\Windows\Fonts\*.?t?") to the index
+static void add_font_files(fz_context* ctx, font_index_builder* fib, const WCHAR* pattern) {
     WCHAR szPath[MAX_PATH], *lpFileName;
     WIN32_FIND_DATA FileData;
     HANDLE hList;
 
-    GetFullPathName(path, nelem(szPath), szPath, &lpFileName);
+    GetFullPathName(pattern, nelem(szPath), szPath, &lpFileName);
 
     hList = FindFirstFile(szPath, &FileData);
     if (hList == INVALID_HANDLE_VALUE) {
         // Don't complain about missing directories
-        if (GetLastError() == ERROR_FILE_NOT_FOUND)
+        if (GetLastError() == ERROR_FILE_NOT_FOUND || GetLastError() == ERROR_PATH_NOT_FOUND)
             return;
-        fz_throw(ctx, FZ_ERROR_GENERIC, "extend_system_font_list: unknown error %d", GetLastError());
-    }
-    do {
-        if (!(FileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
-            char szPathUtf8[MAX_PATH], *fileExt;
-            int res;
-            lstrcpyn(lpFileName, FileData.cFileName, szPath + MAX_PATH - lpFileName);
-            res = WideCharToMultiByte(CP_UTF8, 0, szPath, -1, szPathUtf8, sizeof(szPathUtf8), NULL, NULL);
-            if (!res) {
-                fz_warn(ctx, "WideCharToMultiByte failed for %S", szPath);
-                continue;
+        fz_throw(ctx, FZ_ERROR_GENERIC, "add_font_files: unknown error %d", GetLastError());
+    }
+    fz_try(ctx) {
+        do {
+            if (!(FileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+                char szPathUtf8[MAX_PATH], *fileExt;
+                int res;
+                lstrcpyn(lpFileName, FileData.cFileName, szPath + MAX_PATH - lpFileName);
+                res = WideCharToMultiByte(CP_UTF8, 0, szPath, -1, szPathUtf8, sizeof(szPathUtf8), NULL, NULL);
+                if (!res) {
+                    fz_warn(ctx, "WideCharToMultiByte failed for %S", szPath);
+                    continue;
+                }
+                fileExt = szPathUtf8 + strlen(szPathUtf8) - 4;
+                if (!_stricmp(fileExt, ".ttc") || !_stricmp(fileExt, ".ttf") || !_stricmp(fileExt, ".otf"))
+                    add_index_file(ctx, fib, szPathUtf8, &FileData);
             }
-            fileExt = szPathUtf8 + strlen(szPathUtf8) - 4;
-            fz_try(ctx) {
-                if (!_stricmp(fileExt, ".ttc"))
-                    parseTTCs(ctx, szPathUtf8);
-                else if (!_stricmp(fileExt, ".ttf") || !_stricmp(fileExt, ".otf"))
-                    parseTTFs(ctx, szPathUtf8);
+        } while (FindNextFile(hList, &FileData));
+    }
+    fz_always(ctx) {
+        FindClose(hList);
+    }
+    fz_catch(ctx) {
+        fz_rethrow(ctx);
+    }
+}
+
+static void parse_font_file(fz_context* ctx, font_index_builder* fib, int file) {
+    // the strings can be reallocated while the file's faces are added
+    char* path = fz_strdup(ctx, fib->strings + fib->files[file].path);
+    char* fileExt = path + strlen(path) - 4;
+
+    fib->curr_file = file;
+    fz_try(ctx) {
+        if (!_stricmp(fileExt, ".ttc"))
+            parseTTCs(ctx, fib, path);
+        else
+            parseTTFs(ctx, fib, path);
+    }
+    fz_always(ctx) {
+        fz_free(ctx, path);
+    }
+    fz_catch(ctx) {
+        // ignore errors occurring while parsing a given font file
+    }
+}
+
+static void get_font_index_parts(const char* data, font_index_file** files, font_index_face** faces,
+                                 const char** strings) {
+    const font_index_header* hdr = (const font_index_header*)data;
+    *files = (font_index_file*)(hdr + 1);
+    *faces = (font_index_face*)(*files + hdr->nfiles);
+    *strings = (const char*)(*faces + hdr->nfaces);
+}
+
+// makes sure that an index read from disk can't point outside of itself
+static int is_valid_font_index(const char* data, size_t len) {
+    const font_index_header* hdr = (const font_index_header*)data;
+    font_index_file* files;
+    font_index_face* faces;
+    const char* strings;
+    DWORD i;
+
+    if (len < sizeof(font_index_header) || hdr->magic != FONT_INDEX_MAGIC || hdr->version != FONT_INDEX_VERSION)
+        return 0;
+    if (hdr->nfiles > len || hdr->nfaces > len || hdr->strings_len == 0 || hdr->strings_len > len)
+        return 0;
+    if (sizeof(font_index_header) + (ULONGLONG)hdr->nfiles * sizeof(font_index_file) +
+            (ULONGLONG)hdr->nfaces * sizeof(font_index_face) + hdr->strings_len !=
+        len)
+        return 0;
+    get_font_index_parts(data, &files, &faces, &strings);
+    if (strings[hdr->strings_len - 1] != '\0')
+        return 0;
+    for (i = 0; i < hdr->nfiles; i++) {
+        if (files[i].path >= hdr->strings_len)
+            return 0;
+    }
+    for (i = 0; i < hdr->nfaces; i++) {
+        if (faces[i].name >= hdr->strings_len || faces[i].file >= hdr->nfiles)
+            return 0;
+    }
+    return 1;
+}
+
+static void drop_font_index(void) {
+    if (fontindex.mapping) {
+        UnmapViewOfFile(fontindex.data);
+        CloseHandle(fontindex.mapping);
+    } else {
+        free((void*)fontindex.data);
+    }
+    memset(&fontindex, 0, sizeof(fontindex));
+}
+
+static void map_font_index(void) {
+    HANDLE hFile, hMap = NULL;
+    LARGE_INTEGER size;
+    const char* data = NULL;
+
+    hFile = CreateFile(font_index_path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return;
+    if (GetFileSizeEx(hFile, &size) && size.QuadPart > 0 && size.QuadPart < INT_MAX)
+        hMap = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (hMap)
+        data = (const char*)MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(hFile);
+
+    if (data && is_valid_font_index(data, (size_t)size.QuadPart)) {
+        fontindex.data = data;
+        fontindex.len = (size_t)size.QuadPart;
+        fontindex.mapping = hMap;
+        return;
+    }
+    if (data)
+        UnmapViewOfFile(data);
+    if (hMap)
+        CloseHandle(hMap);
+}
+
+static void save_font_index(fz_context* ctx) {
+    WCHAR tmpPath[MAX_PATH + 4];
+    HANDLE hFile;
+    DWORD written;
+    BOOL ok;
+
+    // font_index_path is at most MAX_PATH - 1 characters long
+    wcscpy_s(tmpPath, nelem(tmpPath), font_index_path);
+    wcscat_s(tmpPath, nelem(tmpPath), L".tmp");
+    hFile = CreateFile(tmpPath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        fz_warn(ctx, "couldn't save the system font index to %S", font_index_path);
+        return;
+    }
+    ok = WriteFile(hFile, fontindex.data, (DWORD)fontindex.len, &written, NULL) && written == fontindex.len;
+    CloseHandle(hFile);
+    // replace the previous index at once, so that it's never seen incomplete
+    if (!ok || !MoveFileEx(tmpPath, font_index_path, MOVEFILE_REPLACE_EXISTING)) {
+        DeleteFile(tmpPath);
+        fz_warn(ctx, "couldn't save the system font index to %S", font_index_path);
+    }
+}
+
+static int cmp_index_file_paths(void* strings, const void* elem1, const void* elem2) {
+    const char* path1 = (const char*)strings + ((const font_index_file*)elem1)->path;
+    const char* path2 = (const char*)strings + ((const font_index_file*)elem2)->path;
+    return _stricmp(path1, path2);
+}
+
+static int cmp_index_face_names(void* strings, const void* elem1, const void* elem2) {
+    const char* name1 = (const char*)strings + ((const font_index_face*)elem1)->name;
+    const char* name2 = (const char*)strings + ((const font_index_face*)elem2)->name;
+    return _stricmp(name1, name2);
+}
+
+static int is_same_font_file(const font_index_file* file1, const font_index_file* file2) {
+    return !CompareFileTime(&file1->mtime, &file2->mtime) && file1->size_high == file2->size_high &&
+           file1->size_low == file2->size_low;
+}
+
+// returns 1 if the loaded index lists exactly the same (unmodified) files as fib
+static int is_font_index_current(font_index_builder* fib) {
+    const font_index_header* hdr = (const font_index_header*)fontindex.data;
+    font_index_file* files;
+    font_index_face* faces;
+    const char* strings;
+    int i;
+
+    if (!hdr || hdr->nfiles != (DWORD)fib->nfiles)
+        return 0;
+    get_font_index_parts(fontindex.data, &files, &faces, &strings);
+    for (i = 0; i < fib->nfiles; i++) {
+        if (_stricmp(strings + files[i].path, fib->strings + fib->files[i].path) != 0 ||
+            !is_same_font_file(&files[i], &fib->files[i]))
+            return 0;
+    }
+    return 1;
+}
+
+// adds the faces of all files in fib, taking them from the loaded index for unmodified files
+static void update_font_index_faces(fz_context* ctx, font_index_builder* fib) {
+    const font_index_header* hdr = (const font_index_header*)fontindex.data;
+    font_index_file* files = NULL;
+    font_index_face* faces = NULL;
+    const char* strings = NULL;
+    int* file_map = NULL;
+    char* is_indexed = NULL;
+    int nfiles = hdr ? (int)hdr->nfiles : 0;
+    int i, j;
+
+    fz_var(file_map);
+    fz_var(is_indexed);
+
+    fz_try(ctx) {
+        is_indexed = fz_malloc_array(ctx, fib->nfiles + 1, char);
+        memset(is_indexed, 0, fib->nfiles + 1);
+        if (hdr) {
+            // both lists of files are sorted by path, so they can be merged
+            get_font_index_parts(fontindex.data, &files, &faces, &strings);
+            file_map = fz_malloc_array(ctx, nfiles + 1, int);
+            for (i = 0, j = 0; i < nfiles; i++) {
+                int cmp = 1;
+                while (j < fib->nfiles &&
+                       (cmp = _stricmp(strings + files[i].path, fib->strings + fib->files[j].path)) > 0)
+                    j++;
+                file_map[i] = -1;
+                if (cmp == 0 && is_same_font_file(&files[i], &fib->files[j])) {
+                    file_map[i] = j;
+                    is_indexed[j] = 1;
+                }
             }
-            fz_catch(ctx) {
-                // ignore errors occurring while parsing a given font file
+            for (i = 0; i < (int)hdr->nfaces; i++) {
+                if (file_map[faces[i].file] >= 0)
+                    add_index_face(ctx, fib, strings + faces[i].name, file_map[faces[i].file], faces[i].index);
             }
         }
-    } while (FindNextFile(hList, &FileData));
-    FindClose(hList);
+        for (j = 0; j < fib->nfiles; j++) {
+            if (!is_indexed[j])
+                parse_font_file(ctx, fib, j);
+        }
+    }
+    fz_always(ctx) {
+        fz_free(ctx, file_map);
+        fz_free(ctx, is_indexed);
+    }
+    fz_catch(ctx) {
+        fz_rethrow(ctx);
+    }
+}
+
+// replaces the loaded index with the one put together in fib
+static void set_font_index(fz_context* ctx, font_index_builder* fib) {
+    font_index_header hdr;
+    font_index_file* files;
+    font_index_face* faces;
+    const char* strings;
+    size_t len;
+    char* data;
+
+    // sort the faces, so that they can be searched binarily
+    qsort_s(fib->faces, (size_t)fib->nfaces, sizeof(font_index_face), cmp_index_face_names, fib->strings);
+
+    hdr.magic = FONT_INDEX_MAGIC;
+    hdr.version = FONT_INDEX_VERSION;
+    hdr.nfiles = fib->nfiles;
+    hdr.nfaces = fib->nfaces;
+    // make sure that there's always at least one string
+    if (fib->strings_len == 0)
+        add_index_string(ctx, fib, "");
+    hdr.strings_len = fib->strings_len;
+
+    len = sizeof(hdr) + fib->nfiles * sizeof(font_index_file) + fib->nfaces * sizeof(font_index_face) +
+          fib->strings_len;
+    // use malloc/free for the index, since it
+    // remains in memory even with all fz_contexts destroyed
+    data = (char*)malloc(len);
+    if (!data)
+        fz_throw(ctx, FZ_ERROR_MEMORY, "OOM in set_font_index");
+    memcpy(data, &hdr, sizeof(hdr));
+    get_font_index_parts(data, &files, &faces, &strings);
+    memcpy(files, fib->files, fib->nfiles * sizeof(font_index_file));
+    memcpy(faces, fib->faces, fib->nfaces * sizeof(font_index_face));
+    memcpy((char*)strings, fib->strings, fib->strings_len);
+
+    drop_font_index();
+    fontindex.data = data;
+    fontindex.len = len;
+}
+
+static void load_font_list_from_index(fz_context* ctx) {
+    const font_index_header* hdr = (const font_index_header*)fontindex.data;
+    font_index_file* files;
+    font_index_face* faces;
+    const char* strings;
+    sys_font_info* fontmap;
+    int i;
+
+    get_font_index_parts(fontindex.data, &files, &faces, &strings);
+    // use realloc/free for the fontmap, since the list can
+    // remain in memory even with all fz_contexts destroyed
+    fontmap = (sys_font_info*)realloc(fontlistMS.fontmap, (hdr->nfaces + 1) * sizeof(sys_font_info));
+    if (!fontmap)
+        fz_throw(ctx, FZ_ERROR_MEMORY, "OOM in load_font_list_from_index");
+    for (i = 0; i < (int)hdr->nfaces; i++) {
+        fontmap[i].fontface = strings + faces[i].name;
+        fontmap[i].fontpath = strings + files[faces[i].file].path;
+        fontmap[i].index = faces[i].index;
+    }
+    fontlistMS.fontmap = fontmap;
+    fontlistMS.cap = hdr->nfaces + 1;
+    fontlistMS.len = hdr->nfaces;
 }
 
 // cf. http://blogs.msdn.com/b/oldnewthing/archive/2004/10/25/247180.aspx
@@ -461,51 +813,60 @@ EXTERN_C IMAGE_DOS_HEADER __ImageBase;
 #define CURRENT_HMODULE ((HMODULE)&__ImageBase)
 
 static void create_system_font_list(fz_context* ctx) {
+    font_index_builder fib = {0};
     WCHAR szFontDir[MAX_PATH];
     UINT cch;
 
-    cch = GetWindowsDirectory(szFontDir, nelem(szFontDir) - 12);
-    if (0 < cch && cch < nelem(szFontDir) - 12) {
-        wcscat_s(szFontDir, MAX_PATH, L"\\Fonts\\*.?t?");
-        extend_system_font_list(ctx, szFontDir);
-    }
+    if (font_index_path[0] && !fontindex.data)
+        map_font_index();
 
-    if (fontlistMS.len == 0)
-        fz_warn(ctx, "couldn't find any usable system fonts");
+    fz_try(ctx) {
+        if (font_dir[0]) {
+            if (wcslen(font_dir) < nelem(szFontDir) - 7) {
+                wcscpy_s(szFontDir, nelem(szFontDir), font_dir);
+                wcscat_s(szFontDir, nelem(szFontDir), L"\\*.?t?");
+                add_font_files(ctx, &fib, szFontDir);
+            }
+        } else {
+            cch = GetWindowsDirectory(szFontDir, nelem(szFontDir) - 12);
+            if (0 < cch && cch < nelem(szFontDir) - 12) {
+                wcscat_s(szFontDir, MAX_PATH, L"\\Fonts\\*.?t?");
+                add_font_files(ctx, &fib, szFontDir);
+            }
+        }
 
 #ifdef NOCJKFONT
-    {
-        // If no CJK fallback font is builtin but one has been shipped separately (in the same
-        // directory as the main executable), add it to the list of loadable system fonts
-        WCHAR szFile[MAX_PATH], *lpFileName;
-        szFile[0] = '\0';
-        GetModuleFileName(CURRENT_HMODULE, szFontDir, MAX_PATH);
-        szFontDir[nelem(szFontDir) - 1] = '\0';
-        GetFullPathName(szFontDir, MAX_PATH, szFile, &lpFileName);
-        lstrcpyn(lpFileName, L"DroidSansFallback.ttf", szFile + MAX_PATH - lpFileName);
-        extend_system_font_list(ctx, szFile);
-    }
+        {
+            // If no CJK fallback font is builtin but one has been shipped separately (in the same
+            // directory as the main executable), add it to the list of loadable system fonts
+            WCHAR szFile[MAX_PATH], *lpFileName;
+            szFile[0] = '\0';
+            GetModuleFileName(CURRENT_HMODULE, szFontDir, MAX_PATH);
+            szFontDir[nelem(szFontDir) - 1] = '\0';
+            GetFullPathName(szFontDir, MAX_PATH, szFile, &lpFileName);
+            lstrcpyn(lpFileName, L"DroidSansFallback.ttf", szFile + MAX_PATH - lpFileName);
+            add_font_files(ctx, &fib, szFile);
+        }
 #endif
 
-    // sort the font list, so that it can be searched binarily
-    qsort((void*)fontlistMS.fontmap, (size_t)fontlistMS.len, sizeof(sys_font_info), _stricmp);
-
-#ifdef DEBUG
-    // allow to overwrite system fonts for debugging purposes
-    // (either pass a full path or a search pattern such as "fonts\*.ttf")
-    cch = GetEnvironmentVariable(L"MUPDF_FONTS_PATTERN", szFontDir, nelem(szFontDir));
-    if (0 < cch && cch < nelem(szFontDir)) {
-        int i, prev_len = fontlistMS.len;
-        extend_system_font_list(ctx, szFontDir);
-        for (i = prev_len; i < fontlistMS.len; i++) {
-            sys_font_info* entry = bsearch(fontlistMS.fontmap[i].fontface, fontlistMS.fontmap, prev_len,
-                                           sizeof(sys_font_info), lookup_compare);
-            if (entry)
-                *entry = fontlistMS.fontmap[i];
+        qsort_s(fib.files, (size_t)fib.nfiles, sizeof(font_index_file), cmp_index_file_paths, fib.strings);
+        if (!is_font_index_current(&fib)) {
+            update_font_index_faces(ctx, &fib);
+            set_font_index(ctx, &fib);
+            if (font_index_path[0])
+                save_font_index(ctx);
         }
-        qsort(fontlistMS.fontmap, fontlistMS.len, sizeof(sys_font_info), _stricmp);
+        load_font_list_from_index(ctx);
     }
-#endif
+    fz_always(ctx) {
+        drop_font_index_builder(ctx, &fib);
+    }
+    fz_catch(ctx) {
+        fz_rethrow(ctx);
+    }
+
+    if (fontlistMS.len == 0)
+        fz_warn(ctx, "couldn't find any usable system fonts");
 }
 
 // TODO(port): replace the caller
@@ -516,59 +877,61 @@ static void* fz_resize_array(fz_context* ctx, void* p, unsigned int count, unsig
     return np;
 }
 
+// system fonts are only read once per process and kept for its lifetime.
+// every fz_context (which might have locks of its own) gets its own
+// fz_buffer for the data (cf. fz_new_buffer_from_shared_data)
 typedef struct cached_font {
     struct cached_font* next;
     sys_font_info* fi;
-    fz_context* ctx;
-    fz_buffer* buffer;
+    unsigned char* data;
+    size_t len;
 } cached_font;
 
 static cached_font* cached_fonts = 0;
 
-static fz_buffer* get_cached_font_buffer(fz_context* ctx, sys_font_info* fi) {
+static cached_font* find_cached_font(sys_font_info* fi) {
     EnterCriticalSection(&cs_fonts);
     cached_font* f = cached_fonts;
-    fz_buffer* buffer = NULL;
-    while (f) {
-        if (f->ctx == ctx && f->fi == fi) {
-            buffer = f->buffer;
-            break;
-        }
+    while (f && f->fi != fi) {
         f = f->next;
     }
     LeaveCriticalSection(&cs_fonts);
-    return buffer;
+    return f;
 }
 
-void drop_cached_fonts_for_ctx(fz_context* ctx) {
-    EnterCriticalSection(&cs_fonts);
+// returns the cached font (which might have been added by another
+// thread in the meantime) or NULL if out of memory
+static cached_font* add_cached_font(sys_font_info* fi, fz_buffer* buffer) {
+    cached_font* f = (cached_font*)malloc(sizeof(cached_font));
+    if (!f) {
+        return find_cached_font(fi);
+    }
+    f->data = (unsigned char*)malloc(buffer->len ? buffer->len : 1);
+    if (!f->data) {
+        free(f);
+        return find_cached_font(fi);
+    }
+    memcpy(f->data, buffer->data, buffer->len);
+    f->len = buffer->len;
+    f->fi = fi;
 
-    cached_font** currp = &cached_fonts;
-    cached_font** nextp;
-    cached_font* curr;
-    cached_font* next;
-    int refs;
-    while (1) {
-        curr = *currp;
-        if (!curr) {
-            break;
-        }
-        nextp = &(curr->next);
-        if (curr->ctx == ctx) {
-            next = *nextp;
-            refs = curr->buffer->refs;
-            if (refs != 1) {
-                // TODO: crash?
-                fz_warn(ctx, "drop_cached_fonts_for_ctx: bad refcount %d", refs);
-            }
-            fz_drop_buffer(curr->ctx, curr->buffer);
-            free(curr);
-            *currp = next;
-        } else {
-            currp = nextp;
-        }
+    EnterCriticalSection(&cs_fonts);
+    cached_font* existing = cached_fonts;
+    while (existing && existing->fi != fi) {
+        existing = existing->next;
+    }
+    if (!existing) {
+        f->next = cached_fonts;
+        cached_fonts = f;
     }
     LeaveCriticalSection(&cs_fonts);
+
+    if (existing) {
+        free(f->data);
+        free(f);
+        return existing;
+    }
+    return f;
 }
 
 static fz_font* pdf_load_windows_font_by_name(fz_context* ctx, const char* orig_name) {
@@ -644,28 +1007,36 @@ static fz_font* pdf_load_windows_font_by_name(fz_context* ctx, const char* orig_
     if (!found)
         fz_throw(ctx, FZ_ERROR_GENERIC, "couldn't find system font '%s'", orig_name);
 
-    buffer = get_cached_font_buffer(ctx, found);
-    if (buffer) {
+    cached_font* cached = find_cached_font(found);
+    if (cached) {
         fz_warn(ctx, "found cached non-embedded buffer for font '%s' from '%s'", orig_name, found->fontpath);
+        buffer = fz_new_buffer_from_shared_data(ctx, cached->data, cached->len);
     } else {
-        buffer = fz_read_file(ctx, found->fontpath);
-        if (!buffer) {
+        fz_buffer* loaded = fz_read_file(ctx, found->fontpath);
+        if (!loaded) {
             return NULL;
         }
-        cached_font* f = (cached_font*)malloc(sizeof(cached_font));
-        f->fi = found;
-        f->ctx = ctx;
-        f->buffer = buffer;
-        EnterCriticalSection(&cs_fonts);
-        f->next = cached_fonts;
-        cached_fonts = f;
-        LeaveCriticalSection(&cs_fonts);
+        cached = add_cached_font(found, loaded);
+        if (cached) {
+            fz_drop_buffer(ctx, loaded);
+            buffer = fz_new_buffer_from_shared_data(ctx, cached->data, cached->len);
+        } else {
+            buffer = loaded;
+        }
 
         fz_warn(ctx, "loading non-embedded font '%s' from '%s'", orig_name, found->fontpath);
     }
 
     int use_glyph_bbox = strcmp(found->fontface, "DroidSansFallback") != 0;
-    font = fz_new_font_from_buffer(ctx, orig_name, buffer, found->index, use_glyph_bbox);
+    fz_try(ctx) {
+        font = fz_new_font_from_buffer(ctx, orig_name, buffer, found->index, use_glyph_bbox);
+    }
+    fz_always(ctx) {
+        fz_drop_buffer(ctx, buffer);
+    }
+    fz_catch(ctx) {
+        fz_rethrow(ctx);
+    }
     font->flags.ft_substitute = 1;
     return font;
 }
@@ -762,7 +1133,27 @@ static fz_font* pdf_load_windows_cjk_font(fz_context* ctx, const char* fontname,
 
     return font;
 }
-#endif
+
+// sets the directory containing the system fonts (%WINDIR%\Fonts by default)
+// must be called before the first document is loaded
+void pdf_set_system_font_dir(const WCHAR* dir) {
+    size_t len;
+    font_dir[0] = '\0';
+    if (dir)
+        lstrcpyn(font_dir, dir, nelem(font_dir));
+    len = wcslen(font_dir);
+    while (len > 0 && (font_dir[len - 1] == '\\' || font_dir[len - 1] == '/'))
+        font_dir[--len] = '\0';
+}
+
+// sets the path of the file in which to save the index of the system fonts,
+// so that they don't have to be parsed again on the next start (not saved by default)
+// must be called before the first document is loaded
+void pdf_set_system_font_index_path(const WCHAR* path) {
+    font_index_path[0] = '\0';
+    if (path)
+        lstrcpyn(font_index_path, path, nelem(font_index_path));
+}
 
 void init_system_font_list(void) {
     // this should always happen on main thread
@@ -775,8 +1166,10 @@ void init_system_font_list(void) {
 void destroy_system_font_list(void) {
     free(fontlistMS.fontmap);
     memset(&fontlistMS, 0, sizeof(fontlistMS));
+    drop_font_index();
     DeleteCriticalSection(&cs_fonts);
 }
+#endif
 
 void pdf_install_load_system_font_funcs(fz_context* ctx) {
 #ifdef _WIN32
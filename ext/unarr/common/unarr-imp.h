@@ -72,6 +72,8 @@ struct ar_archive_s {
     off64_t entry_offset_next;
     size_t entry_size_uncompressed;
     time64_t entry_filetime;
+    /* set by formats supporting solid compression (-1 otherwise) */
+    off64_t entry_solid_start;
 };
 
 ar_archive *ar_open_archive(ar_stream *stream, size_t struct_size, ar_archive_close_fn close, ar_parse_entry_fn parse_entry,
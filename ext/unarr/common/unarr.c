@@ -19,6 +19,7 @@ ar_archive *ar_open_archive(ar_stream *stream, size_t struct_size, ar_archive_cl
     ar->stream = stream;
     ar->entry_offset_first = first_entry_offset;
     ar->entry_offset_next = first_entry_offset;
+    ar->entry_solid_start = -1;
     return ar;
 }
 
@@ -36,12 +37,14 @@ bool ar_at_eof(ar_archive *ar)
 
 bool ar_parse_entry(ar_archive *ar)
 {
+    ar->entry_solid_start = -1;
     return ar->parse_entry(ar, ar->entry_offset_next);
 }
 
 bool ar_parse_entry_at(ar_archive *ar, off64_t offset)
 {
     ar->at_eof = false;
+    ar->entry_solid_start = -1;
     return ar->parse_entry(ar, offset ? offset : ar->entry_offset_first);
 }
 
@@ -80,6 +83,11 @@ time64_t ar_entry_get_filetime(ar_archive *ar)
     return ar->entry_filetime;
 }
 
+off64_t ar_entry_get_solid_start(ar_archive *ar)
+{
+    return ar->entry_solid_start >= 0 ? ar->entry_solid_start : ar->entry_offset;
+}
+
 bool ar_entry_uncompress(ar_archive *ar, void *buffer, size_t count)
 {
     return ar->uncompress(ar, buffer, count);
@@ -7,9 +7,50 @@ static void rar_close(ar_archive *ar)
 {
     ar_archive_rar *rar = (ar_archive_rar *)ar;
     free(rar->entry.name);
+    free(rar->checkpoints.offsets);
     rar_clear_uncompress(&rar->uncomp);
 }
 
+static size_t rar_find_checkpoint(ar_archive_rar *rar, off64_t offset)
+{
+    /* returns the index of the first checkpoint >= offset */
+    size_t lo = 0, hi = rar->checkpoints.count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (rar->checkpoints.offsets[mid] < offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static void rar_add_checkpoint(ar_archive_rar *rar, off64_t offset)
+{
+    struct ar_archive_rar_checkpoints *cp = &rar->checkpoints;
+    size_t idx = rar_find_checkpoint(rar, offset);
+    if (idx < cp->count && cp->offsets[idx] == offset)
+        return;
+    if (cp->count == cp->capacity) {
+        size_t capacity = cp->capacity ? cp->capacity * 2 : 64;
+        off64_t *offsets = realloc(cp->offsets, capacity * sizeof(off64_t));
+        if (!offsets)
+            return;
+        cp->offsets = offsets;
+        cp->capacity = capacity;
+    }
+    memmove(cp->offsets + idx + 1, cp->offsets + idx, (cp->count - idx) * sizeof(off64_t));
+    cp->offsets[idx] = offset;
+    cp->count++;
+}
+
+/* returns the offset of the closest entry before 'offset' where uncompression can restart */
+static off64_t rar_get_solid_start(ar_archive_rar *rar, off64_t offset)
+{
+    size_t idx = rar_find_checkpoint(rar, offset);
+    return idx > 0 ? rar->checkpoints.offsets[idx - 1] : rar->super.entry_offset_first;
+}
+
 static bool rar_parse_entry(ar_archive *ar, off64_t offset)
 {
     ar_archive_rar *rar = (ar_archive_rar *)ar;
@@ -78,6 +119,14 @@ static bool rar_parse_entry(ar_archive *ar, off64_t offset)
             else {
                 br_clear_leftover_bits(&rar->uncomp);
             }
+            /* the uncompression state is reset for stored entries as well */
+            if (!rar->entry.solid || rar->entry.method == METHOD_STORE) {
+                rar_add_checkpoint(rar, ar->entry_offset);
+                ar->entry_solid_start = ar->entry_offset;
+            }
+            else {
+                ar->entry_solid_start = rar_get_solid_start(rar, ar->entry_offset);
+            }
 
             rar->solid.restart = rar->entry.solid && (out_of_order || !rar->solid.part_done);
             rar->solid.part_done = !ar->entry_size_uncompressed;
@@ -137,7 +186,7 @@ static bool rar_restart_solid(ar_archive *ar)
     ar_archive_rar *rar = (ar_archive_rar *)ar;
     off64_t current_offset = ar->entry_offset;
     log("Restarting decompression for solid entry");
-    if (!ar_parse_entry_at(ar, ar->entry_offset_first)) {
+    if (!ar_parse_entry_at(ar, rar_get_solid_start(rar, current_offset))) {
         ar_parse_entry_at(ar, current_offset);
         return false;
     }
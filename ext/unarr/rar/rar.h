@@ -240,6 +240,14 @@ struct ar_archive_rar_solid {
     bool restart;
 };
 
+/* sorted offsets of the entries seen so far which don't depend on the
+   preceding ones (where rar_restart_solid can restart uncompression) */
+struct ar_archive_rar_checkpoints {
+    off64_t *offsets;
+    size_t count;
+    size_t capacity;
+};
+
 struct ar_archive_rar_s {
     ar_archive super;
     uint16_t archive_flags;
@@ -247,6 +255,7 @@ struct ar_archive_rar_s {
     struct ar_archive_rar_uncomp uncomp;
     struct ar_archive_rar_progress progress;
     struct ar_archive_rar_solid solid;
+    struct ar_archive_rar_checkpoints checkpoints;
 };
 
 #endif
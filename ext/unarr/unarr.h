@@ -66,6 +66,8 @@ off64_t ar_entry_get_offset(ar_archive *ar);
 size_t ar_entry_get_size(ar_archive *ar);
 /* returns the stored modification date of the current entry in 100ns since 1601/01/01 */
 time64_t ar_entry_get_filetime(ar_archive *ar);
+/* returns the offset of the entry where uncompression has to start for the current entry in solid archives (i.e. all entries from there on have to be uncompressed in order); same as ar_entry_get_offset for entries which can be uncompressed on their own */
+off64_t ar_entry_get_solid_start(ar_archive *ar);
 /* WARNING: don't manually seek in the stream between ar_parse_entry and the last corresponding ar_entry_uncompress call! */
 /* uncompresses the next 'count' bytes of the current entry into buffer; returns false on error */
 bool ar_entry_uncompress(ar_archive *ar, void *buffer, size_t count);
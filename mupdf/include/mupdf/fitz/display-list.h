@@ -96,6 +96,12 @@ void fz_drop_display_list(fz_context *ctx, fz_display_list *list);
 */
 fz_rect fz_bound_display_list(fz_context *ctx, fz_display_list *list);
 
+/**
+	sumatrapdf: Return the number of bytes used by the recorded
+	nodes of a display list (not counting the resources it keeps).
+*/
+size_t fz_display_list_size(fz_context *ctx, fz_display_list *list);
+
 /**
 	Create a new image from a display list.
 
@@ -227,6 +227,20 @@ void fz_install_load_system_font_funcs(fz_context *ctx,
 	fz_load_system_cjk_font_fn *f_cjk,
 	fz_load_system_fallback_font_fn *f_fallback);
 
+/**
+	sumatrapdf: Share font data between contexts which don't share
+	locks (e.g. one per document).
+
+	share returns data with the same content as data (and digest as
+	its MD5 digest) which stays valid until it's passed to release,
+	or NULL. Both must be thread-safe.
+
+	Only one set of hooks can be in use at a time (for all contexts).
+*/
+typedef const unsigned char *(fz_share_font_data_fn)(const unsigned char digest[16], const unsigned char *data, size_t len);
+typedef void (fz_release_font_data_fn)(const unsigned char *data);
+void fz_set_shared_font_data_funcs(fz_share_font_data_fn *share, fz_release_font_data_fn *release);
+
 /**
 	Attempt to load a given font from the system.
 
@@ -352,6 +352,15 @@ int fz_store_scavenge_external(fz_context *ctx, size_t size, int *phase);
 */
 int fz_shrink_store(fz_context *ctx, unsigned int percent);
 
+/**
+	sumatrapdf: Returns how many times the store has had to evict
+	items to stay within its maximum size (or to make room for an
+	allocation). Callers holding on to storables (e.g. through
+	display lists) can compare it with an earlier value to find out
+	whether the store is under memory pressure.
+*/
+int fz_store_scavenges(fz_context *ctx);
+
 /**
 	Callback function called by fz_filter_store on every item within
 	the store.
@@ -284,6 +284,26 @@ float fz_font_descender(fz_context *ctx, fz_font *font)
  * Freetype hooks
  */
 
+/* sumatrapdf: font data by content, so that the same font loaded several
+ * times (each of which gets its own fz_font) is only kept in memory once.
+ * shared is set if the data is also shared with other contexts */
+typedef struct fz_shared_font_data
+{
+	struct fz_shared_font_data *next;
+	unsigned char digest[16];
+	fz_buffer *buffer;
+	const unsigned char *shared;
+} fz_shared_font_data;
+
+static fz_share_font_data_fn *share_font_data_fn = NULL;
+static fz_release_font_data_fn *release_font_data_fn = NULL;
+
+void fz_set_shared_font_data_funcs(fz_share_font_data_fn *share, fz_release_font_data_fn *release)
+{
+	share_font_data_fn = share;
+	release_font_data_fn = release;
+}
+
 struct fz_font_context
 {
 	int ctx_refs;
@@ -300,6 +320,8 @@ struct fz_font_context
 	struct { fz_font *serif, *sans; } fallback[256];
 	fz_font *symbol1, *symbol2, *math, *music;
 	fz_font *emoji;
+
+	fz_shared_font_data *shared_data;
 };
 
 #undef __FTERRORS_H__
@@ -383,6 +405,16 @@ void fz_drop_font_context(fz_context *ctx)
 		fz_drop_font(ctx, ctx->font->math);
 		fz_drop_font(ctx, ctx->font->music);
 		fz_drop_font(ctx, ctx->font->emoji);
+		while (ctx->font->shared_data)
+		{
+			fz_shared_font_data *item = ctx->font->shared_data;
+			ctx->font->shared_data = item->next;
+			/* (data still referenced elsewhere is leaked instead) */
+			if (item->shared && item->buffer->refs == 1)
+				release_font_data_fn(item->shared);
+			fz_drop_buffer(ctx, item->buffer);
+			fz_free(ctx, item);
+		}
 		fz_free(ctx, ctx->font);
 		ctx->font = NULL;
 	}
@@ -630,6 +662,120 @@ fz_drop_freetype(fz_context *ctx)
 	fz_unlock(ctx, FZ_LOCK_FREETYPE);
 }
 
+/* sumatrapdf: a new buffer for the data shared with other contexts (or NULL) */
+static fz_buffer *
+new_buffer_from_other_contexts(fz_context *ctx, fz_buffer *buffer, const unsigned char digest[16], const unsigned char **shared)
+{
+	fz_buffer *result = NULL;
+
+	*shared = share_font_data_fn ? share_font_data_fn(digest, buffer->data, buffer->len) : NULL;
+	if (!*shared)
+		return NULL;
+	fz_try(ctx)
+		result = fz_new_buffer_from_shared_data(ctx, *shared, buffer->len);
+	fz_catch(ctx)
+	{
+		release_font_data_fn(*shared);
+		*shared = NULL;
+	}
+	return result;
+}
+
+/*
+	sumatrapdf: returns a reference to a buffer with the same content as
+	buffer (and its MD5 digest), which is shared with all other fonts with
+	that content. Buffers only referenced by the list are dropped from it.
+	Buffer refcounts are changed directly while the list is locked (as
+	fz_keep_imp does), since FZ_LOCK_ALLOC can't be taken recursively.
+*/
+static fz_buffer *
+share_font_data(fz_context *ctx, fz_buffer *buffer, unsigned char digest[16], int *has_digest)
+{
+	fz_font_context *fct = ctx->font;
+	fz_shared_font_data *item, **prev, *node, *unused = NULL;
+	fz_buffer *found = NULL, *other;
+	const unsigned char *shared;
+
+	*has_digest = 0;
+	/* built-in fonts don't use any memory of their own */
+	if (buffer->shared)
+		return fz_keep_buffer(ctx, buffer);
+
+	/* e.g. cached system fonts are passed in with the same buffer */
+	fz_lock(ctx, FZ_LOCK_ALLOC);
+	for (item = fct->shared_data; item && !found; item = item->next)
+	{
+		if (item->buffer == buffer)
+		{
+			memcpy(digest, item->digest, 16);
+			found = buffer;
+			found->refs++;
+		}
+	}
+	fz_unlock(ctx, FZ_LOCK_ALLOC);
+	if (found)
+	{
+		*has_digest = 1;
+		return found;
+	}
+
+	fz_md5_buffer(ctx, buffer, digest);
+	*has_digest = 1;
+	node = fz_malloc_no_throw(ctx, sizeof *node);
+	other = node ? new_buffer_from_other_contexts(ctx, buffer, digest, &shared) : NULL;
+
+	fz_lock(ctx, FZ_LOCK_ALLOC);
+	prev = &fct->shared_data;
+	while ((item = *prev) != NULL)
+	{
+		if (!found && item->buffer->len == buffer->len && !memcmp(item->digest, digest, 16))
+		{
+			found = item->buffer;
+			found->refs++;
+			prev = &item->next;
+		}
+		else if (item->buffer->refs == 1)
+		{
+			*prev = item->next;
+			item->next = unused;
+			unused = item;
+		}
+		else
+			prev = &item->next;
+	}
+	if (!found && node)
+	{
+		memcpy(node->digest, digest, 16);
+		node->buffer = other ? other : buffer;
+		node->shared = other ? shared : NULL;
+		node->next = fct->shared_data;
+		fct->shared_data = node;
+		node = NULL;
+		/* one reference for the list and one for the caller */
+		found = other ? other : buffer;
+		found->refs += other ? 1 : 2;
+		other = NULL;
+	}
+	fz_unlock(ctx, FZ_LOCK_ALLOC);
+
+	fz_free(ctx, node);
+	if (other)
+	{
+		fz_drop_buffer(ctx, other);
+		release_font_data_fn(shared);
+	}
+	while (unused)
+	{
+		item = unused;
+		unused = item->next;
+		fz_drop_buffer(ctx, item->buffer);
+		if (item->shared)
+			release_font_data_fn(item->shared);
+		fz_free(ctx, item);
+	}
+	return found ? found : fz_keep_buffer(ctx, buffer);
+}
+
 fz_font *
 fz_new_font_from_buffer(fz_context *ctx, const char *name, fz_buffer *buffer, int index, int use_glyph_bbox)
 {
@@ -639,6 +785,10 @@ fz_new_font_from_buffer(fz_context *ctx, const char *name, fz_buffer *buffer, in
 	int fterr;
 	FT_ULong tag, size, i, n;
 	char namebuf[sizeof(font->name)];
+	unsigned char digest[16];
+	int has_digest;
+
+	buffer = share_font_data(ctx, buffer, digest, &has_digest);
 
 	fz_keep_freetype(ctx);
 
@@ -647,6 +797,7 @@ fz_new_font_from_buffer(fz_context *ctx, const char *name, fz_buffer *buffer, in
 	fz_unlock(ctx, FZ_LOCK_FREETYPE);
 	if (fterr)
 	{
+		fz_drop_buffer(ctx, buffer);
 		fz_drop_freetype(ctx);
 		fz_throw(ctx, FZ_ERROR_GENERIC, "FT_New_Memory_Face(%s): %s", name, ft_error_string(fterr));
 	}
@@ -683,6 +834,7 @@ fz_new_font_from_buffer(fz_context *ctx, const char *name, fz_buffer *buffer, in
 		fz_unlock(ctx, FZ_LOCK_FREETYPE);
 		if (fterr)
 			fz_warn(ctx, "FT_Done_Face(%s): %s", name, ft_error_string(fterr));
+		fz_drop_buffer(ctx, buffer);
 		fz_drop_freetype(ctx);
 		fz_rethrow(ctx);
 	}
@@ -728,7 +880,12 @@ fz_new_font_from_buffer(fz_context *ctx, const char *name, fz_buffer *buffer, in
 		}
 	}
 
-	font->buffer = fz_keep_buffer(ctx, buffer);
+	font->buffer = buffer;
+	if (has_digest)
+	{
+		memcpy(font->digest, digest, 16);
+		font->has_digest = 1;
+	}
 
 	return font;
 }
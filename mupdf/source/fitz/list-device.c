@@ -1527,6 +1527,15 @@ fz_bound_display_list(fz_context *ctx, fz_display_list *list)
 	return list->mediabox;
 }
 
+/* sumatrapdf: for memory accounting of cached display lists */
+size_t
+fz_display_list_size(fz_context *ctx, fz_display_list *list)
+{
+	if (!list)
+		return 0;
+	return sizeof(fz_display_list) + list->max * sizeof(fz_display_node);
+}
+
 int fz_display_list_is_empty(fz_context *ctx, const fz_display_list *list)
 {
 	return !list || list->len == 0;
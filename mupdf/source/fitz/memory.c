@@ -18,12 +18,30 @@
  * except the _no_throw family which instead silently returns NULL.
  */
 
+static void *fz_malloc_default(void *opaque, size_t size);
+
+/* sumatrapdf: the default allocator is thread-safe, so FZ_LOCK_ALLOC is
+ * only needed for scavenging (else all threads rendering a document wait
+ * for each other for every single allocation) */
+static int
+alloc_needs_lock(fz_context *ctx)
+{
+	return ctx->alloc.malloc != fz_malloc_default;
+}
+
 static void *
 do_scavenging_malloc(fz_context *ctx, size_t size)
 {
 	void *p;
 	int phase = 0;
 
+	if (!alloc_needs_lock(ctx))
+	{
+		p = ctx->alloc.malloc(ctx->alloc.user, size);
+		if (p != NULL)
+			return p;
+	}
+
 	fz_lock(ctx, FZ_LOCK_ALLOC);
 	do {
 		p = ctx->alloc.malloc(ctx->alloc.user, size);
@@ -44,6 +62,13 @@ do_scavenging_realloc(fz_context *ctx, void *p, size_t size)
 	void *q;
 	int phase = 0;
 
+	if (!alloc_needs_lock(ctx))
+	{
+		q = ctx->alloc.realloc(ctx->alloc.user, p, size);
+		if (q != NULL)
+			return q;
+	}
+
 	fz_lock(ctx, FZ_LOCK_ALLOC);
 	do {
 		q = ctx->alloc.realloc(ctx->alloc.user, p, size);
@@ -135,7 +160,9 @@ fz_realloc_no_throw(fz_context *ctx, void *p, size_t size)
 void
 fz_free(fz_context *ctx, void *p)
 {
-	if (p)
+	if (p && !alloc_needs_lock(ctx))
+		ctx->alloc.free(ctx->alloc.user, p);
+	else if (p)
 	{
 		fz_lock(ctx, FZ_LOCK_ALLOC);
 		ctx->alloc.free(ctx->alloc.user, p);
@@ -5,6 +5,10 @@
 #include <stdio.h>
 #include <string.h>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 typedef struct fz_item
 {
 	void *key;
@@ -37,8 +41,55 @@ struct fz_store
 	int defer_reap_count;
 	int needs_reaping;
 	int scavenging;
+	/* sumatrapdf: number of scavenges which evicted anything */
+	int scavenges;
 };
 
+/*
+	sumatrapdf: the refcounts of storables are changed atomically instead
+	of under FZ_LOCK_ALLOC, so that threads keeping and dropping fonts,
+	images, colorspaces etc. don't all contend on that one lock.
+
+	The store's own structures are still only changed (and items only
+	evicted or reaped) with FZ_LOCK_ALLOC held. This is safe because the
+	only way to get a new reference without already holding one is to find
+	an item in the store, which also requires the lock, so an object only
+	referenced by the store can't be revived while it's being evicted.
+	Negative refcounts (statically allocated objects) are never changed.
+*/
+#ifdef _MSC_VER
+static int refs_add(int *refs, int n)
+{
+	return _InterlockedExchangeAdd((volatile long *)refs, n) + n;
+}
+
+static int refs_cas(int *refs, int old_val, int new_val)
+{
+	return _InterlockedCompareExchange((volatile long *)refs, new_val, old_val) == old_val;
+}
+#else
+static int refs_add(int *refs, int n)
+{
+	return __atomic_add_fetch(refs, n, __ATOMIC_SEQ_CST);
+}
+
+static int refs_cas(int *refs, int old_val, int new_val)
+{
+	return __atomic_compare_exchange_n(refs, &old_val, new_val, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+#endif
+
+static int refs_get(const int *refs)
+{
+	return *(const volatile int *)refs;
+}
+
+/* store_key_refs is only changed with FZ_LOCK_ALLOC held */
+static int key_refs_get(const fz_key_storable *s)
+{
+	return *(const volatile short *)&s->store_key_refs;
+}
+
 void
 fz_new_store_context(fz_context *ctx, size_t max)
 {
@@ -70,7 +121,13 @@ fz_keep_storable(fz_context *ctx, const fz_storable *sc)
 	 * sanely throughout the code. */
 	fz_storable *s = (fz_storable *)sc;
 
-	return fz_keep_imp(ctx, s, &s->refs);
+	/* The caller holds a reference, so refs can't drop to 0 meanwhile */
+	if (s && refs_get(&s->refs) > 0)
+	{
+		(void)Memento_takeRef(s);
+		refs_add(&s->refs, 1);
+	}
+	return s;
 }
 
 void *fz_keep_key_storable(fz_context *ctx, const fz_key_storable *sc)
@@ -134,7 +191,7 @@ do_reap(fz_context *ctx)
 		/* Store whether to drop this value or not in 'prev' */
 		if (item->val->refs > 0)
 			(void)Memento_dropRef(item->val);
-		item->prev = (item->val->refs > 0 && --item->val->refs == 0) ? item : NULL;
+		item->prev = (item->val->refs > 0 && refs_add(&item->val->refs, -1) == 0) ? item : NULL;
 
 		/* Store it in our removal chain - just singly linked */
 		item->next = remove;
@@ -165,17 +222,37 @@ void fz_drop_key_storable(fz_context *ctx, const fz_key_storable *sc)
 	fz_key_storable *s = (fz_key_storable *)sc;
 	int drop;
 	int unlock = 1;
+	int refs;
 
 	if (s == NULL)
 		return;
 
+	/* Only take the lock if the remaining references might all be
+	 * held by store keys, i.e. if the store might need reaping. */
+	for (;;)
+	{
+		refs = refs_get(&s->storable.refs);
+		assert(refs != 0);
+		if (refs <= 0)
+			return;
+		if (refs > 1 && refs - 1 <= key_refs_get(s))
+			break;
+		if (refs_cas(&s->storable.refs, refs, refs - 1))
+		{
+			(void)Memento_dropRef(s);
+			if (refs == 1)
+				s->storable.drop(ctx, &s->storable);
+			return;
+		}
+	}
+
 	fz_lock(ctx, FZ_LOCK_ALLOC);
-	assert(s->storable.refs != 0);
 	if (s->storable.refs > 0)
 	{
 		(void)Memento_dropRef(s);
-		drop = --s->storable.refs == 0;
-		if (!drop && s->storable.refs == s->store_key_refs)
+		refs = refs_add(&s->storable.refs, -1);
+		drop = refs == 0;
+		if (!drop && refs == s->store_key_refs)
 		{
 			if (ctx->store->defer_reap_count > 0)
 			{
@@ -216,8 +293,11 @@ void *fz_keep_key_storable_key(fz_context *ctx, const fz_key_storable *sc)
 	if (s->storable.refs > 0)
 	{
 		(void)Memento_takeRef(s);
-		++s->storable.refs;
+		/* store_key_refs is updated first here and last in
+		 * fz_drop_key_storable_key, so that it's never seen as
+		 * smaller than it is by fz_drop_key_storable */
 		++s->store_key_refs;
+		refs_add(&s->storable.refs, 1);
 	}
 	fz_unlock(ctx, FZ_LOCK_ALLOC);
 	return s;
@@ -236,7 +316,7 @@ void fz_drop_key_storable_key(fz_context *ctx, const fz_key_storable *sc)
 	fz_lock(ctx, FZ_LOCK_ALLOC);
 	assert(s->store_key_refs > 0 && s->storable.refs >= s->store_key_refs);
 	(void)Memento_dropRef(s);
-	drop = --s->storable.refs == 0;
+	drop = refs_add(&s->storable.refs, -1) == 0;
 	--s->store_key_refs;
 	fz_unlock(ctx, FZ_LOCK_ALLOC);
 	/*
@@ -270,7 +350,7 @@ evict(fz_context *ctx, fz_item *item)
 	/* Drop a reference to the value (freeing if required) */
 	if (item->val->refs > 0)
 		(void)Memento_dropRef(item->val);
-	drop = (item->val->refs > 0 && --item->val->refs == 0);
+	drop = (item->val->refs > 0 && refs_add(&item->val->refs, -1) == 0);
 
 	/* Remove from the hash table */
 	if (item->type->make_hash_key)
@@ -371,7 +451,7 @@ ensure_space(fz_context *ctx, size_t tofree)
 		/* Drop a reference to the value (freeing if required) */
 		if (item->val->refs > 0)
 			(void)Memento_dropRef(item->val);
-		drop = (item->val->refs > 0 && --item->val->refs == 0);
+		drop = (item->val->refs > 0 && refs_add(&item->val->refs, -1) == 0);
 
 		fz_unlock(ctx, FZ_LOCK_ALLOC);
 		if (drop)
@@ -482,7 +562,7 @@ fz_store_item(fz_context *ctx, void *key, void *val_, size_t itemsize, const fz_
 			if (existing->val->refs > 0)
 			{
 				(void)Memento_takeRef(existing->val);
-				existing->val->refs++;
+				refs_add(&existing->val->refs, 1);
 			}
 			fz_unlock(ctx, FZ_LOCK_ALLOC);
 			fz_free(ctx, item);
@@ -495,7 +575,7 @@ fz_store_item(fz_context *ctx, void *key, void *val_, size_t itemsize, const fz_
 	if (val->refs > 0)
 	{
 		(void)Memento_takeRef(val);
-		val->refs++;
+		refs_add(&val->refs, 1);
 	}
 
 	/* If we haven't got an infinite store, check for space within it */
@@ -597,7 +677,7 @@ fz_find_item(fz_context *ctx, fz_store_drop_fn *drop, void *key, const fz_store_
 		if (item->val->refs > 0)
 		{
 			(void)Memento_takeRef(item->val);
-			item->val->refs++;
+			refs_add(&item->val->refs, 1);
 		}
 		fz_unlock(ctx, FZ_LOCK_ALLOC);
 		return (void *)item->val;
@@ -655,7 +735,7 @@ fz_remove_item(fz_context *ctx, fz_store_drop_fn *drop, void *key, const fz_stor
 		}
 		if (item->val->refs > 0)
 			(void)Memento_dropRef(item->val);
-		dodrop = (item->val->refs > 0 && --item->val->refs == 0);
+		dodrop = (item->val->refs > 0 && refs_add(&item->val->refs, -1) == 0);
 		fz_unlock(ctx, FZ_LOCK_ALLOC);
 		if (dodrop)
 			item->val->drop(ctx, item->val);
@@ -736,7 +816,7 @@ fz_debug_store_locked(fz_context *ctx, fz_output *out)
 		if (next)
 		{
 			(void)Memento_takeRef(next->val);
-			next->val->refs++;
+			refs_add(&next->val->refs, 1);
 		}
 		fz_unlock(ctx, FZ_LOCK_ALLOC);
 		item->type->format_key(ctx, buf, sizeof buf, item->key);
@@ -747,7 +827,7 @@ fz_debug_store_locked(fz_context *ctx, fz_output *out)
 		if (next)
 		{
 			(void)Memento_dropRef(next->val);
-			next->val->refs--;
+			refs_add(&next->val->refs, -1);
 		}
 	}
 
@@ -836,6 +916,7 @@ scavenge(fz_context *ctx, size_t tofree)
 
 	if (freed != 0) {
 		FZ_LOG_DUMP_STORE(ctx, "After scavenge:\n");
+		store->scavenges++;
 	}
 	store->scavenging = 0;
 	/* Success is managing to evict any blocks */
@@ -853,13 +934,12 @@ fz_drop_storable(fz_context *ctx, const fz_storable *sc)
 	if (s == NULL)
 		return;
 
-	fz_lock(ctx, FZ_LOCK_ALLOC);
 	/* Drop the ref, and leave num as being the number of
 	 * refs left (-1 meaning, "statically allocated"). */
-	if (s->refs > 0)
+	if (refs_get(&s->refs) > 0)
 	{
 		(void)Memento_dropIntRef(s);
-		num = --s->refs;
+		num = refs_add(&s->refs, -1);
 	}
 	else
 		num = -1;
@@ -869,10 +949,13 @@ fz_drop_storable(fz_context *ctx, const fz_storable *sc)
 	 * oversized, we ought to throw any such references
 	 * away to try to bring the store down to a "legal"
 	 * size. Run a scavenge to check for this case. */
-	if (ctx->store->max != FZ_STORE_UNLIMITED)
-		if (num == 1 && ctx->store->size > ctx->store->max)
+	if (num == 1 && ctx->store->max != FZ_STORE_UNLIMITED)
+	{
+		fz_lock(ctx, FZ_LOCK_ALLOC);
+		if (ctx->store->size > ctx->store->max)
 			scavenge(ctx, ctx->store->size - ctx->store->max);
-	fz_unlock(ctx, FZ_LOCK_ALLOC);
+		fz_unlock(ctx, FZ_LOCK_ALLOC);
+	}
 
 	/* If we have no references to an object left, then
 	 * it cannot possibly be in the store (as the store always
@@ -982,6 +1065,21 @@ fz_shrink_store(fz_context *ctx, unsigned int percent)
 	return success;
 }
 
+int
+fz_store_scavenges(fz_context *ctx)
+{
+	int scavenges;
+
+	if (ctx->store == NULL)
+		return 0;
+
+	fz_lock(ctx, FZ_LOCK_ALLOC);
+	scavenges = ctx->store->scavenges;
+	fz_unlock(ctx, FZ_LOCK_ALLOC);
+
+	return scavenges;
+}
+
 void fz_filter_store(fz_context *ctx, fz_store_filter_fn *fn, void *arg, const fz_store_type *type)
 {
 	fz_store *store;
@@ -1029,7 +1127,7 @@ void fz_filter_store(fz_context *ctx, fz_store_filter_fn *fn, void *arg, const f
 		/* Store whether to drop this value or not in 'prev' */
 		if (item->val->refs > 0)
 			(void)Memento_dropRef(item->val);
-		item->prev = (item->val->refs > 0 && --item->val->refs == 0) ? item : NULL;
+		item->prev = (item->val->refs > 0 && refs_add(&item->val->refs, -1) == 0) ? item : NULL;
 
 		/* Store it in our removal chain - just singly linked */
 		item->next = remove;
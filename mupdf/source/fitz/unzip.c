@@ -32,6 +32,10 @@ typedef struct
 
 	int count;
 	zip_entry *entries;
+
+	/* sumatrapdf: case-insensitive hash index into entries (index + 1, 0 for empty slots) */
+	int index_size;
+	int *index;
 } fz_zip_archive;
 
 static void drop_zip_archive(fz_context *ctx, fz_archive *arch)
@@ -41,6 +45,42 @@ static void drop_zip_archive(fz_context *ctx, fz_archive *arch)
 	for (i = 0; i < zip->count; ++i)
 		fz_free(ctx, zip->entries[i].name);
 	fz_free(ctx, zip->entries);
+	fz_free(ctx, zip->index);
+}
+
+static unsigned int hash_zip_name(const char *name)
+{
+	/* FNV-1a over the name with ASCII letters lowercased (matching fz_strcasecmp) */
+	unsigned int h = 2166136261u;
+	int c;
+	while ((c = (unsigned char)*name++) != 0)
+	{
+		if (c >= 'A' && c <= 'Z')
+			c += 'a' - 'A';
+		h = (h ^ c) * 16777619u;
+	}
+	return h;
+}
+
+static void build_zip_index(fz_context *ctx, fz_zip_archive *zip)
+{
+	int i, size = 16;
+	unsigned int slot;
+
+	/* keep the table at most half full */
+	while (size / 2 < zip->count)
+		size *= 2;
+	zip->index = Memento_label(fz_calloc(ctx, size, sizeof(int)), "zip_index");
+	zip->index_size = size;
+
+	/* for duplicate names, the first entry comes first in the probe sequence (as it did for the linear scan) */
+	for (i = 0; i < zip->count; i++)
+	{
+		slot = hash_zip_name(zip->entries[i].name) & (size - 1);
+		while (zip->index[slot])
+			slot = (slot + 1) & (size - 1);
+		zip->index[slot] = i + 1;
+	}
 }
 
 static void read_zip_dir_imp(fz_context *ctx, fz_zip_archive *zip, int64_t start_offset)
@@ -191,6 +231,8 @@ static void read_zip_dir_imp(fz_context *ctx, fz_zip_archive *zip, int64_t start
 
 			zip->count++;
 		}
+
+		build_zip_index(ctx, zip);
 	}
 	fz_always(ctx)
 		fz_free(ctx, name);
@@ -262,12 +304,19 @@ static void ensure_zip_entries(fz_context *ctx, fz_zip_archive *zip)
 
 static zip_entry *lookup_zip_entry(fz_context *ctx, fz_zip_archive *zip, const char *name)
 {
+	unsigned int slot;
 	int i;
 	if (name[0] == '/')
 		++name;
-	for (i = 0; i < zip->count; i++)
-		if (!fz_strcasecmp(name, zip->entries[i].name))
-			return &zip->entries[i];
+	if (!zip->index)
+		return NULL;
+	slot = hash_zip_name(name) & (zip->index_size - 1);
+	while ((i = zip->index[slot]) != 0)
+	{
+		if (!fz_strcasecmp(name, zip->entries[i - 1].name))
+			return &zip->entries[i - 1];
+		slot = (slot + 1) & (zip->index_size - 1);
+	}
 	return NULL;
 }
 
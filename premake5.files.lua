@@ -492,6 +492,7 @@ function utils_files()
     "ByteOrderDecoder.*",
     "ByteReader.*",
     "ByteWriter.*",
+    "CaseFold*",
     "CmdLineParser.*",
     "ColorUtil.*",
     "CryptoUtil.*",
@@ -520,6 +521,7 @@ function utils_files()
     "RegistryPaths.*",
     "Scoped.h",
     "ScopedWin.h",
+    "SearchIndex.*",
     "SerializeTxt.*",
     "SettingsUtil.*",
     "SquareTreeParser.*",
@@ -571,6 +573,7 @@ end
 function engines_files()
   files_in_dir("src", {
     "Annotation.*",
+    "BatchRender.*",
     "Engine*",
     "ChmDoc.*",
     "EbookDoc.*",
@@ -887,6 +890,9 @@ function test_util_files()
     "BaseUtil.*",
     "BitManip.*",
     "ByteOrderDecoder.*",
+    "ByteReader.*",
+    "ByteWriter.*",
+    "CaseFold*",
     "CmdLineParser.*",
     "ColorUtil.*",
     "CryptoUtil.*",
@@ -900,6 +906,7 @@ function test_util_files()
     "HtmlPullParser.*",
     "JsonParser.*",
     "Scoped.*",
+    "SearchIndex.*",
     "SettingsUtil.*",
     "Log.*",
     "StrconvUtil.*",
@@ -953,6 +960,7 @@ function pdf_preview_files()
     "mui/TextRender.*",
     "MUPDF_Exports.cpp",
     "Annotation.*",
+    "BatchRender.*",
     "EngineBase.*",
     "EngineFzUtil.*",
     "EnginePdf.*",
@@ -384,7 +384,7 @@ workspace "SumatraPDF"
     kind "StaticLib"
     language "C"
     regconf()
-    defines { "UNICODE", "_UNICODE", "PPC_BSTR"}
+    defines { "UNICODE", "_UNICODE", "PPC_BSTR", "CHM_MT"}
     disablewarnings { "4018", "4057", "4189", "4244", "4267", "4295", "4701", "4706", "4996" }
     files { "ext/CHMLib/src/chm_lib.c", "ext/CHMLib/src/lzx.c" }
 
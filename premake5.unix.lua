@@ -86,14 +86,135 @@ workspace "SumatraPDF"
     files { "ext/unarr/main.c" }
     links { "unarrlib", "zlib" }
 
+  -- mupdf and its dependencies, configured like in premake5.lua
+  -- third-party code isn't held to our warning level
+  project "jbig2dec"
+    kind "StaticLib"
+    language "C"
+    warnings "Off"
+    defines { "HAVE_STRING_H=1", "JBIG_NO_MEMENTO" }
+    includedirs { "ext/jbig2dec" }
+    jbig2dec_files()
+
+  project "openjpeg"
+    kind "StaticLib"
+    language "C"
+    warnings "Off"
+    defines { "USE_JPIP", "OPJ_STATIC", "OPJ_EXPORTS" }
+    openjpeg_files()
+
+  project "libjpeg-turbo"
+    kind "StaticLib"
+    language "C"
+    warnings "Off"
+    includedirs { "ext/libjpeg-turbo", "ext/libjpeg-turbo/simd" }
+
+    filter 'files:**.asm'
+      buildmessage '%{file.relpath}'
+      buildoutputs { '%{cfg.objdir}/%{file.basename}.o' }
+      buildcommands {
+        'nasm -f elf64 -DELF -D__x86_64__ -I ext/libjpeg-turbo/simd/ -I ext/libjpeg-turbo/win/ -o "%{cfg.objdir}/%{file.basename}.o" "%{file.relpath}"'
+      }
+    filter {}
+    libjpeg_turbo_files()
+
+  project "freetype"
+    kind "StaticLib"
+    language "C"
+    warnings "Off"
+    defines {
+      "FT2_BUILD_LIBRARY",
+      "FT_CONFIG_MODULES_H=\"slimftmodules.h\"",
+      "FT_CONFIG_OPTIONS_H=\"slimftoptions.h\"",
+    }
+    includedirs { "mupdf/scripts/freetype", "ext/freetype/include" }
+    freetype_files()
+
+  project "lcms2"
+    kind "StaticLib"
+    language "C"
+    warnings "Off"
+    includedirs { "ext/lcms2/include" }
+    lcms2_files()
+
+  project "harfbuzz"
+    kind "StaticLib"
+    language "C"
+    warnings "Off"
+    includedirs { "ext/harfbuzz/src/hb-ucdn", "mupdf/scripts/freetype", "ext/freetype/include" }
+    defines {
+      "HAVE_FALLBACK=1",
+      "HAVE_OT",
+      "HAVE_UCDN",
+      "HAVE_FREETYPE",
+      "HB_NO_MT",
+      "hb_malloc_impl=fz_hb_malloc",
+      "hb_calloc_impl=fz_hb_calloc",
+      "hb_realloc_impl=fz_hb_realloc",
+      "hb_free_impl=fz_hb_free"
+    }
+    harfbuzz_files()
+
+  project "mujs"
+    kind "StaticLib"
+    language "C"
+    warnings "Off"
+    includedirs { "ext/mujs" }
+    files { "ext/mujs/one.c", "ext/mujs/mujs.h" }
+
+  project "gumbo"
+    kind "StaticLib"
+    language "C"
+    warnings "Off"
+    includedirs { "ext/gumbo-parser/include" }
+    gumbo_files()
+
+  project "mupdf"
+    kind "StaticLib"
+    language "C"
+    warnings "Off"
+    defines { "USE_JPIP", "OPJ_EXPORTS", "HAVE_LCMS2MT=1" }
+    defines { "OPJ_STATIC", "SHARE_JPEG" }
+    defines { "TOFU", "TOFU_CJK_LANG" }
+    includedirs {
+      "mupdf/include",
+      "mupdf/generated",
+      "ext/jbig2dec",
+      "ext/libjpeg-turbo",
+      "ext/openjpeg/src/lib/openjp2",
+      "ext/zlib",
+      "mupdf/scripts/freetype",
+      "ext/freetype/include",
+      "ext/mujs",
+      "ext/harfbuzz/src",
+      "ext/lcms2/include",
+      "ext/gumbo-parser/src",
+    }
+
+    filter 'files:**.asm'
+      buildmessage 'Compiling %{file.relpath}'
+      buildoutputs { '%{cfg.objdir}/%{file.basename}.o' }
+      buildcommands {
+        'nasm -f elf64 -I mupdf/ -o "%{cfg.objdir}/%{file.basename}.o" "%{file.relpath}"'
+      }
+    filter {}
+
+    mupdf_files()
+
+  -- Archive/unarr on unix and a headless benchmark of plain mupdf (not of the
+  -- engines) for loading, rendering, text extraction and search
   project "test_unix"
     kind "ConsoleApp"
     language "C++"
     cppdialect "C++latest"
 
-    includedirs { "src", "src/utils", "ext/unarr" }
+    includedirs { "src", "src/utils", "ext/unarr", "mupdf/include" }
 
-    links { "unarrlib", "zlib" }
+    -- static libraries have to come after the ones depending on them
+    links {
+      "unarrlib", "mupdf", "harfbuzz", "freetype", "libjpeg-turbo", "jbig2dec", "openjpeg",
+      "lcms2", "mujs", "gumbo", "zlib", "m", "pthread"
+    }
 
     files {
       "src/utils/Archive.cpp",
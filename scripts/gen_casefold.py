@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+"""
+This script generates src/utils/CaseFoldTable.cpp, the tables used by
+FoldCase() and the FindFolded*() functions in src/utils/CaseFold.h.
+
+The tables map every UTF-16 code unit to its simple lowercase equivalent
+(according to the Unicode database of the Python running this script) and
+list for every lowercase character all the other characters folding to it.
+Re-run after upgrading Python to pick up a newer Unicode version.
+"""
+
+import os
+import unicodedata
+
+Template_Table = """\
+/* Copyright 2021 the SumatraPDF project authors (see AUTHORS file).
+   License: Simplified BSD (see COPYING.BSD) */
+
+// This file is auto-generated by gen_casefold.py (Unicode %(unicode_version)s)
+
+#include "utils/BaseUtil.h"
+#include "utils/CaseFold.h"
+
+// index into gCaseFoldDeltas for every block of 256 characters
+const u8 gCaseFoldBlocks[256] = {
+%(blocks)s
+};
+
+// (folded - c) & 0xffff for every character c in a block
+const u16 gCaseFoldDeltas[%(n_deltas)d][256] = {
+%(deltas)s
+};
+
+// (folded, c) for every character c != folded, sorted
+const WCHAR gCaseFoldPreimages[%(n_preimages)d][2] = {
+%(preimages)s
+};
+
+const int gCaseFoldPreimagesCount = %(n_preimages)d;
+"""
+
+# max. number of characters other than itself folding to a character
+# (must match CASE_FOLD_MAX_PREIMAGES in CaseFold.h)
+Max_Preimages = 3
+
+def is_surrogate(c):
+	return 0xD800 <= c <= 0xDFFF
+
+def get_fold_table():
+	fold = list(range(0x10000))
+	for c in range(0x10000):
+		if is_surrogate(c):
+			continue
+		lower = chr(c).lower()
+		if len(lower) == 1:
+			fold[c] = ord(lower) if ord(lower) < 0x10000 else c
+		elif lower[0] < "\x80":
+			# e.g. U+0130 LATIN CAPITAL LETTER I WITH DOT ABOVE lowercases to "i" followed by U+0307
+			fold[c] = ord(lower[0])
+	# folding must be idempotent so that folded text can be compared with folded text
+	for c in range(0x10000):
+		while fold[fold[c]] != fold[c]:
+			fold[c] = fold[fold[c]]
+	return fold
+
+def format_rows(values, per_line, fmt):
+	lines = []
+	for i in range(0, len(values), per_line):
+		lines.append("    " + ", ".join(fmt % v for v in values[i:i + per_line]) + ",")
+	return "\n".join(lines)
+
+def main():
+	os.chdir(os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+
+	fold = get_fold_table()
+
+	# the identity block comes first
+	blocks, deltas = [], [(0,) * 256]
+	for b in range(256):
+		delta = tuple((fold[c] - c) & 0xFFFF for c in range(b * 256, b * 256 + 256))
+		if delta not in deltas:
+			deltas.append(delta)
+		blocks.append(deltas.index(delta))
+	preimages = sorted((fold[c], c) for c in range(0x10000) if fold[c] != c)
+	counts = {}
+	for (folded, c) in preimages:
+		counts[folded] = counts.get(folded, 0) + 1
+	assert max(counts.values()) <= Max_Preimages
+
+	unicode_version = unicodedata.unidata_version
+	blocks = format_rows(blocks, 16, "%d")
+	n_deltas = len(deltas)
+	deltas = "\n".join("    {\n" + format_rows(d, 12, "0x%04x").replace("    ", "        ") + "\n    }," for d in deltas)
+	n_preimages = len(preimages)
+	preimages = format_rows(["{0x%04x, 0x%04x}" % p for p in preimages], 6, "%s")
+
+	content = Template_Table % locals()
+	open("src/utils/CaseFoldTable.cpp", "wb").write(content.replace("\n", "\r\n").encode("ascii"))
+
+if __name__ == "__main__":
+	main()
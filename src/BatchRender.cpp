@@ -0,0 +1,168 @@
+/* Copyright 2021 the SumatraPDF project authors (see AUTHORS file).
+   License: GPLv3 */
+
+#include "utils/BaseUtil.h"
+#include "utils/ScopedWin.h"
+#include "utils/WinUtil.h"
+
+#include "wingui/TreeModel.h"
+
+#include "Annotation.h"
+#include "EngineBase.h"
+#include "BatchRender.h"
+
+struct BatchRenderWorker {
+    BatchRenderer* renderer = nullptr;
+    EngineBase* engine = nullptr;
+    // engine is a clone owned by the worker
+    bool ownsEngine = false;
+    AbortCookie* cookie = nullptr;
+    HANDLE thread = nullptr;
+};
+
+BatchRenderer::BatchRenderer(EngineBase* engine, int nThreads) : engine(engine) {
+    InitializeCriticalSection(&access);
+    InitializeCriticalSection(&engineAccess);
+    InitializeConditionVariable(&pageDone);
+    InitializeConditionVariable(&canRender);
+
+    if (nThreads <= 0) {
+        SYSTEM_INFO si;
+        GetSystemInfo(&si);
+        nThreads = (int)si.dwNumberOfProcessors;
+    }
+    this->nThreads = std::clamp(nThreads, 1, MAX_BATCH_RENDER_THREADS);
+    maxAhead = IsProcess64() ? MAX_BATCH_RENDER_AHEAD_64 : MAX_BATCH_RENDER_AHEAD_32;
+}
+
+BatchRenderer::~BatchRenderer() {
+    Abort();
+    for (BatchRenderWorker* w : workers) {
+        WaitForSingleObject(w->thread, INFINITE);
+        CloseHandle(w->thread);
+        if (w->ownsEngine) {
+            delete w->engine;
+        }
+        delete w;
+    }
+    for (BatchRenderPage& page : pages) {
+        delete page.bmp;
+    }
+    DeleteCriticalSection(&engineAccess);
+    DeleteCriticalSection(&access);
+}
+
+void BatchRenderer::Add(const RenderPageArgs& args) {
+    CrashIf(workers.size() > 0);
+    RectF rect = args.pageRect ? *args.pageRect : engine->PageMediabox(args.pageNo);
+    rect = engine->Transform(rect, args.pageNo, args.zoom, args.rotation);
+    BatchRenderPage page{args};
+    page.size = (size_t)(rect.dx * rect.dy) * 4;
+    pages.Append(page);
+}
+
+void BatchRenderer::Start() {
+    int n = std::min(nThreads, (int)pages.size());
+    for (int i = 0; i < n; i++) {
+        // cloning can take a while, so don't hold access for it (cf. Abort)
+        EngineBase* e = engine;
+        if (i > 0 && !engine->allowsConcurrentRendering) {
+            e = engine->Clone();
+            if (!e) {
+                break;
+            }
+        }
+        BatchRenderWorker* w = new BatchRenderWorker();
+        w->renderer = this;
+        w->engine = e;
+        w->ownsEngine = e != engine;
+        ScopedCritSec scope(&access);
+        workers.Append(w);
+        w->thread = CreateThread(nullptr, 0, WorkerThread, w, 0, nullptr);
+    }
+}
+
+int BatchRenderer::ThreadCount() const {
+    return (int)workers.size();
+}
+
+// returns the index of the next page to render (or -1 once there's nothing left to do)
+int BatchRenderer::GetPageToRender() {
+    ScopedCritSec scope(&access);
+    for (;;) {
+        if (aborted || nextToRender >= (int)pages.size()) {
+            return -1;
+        }
+        // always render the page that is returned next
+        size_t size = pages.at(nextToRender).size;
+        if (sizeAhead == 0 || sizeAhead + size <= maxAhead) {
+            sizeAhead += size;
+            return nextToRender++;
+        }
+        SleepConditionVariableCS(&canRender, &access, INFINITE);
+    }
+}
+
+RenderedBitmap* BatchRenderer::Render(EngineBase* e, RenderPageArgs& args) {
+    if (e != engine || engine->allowsConcurrentRendering) {
+        return e->RenderPage(args);
+    }
+    ScopedCritSec scope(&engineAccess);
+    return e->RenderPage(args);
+}
+
+DWORD WINAPI BatchRenderer::WorkerThread(void* data) {
+    BatchRenderWorker* w = (BatchRenderWorker*)data;
+    BatchRenderer* r = w->renderer;
+    for (int idx = r->GetPageToRender(); idx >= 0; idx = r->GetPageToRender()) {
+        // pages isn't modified after Start
+        RenderPageArgs args = r->pages.at(idx).args;
+        args.cookie_out = &w->cookie;
+        RenderedBitmap* bmp = r->Render(w->engine, args);
+
+        ScopedCritSec scope(&r->access);
+        delete w->cookie;
+        w->cookie = nullptr;
+        BatchRenderPage& page = r->pages.at(idx);
+        page.bmp = bmp;
+        page.isDone = true;
+        WakeAllConditionVariable(&r->pageDone);
+    }
+    return 0;
+}
+
+RenderedBitmap* BatchRenderer::Next() {
+    ScopedCritSec scope(&access);
+    if (nextToReturn >= (int)pages.size()) {
+        return nullptr;
+    }
+    int idx = nextToReturn++;
+    BatchRenderPage& page = pages.at(idx);
+    // pages not rendered yet won't be rendered anymore after an abort
+    while (!page.isDone && !(aborted && idx >= nextToRender)) {
+        SleepConditionVariableCS(&pageDone, &access, INFINITE);
+    }
+    if (idx < nextToRender) {
+        sizeAhead -= page.size;
+    }
+    RenderedBitmap* bmp = page.bmp;
+    page.bmp = nullptr;
+    WakeAllConditionVariable(&canRender);
+    return bmp;
+}
+
+RenderedBitmap* BatchRenderer::RenderNow(RenderPageArgs& args) {
+    return Render(engine, args);
+}
+
+void BatchRenderer::Abort() {
+    ScopedCritSec scope(&access);
+    aborted = true;
+    for (BatchRenderWorker* w : workers) {
+        if (w->cookie) {
+            w->cookie->Abort();
+        }
+    }
+    WakeAllConditionVariable(&canRender);
+    WakeAllConditionVariable(&pageDone);
+}
@@ -0,0 +1,69 @@
+/* Copyright 2021 the SumatraPDF project authors (see AUTHORS file).
+   License: GPLv3 */
+
+// upper limit for the number of threads rendering a batch
+#define MAX_BATCH_RENDER_THREADS 8
+// pages are only rendered ahead of the one returned next as long as
+// their bitmaps take less than this much memory
+#define MAX_BATCH_RENDER_AHEAD_32 (128 * 1024 * 1024)
+#define MAX_BATCH_RENDER_AHEAD_64 (512 * 1024 * 1024)
+
+struct BatchRenderPage {
+    RenderPageArgs args;
+    // estimated memory use of the rendered bitmap
+    size_t size = 0;
+    RenderedBitmap* bmp = nullptr;
+    bool isDone = false;
+};
+
+struct BatchRenderWorker;
+
+// renders a list of pages (e.g. for printing or exporting them) on several threads
+// and returns them in order so that they can be consumed (e.g. encoded or spooled)
+// while the following pages are being rendered. Every thread renders with its own
+// clone of the engine, unless the engine allows concurrent rendering
+class BatchRenderer {
+    EngineBase* engine = nullptr;
+    int nThreads = 0;
+    size_t maxAhead = 0;
+
+    CRITICAL_SECTION access;
+    // serializes rendering with the original engine if it's used by a worker
+    // and doesn't allow concurrent rendering (cf. RenderNow)
+    CRITICAL_SECTION engineAccess;
+    CONDITION_VARIABLE pageDone;
+    CONDITION_VARIABLE canRender;
+
+    Vec<BatchRenderPage> pages;
+    Vec<BatchRenderWorker*> workers;
+    int nextToRender = 0;
+    int nextToReturn = 0;
+    // memory used by pages rendered (or being rendered) but not returned yet
+    size_t sizeAhead = 0;
+    bool aborted = false;
+
+    int GetPageToRender();
+    RenderedBitmap* Render(EngineBase* e, RenderPageArgs& args);
+    static DWORD WINAPI WorkerThread(void* data);
+
+  public:
+    // nThreads = 0 uses one thread per processor
+    explicit BatchRenderer(EngineBase* engine, int nThreads = 0);
+    BatchRenderer(BatchRenderer const&) = delete;
+    BatchRenderer& operator=(BatchRenderer const&) = delete;
+    ~BatchRenderer();
+
+    // adds a page to render (before Start), args.pageRect must remain valid
+    void Add(const RenderPageArgs& args);
+    void Start();
+    // returns the bitmap for the next page (in the order in which pages have
+    // been added) or nullptr if rendering failed or has been aborted
+    // caller takes ownership
+    RenderedBitmap* Next();
+    // renders on the calling thread (e.g. for retrying at a lower zoom level)
+    RenderedBitmap* RenderNow(RenderPageArgs& args);
+    // stops rendering pages (can be called from any thread)
+    void Abort();
+
+    int ThreadCount() const;
+};
@@ -19,6 +19,11 @@
 #include "EbookBase.h"
 #include "ChmDoc.h"
 
+// long objects are decompressed ahead on up to one thread per additional processor
+#define MAX_CHM_DECOMPRESS_THREADS 8
+// decompressed reset intervals are cached within the same budget as the other engines use
+#define MAX_CHM_CACHE_SIZE (256 * 1024 * 1024)
+
 ChmDoc::~ChmDoc() {
     chm_close(chmHandle);
 }
@@ -275,6 +280,12 @@ bool ChmDoc::Load(const WCHAR* fileName) {
     if (!chmHandle) {
         return false;
     }
+    // (the threads are only started by the first read spanning several reset intervals)
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    int nThreads = std::clamp((int)si.dwNumberOfProcessors - 1, 0, MAX_CHM_DECOMPRESS_THREADS);
+    chm_set_param(chmHandle, CHM_PARAM_DECOMPRESS_THREADS, nThreads);
+    chm_set_param(chmHandle, CHM_PARAM_MAX_BYTES_CACHED, MAX_CHM_CACHE_SIZE);
 
     ParseWindowsData();
     if (!ParseSystemData()) {
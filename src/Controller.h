@@ -24,6 +24,10 @@ struct ControllerCallback {
     virtual void RequestRendering(int pageNo) = 0;
     virtual void CleanUp(DisplayModel* dm) = 0;
     virtual void RenderThumbnail(DisplayModel* dm, Size size, const onBitmapRenderedCb&) = 0;
+    // tell the UI that the final page count is known (called from a background thread)
+    virtual void HandleLayoutFinished(DisplayModel* dm) = 0;
+    // tell the UI that actual page sizes differ from the estimated ones (called from a background thread)
+    virtual void HandlePageSizesChanged(DisplayModel* dm) = 0;
     // ChmModel //
     // tell the UI to move focus back to the main window
     // (if always == false, then focus is only moved if it's inside
@@ -59,6 +59,8 @@
 #include "Controller.h"
 #include "DisplayModel.h"
 #include "GlobalPrefs.h"
+#include "FileHistory.h"
+#include "FileThumbnails.h"
 #include "PdfSync.h"
 #include "ProgressUpdateUI.h"
 #include "TextSelection.h"
@@ -66,6 +68,7 @@
 
 // if true, we pre-render the pages right before and after the visible pages
 static bool gPredictiveRender = true;
+static LONG gLastDisplayModelId = 0;
 
 static int ColumnsFromDisplayMode(DisplayMode displayMode) {
     if (!IsSingle(displayMode)) {
@@ -291,6 +294,7 @@ static int LastPageInARowNo(int pageNo, int columns, bool showCover, int pageCou
 // must call SetInitialViewSettings() after creation
 DisplayModel::DisplayModel(EngineBase* engine, ControllerCallback* cb) : Controller(cb) {
     this->engine = engine;
+    id = InterlockedIncrement(&gLastDisplayModelId);
     CrashIf(!engine || engine->PageCount() <= 0);
     engineType = engine->kind;
 
@@ -313,13 +317,21 @@ DisplayModel::DisplayModel(EngineBase* engine, ControllerCallback* cb) : Control
     textCache = new DocumentTextCache(engine);
     textSelection = new TextSelection(engine, textCache);
     textSearch = new TextSearch(engine, textCache);
+
+    // ebooks might still be laid out in the background (with an estimated page count)
+    engine->SetLayoutFinishedCb([this] { this->cb->HandleLayoutFinished(this); });
+    // page sizes of large documents might be resolved in the background
+    engine->SetPageSizesChangedCb([this] { this->cb->HandlePageSizesChanged(this); });
 }
 
 DisplayModel::~DisplayModel() {
     dontRenderFlag = true;
+    engine->SetLayoutFinishedCb(nullptr);
+    engine->SetPageSizesChangedCb(nullptr);
     cb->CleanUp(this);
 
     delete pdfSync;
+    delete layoutCache;
     delete textSearch;
     delete textSelection;
     delete textCache;
@@ -338,6 +350,17 @@ PageInfo* DisplayModel::GetPageInfo(int pageNo) const {
     return &(pagesInfo[pageNo - 1]);
 }
 
+// computed on demand, so that scrolling doesn't have to touch all pages
+Rect DisplayModel::PageOnScreen(int pageNo) const {
+    PageInfo* pageInfo = GetPageInfo(pageNo);
+    if (!pageInfo) {
+        return Rect();
+    }
+    Rect r = pageInfo->pos;
+    r.Offset(-viewPort.x, -viewPort.y);
+    return r;
+}
+
 // Call this before the first Relayout
 void DisplayModel::SetInitialViewSettings(DisplayMode newDisplayMode, int newStartPage, Size viewPort, int screenDPI) {
     totalViewPortSize = viewPort;
@@ -375,18 +398,23 @@ void DisplayModel::SetInitialViewSettings(DisplayMode newDisplayMode, int newSta
     BuildPagesInfo();
 }
 
+// pages with an empty mediabox are laid out as A4 size (resp. letter size)
+static RectF GetDefaultPageRect(EngineBase* engine) {
+    float fileDPI = engine->GetFileDPI();
+    if (0 == GetMeasurementSystem()) {
+        return RectF(0, 0, 21.0 / 2.54 * fileDPI, 29.7 / 2.54 * fileDPI);
+    }
+    return RectF(0, 0, 8.5 * fileDPI, 11 * fileDPI);
+}
+
 void DisplayModel::BuildPagesInfo() {
     CrashIf(pagesInfo);
     int pageCount = PageCount();
     pagesInfo = AllocArray<PageInfo>(pageCount);
+    rowStarts.Reset();
+    visibleStart = visibleEnd = 0;
 
-    RectF defaultRect;
-    float fileDPI = engine->GetFileDPI();
-    if (0 == GetMeasurementSystem()) {
-        defaultRect = RectF(0, 0, 21.0 / 2.54 * fileDPI, 29.7 / 2.54 * fileDPI);
-    } else {
-        defaultRect = RectF(0, 0, 8.5 * fileDPI, 11 * fileDPI);
-    }
+    RectF defaultRect = GetDefaultPageRect(engine);
 
     int columns = ColumnsFromDisplayMode(displayMode);
     int newStartPage = startPage;
@@ -396,8 +424,7 @@ void DisplayModel::BuildPagesInfo() {
 
     for (int pageNo = 1; pageNo <= pageCount; pageNo++) {
         PageInfo* pageInfo = GetPageInfo(pageNo);
-        pageInfo->page = engine->PageMediabox(pageNo);
-        // layout pages with an empty mediabox as A4 size (resp. letter size)
+        pageInfo->page = engine->PageMediaboxOrEstimate(pageNo, &pageInfo->sizeIsEstimate);
         if (pageInfo->page.IsEmpty()) {
             pageInfo->page = defaultRect;
         }
@@ -411,6 +438,57 @@ void DisplayModel::BuildPagesInfo() {
     }
 }
 
+// called once the engine has finished laying out pages in the background
+// and the estimated page count can be replaced with the actual one
+void DisplayModel::UpdatePageCount() {
+    engine->UpdatePageCount();
+    startPage = std::min(startPage, PageCount());
+
+    delete textSearch;
+    delete textSelection;
+    delete textCache;
+    textCache = new DocumentTextCache(engine);
+    textSelection = new TextSelection(engine, textCache);
+    textSearch = new TextSearch(engine, textCache);
+
+    free(pagesInfo);
+    pagesInfo = nullptr;
+    BuildPagesInfo();
+}
+
+// called when the engine has resolved actual page sizes which differ
+// from the estimated ones the pages have been laid out with
+void DisplayModel::UpdatePageSizes() {
+    if (!pagesInfo) {
+        return;
+    }
+    RectF defaultRect = GetDefaultPageRect(engine);
+    bool changed = false;
+    int pageCount = PageCount();
+    for (int pageNo = 1; pageNo <= pageCount; pageNo++) {
+        PageInfo* pageInfo = GetPageInfo(pageNo);
+        if (!pageInfo->sizeIsEstimate) {
+            continue;
+        }
+        RectF page = engine->PageMediaboxOrEstimate(pageNo, &pageInfo->sizeIsEstimate);
+        if (page.IsEmpty()) {
+            page = defaultRect;
+        }
+        if (page != pageInfo->page) {
+            pageInfo->page = page;
+            pageInfo->contentBox = RectF();
+            changed = true;
+        }
+    }
+    if (!changed) {
+        return;
+    }
+    ScrollState ss = GetScrollState();
+    Relayout(zoomVirtual, rotation);
+    SetScrollState(ss);
+    RepaintDisplay();
+}
+
 // TODO: a better name e.g. ShouldShow() to better distinguish between
 // before-layout info and after-layout visibility checks
 bool DisplayModel::PageShown(int pageNo) const {
@@ -540,7 +618,7 @@ int DisplayModel::FirstVisiblePageNo() const {
         return INVALID_PAGE_NO;
     }
 
-    for (int pageNo = 1; pageNo <= PageCount(); ++pageNo) {
+    for (int pageNo = visibleStart; pageNo < visibleEnd; ++pageNo) {
         PageInfo* pageInfo = GetPageInfo(pageNo);
         if (pageInfo->visibleRatio > 0.0) {
             return pageNo;
@@ -551,6 +629,21 @@ int DisplayModel::FirstVisiblePageNo() const {
     return INVALID_PAGE_NO;
 }
 
+int DisplayModel::LastVisiblePageNo() const {
+    CrashIf(!pagesInfo);
+    if (!pagesInfo) {
+        return INVALID_PAGE_NO;
+    }
+
+    for (int pageNo = visibleEnd - 1; pageNo >= visibleStart; --pageNo) {
+        PageInfo* pageInfo = GetPageInfo(pageNo);
+        if (pageInfo->visibleRatio > 0.0) {
+            return pageNo;
+        }
+    }
+    return INVALID_PAGE_NO;
+}
+
 // we consider the most visible page the current one
 // (in continuous layout, there's no better criteria)
 int DisplayModel::CurrentPageNo() const {
@@ -566,7 +659,7 @@ int DisplayModel::CurrentPageNo() const {
     int mostVisiblePage = INVALID_PAGE_NO;
     float ratio = 0;
 
-    for (int pageNo = 1; pageNo <= PageCount(); pageNo++) {
+    for (int pageNo = visibleStart; pageNo < visibleEnd; pageNo++) {
         PageInfo* pageInfo = GetPageInfo(pageNo);
         if (pageInfo->visibleRatio > ratio) {
             mostVisiblePage = pageNo;
@@ -668,6 +761,8 @@ void DisplayModel::Relayout(float newZoomVirtual, int newRotation) {
     viewPort = Rect(viewPort.TL(), totalViewPortSize);
 
 RestartLayout:
+    rowStarts.Reset();
+    int lastShownPageNo = 0;
     int currPosY = windowMargin.top;
     float currZoomReal = zoomReal;
     CalcZoomReal(newZoomVirtual);
@@ -690,6 +785,10 @@ RestartLayout:
             CrashIf(0.0 != pageInfo->visibleRatio);
             continue;
         }
+        if (0 == pageInARow) {
+            rowStarts.Append(pageNo);
+        }
+        lastShownPageNo = pageNo;
         SizeF pageSize = PageSizeAfterRotation(pageNo);
         Rect pos;
         // don't add the full 0.5 for rounding to account for precision errors
@@ -746,6 +845,7 @@ RestartLayout:
         /* this is a partial row */
         currPosY += rowMaxPageDy + pageSpacing.dy;
     }
+    rowStarts.Append(lastShownPageNo + 1);
     // restart the layout if we detect we need to show scrollbars
     // (there are some edge cases we can't catch in the above loop)
     const int canvasDy = currPosY + windowMargin.bottom - pageSpacing.dy;
@@ -884,25 +984,55 @@ void DisplayModel::RecalcVisibleParts() {
         return;
     }
 
-    for (int pageNo = 1; pageNo <= PageCount(); ++pageNo) {
-        PageInfo* pageInfo = GetPageInfo(pageNo);
-        if (!pageInfo->shown) {
-            CrashIf(0.0 != pageInfo->visibleRatio);
-            continue;
+    ClearVisibleParts();
+    // only pages in the rows overlapping the view port can be visible
+    int nRows = (int)rowStarts.size() - 1;
+    for (int row = RowAtY(viewPort.y); row < nRows; row++) {
+        if (GetPageInfo(rowStarts.at(row))->pos.y >= viewPort.y + viewPort.dy) {
+            break;
         }
+        for (int pageNo = rowStarts.at(row); pageNo < rowStarts.at(row + 1); pageNo++) {
+            PageInfo* pageInfo = GetPageInfo(pageNo);
+            if (!pageInfo->shown) {
+                continue;
+            }
 
-        Rect pageRect = pageInfo->pos;
-        Rect visiblePart = pageRect.Intersect(viewPort);
-
-        pageInfo->visibleRatio = 0.0;
-        if (!visiblePart.IsEmpty()) {
+            Rect pageRect = pageInfo->pos;
+            Rect visiblePart = pageRect.Intersect(viewPort);
+            if (visiblePart.IsEmpty()) {
+                continue;
+            }
             CrashIf(pageRect.dx <= 0 || pageRect.dy <= 0);
             // calculate with floating point precision to prevent an integer overflow
             pageInfo->visibleRatio = 1.0f * visiblePart.dx * visiblePart.dy / ((float)pageRect.dx * pageRect.dy);
+            if (visibleStart == visibleEnd) {
+                visibleStart = pageNo;
+            }
+            visibleEnd = pageNo + 1;
+        }
+    }
+}
+
+void DisplayModel::ClearVisibleParts() {
+    for (int pageNo = visibleStart; pageNo < visibleEnd; pageNo++) {
+        GetPageInfo(pageNo)->visibleRatio = 0.0;
+    }
+    visibleStart = visibleEnd = 0;
+}
+
+// returns the last row starting above or at y on the canvas (or the first row)
+int DisplayModel::RowAtY(int y) const {
+    int lo = 0;
+    int hi = (int)rowStarts.size() - 1;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (GetPageInfo(rowStarts.at(mid))->pos.y <= y) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
         }
-        pageInfo->pageOnScreen = pageRect;
-        pageInfo->pageOnScreen.Offset(-viewPort.x, -viewPort.y);
     }
+    return std::max(lo - 1, 0);
 }
 
 int DisplayModel::GetPageNoByPoint(Point pt) {
@@ -911,14 +1041,19 @@ int DisplayModel::GetPageNoByPoint(Point pt) {
         return -1;
     }
 
-    for (int pageNo = 1; pageNo <= PageCount(); ++pageNo) {
+    // pages in other rows end above resp. start below the point
+    int row = RowAtY(pt.y + viewPort.y);
+    if (row >= (int)rowStarts.size() - 1) {
+        return -1;
+    }
+    for (int pageNo = rowStarts.at(row); pageNo < rowStarts.at(row + 1); ++pageNo) {
         PageInfo* pageInfo = GetPageInfo(pageNo);
         CrashIf(!(0.0 == pageInfo->visibleRatio || pageInfo->shown));
         if (!pageInfo->shown) {
             continue;
         }
 
-        if (pageInfo->pageOnScreen.Contains(pt)) {
+        if (PageOnScreen(pageNo).Contains(pt)) {
             return pageNo;
         }
     }
@@ -934,23 +1069,47 @@ int DisplayModel::GetPageNextToPoint(Point pt) {
     unsigned int maxDist = UINT_MAX;
     int closest = startPage;
 
-    for (int pageNo = 1; pageNo <= PageCount(); ++pageNo) {
-        PageInfo* pageInfo = GetPageInfo(pageNo);
-        CrashIf(0.0 != pageInfo->visibleRatio && !pageInfo->shown);
-        if (!pageInfo->shown) {
-            continue;
-        }
+    auto checkRow = [&](int row) {
+        for (int pageNo = rowStarts.at(row); pageNo < rowStarts.at(row + 1); ++pageNo) {
+            PageInfo* pageInfo = GetPageInfo(pageNo);
+            CrashIf(0.0 != pageInfo->visibleRatio && !pageInfo->shown);
+            if (!pageInfo->shown) {
+                continue;
+            }
 
-        if (pageInfo->pageOnScreen.Contains(pt)) {
-            return pageNo;
+            Rect r = PageOnScreen(pageNo);
+            if (r.Contains(pt)) {
+                maxDist = 0;
+                closest = pageNo;
+                return;
+            }
+            unsigned int dist = distSq(pt.x - r.x - r.dx / 2, pt.y - r.y - r.dy / 2);
+            if (dist < maxDist) {
+                closest = pageNo;
+                maxDist = dist;
+            }
         }
+    };
 
-        Rect r = pageInfo->pageOnScreen;
-        unsigned int dist = distSq(pt.x - r.x - r.dx / 2, pt.y - r.y - r.dy / 2);
-        if (dist < maxDist) {
-            closest = pageNo;
-            maxDist = dist;
+    // search outwards from the row at the point until the remaining rows
+    // are too far away to contain a page whose center is any closer
+    int y = pt.y + viewPort.y;
+    int nRows = (int)rowStarts.size() - 1;
+    int rowAtY = RowAtY(y);
+    for (int row = rowAtY; row < nRows && maxDist > 0; row++) {
+        int top = GetPageInfo(rowStarts.at(row))->pos.y;
+        if (row > rowAtY && distSq(0, top - y) >= maxDist) {
+            break;
         }
+        checkRow(row);
+    }
+    // the centers of pages in a row are above the start of the next row
+    for (int row = rowAtY - 1; row >= 0 && maxDist > 0; row--) {
+        int nextTop = GetPageInfo(rowStarts.at(row + 1))->pos.y;
+        if (distSq(0, y - nextTop) >= maxDist) {
+            break;
+        }
+        checkRow(row);
     }
 
     return closest;
@@ -970,7 +1129,7 @@ Point DisplayModel::CvtToScreen(int pageNo, PointF pt) {
     }
     PointF p = engine->Transform(pt, pageNo, zoom, rotation);
     // don't add the full 0.5 for rounding to account for precision errors
-    Rect r = pageInfo->pageOnScreen;
+    Rect r = PageOnScreen(pageNo);
     p.x += 0.499 + r.x;
     p.y += 0.499 + r.y;
 
@@ -995,7 +1154,7 @@ PointF DisplayModel::CvtFromScreen(Point pt, int pageNo) {
     }
 
     // don't add the full 0.5 for rounding to account for precision errors
-    Rect r = pageInfo->pageOnScreen;
+    Rect r = PageOnScreen(pageNo);
     PointF p = PointF(pt.x - 0.499 - r.x, pt.y - 0.499 - r.y);
     float zoom = pageInfo->zoomReal;
     // TODO: must be a better way
@@ -1067,7 +1226,7 @@ void DisplayModel::RenderVisibleParts() {
     int firstVisiblePage = 0;
     int lastVisiblePage = 0;
 
-    for (int pageNo = 1; pageNo <= PageCount(); ++pageNo) {
+    for (int pageNo = visibleStart; pageNo < visibleEnd; ++pageNo) {
         PageInfo* pageInfo = GetPageInfo(pageNo);
         if (pageInfo->visibleRatio > 0.0) {
             CrashIf(!pageInfo->shown);
@@ -1195,9 +1354,10 @@ void DisplayModel::GoToPage(int pageNo, int scrollY, bool addNavPt, int scrollX)
     } else if (ZOOM_FIT_CONTENT == zoomVirtual) {
         // make sure that CalcZoomReal uses the correct page to calculate
         // the zoom level for (visibility will be recalculated below anyway)
-        for (int i = PageCount(); i > 0; i--) {
-            GetPageInfo(i)->visibleRatio = (i == pageNo ? 1.0f : 0);
-        }
+        ClearVisibleParts();
+        GetPageInfo(pageNo)->visibleRatio = 1.0f;
+        visibleStart = pageNo;
+        visibleEnd = pageNo + 1;
         Relayout(zoomVirtual, rotation);
     }
     // lf("DisplayModel::GoToPage(pageNo=%d, scrollY=%d)", pageNo, scrollY);
@@ -1350,10 +1510,10 @@ bool DisplayModel::GoToPrevPage(int scrollY) {
         top = GetContentStart(currPageNo);
     }
 
-    PageInfo* pageInfo = GetPageInfo(currPageNo);
-    if (zoomVirtual == ZOOM_FIT_CONTENT && -pageInfo->pageOnScreen.y <= top.y) {
+    Rect pageOnScreen = PageOnScreen(currPageNo);
+    if (zoomVirtual == ZOOM_FIT_CONTENT && -pageOnScreen.y <= top.y) {
         scrollY = 0; // continue, even though the current page isn't fully visible
-    } else if (std::max(-pageInfo->pageOnScreen.y, 0) > scrollY && IsContinuous(GetDisplayMode())) {
+    } else if (std::max(-pageOnScreen.y, 0) > scrollY && IsContinuous(GetDisplayMode())) {
         /* the current page isn't fully visible, so show it first */
         GoToPage(currPageNo, scrollY);
         return true;
@@ -1366,7 +1526,7 @@ bool DisplayModel::GoToPrevPage(int scrollY) {
 
     // scroll to the bottom of the page
     if (-1 == scrollY) {
-        scrollY = GetPageInfo(firstPageInNewRow)->pageOnScreen.dy;
+        scrollY = PageOnScreen(firstPageInNewRow).dy;
     }
 
     GoToPage(firstPageInNewRow, scrollY);
@@ -1684,7 +1844,7 @@ bool DisplayModel::ShowResultRectToScreen(TextSel* res) {
         return false;
     }
 
-    PageInfo* pageInfo = GetPageInfo(res->pages[0]);
+    Rect pageOnScreen = PageOnScreen(res->pages[0]);
     int sx = 0, sy = 0;
 
     // vertically, we try to position the search result between 40%
@@ -1702,10 +1862,10 @@ bool DisplayModel::ShowResultRectToScreen(TextSel* res) {
     // center of the screen, but don't scroll further than page
     // boundaries, so that as much context as possible remains visible
     if (extremes.x < 0) {
-        sx = std::max(extremes.x + extremes.dx / 2 - viewPort.dx / 2, pageInfo->pageOnScreen.x);
+        sx = std::max(extremes.x + extremes.dx / 2 - viewPort.dx / 2, pageOnScreen.x);
     } else if (extremes.x + extremes.dx >= viewPort.dx) {
         sx = std::min(extremes.x + extremes.dx / 2 - viewPort.dx / 2,
-                      pageInfo->pageOnScreen.x + pageInfo->pageOnScreen.dx - viewPort.dx);
+                      pageOnScreen.x + pageOnScreen.dx - viewPort.dx);
     }
 
     if (sx != 0) {
@@ -1725,22 +1885,23 @@ ScrollState DisplayModel::GetScrollState() {
     }
 
     PageInfo* pageInfo = GetPageInfo(state.page);
+    Rect pageOnScreen = PageOnScreen(state.page);
     // Shortcut: don't calculate precise positions, if the
     // page wasn't scrolled right/down at all
-    if (!pageInfo || pageInfo->pageOnScreen.x > 0 && pageInfo->pageOnScreen.y > 0) {
+    if (!pageInfo || pageOnScreen.x > 0 && pageOnScreen.y > 0) {
         return state;
     }
 
     Rect screen(Point(), viewPort.Size());
-    Rect pageVis = pageInfo->pageOnScreen.Intersect(screen);
+    Rect pageVis = pageOnScreen.Intersect(screen);
     state.page = GetPageNextToPoint(pageVis.TL());
     PointF ptD = CvtFromScreen(pageVis.TL(), state.page);
 
     // Remember to show the margin, if it's currently visible
-    if (pageInfo->pageOnScreen.x <= 0) {
+    if (pageOnScreen.x <= 0) {
         state.x = ptD.x;
     }
-    if (pageInfo->pageOnScreen.y <= 0) {
+    if (pageOnScreen.y <= 0) {
         state.y = ptD.y;
     }
 
@@ -1833,6 +1994,45 @@ void DisplayModel::CopyNavHistory(DisplayModel& orig) {
     }
 }
 
+// after a reload, takes over what prev (showing the previous version of the document)
+// has cached for pages that haven't changed. unchangedPages is set to the number each
+// of prev's pages now has (or 0 if it has changed or hasn't been loaded by prev).
+// only pages visible in prev are compared as that requires loading the new pages;
+// all others are loaded and rendered anew when they're needed
+void DisplayModel::KeepUnchangedPages(DisplayModel& prev, Vec<int>& unchangedPages) {
+    EngineBase* prevEngine = prev.GetEngine();
+    int nPrev = prevEngine->PageCount();
+    int n = engine->PageCount();
+    unchangedPages.Reset();
+    unchangedPages.AppendBlanks(nPrev + 1);
+    Vec<bool> isKept;
+    isKept.AppendBlanks(n + 1);
+
+    // pages inserted or removed in one place shift all the pages after it
+    int shift = n - nPrev;
+    for (int prevPageNo = 1; prevPageNo <= nPrev; prevPageNo++) {
+        if (!prev.PageVisibleNearby(prevPageNo)) {
+            continue;
+        }
+        // pages prev hasn't loaded wouldn't have anything cached either
+        u64 fp = prevEngine->PageFingerprint(prevPageNo, false);
+        if (!fp) {
+            continue;
+        }
+        int candidates[2] = {prevPageNo, prevPageNo + shift};
+        for (int pageNo : candidates) {
+            if (!ValidPageNo(pageNo) || isKept.at(pageNo) || engine->PageFingerprint(pageNo, true) != fp) {
+                continue;
+            }
+            unchangedPages.at(prevPageNo) = pageNo;
+            isKept.at(pageNo) = true;
+            engine->KeepCachedPage(prevEngine, prevPageNo, pageNo);
+            textCache->TakeTextForPage(pageNo, prev.textCache, prevPageNo);
+            break;
+        }
+    }
+}
+
 bool DisplayModel::ShouldCacheRendering(int pageNo) {
     // recommend caching for all documents which are non-trivial to render
     if (!engine->IsImageCollection()) {
@@ -1843,7 +2043,8 @@ bool DisplayModel::ShouldCacheRendering(int pageNo) {
     // them for every UI update (WM_PAINT) can cause notable lags, and also
     // for smaller images which are scaled up
     PageInfo* info = GetPageInfo(pageNo);
-    return info->page.dx * info->page.dy > 1024 * 1024 || info->pageOnScreen.dx * info->pageOnScreen.dy > 1024 * 1024;
+    Rect onScreen = PageOnScreen(pageNo);
+    return info->page.dx * info->page.dy > 1024 * 1024 || onScreen.dx * onScreen.dy > 1024 * 1024;
 }
 
 void DisplayModel::ScrollToLink(PageDestination* dest) {
@@ -1867,8 +2068,7 @@ void DisplayModel::ScrollToLink(PageDestination* dest) {
             scroll.x = -1;
         }
         if (DEST_USE_DEFAULT == rect.y) {
-            PageInfo* pageInfo = GetPageInfo(CurrentPageNo());
-            scroll.y = -(pageInfo->pageOnScreen.y - windowMargin.top);
+            scroll.y = -(PageOnScreen(CurrentPageNo()).y - windowMargin.top);
         }
     } else if (rect.dx != DEST_USE_DEFAULT && rect.dy != DEST_USE_DEFAULT) {
         // PDF: /FitR left bottom right top
@@ -8,6 +8,8 @@
 struct PageInfo {
     /* data that is constant for a given page. page size in document units */
     RectF page{};
+    /* true while page is only an estimate (cf. DisplayModel::UpdatePageSizes()) */
+    bool sizeIsEstimate = false;
 
     /* data that is calculated when needed. actual content size within a page (View target) */
     RectF contentBox{};
@@ -24,8 +26,6 @@ struct PageInfo {
 
     /* data that changes due to scrolling. Calculated in DisplayModel::RecalcVisibleParts() */
     float visibleRatio; /* (0.0 = invisible, 1.0 = fully visible) */
-    /* position of page relative to visible view port: pos.Offset(-viewPort.x, -viewPort.y) */
-    Rect pageOnScreen{};
 
     // when zoomVirtual in DisplayMode is ZOOM_FIT_PAGE, ZOOM_FIT_WIDTH
     // or ZOOM_FIT_CONTENT, this is per-page zoom level
@@ -49,6 +49,7 @@ struct TextSelection;
 class TextSearch;
 struct TextSel;
 class Synchronizer;
+class LayoutCacheFile;
 
 // TODO: in hindsight, zoomVirtual is not a good name since it's either
 // virtual zoom level OR physical zoom level. Would be good to find
@@ -119,6 +120,11 @@ struct DisplayModel : public Controller {
     Kind engineType{nullptr};
 
     Synchronizer* pdfSync{nullptr};
+    // the cached layout the engine was loaded with (cf. FileThumbnails.h)
+    LayoutCacheFile* layoutCache{nullptr};
+    // unlike the pointer, this isn't reused for a later DisplayModel
+    // (cf. FindWindowInfoByDisplayModelId)
+    LONG id = 0;
 
     DocumentTextCache* textCache{nullptr};
     TextSelection* textSelection{nullptr};
@@ -126,6 +132,8 @@ struct DisplayModel : public Controller {
     TextSearch* textSearch{nullptr};
 
     PageInfo* GetPageInfo(int pageNo) const;
+    // position of the page relative to the visible view port
+    Rect PageOnScreen(int pageNo) const;
 
     /* current rotation selected by user */
     int GetRotation() const;
@@ -143,6 +151,7 @@ struct DisplayModel : public Controller {
     bool PageVisible(int pageNo) const;
     bool PageVisibleNearby(int pageNo) const;
     int FirstVisiblePageNo() const;
+    int LastVisiblePageNo() const;
     bool FirstBookPageVisible() const;
     bool LastBookPageVisible() const;
 
@@ -172,8 +181,14 @@ struct DisplayModel : public Controller {
     void SetScrollState(ScrollState state);
 
     void CopyNavHistory(DisplayModel& orig);
+    void KeepUnchangedPages(DisplayModel& prev, Vec<int>& unchangedPages);
 
     void SetInitialViewSettings(DisplayMode displayMode, int newStartPage, Size viewPort, int screenDPI);
+    // replaces everything which depends on the page count once it's final. Render threads
+    // mustn't access the pages meanwhile (cf. RenderCache::UpdateDisplayModel) and the
+    // pages have to be laid out again afterwards
+    void UpdatePageCount();
+    void UpdatePageSizes();
     void SetDisplayR2L(bool r2l);
     bool GetDisplayR2L() const;
 
@@ -192,6 +207,8 @@ struct DisplayModel : public Controller {
     void ChangeStartPage(int startPage);
     Point GetContentStart(int pageNo);
     void RecalcVisibleParts();
+    void ClearVisibleParts();
+    int RowAtY(int y) const;
     void RenderVisibleParts();
     void AddNavPoint();
     RectF GetContentBox(int pageNo);
@@ -204,6 +221,15 @@ struct DisplayModel : public Controller {
 
     /* an array of PageInfo, len of array is pageCount */
     PageInfo* pagesInfo{nullptr};
+    /* the first page of every row of shown pages (i.e. sorted by pos.y)
+       followed by the page after the last shown page, so that pages
+       at a given position can be found with a binary search.
+       Calculated in DisplayModel::Relayout() */
+    Vec<int> rowStarts;
+    /* the range of pages which might have a visibleRatio > 0
+       (visibleStart to visibleEnd - 1) */
+    int visibleStart{0};
+    int visibleEnd{0};
 
     DisplayMode displayMode{DisplayMode::Automatic};
     /* In non-continuous mode is the first page from a file that we're
@@ -3,6 +3,7 @@
 
 #include "utils/BaseUtil.h"
 #include "utils/Archive.h"
+#include "utils/Dict.h"
 #include "utils/FileUtil.h"
 #include "utils/GuessFileType.h"
 #include "utils/GdiPlusUtil.h"
@@ -271,6 +272,11 @@ const char* EPUB_OPF_NS = "http://www.idpf.org/2007/opf";
 const char* EPUB_NCX_NS = "http://www.daisy.org/z3986/2005/ncx/";
 const char* EPUB_ENC_NS = "http://www.w3.org/2001/04/xmlenc#";
 
+// recently used images (and other files) are kept in zip's cache
+#define MAX_EPUB_FILE_CACHE (32 * 1024 * 1024)
+// enough for determining the size of most images
+#define EPUB_IMAGE_HEADER_SIZE (64 * 1024)
+
 EpubDoc::EpubDoc(const WCHAR* fileName) {
     this->fileName.SetCopy(fileName);
     InitializeCriticalSection(&zipAccess);
@@ -285,9 +291,9 @@ EpubDoc::EpubDoc(IStream* stream) {
 EpubDoc::~EpubDoc() {
     EnterCriticalSection(&zipAccess);
 
-    for (size_t i = 0; i < images.size(); i++) {
-        free(images.at(i).base.data);
-        free(images.at(i).fileName);
+    for (EpubChapter& ch : chapters) {
+        free(ch.path);
+        free(ch.html);
     }
 
     LeaveCriticalSection(&zipAccess);
@@ -315,15 +321,11 @@ static bool isHtmlMediaType(const WCHAR* mediatype) {
     return false;
 }
 
-// TODO: switch to seqstring
-static bool isImageMediaType(const WCHAR* mediatype) {
-    return str::Eq(mediatype, L"image/png") || str::Eq(mediatype, L"image/jpeg") || str::Eq(mediatype, L"image/gif");
-}
-
 bool EpubDoc::Load() {
     if (!zip) {
         return false;
     }
+    zip->SetCacheLimit(MAX_EPUB_FILE_CACHE);
     AutoFree container(zip->GetFileDataByName("META-INF/container.xml"));
     if (!container.data) {
         return false;
@@ -382,27 +384,14 @@ bool EpubDoc::Load() {
         *contentPath = '\0';
     }
 
-    WStrList idList, pathList;
+    // manifest ids of html documents (indexes into pathList)
+    dict::MapWStrToInt idToPath;
+    WStrList pathList;
 
     for (node = node->down; node; node = node->next) {
+        // images are looked up by path in zip (cf. GetImageId)
         AutoFreeWstr mediatype(node->GetAttribute("media-type"));
-        if (isImageMediaType(mediatype)) {
-            AutoFreeWstr imgPath = node->GetAttribute("href");
-            if (!imgPath) {
-                continue;
-            }
-            url::DecodeInPlace(imgPath);
-            imgPath.Set(str::Join(contentPath, imgPath));
-            if (encList.Contains(imgPath)) {
-                continue;
-            }
-            // load the image lazily
-            ImageData2 data = {0};
-            auto tmp = strconv::WstrToUtf8(imgPath);
-            data.fileName = (char*)tmp.data();
-            data.fileId = zip->GetFileId(data.fileName);
-            images.Append(data);
-        } else if (isHtmlMediaType(mediatype)) {
+        if (isHtmlMediaType(mediatype)) {
             AutoFreeWstr htmlPath(node->GetAttribute("href"));
             if (!htmlPath) {
                 continue;
@@ -419,8 +408,7 @@ bool EpubDoc::Load() {
             if (encList.size() > 0 && encList.Contains(fullContentPath)) {
                 continue;
             }
-            if (htmlPath && htmlId) {
-                idList.Append(htmlId.StealData());
+            if (htmlPath && htmlId && idToPath.Insert(htmlId, pathList.isize(), nullptr)) {
                 pathList.Append(htmlPath.StealData());
             }
         }
@@ -433,8 +421,9 @@ bool EpubDoc::Load() {
 
     // EPUB 2 ToC
     AutoFreeWstr tocId(node->GetAttribute("toc"));
-    if (tocId && !tocPath && idList.Contains(tocId)) {
-        tocPath.Set(str::Join(contentPath, pathList.at(idList.Find(tocId))));
+    int pathIdx = 0;
+    if (tocId && !tocPath && idToPath.Get(tocId, &pathIdx)) {
+        tocPath.Set(str::Join(contentPath, pathList.at(pathIdx)));
         isNcxToc = true;
     }
     AutoFreeWstr readingDir(node->GetAttribute("page-progression-direction"));
@@ -447,31 +436,59 @@ bool EpubDoc::Load() {
             continue;
         }
         AutoFreeWstr idref = node->GetAttribute("idref");
-        if (!idref || !idList.Contains(idref)) {
+        if (!idref || !idToPath.Get(idref, &pathIdx)) {
             continue;
         }
 
-        const WCHAR* fileName = pathList.at(idList.Find(idref));
-        AutoFreeWstr fullPath = str::Join(contentPath, fileName);
-        AutoFree html = zip->GetFileDataByName(fullPath);
-        if (!html.data) {
+        AutoFreeWstr fullPath = str::Join(contentPath, pathList.at(pathIdx));
+        EpubChapter ch;
+        ch.path = (char*)strconv::WstrToUtf8(fullPath).data();
+        ch.fileId = zip->GetFileId(ch.path);
+        if (ch.fileId == (size_t)-1) {
+            free(ch.path);
             continue;
         }
-        char* decoded = DecodeTextToUtf8(html.data, true);
-        html.TakeOwnershipOf(decoded);
+        ch.fileSize = zip->GetFileInfos().at(ch.fileId)->fileSizeUncompressed;
+        chapters.Append(ch);
+    }
+
+    // only load chapters up to the first one with content
+    size_t offset;
+    for (int i = 0; i < chapters.isize(); i++) {
+        if (GetChapterHtml(i, &offset).size() > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// caller must hold zipAccess
+void EpubDoc::LoadChapters(int count) {
+    for (; chaptersLoaded < count; chaptersLoaded++) {
+        EpubChapter& ch = chapters.at(chaptersLoaded);
+        if (chaptersLoaded > 0) {
+            EpubChapter& prev = chapters.at(chaptersLoaded - 1);
+            ch.htmlOffset = prev.htmlOffset + prev.htmlLen;
+        }
+        AutoFree data(zip->GetFileDataById(ch.fileId));
+        if (!data.data) {
+            continue;
+        }
+        AutoFree html(DecodeTextToUtf8(data.data, true));
         if (!html.data) {
             continue;
         }
         // insert explicit page-breaks between sections including
         // an anchor with the file name at the top (for internal links)
-        AutoFree utf8_path = strconv::WstrToUtf8(fullPath);
-        DebugCrashIf(str::FindChar(utf8_path.Get(), '"'));
-        str::TransChars(utf8_path.Get(), "\"", "'");
-        htmlData.AppendFmt("<pagebreak page_path=\"%s\" page_marker />", utf8_path.Get());
-        htmlData.Append(html.data);
+        AutoFree pagePath(str::Dup(ch.path));
+        DebugCrashIf(str::FindChar(pagePath.Get(), '"'));
+        str::TransChars(pagePath.Get(), "\"", "'");
+        str::Str s;
+        s.AppendFmt("<pagebreak page_path=\"%s\" page_marker />", pagePath.Get());
+        s.Append(html.data);
+        ch.htmlLen = s.size();
+        ch.html = s.StealData();
     }
-
-    return htmlData.size() > 0;
 }
 
 void EpubDoc::ParseMetadata(const char* content) {
@@ -515,11 +532,44 @@ void EpubDoc::ParseMetadata(const char* content) {
     }
 }
 
-std::span<u8> EpubDoc::GetHtmlData() const {
+std::span<u8> EpubDoc::GetHtmlData() {
+    ScopedCritSec scope(&zipAccess);
+    if (htmlData.size() == 0) {
+        LoadChapters(chapters.isize());
+        for (EpubChapter& ch : chapters) {
+            htmlData.Append(ch.html, ch.htmlLen);
+        }
+    }
     return htmlData.AsSpan();
 }
 
-ImageData* EpubDoc::GetImageData(const char* fileName, const char* pagePath) {
+size_t EpubDoc::EstimateHtmlSize() {
+    ScopedCritSec scope(&zipAccess);
+    size_t size = 0;
+    for (int i = 0; i < chapters.isize(); i++) {
+        EpubChapter& ch = chapters.at(i);
+        size += i < chaptersLoaded ? ch.htmlLen : ch.fileSize;
+    }
+    return size;
+}
+
+int EpubDoc::GetChapterCount() const {
+    return chapters.isize();
+}
+
+const char* EpubDoc::GetChapterPath(int idx) const {
+    return chapters.at(idx).path;
+}
+
+std::span<u8> EpubDoc::GetChapterHtml(int idx, size_t* offsetOut) {
+    ScopedCritSec scope(&zipAccess);
+    LoadChapters(idx + 1);
+    EpubChapter& ch = chapters.at(idx);
+    *offsetOut = ch.htmlOffset;
+    return {(u8*)ch.html, ch.htmlLen};
+}
+
+size_t EpubDoc::GetImageId(const char* fileName, const char* pagePath) {
     ScopedCritSec scope(&zipAccess);
 
     if (!pagePath) {
@@ -531,20 +581,12 @@ ImageData* EpubDoc::GetImageData(const char* fileName, const char* pagePath) {
         // styling related state (such as nextPageStyle, listDepth, etc. including
         // format specific state such as hiddenDepth and titleCount) and store it
         // in every HtmlPage, but this should work well enough for now
-        for (size_t i = 0; i < images.size(); i++) {
-            ImageData2* img = &images.at(i);
-            if (str::EndsWithI(img->fileName, fileName)) {
-                if (!img->base.data) {
-                    auto res = zip->GetFileDataById(img->fileId);
-                    img->base.len = res.size();
-                    img->base.data = (char*)res.data();
-                }
-                if (img->base.data) {
-                    return &img->base;
-                }
+        for (auto* fileInfo : zip->GetFileInfos()) {
+            if (str::EndsWithI(fileInfo->name.data(), fileName)) {
+                return fileInfo->fileId;
             }
         }
-        return nullptr;
+        return (size_t)-1;
     }
 
     AutoFree url(NormalizeURL(fileName, pagePath));
@@ -552,35 +594,18 @@ ImageData* EpubDoc::GetImageData(const char* fileName, const char* pagePath) {
     if (str::FindChar(url, '\\')) {
         str::TransChars(url, "\\", "/");
     }
-    for (size_t i = 0; i < images.size(); i++) {
-        ImageData2* img = &images.at(i);
-        if (str::Eq(img->fileName, url)) {
-            if (!img->base.data) {
-                auto res = zip->GetFileDataById(img->fileId);
-                img->base.len = res.size();
-                img->base.data = (char*)res.data();
-            }
-            if (img->base.data) {
-                return &img->base;
-            }
-        }
-    }
+    // this also finds images which aren't registered in the manifest
+    return zip->GetFileId(url);
+}
 
-    // try to also load images which aren't registered in the manifest
-    ImageData2 data = {0};
-    data.fileId = zip->GetFileId(url);
-    if (data.fileId != (size_t)-1) {
-        auto res = zip->GetFileDataById(data.fileId);
-        data.base.len = res.size();
-        data.base.data = (char*)res.data();
-        if (data.base.data) {
-            data.fileName = str::Dup(url);
-            images.Append(data);
-            return &images.Last().base;
-        }
-    }
+std::span<u8> EpubDoc::LoadImageData(size_t imageId) {
+    ScopedCritSec scope(&zipAccess);
+    return zip->GetFileDataById(imageId);
+}
 
-    return nullptr;
+std::span<u8> EpubDoc::LoadImageHeader(size_t imageId) {
+    ScopedCritSec scope(&zipAccess);
+    return zip->GetFileDataPartById(imageId, EPUB_IMAGE_HEADER_SIZE);
 }
 
 std::span<u8> EpubDoc::GetFileData(const char* relPath, const char* pagePath) {
@@ -18,14 +18,33 @@ class PropertyMap {
 
 /* ********** EPUB ********** */
 
-class EpubDoc {
+// a document from the spine, whose html is only loaded when needed
+struct EpubChapter {
+    // full path within the archive
+    char* path = nullptr;
+    size_t fileId = 0;
+    size_t fileSize = 0;
+    // utf-8 html (preceded by a <pagebreak>), nullptr until loaded
+    char* html = nullptr;
+    size_t htmlLen = 0;
+    // offset of html within the html of the whole book
+    size_t htmlOffset = 0;
+};
+
+// images are referenced by their file id within zip
+// and kept in zip's cache while they're recently used
+class EpubDoc : public ImageDataLoader {
     MultiFormatArchive* zip = nullptr;
-    // zip and images are the only mutable members of EpubDoc after initialization;
+    // zip, chapters and htmlData are the only mutable members of EpubDoc after initialization;
     // access to them must be serialized for multi-threaded users (such as EbookController)
     CRITICAL_SECTION zipAccess;
 
+    // in reading order
+    Vec<EpubChapter> chapters;
+    // chapters are loaded in order (since their offsets depend on all previous ones)
+    int chaptersLoaded = 0;
+    // all chapters' html (only concatenated for GetHtmlData)
     str::Str htmlData;
-    Vec<ImageData2> images;
     AutoFreeWstr tocPath;
     AutoFreeWstr fileName;
     PropertyMap props;
@@ -33,6 +52,7 @@ class EpubDoc {
     bool isRtlDoc = false;
 
     bool Load();
+    void LoadChapters(int count);
     void ParseMetadata(const char* content);
     bool ParseNavToc(const char* data, size_t dataLen, const char* pagePath, EbookTocVisitor* visitor);
     bool ParseNcxToc(const char* data, size_t dataLen, const char* pagePath, EbookTocVisitor* visitor);
@@ -40,11 +60,24 @@ class EpubDoc {
   public:
     explicit EpubDoc(const WCHAR* fileName);
     explicit EpubDoc(IStream* stream);
-    ~EpubDoc();
+    ~EpubDoc() override;
 
-    std::span<u8> GetHtmlData() const;
-
-    ImageData* GetImageData(const char* fileName, const char* pagePath);
+    // loads all chapters
+    std::span<u8> GetHtmlData();
+    // exact once all chapters have been loaded
+    size_t EstimateHtmlSize();
+
+    int GetChapterCount() const;
+    const char* GetChapterPath(int idx) const;
+    // loads all chapters up to idx. offsetOut receives the offset
+    // of the chapter's html within the html of the whole book
+    std::span<u8> GetChapterHtml(int idx, size_t* offsetOut);
+
+    // returns (size_t)-1 if there's no such image
+    size_t GetImageId(const char* fileName, const char* pagePath);
+    std::span<u8> LoadImageData(size_t imageId) override;
+    // e.g. for determining the image's size
+    std::span<u8> LoadImageHeader(size_t imageId);
     std::span<u8> GetFileData(const char* relPath, const char* pagePath);
 
     WCHAR* GetProperty(DocumentProperty prop) const;
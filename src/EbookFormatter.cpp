@@ -137,6 +137,49 @@ void MobiFormatter::HandleHtmlTag(HtmlToken* t) {
 
 /* EPUB-specific formatting methods */
 
+EpubFormatter::EpubFormatter(HtmlFormatterArgs* args, EpubDoc* doc) : HtmlFormatter(args), epubDoc(doc) {
+    // skip the chapters before args->reparseIdx
+    while (LoadNextHtml()) {
+        ptrdiff_t offset = args->reparseIdx - htmlOffset;
+        if (offset < (ptrdiff_t)htmlParser->Len()) {
+            htmlParser->SetCurrPosOff(offset);
+            if (offset > 0) {
+                pagePath.SetCopy(epubDoc->GetChapterPath(nextChapter - 1));
+            }
+            break;
+        }
+    }
+}
+
+bool EpubFormatter::LoadNextHtml() {
+    while (nextChapter < epubDoc->GetChapterCount()) {
+        size_t offset = 0;
+        std::span<u8> html = epubDoc->GetChapterHtml(nextChapter++, &offset);
+        if (html.size() > 0) {
+            SetHtml(html, (ptrdiff_t)offset);
+            return true;
+        }
+    }
+    return false;
+}
+
+// images are loaded again when drawn, so layout only needs their size
+bool EpubFormatter::EmitImageSrc(const char* src) {
+    size_t imageId = epubDoc->GetImageId(src, pagePath);
+    if (imageId == (size_t)-1) {
+        return false;
+    }
+    AutoFree data(epubDoc->LoadImageHeader(imageId));
+    ImageData img{data.data, data.size()};
+    if (img.data && EmitImage(&img, epubDoc, imageId)) {
+        return true;
+    }
+    // the size might come after the header (e.g. in JPEGs with large metadata)
+    data.Set(epubDoc->LoadImageData(imageId));
+    img = {data.data, data.size()};
+    return img.data && EmitImage(&img, epubDoc, imageId);
+}
+
 void EpubFormatter::HandleTagImg(HtmlToken* t) {
     CrashIf(!epubDoc);
     if (t->IsEndTag()) {
@@ -147,8 +190,7 @@ void EpubFormatter::HandleTagImg(HtmlToken* t) {
     if (attr) {
         AutoFree src(str::DupN(attr->val, attr->valLen));
         url::DecodeInPlace(src);
-        ImageData* img = epubDoc->GetImageData(src, pagePath);
-        needAlt = !img || !EmitImage(img);
+        needAlt = !EmitImageSrc(src);
     }
     if (needAlt && (attr = t->GetAttrByName("alt")) != nullptr) {
         HandleText(attr->val, attr->valLen);
@@ -209,10 +251,7 @@ void EpubFormatter::HandleTagSvgImage(HtmlToken* t) {
     }
     AutoFree src(str::DupN(attr->val, attr->valLen));
     url::DecodeInPlace(src);
-    ImageData* img = epubDoc->GetImageData(src, pagePath);
-    if (img) {
-        EmitImage(img);
-    }
+    EmitImageSrc(src);
 }
 
 void EpubFormatter::HandleHtmlTag(HtmlToken* t) {
@@ -22,22 +22,25 @@ class MobiFormatter : public HtmlFormatter {
 
 class EpubDoc;
 
+// lays out the html chapter by chapter as they're loaded (ignoring args->htmlStr)
 class EpubFormatter : public HtmlFormatter {
     void HandleTagImg(HtmlToken* t) override;
     void HandleTagPagebreak(HtmlToken* t) override;
     void HandleTagLink(HtmlToken* t) override;
     void HandleHtmlTag(HtmlToken* t) override;
     bool IgnoreText() override;
+    bool LoadNextHtml() override;
 
     void HandleTagSvgImage(HtmlToken* t);
+    bool EmitImageSrc(const char* src);
 
     EpubDoc* epubDoc;
     AutoFree pagePath;
-    size_t hiddenDepth;
+    size_t hiddenDepth = 0;
+    int nextChapter = 0;
 
   public:
-    EpubFormatter(HtmlFormatterArgs* args, EpubDoc* doc) : HtmlFormatter(args), epubDoc(doc), hiddenDepth(0) {
-    }
+    EpubFormatter(HtmlFormatterArgs* args, EpubDoc* doc);
 };
 
 /* formatting extensions for FictionBook */
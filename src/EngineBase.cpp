@@ -533,6 +533,32 @@ RenderedBitmap* EngineBase::GetImageForPageElement(IPageElement*) {
     return nullptr;
 }
 
+void EngineBase::SetLayoutFinishedCb([[maybe_unused]] const std::function<void()>& cb) {
+}
+
+void EngineBase::UpdatePageCount() {
+}
+
+RectF EngineBase::PageMediaboxOrEstimate(int pageNo, bool* isEstimate) {
+    *isEstimate = false;
+    return PageMediabox(pageNo);
+}
+
+void EngineBase::SetPageSizesChangedCb([[maybe_unused]] const std::function<void()>& cb) {
+}
+
+std::span<u8> EngineBase::GetLayoutCache() {
+    return {};
+}
+
+u64 EngineBase::PageFingerprint([[maybe_unused]] int pageNo, [[maybe_unused]] bool load) {
+    return 0;
+}
+
+void EngineBase::KeepCachedPage([[maybe_unused]] EngineBase* prev, [[maybe_unused]] int prevPageNo,
+                                [[maybe_unused]] int pageNo) {
+}
+
 void EngineBase::SetFileName(const WCHAR* s) {
     fileNameBase.SetCopy(s);
 }
@@ -279,6 +279,20 @@ class AbortCookie {
     virtual void Abort() = 0;
 };
 
+class RenderingCallback {
+  public:
+    virtual void Callback(RenderedBitmap* bmp = nullptr) = 0;
+    // called from the rendering thread while a page is rendered progressively
+    // (cf. RenderPageArgs::progressCb). Pages are rendered from top to bottom, so
+    // the top <completion> part of bmp is final (the rest is still blank)
+    // the callee takes ownership of bmp
+    virtual void Progress(RenderedBitmap* bmp, [[maybe_unused]] float completion) {
+        delete bmp;
+    }
+    virtual ~RenderingCallback() {
+    }
+};
+
 struct RenderPageArgs {
     int pageNo = 0;
     float zoom = 0;
@@ -287,6 +301,9 @@ struct RenderPageArgs {
     RectF* pageRect = nullptr;
     RenderTarget target = RenderTarget::View;
     AbortCookie** cookie_out = nullptr;
+    // if set, engines that can (e.g. EnginePdf) pass partial results
+    // of pages that take long to render to progressCb->Progress
+    RenderingCallback* progressCb = nullptr;
 
     RenderPageArgs(int pageNo, float zoom, int rotation, RectF* pageRect = nullptr,
                    RenderTarget target = RenderTarget::View, AbortCookie** cookie_out = nullptr);
@@ -303,6 +320,11 @@ class EngineBase {
     bool isImageCollection = false;
     bool allowsPrinting = true;
     bool allowsCopyingText = true;
+    // if true, RenderPage() may be called from several threads at once
+    bool allowsConcurrentRendering = false;
+    // if true, pages are fingerprinted when they're loaded (cf. PageFingerprint)
+    // which is only worth it if the document might be reloaded
+    bool fingerprintPages = false;
     bool isPasswordProtected = false;
     char* decryptionKey = nullptr;
     bool hasPageLabels = false;
@@ -417,6 +439,34 @@ class EngineBase {
 
     virtual RenderedBitmap* GetImageForPageElement(IPageElement*);
 
+    // engines which lay out pages in the background start out with an estimated
+    // page count and call cb (on the layout thread) once all pages are laid out,
+    // after which UpdatePageCount() sets the final page count (on the UI thread)
+    virtual void SetLayoutFinishedCb(const std::function<void()>& cb);
+    virtual void UpdatePageCount();
+
+    // engines which resolve page sizes in the background return an estimate
+    // (and set isEstimate) for pages whose actual size isn't known yet instead of
+    // resolving it like PageMediabox and call cb (on a background thread)
+    // whenever actual page sizes turn out to differ from the estimate
+    virtual RectF PageMediaboxOrEstimate(int pageNo, bool* isEstimate);
+    virtual void SetPageSizesChangedCb(const std::function<void()>& cb);
+
+    // results of expensive parts of loading the document (such as all page sizes)
+    // which can be passed to CreateEngine when loading the same document again
+    // returns {} if there's nothing worth caching (yet); caller must free
+    virtual std::span<u8> GetLayoutCache();
+
+    // a hash of everything that determines how a page looks (e.g. its content stream
+    // and resources) so that what has been cached for a page can be kept when the
+    // document is reloaded and the page hasn't changed. Returns 0 if unknown (e.g. if
+    // !fingerprintPages when the page was loaded) and, if !load, for pages that haven't
+    // been loaded yet
+    virtual u64 PageFingerprint(int pageNo, bool load);
+    // takes over what prev (a previous version of the same document) has cached
+    // for its page prevPageNo for pageNo which has the same fingerprint
+    virtual void KeepCachedPage(EngineBase* prev, int prevPageNo, int pageNo);
+
     // protected:
     void SetFileName(const WCHAR* s);
 };
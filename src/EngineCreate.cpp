@@ -68,13 +68,14 @@ bool IsSupportedFileType(Kind kind, bool enableEngineEbooks) {
 }
 
 static EngineBase* CreateEngineForKind(Kind kind, const WCHAR* path, PasswordUI* pwdUI, bool enableChmEngine,
-                                       bool enableEngineEbooks) {
+                                       bool enableEngineEbooks, bool ebookLayoutInBackground,
+                                       std::span<u8> layoutCache) {
     if (!kind) {
         return nullptr;
     }
     EngineBase* engine = nullptr;
     if (kind == kindFilePDF) {
-        engine = CreateEnginePdfFromFile(path, pwdUI);
+        engine = CreateEnginePdfFromFile(path, pwdUI, layoutCache);
     } else if (kind == kindFileVbkm) {
         engine = CreateEngineMultiFromFile(path, pwdUI);
     } else if (IsXpsEngineSupportedFileType(kind)) {
@@ -105,7 +106,7 @@ static EngineBase* CreateEngineForKind(Kind kind, const WCHAR* path, PasswordUI*
     } else if (IsPsEngineSupportedFileType(kind)) {
         engine = CreatePsEngineFromFile(path);
     } else if (enableChmEngine && (kind == kindFileChm)) {
-        engine = CreateChmEngineFromFile(path);
+        engine = CreateChmEngineFromFile(path, ebookLayoutInBackground);
     } else if (gEnableMupdfEngine && kind == kindFileEpub) {
         engine = CreateEngineMupdfFromFile(path);
     }
@@ -115,35 +116,38 @@ static EngineBase* CreateEngineForKind(Kind kind, const WCHAR* path, PasswordUI*
     }
 
     if (kind == kindFileEpub) {
-        engine = CreateEpubEngineFromFile(path);
+        engine = CreateEpubEngineFromFile(path, ebookLayoutInBackground);
     } else if (kind == kindFileFb2) {
-        engine = CreateFb2EngineFromFile(path);
+        engine = CreateFb2EngineFromFile(path, ebookLayoutInBackground);
     } else if (kind == kindFileMobi) {
-        engine = CreateMobiEngineFromFile(path);
+        engine = CreateMobiEngineFromFile(path, ebookLayoutInBackground);
     } else if (kind == kindFilePalmDoc) {
-        engine = CreatePdbEngineFromFile(path);
+        engine = CreatePdbEngineFromFile(path, ebookLayoutInBackground);
     } else if (kind == kindFileHTML) {
-        engine = CreatePdbEngineFromFile(path);
+        engine = CreatePdbEngineFromFile(path, ebookLayoutInBackground);
     } else if (kind == kindFileTxt) {
-        engine = CreateTxtEngineFromFile(path);
+        engine = CreateTxtEngineFromFile(path, ebookLayoutInBackground);
     }
     return engine;
 }
 
-EngineBase* CreateEngine(const WCHAR* path, PasswordUI* pwdUI, bool enableChmEngine, bool enableEngineEbooks) {
+EngineBase* CreateEngine(const WCHAR* path, PasswordUI* pwdUI, bool enableChmEngine, bool enableEngineEbooks,
+                         bool ebookLayoutInBackground, std::span<u8> layoutCache) {
     CrashIf(!path);
 
     // try to open with the engine guess from file name
     // if that fails, try to guess the file type based on content
     Kind kind = GuessFileTypeFromName(path);
-    EngineBase* engine = CreateEngineForKind(kind, path, pwdUI, enableChmEngine, enableEngineEbooks);
+    EngineBase* engine = CreateEngineForKind(kind, path, pwdUI, enableChmEngine, enableEngineEbooks,
+                                             ebookLayoutInBackground, layoutCache);
     if (engine) {
         return engine;
     }
 
     Kind newKind = GuessFileTypeFromContent(path);
     if (kind != newKind) {
-        engine = CreateEngineForKind(newKind, path, pwdUI, enableChmEngine, enableEngineEbooks);
+        engine = CreateEngineForKind(newKind, path, pwdUI, enableChmEngine, enableEngineEbooks,
+                                     ebookLayoutInBackground, layoutCache);
     }
     return engine;
 }
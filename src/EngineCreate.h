@@ -3,8 +3,12 @@
 
 bool IsSupportedFileType(Kind kind, bool enableEngineEbooks);
 
+// with ebookLayoutInBackground, ebooks start out with an estimated page count
+// (cf. EngineBase::SetLayoutFinishedCb)
+// layoutCache is what EngineBase::GetLayoutCache returned for the unchanged file
 EngineBase* CreateEngine(const WCHAR* filePath, PasswordUI* pwdUI = nullptr, bool enableChmEngine = true,
-                         bool enableEngineEbooks = true);
+                         bool enableEngineEbooks = true, bool ebookLayoutInBackground = false,
+                         std::span<u8> layoutCache = {});
 
 bool EngineSupportsAnnotations(EngineBase*);
 bool EngineGetAnnotations(EngineBase*, Vec<Annotation*>*);
@@ -14,6 +14,7 @@
 #include "utils/WinUtil.h"
 #include "utils/ScopedWin.h"
 #include "utils/Log.h"
+#include "utils/ThreadUtil.h"
 
 #include "SumatraConfig.h"
 #include "wingui/TreeModel.h"
@@ -127,41 +128,32 @@ static TocItem* newDjVuTocItem(TocItem* parent, const char* title, const char* l
     return res;
 }
 
+// libdjvu initializes the locale when creating a context
+static Mutex gDjVuContextCreation;
+
+// every document has its own context (and thus its own message queue), so that
+// different documents can be rendered in parallel. lock serializes all calls into
+// libdjvu for the document (which is fine, as rendering is serialized per document anyway)
 struct DjVuContext {
     ddjvu_context_t* ctx = nullptr;
-    int refCount = 1;
     CRITICAL_SECTION lock;
 
     DjVuContext() {
         InitializeCriticalSection(&lock);
+        gDjVuContextCreation.Lock();
         ctx = ddjvu_context_create("DjVuEngine");
         // reset the locale to "C" as most other code expects
         setlocale(LC_ALL, "C");
+        gDjVuContextCreation.Unlock();
         CrashIf(!ctx);
     }
 
-    int AddRef() {
-        EnterCriticalSection(&lock);
-        ++refCount;
-        int res = refCount;
-        LeaveCriticalSection(&lock);
-        return res;
-    }
-
-    int Release() {
-        EnterCriticalSection(&lock);
-        CrashIf(refCount <= 0);
-        --refCount;
-        LeaveCriticalSection(&lock);
-        return refCount;
-    }
-
     ~DjVuContext() {
-        EnterCriticalSection(&lock);
+        gDjVuContextCreation.Lock();
         if (ctx) {
             ddjvu_context_release(ctx);
         }
-        LeaveCriticalSection(&lock);
+        gDjVuContextCreation.Unlock();
         DeleteCriticalSection(&lock);
     }
 
@@ -202,36 +194,24 @@ struct DjVuContext {
     }
 };
 
-// TODO: make it non-static because it accesses other static state
-// in djvu which got deleted first
-static DjVuContext* gDjVuContext;
-
-static DjVuContext* GetDjVuContext() {
-    if (!gDjVuContext) {
-        gDjVuContext = new DjVuContext();
-    } else {
-        gDjVuContext->AddRef();
-    }
-    return gDjVuContext;
-}
-
-static void ReleaseDjVuContext() {
-    CrashIf(!gDjVuContext);
-    int refCount = gDjVuContext->Release();
-    if (refCount != 0) {
-        return;
-    }
-}
-
 void CleanupDjVuEngine() {
-    if (gDjVuContext) {
-        CrashIf(gDjVuContext->refCount != 0);
-        delete gDjVuContext;
-        gDjVuContext = nullptr;
-    }
     minilisp_finish();
 }
 
+// decoded pages are kept around so that rendering several tiles or zoom
+// levels of a page (or its thumbnail) only decodes the page once
+struct DjVuDecodedPage {
+    int pageNo = 0;
+    ddjvu_page_t* page = nullptr;
+    size_t size = 0;
+};
+
+// max. estimated memory used by the decoded pages of a document
+#define MAX_DECODED_PAGES_SIZE (64 * 1024 * 1024)
+// number of decoded pages to keep regardless of MAX_DECODED_PAGES_SIZE
+// (i.e. the current page and its neighbours)
+#define MIN_DECODED_PAGES 3
+
 class EngineDjVu : public EngineBase {
   public:
     EngineDjVu();
@@ -280,6 +260,12 @@ class EngineDjVu : public EngineBase {
 
     Vec<ddjvu_fileinfo_t> fileInfos;
 
+    DjVuContext* ctx = nullptr;
+    // least recently used first
+    Vec<DjVuDecodedPage> decodedPages;
+    size_t decodedPagesSize = 0;
+
+    ddjvu_page_t* GetDecodedPage(int pageNo);
     RenderedBitmap* CreateRenderedBitmap(const char* bmpData, Size size, bool grayscale) const;
     bool ExtractPageText(miniexp_t item, str::WStr& extracted, Vec<Rect>& coords);
     char* ResolveNamedDest(const char* name);
@@ -295,12 +281,15 @@ EngineDjVu::EngineDjVu() {
     defaultFileExt = L".djvu";
     // DPI isn't constant for all pages and thus premultiplied
     fileDPI = 300.0f;
-    GetDjVuContext();
+    ctx = new DjVuContext();
 }
 
 EngineDjVu::~EngineDjVu() {
-    ScopedCritSec scope(&gDjVuContext->lock);
+    EnterCriticalSection(&ctx->lock);
 
+    for (DjVuDecodedPage& p : decodedPages) {
+        ddjvu_page_release(p.page);
+    }
     delete tocTree;
     free(mediaboxes);
 
@@ -321,7 +310,9 @@ EngineDjVu::~EngineDjVu() {
     if (stream) {
         stream->Release();
     }
-    ReleaseDjVuContext();
+
+    LeaveCriticalSection(&ctx->lock);
+    delete ctx;
 }
 
 EngineBase* EngineDjVu::Clone() {
@@ -436,12 +427,12 @@ bool EngineDjVu::LoadMediaboxes() {
 
 bool EngineDjVu::Load(const WCHAR* fileName) {
     SetFileName(fileName);
-    doc = gDjVuContext->OpenFile(fileName);
+    doc = ctx->OpenFile(fileName);
     return FinishLoading();
 }
 
 bool EngineDjVu::Load(IStream* stream) {
-    doc = gDjVuContext->OpenStream(stream);
+    doc = ctx->OpenStream(stream);
     return FinishLoading();
 }
 
@@ -450,10 +441,10 @@ bool EngineDjVu::FinishLoading() {
         return false;
     }
 
-    ScopedCritSec scope(&gDjVuContext->lock);
+    ScopedCritSec scope(&ctx->lock);
 
     while (!ddjvu_document_decoding_done(doc)) {
-        gDjVuContext->SpinMessageLoop();
+        ctx->SpinMessageLoop();
     }
 
     if (ddjvu_document_decoding_error(doc)) {
@@ -473,7 +464,7 @@ bool EngineDjVu::FinishLoading() {
             ddjvu_status_t status;
             ddjvu_pageinfo_t info;
             while ((status = ddjvu_document_get_pageinfo(doc, i, &info)) < DDJVU_JOB_OK) {
-                gDjVuContext->SpinMessageLoop();
+                ctx->SpinMessageLoop();
             }
             if (DDJVU_JOB_OK == status) {
                 float dx = (float)info.width * GetFileDPI() / (float)info.dpi;
@@ -489,7 +480,7 @@ bool EngineDjVu::FinishLoading() {
     }
 
     while ((outline = ddjvu_document_get_outline(doc)) == miniexp_dummy) {
-        gDjVuContext->SpinMessageLoop();
+        ctx->SpinMessageLoop();
     }
     if (!miniexp_consp(outline) || miniexp_car(outline) != miniexp_symbol("bookmarks")) {
         ddjvu_miniexp_release(doc, outline);
@@ -501,7 +492,7 @@ bool EngineDjVu::FinishLoading() {
         ddjvu_status_t status;
         ddjvu_fileinfo_s info;
         while ((status = ddjvu_document_get_fileinfo(doc, i, &info)) < DDJVU_JOB_OK) {
-            gDjVuContext->SpinMessageLoop();
+            ctx->SpinMessageLoop();
         }
         if (DDJVU_JOB_OK == status && info.type == 'P' && info.pageno >= 0) {
             fileInfos.Append(info);
@@ -548,8 +539,59 @@ RenderedBitmap* EngineDjVu::CreateRenderedBitmap(const char* bmpData, Size size,
     return new RenderedBitmap(hbmp, size, hMap);
 }
 
+// estimates the memory used by a decoded page (which libdjvu doesn't expose):
+// bitonal pages are mostly JB2 shapes, others mostly IW44 wavelet coefficients
+static size_t EstimateDecodedPageSize(ddjvu_page_t* page) {
+    size_t pixels = (size_t)ddjvu_page_get_width(page) * (size_t)ddjvu_page_get_height(page);
+    if (DDJVU_PAGETYPE_BITONAL == ddjvu_page_get_type(page)) {
+        return pixels / 8;
+    }
+    return pixels * 3;
+}
+
+// returns the decoded page (owned by decodedPages) or nullptr on failure
+// caller must hold ctx->lock
+ddjvu_page_t* EngineDjVu::GetDecodedPage(int pageNo) {
+    for (size_t i = 0; i < decodedPages.size(); i++) {
+        if (decodedPages.at(i).pageNo == pageNo) {
+            DjVuDecodedPage p = decodedPages.PopAt(i);
+            decodedPages.Append(p);
+            return p.page;
+        }
+    }
+
+    ddjvu_page_t* page = ddjvu_page_create_by_pageno(doc, pageNo - 1);
+    if (!page) {
+        return nullptr;
+    }
+    while (!ddjvu_page_decoding_done(page)) {
+        ctx->SpinMessageLoop();
+    }
+    if (ddjvu_page_decoding_error(page)) {
+        ddjvu_page_release(page);
+        return nullptr;
+    }
+
+    DjVuDecodedPage p;
+    p.pageNo = pageNo;
+    p.page = page;
+    p.size = EstimateDecodedPageSize(page);
+    // a single 600 dpi color page can take more than MAX_DECODED_PAGES_SIZE,
+    // so the budget grows with the page size
+    size_t maxSize = std::max((size_t)MAX_DECODED_PAGES_SIZE, p.size * MIN_DECODED_PAGES);
+    // evict the least recently used pages (but always keep the new one)
+    while (decodedPages.size() > 0 && decodedPagesSize + p.size > maxSize) {
+        DjVuDecodedPage old = decodedPages.PopAt(0);
+        decodedPagesSize -= old.size;
+        ddjvu_page_release(old.page);
+    }
+    decodedPages.Append(p);
+    decodedPagesSize += p.size;
+    return page;
+}
+
 RenderedBitmap* EngineDjVu::RenderPage(RenderPageArgs& args) {
-    ScopedCritSec scope(&gDjVuContext->lock);
+    ScopedCritSec scope(&ctx->lock);
     auto pageRect = args.pageRect;
     auto zoom = args.zoom;
     auto pageNo = args.pageNo;
@@ -559,27 +601,21 @@ RenderedBitmap* EngineDjVu::RenderPage(RenderPageArgs& args) {
     Rect full = Transform(PageMediabox(pageNo), pageNo, zoom, rotation).Round();
     screen = full.Intersect(screen);
 
-    ddjvu_page_t* page = ddjvu_page_create_by_pageno(doc, pageNo - 1);
+    ddjvu_page_t* page = GetDecodedPage(pageNo);
     if (!page) {
         return nullptr;
     }
+    // the rotation is relative to the page's orientation (which PageMediabox accounts for)
     int rotation4 = (((-rotation / 90) % 4) + 4) % 4;
+    rotation4 = (rotation4 + ddjvu_page_get_initial_rotation(page)) % 4;
     ddjvu_page_set_rotation(page, (ddjvu_page_rotation_t)rotation4);
 
-    while (!ddjvu_page_decoding_done(page)) {
-        gDjVuContext->SpinMessageLoop();
-    }
-    if (ddjvu_page_decoding_error(page)) {
-        return nullptr;
-    }
-
     bool isBitonal = DDJVU_PAGETYPE_BITONAL == ddjvu_page_get_type(page);
     ddjvu_format_style_t style = isBitonal ? DDJVU_FORMAT_GREY8 : DDJVU_FORMAT_BGR24;
     ddjvu_format_t* fmt = ddjvu_format_create(style, 0, nullptr);
 
     defer {
         ddjvu_format_release(fmt);
-        ddjvu_page_release(page);
     };
 
     int topToBottom = TRUE;
@@ -611,28 +647,20 @@ RenderedBitmap* EngineDjVu::RenderPage(RenderPageArgs& args) {
 }
 
 RectF EngineDjVu::PageContentBox(int pageNo, [[maybe_unused]] RenderTarget target) {
-    ScopedCritSec scope(&gDjVuContext->lock);
+    ScopedCritSec scope(&ctx->lock);
 
     RectF pageRc = PageMediabox(pageNo);
-    ddjvu_page_t* page = ddjvu_page_create_by_pageno(doc, pageNo - 1);
+    ddjvu_page_t* page = GetDecodedPage(pageNo);
     if (!page) {
         return pageRc;
     }
-    ddjvu_page_set_rotation(page, DDJVU_ROTATE_0);
-
-    while (!ddjvu_page_decoding_done(page)) {
-        gDjVuContext->SpinMessageLoop();
-    }
-    if (ddjvu_page_decoding_error(page)) {
-        return pageRc;
-    }
+    ddjvu_page_set_rotation(page, ddjvu_page_get_initial_rotation(page));
 
     // render the page in 8-bit grayscale up to 250x250 px in size
     ddjvu_format_t* fmt = ddjvu_format_create(DDJVU_FORMAT_GREY8, 0, nullptr);
 
     defer {
         ddjvu_format_release(fmt);
-        ddjvu_page_release(page);
     };
 
     ddjvu_format_set_row_order(fmt, /* top_to_bottom */ TRUE);
@@ -824,11 +852,11 @@ bool EngineDjVu::ExtractPageText(miniexp_t item, str::WStr& extracted, Vec<Rect>
 
 PageText EngineDjVu::ExtractPageText(int pageNo) {
     const WCHAR* lineSep = L"\n";
-    ScopedCritSec scope(&gDjVuContext->lock);
+    ScopedCritSec scope(&ctx->lock);
 
     miniexp_t pagetext;
     while ((pagetext = ddjvu_document_get_pagetext(doc, pageNo - 1, nullptr)) == miniexp_dummy) {
-        gDjVuContext->SpinMessageLoop();
+        ctx->SpinMessageLoop();
     }
     if (miniexp_nil == pagetext) {
         return {};
@@ -851,7 +879,7 @@ PageText EngineDjVu::ExtractPageText(int pageNo) {
     ddjvu_status_t status;
     ddjvu_pageinfo_t info;
     while ((status = ddjvu_document_get_pageinfo(doc, pageNo - 1, &info)) < DDJVU_JOB_OK) {
-        gDjVuContext->SpinMessageLoop();
+        ctx->SpinMessageLoop();
     }
     float dpiFactor = 1.0;
     if (DDJVU_JOB_OK == status) {
@@ -883,16 +911,16 @@ PageText EngineDjVu::ExtractPageText(int pageNo) {
 Vec<IPageElement*>* EngineDjVu::GetElements(int pageNo) {
     CrashIf(pageNo < 1 || pageNo > PageCount());
     if (annos && miniexp_dummy == annos[pageNo - 1]) {
-        ScopedCritSec scope(&gDjVuContext->lock);
+        ScopedCritSec scope(&ctx->lock);
         while ((annos[pageNo - 1] = ddjvu_document_get_pageanno(doc, pageNo - 1)) == miniexp_dummy) {
-            gDjVuContext->SpinMessageLoop();
+            ctx->SpinMessageLoop();
         }
     }
     if (!annos || !annos[pageNo - 1]) {
         return nullptr;
     }
 
-    ScopedCritSec scope(&gDjVuContext->lock);
+    ScopedCritSec scope(&ctx->lock);
 
     auto els = new Vec<IPageElement*>();
     Rect page = PageMediabox(pageNo).Round();
@@ -900,7 +928,7 @@ Vec<IPageElement*>* EngineDjVu::GetElements(int pageNo) {
     ddjvu_status_t status;
     ddjvu_pageinfo_t info;
     while ((status = ddjvu_document_get_pageinfo(doc, pageNo - 1, &info)) < DDJVU_JOB_OK) {
-        gDjVuContext->SpinMessageLoop();
+        ctx->SpinMessageLoop();
     }
     float dpiFactor = 1.0;
     if (DDJVU_JOB_OK == status) {
@@ -1082,7 +1110,7 @@ TocTree* EngineDjVu::GetToc() {
     if (tocTree) {
         return tocTree;
     }
-    ScopedCritSec scope(&gDjVuContext->lock);
+    ScopedCritSec scope(&ctx->lock);
     int idCounter = 0;
     TocItem* root = BuildTocTree(nullptr, outline, idCounter);
     if (!root) {
@@ -8,6 +8,7 @@
 #include "utils/GdiPlusUtil.h"
 #include "mui/MiniMui.h"
 #include "utils/TgaReader.h"
+#include "utils/Timer.h"
 #include "utils/WinUtil.h"
 
 #include "wingui/TreeModel.h"
@@ -16,6 +17,8 @@
 #include "EngineBase.h"
 #include "EngineDjVu.h"
 #include "EngineCreate.h"
+#include "EnginePdf.h"
+#include "BatchRender.h"
 #include "PdfCreator.h"
 
 #define Out(msg, ...) printf(msg, __VA_ARGS__)
@@ -386,7 +389,8 @@ bool CheckRenderPath(const WCHAR* path) {
     return true;
 }
 
-bool RenderDocument(EngineBase* engine, const WCHAR* renderPath, float zoom = 1.f, bool silent = false) {
+bool RenderDocument(EngineBase* engine, const WCHAR* renderPath, float zoom = 1.f, bool silent = false,
+                    int nThreads = 0) {
     if (!CheckRenderPath(renderPath)) {
         return false;
     }
@@ -419,13 +423,19 @@ bool RenderDocument(EngineBase* engine, const WCHAR* renderPath, float zoom = 1.
         if (engine->SaveFileAsPDF(pathUtf8.Get(), true)) {
             return true;
         }
-        return PdfCreator::RenderToFile(pathUtf8.Get(), engine);
+        return PdfCreator::RenderToFile(pathUtf8.Get(), engine, 150, nThreads);
     }
 
+    // the following pages are rendered while the previous ones are being saved
+    BatchRenderer renderer(engine, nThreads);
+    for (int pageNo = 1; pageNo <= engine->PageCount(); pageNo++) {
+        renderer.Add(RenderPageArgs(pageNo, zoom, 0));
+    }
+    renderer.Start();
+
     bool success = true;
     for (int pageNo = 1; pageNo <= engine->PageCount(); pageNo++) {
-        RenderPageArgs args(pageNo, zoom, 0);
-        RenderedBitmap* bmp = engine->RenderPage(args);
+        RenderedBitmap* bmp = renderer.Next();
         success &= bmp != nullptr;
         if (!bmp && !silent) {
             ErrOut("Error: Failed to render page %d for %s!", pageNo, engine->FileName());
@@ -470,6 +480,10 @@ class PasswordHolder : public PasswordUI {
     }
 };
 
+// in mupdf_load_system_font.c
+extern "C" void pdf_set_system_font_dir(const WCHAR* dir);
+extern "C" void pdf_set_system_font_index_path(const WCHAR* path);
+
 int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv) {
     setlocale(LC_ALL, "C");
     DisableDataExecution();
@@ -478,7 +492,8 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv) {
     ParseCmdLine(GetCommandLine(), argList);
     if (argList.size() < 2) {
     Usage:
-        ErrOut("%s [-pwd <password>][-quick][-render <path-%%d.tga>] <filename>",
+        ErrOut("%s [-pwd <password>][-quick][-render <path-%%d.tga>][-threads <n>][-lockstats]"
+               "[-fontdir <dir>][-fontindex <path>] <filename>",
                path::GetBaseNameNoFree(argList.at(0)));
         return 2;
     }
@@ -488,7 +503,8 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv) {
     bool fullDump = true;
     WCHAR* renderPath = nullptr;
     float renderZoom = 1.f;
-    bool loadOnly = false, silent = false;
+    int renderThreads = 0;
+    bool loadOnly = false, silent = false, lockStats = false;
     int breakAlloc = 0;
 
     for (size_t i = 1; i < argList.size(); i++) {
@@ -504,6 +520,20 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv) {
                 i++;
             }
             renderPath = argList.at(++i);
+        } else if (str::Eq(argList.at(i), L"-threads") && i + 1 < argList.size()) {
+            // number of threads for -render (e.g. -threads 1 for comparing
+            // with -silent how well rendering scales)
+            renderThreads = _wtoi(argList.at(++i));
+        } else if (str::Eq(argList.at(i), L"-lockstats")) {
+            // reports rendering time and how long threads waited for
+            // mupdf's locks (e.g. -silent -lockstats -threads 4)
+            lockStats = true;
+        } else if (str::Eq(argList.at(i), L"-fontdir") && i + 1 < argList.size()) {
+            // loads non-embedded fonts from the given directory instead of %WINDIR%\Fonts
+            pdf_set_system_font_dir(argList.at(++i));
+        } else if (str::Eq(argList.at(i), L"-fontindex") && i + 1 < argList.size()) {
+            // caches the names of the fonts found in the font directory
+            pdf_set_system_font_index_path(argList.at(++i));
         } else if (str::Eq(argList.at(i), L"-loadonly")) {
             // -loadonly and -silent are only meant for profiling
             loadOnly = true;
@@ -535,7 +565,9 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv) {
     if (silent) {
         FILE* nul;
         freopen_s(&nul, "NUL", "w", stdout);
-        freopen_s(&nul, "NUL", "w", stderr);
+        if (!lockStats) {
+            freopen_s(&nul, "NUL", "w", stderr);
+        }
     }
 
     ScopedGdiPlus gdiPlus;
@@ -571,7 +603,16 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv) {
         DumpData(engine, fullDump);
     }
     if (renderPath) {
-        RenderDocument(engine, renderPath, renderZoom, silent);
+        auto t = TimeGet();
+        RenderDocument(engine, renderPath, renderZoom, silent, renderThreads);
+        if (lockStats) {
+            i64 nWaits, nAllocWaits;
+            double waitMs, allocWaitMs;
+            EnginePdfGetLockWaitStats(&nWaits, &waitMs, &nAllocWaits, &allocWaitMs);
+            ErrOut("Rendering took %.2f ms, threads waited %d times for locks (%.2f ms), %d of them for FZ_LOCK_ALLOC "
+                   "(%.2f ms)",
+                   TimeSinceInMs(t), (int)nWaits, waitMs, (int)nAllocWaits, allocWaitMs);
+        }
     }
     delete engine;
 
@@ -104,6 +104,13 @@ class EngineEbook : public EngineBase {
 
     bool BenchLoadPage(int pageNo) override;
 
+    void SetLayoutFinishedCb(const std::function<void()>& cb) override;
+    void UpdatePageCount() override;
+
+    // if set before loading, only the first few pages are laid out during
+    // loading and the remaining ones on a background thread
+    bool layoutInBackground = false;
+
   protected:
     Vec<HtmlPage*>* pages = nullptr;
     Vec<PageAnchor> anchors;
@@ -118,12 +125,29 @@ class EngineEbook : public EngineBase {
     RectF pageRect;
     float pageBorder;
 
+    // state of the background layout (pages, anchors and layoutFinished
+    // are protected by pagesAccess while the layout thread is running)
+    HtmlFormatter* formatter = nullptr;
+    bool skipEmptyPages = false;
+    HANDLE layoutThread = nullptr;
+    LONG layoutCancelled = 0;
+    bool layoutFinished = false;
+    CONDITION_VARIABLE pagesLaidOut;
+    std::function<void()> layoutFinishedCb;
+
     void GetTransform(Matrix& m, float zoom, int rotation);
     bool ExtractPageAnchors();
     WCHAR* ExtractFontList();
 
     virtual PageElement* CreatePageLink(DrawInstr* link, Rect rect, int pageNo);
 
+    bool StartLayout(HtmlFormatter* formatter, bool skipEmptyPages, size_t htmlSize);
+    void StopLayout();
+    static DWORD WINAPI LayoutThread(void* data);
+    bool IsLayoutFinished();
+    bool IsPageLaidOut(int pageNo);
+    void WaitForLayout();
+
     Vec<DrawInstr>* GetHtmlPage(int pageNo);
 };
 
@@ -176,9 +200,13 @@ EngineEbook::EngineEbook() {
     pageBorder = 0.4f * GetFileDPI();
     preferredLayout = Layout_Book;
     InitializeCriticalSection(&pagesAccess);
+    InitializeConditionVariable(&pagesLaidOut);
 }
 
 EngineEbook::~EngineEbook() {
+    // subclasses must already have called StopLayout() before deleting their documents
+    StopLayout();
+
     EnterCriticalSection(&pagesAccess);
 
     if (pages) {
@@ -231,11 +259,142 @@ void EngineEbook::GetTransform(Matrix& m, float zoom, int rotation) {
     GetBaseTransform(m, ToGdipRectF(pageRect), zoom, rotation);
 }
 
+// estimates the page count from how much of the HTML the pages laid out so far cover
+static int EstimatePageCount(Vec<HtmlPage*>* pages, size_t htmlSize) {
+    int n = (int)pages->size();
+    int lastPageStart = n > 0 ? pages->Last()->reparseIdx : 0;
+    if (n < 2 || lastPageStart <= 0) {
+        return std::max(n, 1);
+    }
+    double bytesPerPage = (double)lastPageStart / (n - 1);
+    int estimate = (int)((double)htmlSize / bytesPerPage) + 1;
+    return std::max(estimate, n);
+}
+
+// takes ownership of formatter. Lays out all pages or, if layoutInBackground is set,
+// only the first few pages and starts a thread for laying out the remaining ones
+// (in which case pageCount is an estimate until UpdatePageCount is called)
+bool EngineEbook::StartLayout(HtmlFormatter* formatter, bool skipEmptyPages, size_t htmlSize) {
+    CrashIf(pages || this->formatter);
+    // enough pages for showing the first few pages in any display mode
+    const int pagesUpFront = layoutInBackground ? 16 : INT_MAX;
+
+    pages = new Vec<HtmlPage*>();
+    HtmlPage* pd = nullptr;
+    while ((int)pages->size() < pagesUpFront && (pd = formatter->Next(skipEmptyPages)) != nullptr) {
+        pages->Append(pd);
+    }
+    if (!pd) {
+        delete formatter;
+        pageCount = (int)pages->size();
+        layoutFinished = true;
+        return ExtractPageAnchors() && pageCount > 0;
+    }
+
+    this->formatter = formatter;
+    this->skipEmptyPages = skipEmptyPages;
+    pageCount = EstimatePageCount(pages, htmlSize);
+    layoutThread = CreateThread(nullptr, 0, LayoutThread, this, 0, nullptr);
+    if (!layoutThread) {
+        // finish the layout synchronously
+        LayoutThread(this);
+        pageCount = (int)pages->size();
+    }
+    return true;
+}
+
+DWORD WINAPI EngineEbook::LayoutThread(void* data) {
+    EngineEbook* engine = (EngineEbook*)data;
+    HtmlFormatter* formatter = engine->formatter;
+    for (HtmlPage* pd = formatter->Next(engine->skipEmptyPages); pd; pd = formatter->Next(engine->skipEmptyPages)) {
+        ScopedCritSec scope(&engine->pagesAccess);
+        engine->pages->Append(pd);
+        WakeAllConditionVariable(&engine->pagesLaidOut);
+        if (InterlockedAdd(&engine->layoutCancelled, 0) > 0) {
+            break;
+        }
+    }
+
+    std::function<void()> cb;
+    {
+        ScopedCritSec scope(&engine->pagesAccess);
+        delete engine->formatter;
+        engine->formatter = nullptr;
+        engine->ExtractPageAnchors();
+        engine->layoutFinished = true;
+        cb = engine->layoutFinishedCb;
+        WakeAllConditionVariable(&engine->pagesLaidOut);
+    }
+    if (cb && InterlockedAdd(&engine->layoutCancelled, 0) == 0) {
+        cb();
+    }
+    return 0;
+}
+
+// must be called before deleting anything the formatter might access
+void EngineEbook::StopLayout() {
+    if (!layoutThread) {
+        return;
+    }
+    InterlockedIncrement(&layoutCancelled);
+    WaitForSingleObject(layoutThread, INFINITE);
+    CloseHandle(layoutThread);
+    layoutThread = nullptr;
+}
+
+void EngineEbook::SetLayoutFinishedCb(const std::function<void()>& cb) {
+    bool callNow = false;
+    {
+        ScopedCritSec scope(&pagesAccess);
+        layoutFinishedCb = cb;
+        // if the layout has finished already, pageCount might still be an estimate
+        callNow = layoutFinished && pageCount != (int)pages->size();
+    }
+    if (callNow && cb) {
+        cb();
+    }
+}
+
+void EngineEbook::UpdatePageCount() {
+    ScopedCritSec scope(&pagesAccess);
+    if (layoutFinished) {
+        pageCount = (int)pages->size();
+    }
+}
+
+bool EngineEbook::IsLayoutFinished() {
+    ScopedCritSec scope(&pagesAccess);
+    return layoutFinished;
+}
+
+bool EngineEbook::IsPageLaidOut(int pageNo) {
+    ScopedCritSec scope(&pagesAccess);
+    return layoutFinished || pageNo <= (int)pages->size();
+}
+
+// note: pagesAccess mustn't be held when calling this (nor GetHtmlPage)
+void EngineEbook::WaitForLayout() {
+    ScopedCritSec scope(&pagesAccess);
+    while (!layoutFinished) {
+        SleepConditionVariableCS(&pagesLaidOut, &pagesAccess, INFINITE);
+    }
+}
+
+// waits until the page has been laid out. Pages beyond the last one
+// are empty (for when the estimated page count was too large)
 Vec<DrawInstr>* EngineEbook::GetHtmlPage(int pageNo) {
-    CrashIf(pageNo < 1 || PageCount() < pageNo);
-    if (pageNo < 1 || PageCount() < pageNo) {
+    static Vec<DrawInstr> emptyPage;
+    CrashIf(pageNo < 1);
+    if (pageNo < 1) {
         return nullptr;
     }
+    ScopedCritSec scope(&pagesAccess);
+    while (!layoutFinished && pageNo > (int)pages->size()) {
+        SleepConditionVariableCS(&pagesLaidOut, &pagesAccess, INFINITE);
+    }
+    if (pageNo > (int)pages->size()) {
+        return &emptyPage;
+    }
     return &pages->at(pageNo - 1)->instructions;
 }
 
@@ -243,11 +402,8 @@ bool EngineEbook::ExtractPageAnchors() {
     ScopedCritSec scope(&pagesAccess);
 
     DrawInstr* baseAnchor = nullptr;
-    for (int pageNo = 1; pageNo <= pageCount; pageNo++) {
-        Vec<DrawInstr>* pageInstrs = GetHtmlPage(pageNo);
-        if (!pageInstrs) {
-            return false;
-        }
+    for (int pageNo = 1; pageNo <= (int)pages->size(); pageNo++) {
+        Vec<DrawInstr>* pageInstrs = &pages->at(pageNo - 1)->instructions;
 
         for (size_t k = 0; k < pageInstrs->size(); k++) {
             DrawInstr* i = &pageInstrs->at(k);
@@ -316,10 +472,11 @@ RenderedBitmap* EngineEbook::RenderPage(RenderPageArgs& args) {
         *args.cookie_out = cookie;
     }
 
+    Vec<DrawInstr>* pageInstrs = GetHtmlPage(pageNo);
     ScopedCritSec scope(&pagesAccess);
 
     mui::ITextRender* textDraw = mui::TextRenderGdiplus::Create(&g);
-    DrawHtmlPage(&g, textDraw, GetHtmlPage(pageNo), pageBorder, pageBorder, false, Color((ARGB)Color::Black),
+    DrawHtmlPage(&g, textDraw, pageInstrs, pageBorder, pageBorder, false, Color((ARGB)Color::Black),
                  cookie ? &cookie->abort : nullptr);
     delete textDraw;
     DeleteDC(hDC);
@@ -341,6 +498,7 @@ static Rect GetInstrBbox(DrawInstr& instr, float pageBorder) {
 
 PageText EngineEbook::ExtractPageText(int pageNo) {
     const WCHAR* lineSep = L"\n";
+    Vec<DrawInstr>* pageInstrs = GetHtmlPage(pageNo);
     ScopedCritSec scope(&pagesAccess);
 
     gAllowAllocFailure++;
@@ -352,7 +510,6 @@ PageText EngineEbook::ExtractPageText(int pageNo) {
     Vec<Rect> coords;
     bool insertSpace = false;
 
-    Vec<DrawInstr>* pageInstrs = GetHtmlPage(pageNo);
     for (DrawInstr& i : *pageInstrs) {
         Rect bbox = GetInstrBbox(i, pageBorder);
         switch (i.type) {
@@ -447,6 +604,13 @@ PageElement* EngineEbook::CreatePageLink(DrawInstr* link, Rect rect, int pageNo)
 Vec<IPageElement*>* EngineEbook::GetElements(int pageNo) {
     auto els = new Vec<IPageElement*>();
 
+    // don't wait for the background layout (links only work once it has
+    // finished, as they might point to pages which haven't been laid out yet)
+    bool finished = IsLayoutFinished();
+    if (!finished && !IsPageLaidOut(pageNo)) {
+        return els;
+    }
+
     Vec<DrawInstr>* pageInstrs = GetHtmlPage(pageNo);
     size_t n = pageInstrs->size();
     for (size_t idx = 0; idx < n; idx++) {
@@ -455,7 +619,7 @@ Vec<IPageElement*>* EngineEbook::GetElements(int pageNo) {
             auto box = GetInstrBbox(i, pageBorder);
             auto el = newImageDataElement(pageNo, box, (int)idx);
             els->Append(el);
-        } else if (DrawInstrType::LinkStart == i.type && !i.bbox.IsEmpty()) {
+        } else if (finished && DrawInstrType::LinkStart == i.type && !i.bbox.IsEmpty()) {
             IPageElement* link = CreatePageLink(&i, GetInstrBbox(i, pageBorder), pageNo);
             if (link) {
                 els->Append(link);
@@ -466,9 +630,9 @@ Vec<IPageElement*>* EngineEbook::GetElements(int pageNo) {
     return els;
 }
 
-static RenderedBitmap* getImageFromData(ImageData imageData) {
+static RenderedBitmap* getImageFromData(std::span<u8> imageData) {
     HBITMAP hbmp{nullptr};
-    Bitmap* bmp = BitmapFromData(imageData.AsSpan());
+    Bitmap* bmp = BitmapFromData(imageData);
     if (!bmp || bmp->GetHBITMAP((ARGB)Color::White, &hbmp) != Ok) {
         delete bmp;
         return nullptr;
@@ -484,8 +648,8 @@ RenderedBitmap* EngineEbook::GetImageForPageElement(IPageElement* iel) {
     int idx = el->imageID;
     Vec<DrawInstr>* pageInstrs = GetHtmlPage(pageNo);
     const DrawInstr& i = pageInstrs->at(idx);
-    CrashIf(i.type != DrawInstrType::Image);
-    return getImageFromData(i.img);
+    AutoFree loaded;
+    return getImageFromData(GetInstrImageData(i, loaded));
 }
 
 IPageElement* EngineEbook::GetElementAtPos(int pageNo, PointF pt) {
@@ -511,6 +675,8 @@ IPageElement* EngineEbook::GetElementAtPos(int pageNo, PointF pt) {
 }
 
 PageDestination* EngineEbook::GetNamedDest(const WCHAR* name) {
+    WaitForLayout();
+
     AutoFree name_utf8(strconv::WstrToUtf8(name));
     const char* id = name_utf8.Get();
     if (str::FindChar(id, '#')) {
@@ -563,18 +729,14 @@ PageDestination* EngineEbook::GetNamedDest(const WCHAR* name) {
 }
 
 WCHAR* EngineEbook::ExtractFontList() {
+    WaitForLayout();
     ScopedCritSec scope(&pagesAccess);
 
     Vec<mui::CachedFont*> seenFonts;
     WStrVec fonts;
 
-    for (int pageNo = 1; pageNo <= PageCount(); pageNo++) {
-        Vec<DrawInstr>* pageInstrs = GetHtmlPage(pageNo);
-        if (!pageInstrs) {
-            continue;
-        }
-
-        for (DrawInstr& i : *pageInstrs) {
+    for (HtmlPage* page : *pages) {
+        for (DrawInstr& i : page->instructions) {
             if (DrawInstrType::SetFont != i.type || seenFonts.Contains(i.font)) {
                 continue;
             }
@@ -690,7 +852,7 @@ class EngineEpub : public EngineEbook {
 
     TocTree* GetToc() override;
 
-    static EngineBase* CreateFromFile(const WCHAR* fileName);
+    static EngineBase* CreateFromFile(const WCHAR* fileName, bool layoutInBackground = false);
     static EngineBase* CreateFromStream(IStream* stream);
 
   protected:
@@ -709,6 +871,7 @@ EngineEpub::EngineEpub() : EngineEbook() {
 }
 
 EngineEpub::~EngineEpub() {
+    StopLayout();
     delete doc;
     delete tocTree;
     if (stream) {
@@ -752,8 +915,8 @@ bool EngineEpub::FinishLoading() {
         return false;
     }
 
+    // EpubFormatter loads the html chapter by chapter
     HtmlFormatterArgs args{};
-    args.htmlStr = doc->GetHtmlData();
     args.pageDx = (float)pageRect.dx - 2 * pageBorder;
     args.pageDy = (float)pageRect.dy - 2 * pageBorder;
     args.SetFontName(GetDefaultFontName());
@@ -761,11 +924,7 @@ bool EngineEpub::FinishLoading() {
     args.textAllocator = &allocator;
     args.textRenderMethod = mui::TextRenderMethodGdiplusQuick;
 
-    pages = EpubFormatter(&args, doc).FormatAllPages(false);
-
-    // must set pageCount before ExtractPageAnchors
-    pageCount = (int)pages->size();
-    if (!ExtractPageAnchors()) {
+    if (!StartLayout(new EpubFormatter(&args, doc), false, doc->EstimateHtmlSize())) {
         return false;
     }
 
@@ -804,6 +963,10 @@ TocTree* EngineEpub::GetToc() {
     if (tocTree) {
         return tocTree;
     }
+    // the ToC is only available once all pages have been laid out
+    if (!IsLayoutFinished()) {
+        return nullptr;
+    }
     EbookTocBuilder builder(this);
     doc->ParseToc(&builder);
     TocItem* root = builder.GetRoot();
@@ -814,8 +977,9 @@ TocTree* EngineEpub::GetToc() {
     return tocTree;
 }
 
-EngineBase* EngineEpub::CreateFromFile(const WCHAR* fileName) {
+EngineBase* EngineEpub::CreateFromFile(const WCHAR* fileName, bool layoutInBackground) {
     EngineEpub* engine = new EngineEpub();
+    engine->layoutInBackground = layoutInBackground;
     if (!engine->Load(fileName)) {
         delete engine;
         return nullptr;
@@ -832,8 +996,8 @@ EngineBase* EngineEpub::CreateFromStream(IStream* stream) {
     return engine;
 }
 
-EngineBase* CreateEpubEngineFromFile(const WCHAR* fileName) {
-    return EngineEpub::CreateFromFile(fileName);
+EngineBase* CreateEpubEngineFromFile(const WCHAR* fileName, bool layoutInBackground) {
+    return EngineEpub::CreateFromFile(fileName, layoutInBackground);
 }
 
 EngineBase* CreateEpubEngineFromStream(IStream* stream) {
@@ -849,6 +1013,7 @@ class EngineFb2 : public EngineEbook {
         defaultFileExt = L".fb2";
     }
     virtual ~EngineFb2() {
+        StopLayout();
         delete tocTree;
         delete doc;
     }
@@ -866,7 +1031,7 @@ class EngineFb2 : public EngineEbook {
 
     TocTree* GetToc() override;
 
-    static EngineBase* CreateFromFile(const WCHAR* fileName);
+    static EngineBase* CreateFromFile(const WCHAR* fileName, bool layoutInBackground = false);
     static EngineBase* CreateFromStream(IStream* stream);
 
   protected:
@@ -907,10 +1072,7 @@ bool EngineFb2::FinishLoading() {
         defaultFileExt = L".fb2z";
     }
 
-    pages = Fb2Formatter(&args, doc).FormatAllPages(false);
-    // must set pageCount before ExtractPageAnchors
-    pageCount = (int)pages->size();
-    if (!ExtractPageAnchors()) {
+    if (!StartLayout(new Fb2Formatter(&args, doc), false, args.htmlStr.size())) {
         return false;
     }
     return pageCount > 0;
@@ -920,6 +1082,9 @@ TocTree* EngineFb2::GetToc() {
     if (tocTree) {
         return tocTree;
     }
+    if (!IsLayoutFinished()) {
+        return nullptr;
+    }
     EbookTocBuilder builder(this);
     doc->ParseToc(&builder);
     TocItem* root = builder.GetRoot();
@@ -930,8 +1095,9 @@ TocTree* EngineFb2::GetToc() {
     return tocTree;
 }
 
-EngineBase* EngineFb2::CreateFromFile(const WCHAR* fileName) {
+EngineBase* EngineFb2::CreateFromFile(const WCHAR* fileName, bool layoutInBackground) {
     EngineFb2* engine = new EngineFb2();
+    engine->layoutInBackground = layoutInBackground;
     if (!engine->Load(fileName)) {
         delete engine;
         return nullptr;
@@ -948,8 +1114,8 @@ EngineBase* EngineFb2::CreateFromStream(IStream* stream) {
     return engine;
 }
 
-EngineBase* CreateFb2EngineFromFile(const WCHAR* fileName) {
-    return EngineFb2::CreateFromFile(fileName);
+EngineBase* CreateFb2EngineFromFile(const WCHAR* fileName, bool layoutInBackground) {
+    return EngineFb2::CreateFromFile(fileName, layoutInBackground);
 }
 
 EngineBase* CreateFb2EngineFromStream(IStream* stream) {
@@ -967,6 +1133,7 @@ class EngineMobi : public EngineEbook {
         defaultFileExt = L".mobi";
     }
     ~EngineMobi() override {
+        StopLayout();
         delete tocTree;
         delete doc;
     }
@@ -985,7 +1152,7 @@ class EngineMobi : public EngineEbook {
     PageDestination* GetNamedDest(const WCHAR* name) override;
     TocTree* GetToc() override;
 
-    static EngineBase* CreateFromFile(const WCHAR* fileName);
+    static EngineBase* CreateFromFile(const WCHAR* fileName, bool layoutInBackground = false);
     static EngineBase* CreateFromStream(IStream* stream);
 
   protected:
@@ -1022,10 +1189,7 @@ bool EngineMobi::FinishLoading() {
     args.textAllocator = &allocator;
     args.textRenderMethod = mui::TextRenderMethodGdiplusQuick;
 
-    pages = MobiFormatter(&args, doc).FormatAllPages();
-    // must set pageCount before ExtractPageAnchors
-    pageCount = (int)pages->size();
-    if (!ExtractPageAnchors()) {
+    if (!StartLayout(new MobiFormatter(&args, doc), true, args.htmlStr.size())) {
         return false;
     }
     return pageCount > 0;
@@ -1036,13 +1200,15 @@ PageDestination* EngineMobi::GetNamedDest(const WCHAR* name) {
     if (filePos < 0 || 0 == filePos && *name != '0') {
         return nullptr;
     }
+    WaitForLayout();
+    int nPages = (int)pages->size();
     int pageNo;
-    for (pageNo = 1; pageNo < PageCount(); pageNo++) {
+    for (pageNo = 1; pageNo < nPages; pageNo++) {
         if (pages->at(pageNo)->reparseIdx > filePos) {
             break;
         }
     }
-    CrashIf(pageNo < 1 || pageNo > PageCount());
+    CrashIf(pageNo < 1 || pageNo > nPages);
 
     const std::span<u8> htmlData = doc->GetHtmlData();
     size_t htmlLen = htmlData.size();
@@ -1051,8 +1217,8 @@ PageDestination* EngineMobi::GetNamedDest(const WCHAR* name) {
         return nullptr;
     }
 
-    ScopedCritSec scope(&pagesAccess);
     Vec<DrawInstr>* pageInstrs = GetHtmlPage(pageNo);
+    ScopedCritSec scope(&pagesAccess);
     // link to the bottom of the page, if filePos points
     // beyond the last visible DrawInstr of a page
     float currY = (float)pageRect.dy;
@@ -1072,6 +1238,9 @@ TocTree* EngineMobi::GetToc() {
     if (tocTree) {
         return tocTree;
     }
+    if (!IsLayoutFinished()) {
+        return nullptr;
+    }
     EbookTocBuilder builder(this);
     doc->ParseToc(&builder);
     TocItem* root = builder.GetRoot();
@@ -1082,8 +1251,9 @@ TocTree* EngineMobi::GetToc() {
     return tocTree;
 }
 
-EngineBase* EngineMobi::CreateFromFile(const WCHAR* fileName) {
+EngineBase* EngineMobi::CreateFromFile(const WCHAR* fileName, bool layoutInBackground) {
     EngineMobi* engine = new EngineMobi();
+    engine->layoutInBackground = layoutInBackground;
     if (!engine->Load(fileName)) {
         delete engine;
         return nullptr;
@@ -1100,8 +1270,8 @@ EngineBase* EngineMobi::CreateFromStream(IStream* stream) {
     return engine;
 }
 
-EngineBase* CreateMobiEngineFromFile(const WCHAR* fileName) {
-    return EngineMobi::CreateFromFile(fileName);
+EngineBase* CreateMobiEngineFromFile(const WCHAR* fileName, bool layoutInBackground) {
+    return EngineMobi::CreateFromFile(fileName, layoutInBackground);
 }
 
 EngineBase* CreateMobiEngineFromStream(IStream* stream) {
@@ -1117,6 +1287,7 @@ class EnginePdb : public EngineEbook {
         defaultFileExt = L".pdb";
     }
     virtual ~EnginePdb() {
+        StopLayout();
         delete tocTree;
         delete doc;
     }
@@ -1134,7 +1305,7 @@ class EnginePdb : public EngineEbook {
 
     TocTree* GetToc() override;
 
-    static EngineBase* CreateFromFile(const WCHAR* fileName);
+    static EngineBase* CreateFromFile(const WCHAR* fileName, bool layoutInBackground = false);
 
   protected:
     PalmDoc* doc = nullptr;
@@ -1160,10 +1331,7 @@ bool EnginePdb::Load(const WCHAR* fileName) {
     args.textAllocator = &allocator;
     args.textRenderMethod = mui::TextRenderMethodGdiplusQuick;
 
-    pages = HtmlFormatter(&args).FormatAllPages();
-    // must set pageCount before ExtractPageAnchors
-    pageCount = (int)pages->size();
-    if (!ExtractPageAnchors()) {
+    if (!StartLayout(new HtmlFormatter(&args), true, args.htmlStr.size())) {
         return false;
     }
 
@@ -1174,6 +1342,9 @@ TocTree* EnginePdb::GetToc() {
     if (tocTree) {
         return tocTree;
     }
+    if (!IsLayoutFinished()) {
+        return nullptr;
+    }
     EbookTocBuilder builder(this);
     doc->ParseToc(&builder);
     auto* root = builder.GetRoot();
@@ -1181,8 +1352,9 @@ TocTree* EnginePdb::GetToc() {
     return tocTree;
 }
 
-EngineBase* EnginePdb::CreateFromFile(const WCHAR* fileName) {
+EngineBase* EnginePdb::CreateFromFile(const WCHAR* fileName, bool layoutInBackground) {
     EnginePdb* engine = new EnginePdb();
+    engine->layoutInBackground = layoutInBackground;
     if (!engine->Load(fileName)) {
         delete engine;
         return nullptr;
@@ -1190,8 +1362,8 @@ EngineBase* EnginePdb::CreateFromFile(const WCHAR* fileName) {
     return engine;
 }
 
-EngineBase* CreatePdbEngineFromFile(const WCHAR* fileName) {
-    return EnginePdb::CreateFromFile(fileName);
+EngineBase* CreatePdbEngineFromFile(const WCHAR* fileName, bool layoutInBackground) {
+    return EnginePdb::CreateFromFile(fileName, layoutInBackground);
 }
 
 /* formatting extensions for CHM */
@@ -1329,6 +1501,7 @@ class EngineChm : public EngineEbook {
         defaultFileExt = L".chm";
     }
     virtual ~EngineChm() {
+        StopLayout();
         delete dataCache;
         delete doc;
         delete tocTree;
@@ -1348,7 +1521,7 @@ class EngineChm : public EngineEbook {
     PageDestination* GetNamedDest(const WCHAR* name) override;
     TocTree* GetToc() override;
 
-    static EngineBase* CreateFromFile(const WCHAR* fileName);
+    static EngineBase* CreateFromFile(const WCHAR* fileName, bool layoutInBackground = false);
 
   protected:
     ChmDoc* doc = nullptr;
@@ -1482,10 +1655,7 @@ bool EngineChm::Load(const WCHAR* fileName) {
     args.textAllocator = &allocator;
     args.textRenderMethod = mui::TextRenderMethodGdiplusQuick;
 
-    pages = ChmFormatter(&args, dataCache).FormatAllPages(false);
-    // must set pageCount before ExtractPageAnchors
-    pageCount = (int)pages->size();
-    if (!ExtractPageAnchors()) {
+    if (!StartLayout(new ChmFormatter(&args, dataCache), false, args.htmlStr.size())) {
         return false;
     }
 
@@ -1512,6 +1682,9 @@ TocTree* EngineChm::GetToc() {
     if (tocTree) {
         return tocTree;
     }
+    if (!IsLayoutFinished()) {
+        return nullptr;
+    }
     EbookTocBuilder builder(this);
     doc->ParseToc(&builder);
     if (doc->HasIndex()) {
@@ -1555,8 +1728,9 @@ PageElement* EngineChm::CreatePageLink(DrawInstr* link, Rect rect, int pageNo) {
     return newEbookLink(link, rect, dest, pageNo);
 }
 
-EngineBase* EngineChm::CreateFromFile(const WCHAR* fileName) {
+EngineBase* EngineChm::CreateFromFile(const WCHAR* fileName, bool layoutInBackground) {
     EngineChm* engine = new EngineChm();
+    engine->layoutInBackground = layoutInBackground;
     if (!engine->Load(fileName)) {
         delete engine;
         return nullptr;
@@ -1564,8 +1738,8 @@ EngineBase* EngineChm::CreateFromFile(const WCHAR* fileName) {
     return engine;
 }
 
-EngineBase* CreateChmEngineFromFile(const WCHAR* fileName) {
-    return EngineChm::CreateFromFile(fileName);
+EngineBase* CreateChmEngineFromFile(const WCHAR* fileName, bool layoutInBackground) {
+    return EngineChm::CreateFromFile(fileName, layoutInBackground);
 }
 
 /* EngineBase for handling HTML documents */
@@ -1579,6 +1753,7 @@ class EngineHtml : public EngineEbook {
         defaultFileExt = L".html";
     }
     virtual ~EngineHtml() {
+        StopLayout();
         delete doc;
     }
     EngineBase* Clone() override {
@@ -1593,7 +1768,7 @@ class EngineHtml : public EngineEbook {
         return prop != DocumentProperty::FontList ? doc->GetProperty(prop) : ExtractFontList();
     }
 
-    static EngineBase* CreateFromFile(const WCHAR* fileName);
+    static EngineBase* CreateFromFile(const WCHAR* fileName, bool layoutInBackground = false);
 
   protected:
     HtmlDoc* doc = nullptr;
@@ -1620,10 +1795,7 @@ bool EngineHtml::Load(const WCHAR* fileName) {
     args.textAllocator = &allocator;
     args.textRenderMethod = mui::TextRenderMethodGdiplus;
 
-    pages = HtmlFileFormatter(&args, doc).FormatAllPages(false);
-    // must set pageCount before ExtractPageAnchors
-    pageCount = (int)pages->size();
-    if (!ExtractPageAnchors()) {
+    if (!StartLayout(new HtmlFileFormatter(&args, doc), false, args.htmlStr.size())) {
         return false;
     }
 
@@ -1657,8 +1829,9 @@ PageElement* EngineHtml::CreatePageLink(DrawInstr* link, Rect rect, int pageNo)
     return newEbookLink(link, rect, dest, pageNo, true);
 }
 
-EngineBase* EngineHtml::CreateFromFile(const WCHAR* fileName) {
+EngineBase* EngineHtml::CreateFromFile(const WCHAR* fileName, bool layoutInBackground) {
     EngineHtml* engine = new EngineHtml();
+    engine->layoutInBackground = layoutInBackground;
     if (!engine->Load(fileName)) {
         delete engine;
         return nullptr;
@@ -1666,8 +1839,8 @@ EngineBase* EngineHtml::CreateFromFile(const WCHAR* fileName) {
     return engine;
 }
 
-EngineBase* CreateHtmlEngineFromFile(const WCHAR* fileName) {
-    return EngineHtml::CreateFromFile(fileName);
+EngineBase* CreateHtmlEngineFromFile(const WCHAR* fileName, bool layoutInBackground) {
+    return EngineHtml::CreateFromFile(fileName, layoutInBackground);
 }
 
 /* EngineBase for handling TXT documents */
@@ -1681,6 +1854,7 @@ class EngineTxt : public EngineEbook {
         defaultFileExt = L".txt";
     }
     virtual ~EngineTxt() {
+        StopLayout();
         delete tocTree;
         delete doc;
     }
@@ -1698,7 +1872,7 @@ class EngineTxt : public EngineEbook {
 
     TocTree* GetToc() override;
 
-    static EngineBase* CreateFromFile(const WCHAR* fileName);
+    static EngineBase* CreateFromFile(const WCHAR* fileName, bool layoutInBackground = false);
 
   protected:
     TxtDoc* doc = nullptr;
@@ -1735,10 +1909,7 @@ bool EngineTxt::Load(const WCHAR* fileName) {
     args.textAllocator = &allocator;
     args.textRenderMethod = mui::TextRenderMethodGdiplus;
 
-    pages = TxtFormatter(&args).FormatAllPages(false);
-    // must set pageCount before ExtractPageAnchors
-    pageCount = (int)pages->size();
-    if (!ExtractPageAnchors()) {
+    if (!StartLayout(new TxtFormatter(&args), false, args.htmlStr.size())) {
         return false;
     }
 
@@ -1749,6 +1920,9 @@ TocTree* EngineTxt::GetToc() {
     if (tocTree) {
         return tocTree;
     }
+    if (!IsLayoutFinished()) {
+        return nullptr;
+    }
     EbookTocBuilder builder(this);
     doc->ParseToc(&builder);
     auto* root = builder.GetRoot();
@@ -1757,8 +1931,9 @@ TocTree* EngineTxt::GetToc() {
     return tocTree;
 }
 
-EngineBase* EngineTxt::CreateFromFile(const WCHAR* fileName) {
+EngineBase* EngineTxt::CreateFromFile(const WCHAR* fileName, bool layoutInBackground) {
     EngineTxt* engine = new EngineTxt();
+    engine->layoutInBackground = layoutInBackground;
     if (!engine->Load(fileName)) {
         delete engine;
         return nullptr;
@@ -1766,8 +1941,8 @@ EngineBase* EngineTxt::CreateFromFile(const WCHAR* fileName) {
     return engine;
 }
 
-EngineBase* CreateTxtEngineFromFile(const WCHAR* fileName) {
-    return EngineTxt::CreateFromFile(fileName);
+EngineBase* CreateTxtEngineFromFile(const WCHAR* fileName, bool layoutInBackground) {
+    return EngineTxt::CreateFromFile(fileName, layoutInBackground);
 }
 
 void EngineEbookCleanup() {
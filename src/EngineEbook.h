@@ -1,16 +1,16 @@
 /* Copyright 2021 the SumatraPDF project authors (see AUTHORS file).
    License: GPLv3 */
 
-EngineBase* CreateEpubEngineFromFile(const WCHAR* fileName);
+EngineBase* CreateEpubEngineFromFile(const WCHAR* fileName, bool layoutInBackground = false);
 EngineBase* CreateEpubEngineFromStream(IStream* stream);
-EngineBase* CreateFb2EngineFromFile(const WCHAR* fileName);
+EngineBase* CreateFb2EngineFromFile(const WCHAR* fileName, bool layoutInBackground = false);
 EngineBase* CreateFb2EngineFromStream(IStream* stream);
-EngineBase* CreateMobiEngineFromFile(const WCHAR* fileName);
+EngineBase* CreateMobiEngineFromFile(const WCHAR* fileName, bool layoutInBackground = false);
 EngineBase* CreateMobiEngineFromStream(IStream* stream);
-EngineBase* CreatePdbEngineFromFile(const WCHAR* fileName);
-EngineBase* CreateChmEngineFromFile(const WCHAR* fileName);
-EngineBase* CreateHtmlEngineFromFile(const WCHAR* fileName);
-EngineBase* CreateTxtEngineFromFile(const WCHAR* fileName);
+EngineBase* CreatePdbEngineFromFile(const WCHAR* fileName, bool layoutInBackground = false);
+EngineBase* CreateChmEngineFromFile(const WCHAR* fileName, bool layoutInBackground = false);
+EngineBase* CreateHtmlEngineFromFile(const WCHAR* fileName, bool layoutInBackground = false);
+EngineBase* CreateTxtEngineFromFile(const WCHAR* fileName, bool layoutInBackground = false);
 
 void SetDefaultEbookFont(const WCHAR* name, float size);
 void EngineEbookCleanup();
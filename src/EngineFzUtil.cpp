@@ -16,6 +16,7 @@ extern "C" {
 #include "utils/TrivialHtmlParser.h"
 #include "utils/WinUtil.h"
 #include "utils/ZipUtil.h"
+#include "utils/Timer.h"
 #include "utils/Log.h"
 
 #include "AppColors.h"
@@ -32,6 +33,136 @@ extern "C" {
 // so that their content can be loaded on demand in order to preserve memory
 #define MAX_MEMORY_FILE_SIZE (32 * 1024 * 1024)
 
+extern "C" void pdf_install_load_system_font_funcs(fz_context* ctx);
+
+// mupdf's locks for the fz_context of one document (and its clones)
+struct FzDocLocks {
+    fz_locks_context locks;
+    CRITICAL_SECTION mutexes[FZ_LOCK_MAX];
+};
+
+// how often and how long threads had to wait for mupdf's locks (in all documents)
+static LONG64 gFzLockWaitCount[FZ_LOCK_MAX];
+static LONG64 gFzLockWaitTicks[FZ_LOCK_MAX];
+
+static void fz_lock_context_cs(void* user, int lock) {
+    FzDocLocks* l = (FzDocLocks*)user;
+    if (TryEnterCriticalSection(&l->mutexes[lock])) {
+        return;
+    }
+    auto t = TimeGet();
+    EnterCriticalSection(&l->mutexes[lock]);
+    InterlockedIncrement64(&gFzLockWaitCount[lock]);
+    InterlockedAdd64(&gFzLockWaitTicks[lock], TimeGet().QuadPart - t.QuadPart);
+}
+
+static void fz_unlock_context_cs(void* user, int lock) {
+    FzDocLocks* l = (FzDocLocks*)user;
+    LeaveCriticalSection(&l->mutexes[lock]);
+}
+
+// font data shared by all documents (cf. fz_set_shared_font_data_funcs)
+struct SharedFontData {
+    u8 digest[16];
+    u8* data = nullptr;
+    size_t len = 0;
+    int refs = 0;
+};
+
+static CRITICAL_SECTION gSharedFontDataAccess;
+static Vec<SharedFontData*>* gSharedFontData = nullptr;
+static INIT_ONCE gSharedFontDataInit = INIT_ONCE_STATIC_INIT;
+
+static const unsigned char* ShareFontData(const unsigned char digest[16], const unsigned char* data, size_t len) {
+    ScopedCritSec scope(&gSharedFontDataAccess);
+    for (SharedFontData* fd : *gSharedFontData) {
+        if (fd->len == len && memeq(fd->digest, digest, sizeof(fd->digest))) {
+            fd->refs++;
+            return fd->data;
+        }
+    }
+    SharedFontData* fd = new SharedFontData();
+    fd->data = (u8*)memdup(data, len);
+    if (!fd->data) {
+        delete fd;
+        return nullptr;
+    }
+    memcpy(fd->digest, digest, sizeof(fd->digest));
+    fd->len = len;
+    fd->refs = 1;
+    gSharedFontData->Append(fd);
+    return fd->data;
+}
+
+static void ReleaseFontData(const unsigned char* data) {
+    ScopedCritSec scope(&gSharedFontDataAccess);
+    for (size_t i = 0; i < gSharedFontData->size(); i++) {
+        SharedFontData* fd = gSharedFontData->at(i);
+        if (fd->data == data) {
+            if (--fd->refs == 0) {
+                gSharedFontData->RemoveAtFast(i);
+                free(fd->data);
+                delete fd;
+            }
+            return;
+        }
+    }
+    CrashIf(true);
+}
+
+static BOOL CALLBACK InitSharedFontData(INIT_ONCE*, void*, void**) {
+    InitializeCriticalSection(&gSharedFontDataAccess);
+    gSharedFontData = new Vec<SharedFontData*>();
+    fz_set_shared_font_data_funcs(ShareFontData, ReleaseFontData);
+    return TRUE;
+}
+
+fz_context* NewEngineFzContext(size_t maxStore) {
+    InitOnceExecuteOnce(&gSharedFontDataInit, InitSharedFontData, nullptr, nullptr);
+
+    FzDocLocks* l = new FzDocLocks();
+    for (size_t i = 0; i < dimof(l->mutexes); i++) {
+        InitializeCriticalSection(&l->mutexes[i]);
+    }
+    l->locks.user = l;
+    l->locks.lock = fz_lock_context_cs;
+    l->locks.unlock = fz_unlock_context_cs;
+    fz_context* ctx = fz_new_context(nullptr, &l->locks, maxStore);
+    if (!ctx) {
+        for (size_t i = 0; i < dimof(l->mutexes); i++) {
+            DeleteCriticalSection(&l->mutexes[i]);
+        }
+        delete l;
+    }
+    return ctx;
+}
+
+void DropEngineFzContext(fz_context* ctx) {
+    if (!ctx) {
+        return;
+    }
+    FzDocLocks* l = (FzDocLocks*)ctx->locks.user;
+    fz_drop_context(ctx);
+    for (size_t i = 0; i < dimof(l->mutexes); i++) {
+        DeleteCriticalSection(&l->mutexes[i]);
+    }
+    delete l;
+}
+
+void FzGetLockWaitStats(int lock, i64* nWaits, double* waitMs) {
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    i64 ticks = 0;
+    *nWaits = 0;
+    for (int i = 0; i < FZ_LOCK_MAX; i++) {
+        if (lock == -1 || lock == i) {
+            *nWaits += InterlockedAdd64(&gFzLockWaitCount[i], 0);
+            ticks += InterlockedAdd64(&gFzLockWaitTicks[i], 0);
+        }
+    }
+    *waitMs = (double)ticks * 1000.0 / (double)freq.QuadPart;
+}
+
 RectF ToRectFl(fz_rect rect) {
     return RectF::FromXY(rect.x0, rect.y0, rect.x1, rect.y1);
 }
@@ -5,10 +5,10 @@
 
 // maximum amount of memory that MuPDF should use per fz_context store
 #define MAX_CONTEXT_MEMORY (256 * 1024 * 1024)
-// number of page content trees to cache for quicker rendering
-#define MAX_PAGE_RUN_CACHE 8
-// maximum estimated memory requirement allowed for the run cache of one document
-#define MAX_PAGE_RUN_MEMORY (40 * 1024 * 1024)
+// maximum memory allowed for cached page display lists of one document. It's a part
+// of the store budget because the lists keep fonts and images in the store alive
+// (and the lists give up memory whenever the store has to evict, cf. CacheDisplayList)
+#define MAX_PAGE_RUN_MEMORY (MAX_CONTEXT_MEMORY / 8)
 
 class FitzAbortCookie : public AbortCookie {
   public:
@@ -38,8 +38,26 @@ struct FzPageInfo {
     Vec<IPageElement*> comments;
 
     RectF mediabox = {};
+    // true while mediabox is only the estimate used until the actual
+    // size has been resolved (cf. EnginePdf::PageMediabox)
+    bool mediaboxIsEstimate = false;
     Vec<FitzImagePos> images;
 
+    // recorded page content, replayed for rendering, content box and text
+    // extraction so that the page is only interpreted once. Only changed
+    // under ctxAccess. Take a reference with fz_keep_display_list() to use
+    // it outside of it.
+    fz_display_list* list = nullptr;
+    // estimated memory used by list
+    size_t listSize = 0;
+    // number of annotations when list was recorded (detects deleted annotations)
+    int listAnnotsCount = 0;
+    // how long rendering (a tile of) the page took the last time, in ms
+    // (set with InterlockedExchange, as render threads don't hold ctxAccess)
+    LONG renderMs = 0;
+    // taken when the page is loaded (cf. EnginePdf::PageFingerprint), 0 if that failed
+    u64 fingerprint = 0;
+
     // if false, only loaded page (fast)
     // if true, loaded expensive info (extracted text etc.)
     bool fullyLoaded = false;
@@ -50,6 +68,14 @@ struct LinkRectList {
     Vec<fz_rect> coords;
 };
 
+// a new fz_context with locks of its own for one document. Font data with
+// the same content is shared with other documents nonetheless
+fz_context* NewEngineFzContext(size_t maxStore);
+void DropEngineFzContext(fz_context* ctx);
+// how often and how long threads waited for mupdf's lock (or all of them if
+// lock is -1) for profiling
+void FzGetLockWaitStats(int lock, i64* nWaits, double* waitMs);
+
 fz_rect To_fz_rect(RectF rect);
 RectF ToRectFl(fz_rect rect);
 fz_matrix fz_create_view_ctm(fz_rect mediabox, float zoom, int rotation);
@@ -68,8 +68,14 @@ Kind kindEngineImage = "engineImage";
 Kind kindEngineImageDir = "engineImageDir";
 Kind kindEngineComicBooks = "engineComicBooks";
 
-// number of decoded bitmaps to cache for quicker rendering
-#define MAX_IMAGE_PAGE_CACHE 10
+// maximum size of decoded bitmaps to cache for quicker rendering
+#define MAX_IMAGE_PAGE_CACHE_SIZE (256 * 1024 * 1024)
+// number of pages after the requested one to decode in the background
+#define IMAGE_PAGE_READ_AHEAD 3
+// maximum size of uncompressed comic book images kept in memory
+#define MAX_CBX_FILE_CACHE (64 * 1024 * 1024)
+// how much of an image to uncompress for reading its size from the header
+#define IMAGE_HEADER_SIZE (64 * 1024)
 
 ///// EngineImages methods apply to all types of engines handling full-page images /////
 
@@ -78,6 +84,11 @@ struct ImagePage {
     Bitmap* bmp = nullptr;
     bool ownBmp = true;
     int refs = 1;
+    // estimated memory used by decoded bmp
+    size_t size = 0;
+    // set while bmp is being decoded (outside of cacheAccess)
+    // other threads asking for the page wait for pageLoaded
+    bool isLoading = false;
 
     ImagePage(int pageNo, Bitmap* bmp) {
         this->pageNo = pageNo;
@@ -122,16 +133,33 @@ class EngineImages : public EngineBase {
     ScopedComPtr<IStream> fileStream;
 
     CRITICAL_SECTION cacheAccess;
+    // signaled when a page finished loading or a read-ahead finished
+    CONDITION_VARIABLE pageLoaded;
+    // Most Recently Used first
     Vec<ImagePage*> pageCache;
+    size_t pageCacheSize = 0;
+    int readAheadsInFlight = 0;
+    bool readAheadStopped = false;
     Vec<RectF> mediaboxes;
 
     void GetTransform(Matrix& m, int pageNo, float zoom, int rotation);
 
+    // can be called concurrently from multiple threads (but not for the same page)
     virtual Bitmap* LoadBitmapForPage(int pageNo, bool& deleteAfterUse) = 0;
     virtual RectF LoadMediabox(int pageNo) = 0;
 
-    ImagePage* GetPage(int pageNo, bool tryOnly = false);
+    ImagePage* GetPage(int pageNo, bool tryOnly = false, bool readAhead = true);
     void DropPage(ImagePage* page, bool forceRemove);
+    bool IsPageCacheFull();
+    // must be called from destructors of derived classes
+    // because read-ahead calls LoadBitmapForPage
+    void StopReadAhead();
+
+  private:
+    ImagePage* LoadPage(int pageNo, bool tryOnly);
+    void ReadAhead(int pageNo);
+    void RemoveFromCache(ImagePage* page);
+    static DWORD WINAPI ReadAheadProc(void* data);
 };
 
 EngineImages::EngineImages() {
@@ -141,9 +169,11 @@ EngineImages::EngineImages() {
     isImageCollection = true;
 
     InitializeCriticalSection(&cacheAccess);
+    InitializeConditionVariable(&pageLoaded);
 }
 
 EngineImages::~EngineImages() {
+    StopReadAhead();
     EnterCriticalSection(&cacheAccess);
     while (pageCache.size() > 0) {
         ImagePage* lastPage = pageCache.Last();
@@ -322,7 +352,26 @@ bool EngineImages::SaveFileAs(const char* copyFileName, [[maybe_unused]] bool in
     return file::WriteFile(dstPath, d.AsSpan());
 }
 
-ImagePage* EngineImages::GetPage(int pageNo, bool tryOnly) {
+static size_t BitmapMemorySize(Bitmap* bmp) {
+    if (!bmp) {
+        return 0;
+    }
+    size_t bpp = Gdiplus::GetPixelFormatSize(bmp->GetPixelFormat());
+    return (size_t)bmp->GetWidth() * (size_t)bmp->GetHeight() * bpp / 8;
+}
+
+ImagePage* EngineImages::GetPage(int pageNo, bool tryOnly, bool readAhead) {
+    ImagePage* page = LoadPage(pageNo, tryOnly);
+    if (page && !tryOnly && readAhead) {
+        ReadAhead(pageNo);
+    }
+    return page;
+}
+
+// decoding happens outside of cacheAccess so that threads asking for
+// other (cached) pages or mediaboxes don't have to wait for it. If a page
+// is already being decoded, we wait for that instead of decoding it again
+ImagePage* EngineImages::LoadPage(int pageNo, bool tryOnly) {
     ScopedCritSec scope(&cacheAccess);
 
     ImagePage* result = nullptr;
@@ -338,30 +387,120 @@ ImagePage* EngineImages::GetPage(int pageNo, bool tryOnly) {
     }
 
     if (!result) {
+        result = new ImagePage(pageNo, nullptr);
+        result->isLoading = true;
+        result->refs++;
+        pageCache.InsertAt(0, result);
+
+        LeaveCriticalSection(&cacheAccess);
+        bool ownBmp = true;
+        Bitmap* bmp = LoadBitmapForPage(pageNo, ownBmp);
+        size_t size = ownBmp ? BitmapMemorySize(bmp) : 0;
+        EnterCriticalSection(&cacheAccess);
+
+        result->bmp = bmp;
+        result->ownBmp = ownBmp;
+        result->size = size;
+        result->isLoading = false;
+        if (pageCache.Contains(result)) {
+            pageCacheSize += size;
+        }
+        WakeAllConditionVariable(&pageLoaded);
+
         // TODO: drop most memory intensive pages first
         // (i.e. formats which aren't IsGdiPlusNativeFormat)?
-        if (pageCache.size() >= MAX_IMAGE_PAGE_CACHE) {
-            CrashIf(pageCache.size() != MAX_IMAGE_PAGE_CACHE);
-            DropPage(pageCache.Last(), true);
+        for (int i = pageCache.isize() - 1; i > 0 && pageCacheSize > MAX_IMAGE_PAGE_CACHE_SIZE; i--) {
+            ImagePage* page = pageCache.at(i);
+            if (!page->isLoading && page != result) {
+                DropPage(page, true);
+            }
+        }
+    } else {
+        result->refs++;
+        if (result != pageCache.at(0)) {
+            // keep the list Most Recently Used first
+            pageCache.Remove(result);
+            pageCache.InsertAt(0, result);
+        }
+        while (result->isLoading) {
+            SleepConditionVariableCS(&pageLoaded, &cacheAccess, INFINITE);
         }
-        result = new ImagePage(pageNo, nullptr);
-        result->bmp = LoadBitmapForPage(pageNo, result->ownBmp);
-        pageCache.InsertAt(0, result);
-    } else if (result != pageCache.at(0)) {
-        // keep the list Most Recently Used first
-        pageCache.Remove(result);
-        pageCache.InsertAt(0, result);
     }
+
     // return nullptr if a page failed to load
-    if (result && !result->bmp) {
+    if (!result->bmp) {
+        DropPage(result, false);
         return nullptr;
     }
-    if (!result) {
-        return nullptr;
+    return result;
+}
+
+bool EngineImages::IsPageCacheFull() {
+    ScopedCritSec scope(&cacheAccess);
+    return pageCacheSize >= MAX_IMAGE_PAGE_CACHE_SIZE;
+}
+
+struct ImageReadAheadData {
+    EngineImages* engine = nullptr;
+    int pageNo = 0;
+};
+
+DWORD WINAPI EngineImages::ReadAheadProc(void* data) {
+    auto* d = (ImageReadAheadData*)data;
+    EngineImages* engine = d->engine;
+    ImagePage* page = engine->LoadPage(d->pageNo, false);
+    if (page) {
+        engine->DropPage(page, false);
     }
+    delete d;
 
-    result->refs++;
-    return result;
+    ScopedCritSec scope(&engine->cacheAccess);
+    engine->readAheadsInFlight--;
+    WakeAllConditionVariable(&engine->pageLoaded);
+    return 0;
+}
+
+// decode the pages following pageNo on the thread pool so that
+// they're ready by the time the user gets to them
+void EngineImages::ReadAhead(int pageNo) {
+    ScopedCritSec scope(&cacheAccess);
+    int lastPageNo = std::min(pageNo + IMAGE_PAGE_READ_AHEAD, pageCount);
+    for (int n = pageNo + 1; n <= lastPageNo; n++) {
+        if (readAheadStopped || pageCacheSize >= MAX_IMAGE_PAGE_CACHE_SIZE) {
+            return;
+        }
+        bool isCached = false;
+        for (ImagePage* page : pageCache) {
+            isCached |= (page->pageNo == n);
+        }
+        if (isCached) {
+            continue;
+        }
+        auto* data = new ImageReadAheadData();
+        data->engine = this;
+        data->pageNo = n;
+        if (!QueueUserWorkItem(ReadAheadProc, data, WT_EXECUTEDEFAULT)) {
+            delete data;
+            return;
+        }
+        readAheadsInFlight++;
+    }
+}
+
+void EngineImages::StopReadAhead() {
+    ScopedCritSec scope(&cacheAccess);
+    readAheadStopped = true;
+    while (readAheadsInFlight > 0) {
+        SleepConditionVariableCS(&pageLoaded, &cacheAccess, INFINITE);
+    }
+}
+
+// Note: make sure to only call with cacheAccess
+void EngineImages::RemoveFromCache(ImagePage* page) {
+    if (pageCache.Remove(page) < 0) {
+        return;
+    }
+    pageCacheSize -= page->size;
 }
 
 void EngineImages::DropPage(ImagePage* page, bool forceRemove) {
@@ -370,7 +509,7 @@ void EngineImages::DropPage(ImagePage* page, bool forceRemove) {
     CrashIf(page->refs < 0);
 
     if (0 == page->refs || forceRemove) {
-        pageCache.Remove(page);
+        RemoveFromCache(page);
     }
 
     if (0 == page->refs) {
@@ -398,6 +537,8 @@ class EngineImage : public EngineImages {
     static EngineBase* CreateFromStream(IStream* stream);
 
   protected:
+    // pages are decoded concurrently but GDI+ objects aren't thread-safe
+    CRITICAL_SECTION imageAccess;
     Bitmap* image = nullptr;
     const WCHAR* fileExt = nullptr;
 
@@ -411,10 +552,13 @@ class EngineImage : public EngineImages {
 
 EngineImage::EngineImage() {
     kind = kindEngineImage;
+    InitializeCriticalSection(&imageAccess);
 }
 
 EngineImage::~EngineImage() {
+    StopReadAhead();
     delete image;
+    DeleteCriticalSection(&imageAccess);
 }
 
 EngineBase* EngineImage::Clone() {
@@ -553,6 +697,7 @@ Bitmap* EngineImage::LoadBitmapForPage(int pageNo, bool& deleteAfterUse) {
 
     // extract other frames from multi-page TIFFs and animated GIFs
     CrashIf(!str::Eq(fileExt, L".tif") && !str::Eq(fileExt, L".gif"));
+    ScopedCritSec scope(&imageAccess);
     const GUID* frameDimension = str::Eq(fileExt, L".tif") ? &FrameDimensionPage : &FrameDimensionTime;
     uint frameCount = image->GetFrameCount(frameDimension);
     CrashIf((unsigned int)pageNo > frameCount);
@@ -575,7 +720,8 @@ RectF EngineImage::LoadMediabox(int pageNo) {
     }
 
     // fill the cache to prevent the first few frames from being unpacked twice
-    ImagePage* page = GetPage(pageNo, MAX_IMAGE_PAGE_CACHE == pageCache.size());
+    // (but don't read ahead, as mediaboxes are requested for one page after the other anyway)
+    ImagePage* page = GetPage(pageNo, IsPageCacheFull(), false);
     if (page) {
         RectF mbox(0, 0, (float)page->bmp->GetWidth(), (float)page->bmp->GetHeight());
         DropPage(page, false);
@@ -583,6 +729,7 @@ RectF EngineImage::LoadMediabox(int pageNo) {
     }
 
     CrashIf(!str::Eq(fileExt, L".tif") && !str::Eq(fileExt, L".gif"));
+    ScopedCritSec scope(&imageAccess);
     RectF mbox = RectF(0, 0, (float)image->GetWidth(), (float)image->GetHeight());
     Bitmap* frame = image->Clone(0, 0, image->GetWidth(), image->GetHeight(), PixelFormat32bppARGB);
     if (!frame) {
@@ -671,6 +818,7 @@ class EngineImageDir : public EngineImages {
     }
 
     virtual ~EngineImageDir() {
+        StopReadAhead();
         delete tocTree;
     }
 
@@ -872,9 +1020,6 @@ class EngineCbx : public EngineImages, public json::ValueVisitor {
     static EngineBase* CreateFromFile(const WCHAR* path);
     static EngineBase* CreateFromStream(IStream* stream);
 
-    // an image for each page
-    Vec<ImageData> images;
-
   protected:
     Bitmap* LoadBitmapForPage(int pageNo, bool& deleteAfterUse) override;
     RectF LoadMediabox(int pageNo) override;
@@ -884,10 +1029,14 @@ class EngineCbx : public EngineImages, public json::ValueVisitor {
     bool FinishLoading();
 
     ImageData GetImageData(int pageNo);
+    void LoadMediaboxesInArchiveOrder();
     void ParseComicInfoXml(std::span<u8> xmlData);
 
-    // access to cbxFile must be protected after initialization (with cacheAccess)
+    // images are only uncompressed when needed so cbxFile stays
+    // open. Access to it must be protected with archiveAccess
+    CRITICAL_SECTION archiveAccess;
     MultiFormatArchive* cbxFile = nullptr;
+    // an image file for each page
     Vec<MultiFormatArchive::FileInfo*> files;
     TocTree* tocTree = nullptr;
 
@@ -909,18 +1058,14 @@ class EngineCbx : public EngineImages, public json::ValueVisitor {
 EngineCbx::EngineCbx(MultiFormatArchive* arch) {
     cbxFile = arch;
     kind = kindEngineComicBooks;
+    InitializeCriticalSection(&archiveAccess);
 }
 
 EngineCbx::~EngineCbx() {
+    StopReadAhead();
     delete tocTree;
-
-    // can be set in error conditions but generally is
-    // deleted in FinishLoading
     delete cbxFile;
-
-    for (auto&& img : images) {
-        free(img.data);
-    }
+    DeleteCriticalSection(&archiveAccess);
 }
 
 EngineBase* EngineCbx::Clone() {
@@ -1021,15 +1166,6 @@ bool EngineCbx::FinishLoading() {
         }
     }
 
-    AutoFree metadata(cbxFile->GetFileDataByName("ComicInfo.xml"));
-    if (metadata.data) {
-        ParseComicInfoXml(metadata.AsSpan());
-    }
-    std::string_view comment = cbxFile->GetComment();
-    if (comment.data()) {
-        json::Parse(comment.data(), this);
-    }
-
     size_t nFiles = pageFiles.size();
     if (nFiles == 0) {
         return false;
@@ -1063,28 +1199,61 @@ bool EngineCbx::FinishLoading() {
     }
     tocTree = new TocTree(root);
 
-    for (int i = 0; i < pageCount; i++) {
-        size_t fileId = files[i]->fileId;
-        std::span<u8> sv = cbxFile->GetFileDataById(fileId);
-        ImageData img;
-        img.data = (char*)sv.data();
-        img.len = sv.size();
-        images.Append(img);
+    // images are uncompressed on demand when a page is shown
+    cbxFile->SetCacheLimit(MAX_CBX_FILE_CACHE);
+    if (cbxFile->IsSolid()) {
+        LoadMediaboxesInArchiveOrder();
     }
 
-    delete cbxFile;
-    cbxFile = nullptr;
+    // read after the images so that reading from a solid archive can
+    // continue where it left off, if ComicInfo.xml comes last
+    AutoFree metadata(cbxFile->GetFileDataByName("ComicInfo.xml"));
+    if (metadata.data) {
+        ParseComicInfoXml(metadata.AsSpan());
+    }
+    std::string_view comment = cbxFile->GetComment();
+    if (comment.data()) {
+        json::Parse(comment.data(), this);
+    }
 
     return true;
 }
 
+// all mediaboxes are needed for the layout and getting them in the order of files
+// sorted by name would uncompress a solid archive over and over again. Instead,
+// uncompress it once in archive order (the last images remain in cbxFile's cache)
+void EngineCbx::LoadMediaboxesInArchiveOrder() {
+    Vec<int> pageIdxs;
+    for (int i = 0; i < pageCount; i++) {
+        pageIdxs.Append(i);
+    }
+    std::sort(pageIdxs.begin(), pageIdxs.end(), [this](int i1, int i2) { return files[i1]->fileId < files[i2]->fileId; });
+    for (int i : pageIdxs) {
+        AutoFree header(cbxFile->GetFileDataPartById(files[i]->fileId, IMAGE_HEADER_SIZE));
+        if (!header.data) {
+            continue;
+        }
+        Size size = BitmapSizeFromData(header.AsSpan());
+        if (!size.IsEmpty()) {
+            mediaboxes.at(i) = RectF(0, 0, (float)size.dx, (float)size.dy);
+        }
+    }
+}
+
 TocTree* EngineCbx::GetToc() {
     return tocTree;
 }
 
+// caller must free() the data
 ImageData EngineCbx::GetImageData(int pageNo) {
     CrashIf((pageNo < 1) || (pageNo > PageCount()));
-    return images[pageNo - 1];
+    ScopedCritSec scope(&archiveAccess);
+    size_t fileId = files[pageNo - 1]->fileId;
+    std::span<u8> d = cbxFile->GetFileDataById(fileId);
+    ImageData img;
+    img.data = (char*)d.data();
+    img.len = d.size();
+    return img;
 }
 
 static char* GetTextContent(HtmlPullParser& parser) {
@@ -1180,6 +1349,7 @@ bool EngineCbx::SaveFileAsPDF(const char* pdfFileName, [[maybe_unused]] bool inc
     for (int i = 1; i <= PageCount() && ok; i++) {
         ImageData img = GetImageData(i);
         ok = c->AddPageFromImageData(img.data, img.size(), GetFileDPI());
+        free(img.data);
     }
     if (ok) {
         c->CopyProperties(this);
@@ -1220,28 +1390,41 @@ Bitmap* EngineCbx::LoadBitmapForPage(int pageNo, bool& deleteAfterUse) {
         logf("EngineCbx::LoadBitmapForPage(page: %d) took %.2f\n", pageNo, dur);
     };
     ImageData img = GetImageData(pageNo);
-    if (img.data) {
-        deleteAfterUse = true;
-        return BitmapFromData(img.AsSpan());
+    if (!img.data) {
+        return nullptr;
     }
-    return nullptr;
+    deleteAfterUse = true;
+    Bitmap* bmp = BitmapFromData(img.AsSpan());
+    free(img.data);
+    return bmp;
 }
 
 RectF EngineCbx::LoadMediabox(int pageNo) {
-    // fill the cache to prevent the first few images from being unpacked twice
-    ImagePage* page = GetPage(pageNo, MAX_IMAGE_PAGE_CACHE == pageCache.size());
+    ImagePage* page = GetPage(pageNo, true);
     if (page) {
         RectF mbox(0, 0, (float)page->bmp->GetWidth(), (float)page->bmp->GetHeight());
         DropPage(page, false);
         return mbox;
     }
 
-    ImageData img = GetImageData(pageNo);
-    if (img.data) {
-        Size size = BitmapSizeFromData(img.AsSpan());
-        return RectF(0, 0, (float)size.dx, (float)size.dy);
+    // only uncompress the start of the image, which is enough for reading
+    // the size from the header in most cases
+    Size size;
+    {
+        ScopedCritSec scope(&archiveAccess);
+        size_t fileId = files[pageNo - 1]->fileId;
+        AutoFree header(cbxFile->GetFileDataPartById(fileId, IMAGE_HEADER_SIZE));
+        if (header.data) {
+            size = BitmapSizeFromData(header.AsSpan());
+        }
     }
-    return RectF();
+    if (size.IsEmpty()) {
+        AutoFree img(GetImageData(pageNo).AsSpan());
+        if (img.data) {
+            size = BitmapSizeFromData(img.AsSpan());
+        }
+    }
+    return RectF(0, 0, (float)size.dx, (float)size.dy);
 }
 
 EngineBase* EngineCbx::CreateFromFile(const WCHAR* path) {
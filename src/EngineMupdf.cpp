@@ -29,7 +29,6 @@ extern "C" {
 
 #if 0
 // in mupdf_load_system_font.c
-extern "C" void drop_cached_fonts_for_ctx(fz_context*);
 extern "C" void pdf_install_load_system_font_funcs(fz_context* ctx);
 
 class EngineMupdf : public EngineBase {
@@ -71,13 +70,12 @@ class EngineMupdf : public EngineBase {
     // protected critical section in order to avoid deadlocks
     CRITICAL_SECTION* ctxAccess;
     CRITICAL_SECTION pagesAccess;
-
-    CRITICAL_SECTION mutexes[FZ_LOCK_MAX];
+    // what ctxAccess points to
+    CRITICAL_SECTION docAccess;
 
     RenderedBitmap* GetPageImage(int pageNo, RectF rect, int imageIdx);
 
     fz_context* ctx = nullptr;
-    fz_locks_context fz_locks_ctx;
     fz_document* _doc = nullptr;
     fz_stream* _docStream = nullptr;
     Vec<FzPageInfo*> _pages;
@@ -97,16 +95,6 @@ class EngineMupdf : public EngineBase {
     TocItem* BuildTocTree(TocItem* parent, fz_outline* outline, int& idCounter, bool isAttachment);
 };
 
-static void fz_lock_context_cs(void* user, int lock) {
-    EngineMupdf* e = (EngineMupdf*)user;
-    EnterCriticalSection(&e->mutexes[lock]);
-}
-
-static void fz_unlock_context_cs(void* user, int lock) {
-    EngineMupdf* e = (EngineMupdf*)user;
-    LeaveCriticalSection(&e->mutexes[lock]);
-}
-
 static void fz_print_cb(void* user, const char* msg) {
     log(msg);
     if (!str::EndsWith(msg, "\n")) {
@@ -124,16 +112,11 @@ EngineMupdf::EngineMupdf() {
     defaultFileExt = L".pdf";
     fileDPI = 72.0f;
 
-    for (size_t i = 0; i < dimof(mutexes); i++) {
-        InitializeCriticalSection(&mutexes[i]);
-    }
+    InitializeCriticalSection(&docAccess);
     InitializeCriticalSection(&pagesAccess);
-    ctxAccess = &mutexes[FZ_LOCK_ALLOC];
+    ctxAccess = &docAccess;
 
-    fz_locks_ctx.user = this;
-    fz_locks_ctx.lock = fz_lock_context_cs;
-    fz_locks_ctx.unlock = fz_unlock_context_cs;
-    ctx = fz_new_context(nullptr, &fz_locks_ctx, FZ_STORE_DEFAULT);
+    ctx = NewEngineFzContext(FZ_STORE_DEFAULT);
     installFitzErrorCallbacks(ctx);
 
     pdf_install_load_system_font_funcs(ctx);
@@ -161,13 +144,10 @@ EngineMupdf::~EngineMupdf() {
     fz_drop_outline(ctx, outline);
 
     fz_drop_document(ctx, _doc);
-    drop_cached_fonts_for_ctx(ctx);
-    fz_drop_context(ctx);
+    DropEngineFzContext(ctx);
 
-    for (size_t i = 0; i < dimof(mutexes); i++) {
-        LeaveCriticalSection(&mutexes[i]);
-        DeleteCriticalSection(&mutexes[i]);
-    }
+    LeaveCriticalSection(ctxAccess);
+    DeleteCriticalSection(ctxAccess);
     LeaveCriticalSection(&pagesAccess);
     DeleteCriticalSection(&pagesAccess);
 }
@@ -8,8 +8,11 @@ extern "C" {
 
 #include "utils/BaseUtil.h"
 #include "utils/Archive.h"
+#include "utils/ByteReader.h"
+#include "utils/ByteWriter.h"
 #include "utils/ScopedWin.h"
 #include "utils/FileUtil.h"
+#include "utils/Timer.h"
 #include "utils/GuessFileType.h"
 #include "utils/HtmlParserLookup.h"
 #include "utils/HtmlPullParser.h"
@@ -28,13 +31,30 @@ extern "C" {
 #include "EnginePdf.h"
 
 // in mupdf_load_system_font.c
-extern "C" void drop_cached_fonts_for_ctx(fz_context*);
 extern "C" void pdf_install_load_system_font_funcs(fz_context* ctx);
 
 AnnotationType AnnotationTypeFromPdfAnnot(enum pdf_annot_type tp);
 
 Kind kindEnginePdf = "enginePdf";
 
+// documents with at least that many pages have their page sizes resolved lazily
+#define MIN_PAGES_FOR_LAZY_MEDIABOXES 1000
+// minimum time between two notifications about changed page sizes
+#define PAGE_SIZES_CHANGED_INTERVAL_MS 250
+// page sizes and labels are only worth caching for documents with many pages
+#define MIN_PAGES_FOR_LAYOUT_CACHE 100
+#define PDF_LAYOUT_CACHE_TAG 0x31464450 // "PDF1"
+// progressively rendered pages are split into at most that many bands
+// (of at least PROGRESSIVE_BAND_MIN_DY pixels each)
+#define PROGRESSIVE_MAX_BANDS 8
+#define PROGRESSIVE_BAND_MIN_DY 64
+// partial results are published at most this often, starting when
+// rendering has taken that long (so that quick pages are rendered at once)
+#define PROGRESSIVE_RESULT_INTERVAL_MS 150
+// pages are only rendered in bands if rendering them took longer than
+// PROGRESSIVE_RESULT_INTERVAL_MS before or if their display list is that large
+#define PROGRESSIVE_MIN_LIST_SIZE (1024 * 1024)
+
 static fz_link* FixupPageLinks(fz_link* root) {
     // Links in PDF documents are added from bottom-most to top-most,
     // i.e. links that appear later in the list should be preferred
@@ -306,6 +326,11 @@ class EnginePdf : public EngineBase {
 
     RectF PageMediabox(int pageNo) override;
     RectF PageContentBox(int pageNo, RenderTarget target = RenderTarget::View) override;
+    RectF PageMediaboxOrEstimate(int pageNo, bool* isEstimate) override;
+    void SetPageSizesChangedCb(const std::function<void()>& cb) override;
+    std::span<u8> GetLayoutCache() override;
+    u64 PageFingerprint(int pageNo, bool load) override;
+    void KeepCachedPage(EngineBase* prev, int prevPageNo, int pageNo) override;
 
     RenderedBitmap* RenderPage(RenderPageArgs& args) override;
 
@@ -333,27 +358,45 @@ class EnginePdf : public EngineBase {
 
     int GetAnnotations(Vec<Annotation*>* annotsOut);
 
-    static EngineBase* CreateFromFile(const WCHAR* path, PasswordUI* pwdUI);
+    static EngineBase* CreateFromFile(const WCHAR* path, PasswordUI* pwdUI, std::span<u8> layoutCache);
     static EngineBase* CreateFromStream(IStream* stream, PasswordUI* pwdUI);
 
     // make sure to never ask for pagesAccess in an ctxAccess
     // protected critical section in order to avoid deadlocks
     CRITICAL_SECTION* ctxAccess;
     CRITICAL_SECTION pagesAccess;
-
-    CRITICAL_SECTION mutexes[FZ_LOCK_MAX];
+    // protects the mediabox of pages which are resolved lazily, must
+    // neither be held when asking for ctxAccess nor for pagesAccess
+    CRITICAL_SECTION mediaboxesAccess;
+    // what ctxAccess points to
+    CRITICAL_SECTION docAccess;
 
     RenderedBitmap* GetPageImage(int pageNo, RectF rect, int imageIdx);
 
     fz_context* ctx = nullptr;
-    fz_locks_context fz_locks_ctx;
     fz_document* _doc = nullptr;
     fz_stream* _docStream = nullptr;
     Vec<FzPageInfo> _pages;
+    // pages with a cached display list, least recently used first
+    Vec<FzPageInfo*> pagesWithList;
+    size_t listsMemory = 0;
+    // fz_store_scavenges() when the last display list was cached
+    int storeScavenges = 0;
+    // for documents with many pages, page sizes are only resolved when
+    // needed or in the background (cf. FinishLoading)
+    bool lazyMediaboxes = false;
+    bool pageSizesChanged = false;
+    std::function<void()> pageSizesChangedCb;
+    HANDLE mediaboxesThread = nullptr;
+    LONG mediaboxesCancelled = 0;
     fz_outline* outline = nullptr;
     fz_outline* attachments = nullptr;
     pdf_obj* _info = nullptr;
     WStrVec* _pageLabels = nullptr;
+    // only set while loading (cf. CreateFromFile)
+    std::span<u8> layoutCache;
+    // fingerprints of indirect objects by object number (cf. GetPageFingerprint)
+    Vec<u64> objFingerprints;
 
     TocTree* tocTree = nullptr;
 
@@ -363,11 +406,18 @@ class EnginePdf : public EngineBase {
     // bool Load(fz_stream* stm, PasswordUI* pwdUI = nullptr);
     bool LoadFromStream(fz_stream* stm, PasswordUI* pwdUI = nullptr);
     bool FinishLoading();
+    bool LoadLayoutCache();
+    RectF LoadMediabox(int pageNo);
+    void SetResolvedMediabox(FzPageInfo* pageInfo, RectF mediabox);
+    static DWORD WINAPI ResolveMediaboxesThread(void* data);
 
     FzPageInfo* GetFzPageInfoFast(int pageNo);
     FzPageInfo* GetFzPageInfo(int pageNo, bool loadQuick);
+    fz_display_list* GetDisplayList(FzPageInfo* pageInfo, const char* usage);
+    void CacheDisplayList(FzPageInfo* pageInfo, fz_display_list* list);
+    void DropDisplayList(FzPageInfo* pageInfo);
+    u64 GetPageFingerprint(FzPageInfo* pageInfo);
     fz_matrix viewctm(int pageNo, float zoom, int rotation);
-    fz_matrix viewctm(fz_page* page, float zoom, int rotation);
     TocItem* BuildTocTree(TocItem* parent, fz_outline* outline, int& idCounter, bool isAttachment);
     WCHAR* ExtractFontList();
 
@@ -385,16 +435,6 @@ bool PdfLink::SaveEmbedded(LinkSaverUI& saveUI) {
 }
 #endif
 
-static void fz_lock_context_cs(void* user, int lock) {
-    EnginePdf* e = (EnginePdf*)user;
-    EnterCriticalSection(&e->mutexes[lock]);
-}
-
-static void fz_unlock_context_cs(void* user, int lock) {
-    EnginePdf* e = (EnginePdf*)user;
-    LeaveCriticalSection(&e->mutexes[lock]);
-}
-
 static void fz_print_cb(void* user, const char* msg) {
     log(msg);
     if (!str::EndsWith(msg, "\n")) {
@@ -412,22 +452,24 @@ EnginePdf::EnginePdf() {
     defaultFileExt = L".pdf";
     fileDPI = 72.0f;
 
-    for (size_t i = 0; i < dimof(mutexes); i++) {
-        InitializeCriticalSection(&mutexes[i]);
-    }
+    InitializeCriticalSection(&docAccess);
     InitializeCriticalSection(&pagesAccess);
-    ctxAccess = &mutexes[FZ_LOCK_ALLOC];
+    InitializeCriticalSection(&mediaboxesAccess);
+    ctxAccess = &docAccess;
 
-    fz_locks_ctx.user = this;
-    fz_locks_ctx.lock = fz_lock_context_cs;
-    fz_locks_ctx.unlock = fz_unlock_context_cs;
-    ctx = fz_new_context(nullptr, &fz_locks_ctx, FZ_STORE_DEFAULT);
+    ctx = NewEngineFzContext(MAX_CONTEXT_MEMORY);
     installFitzErrorCallbacks(ctx);
 
     pdf_install_load_system_font_funcs(ctx);
 }
 
 EnginePdf::~EnginePdf() {
+    if (mediaboxesThread) {
+        InterlockedIncrement(&mediaboxesCancelled);
+        WaitForSingleObject(mediaboxesThread, INFINITE);
+        CloseHandle(mediaboxesThread);
+    }
+
     EnterCriticalSection(&pagesAccess);
 
     // TODO: remove this lock and see what happens
@@ -438,6 +480,7 @@ EnginePdf::~EnginePdf() {
         if (pi->links) {
             fz_drop_link(ctx, pi->links);
         }
+        fz_drop_display_list(ctx, pi->list);
         if (pi->page) {
             fz_drop_page(ctx, pi->page);
         }
@@ -450,18 +493,16 @@ EnginePdf::~EnginePdf() {
     pdf_drop_obj(ctx, _info);
 
     fz_drop_document(ctx, _doc);
-    drop_cached_fonts_for_ctx(ctx);
-    fz_drop_context(ctx);
+    DropEngineFzContext(ctx);
 
     delete _pageLabels;
     delete tocTree;
 
-    for (size_t i = 0; i < dimof(mutexes); i++) {
-        LeaveCriticalSection(&mutexes[i]);
-        DeleteCriticalSection(&mutexes[i]);
-    }
+    LeaveCriticalSection(ctxAccess);
+    DeleteCriticalSection(ctxAccess);
     LeaveCriticalSection(&pagesAccess);
     DeleteCriticalSection(&pagesAccess);
+    DeleteCriticalSection(&mediaboxesAccess);
 }
 
 class PasswordCloner : public PasswordUI {
@@ -795,29 +836,56 @@ bool EnginePdf::FinishLoading() {
     pdf_document* doc = (pdf_document*)_doc;
 
     preferredLayout = GetPreferredLayout(ctx, doc);
+    // pages are rendered from display lists on cloned contexts
+    allowsConcurrentRendering = true;
     allowsPrinting = fz_has_permission(ctx, _doc, FZ_PERMISSION_PRINT);
     allowsCopyingText = fz_has_permission(ctx, _doc, FZ_PERMISSION_COPY);
 
     ScopedCritSec scope(ctxAccess);
 
-    bool loadPageTreeFailed = false;
-    fz_try(ctx) {
-        pdf_load_page_tree(ctx, doc);
-    }
-    fz_catch(ctx) {
-        fz_warn(ctx, "pdf_load_page_tree() failed");
-        loadPageTreeFailed = true;
-    }
+    // loading the page tree and the size of every page requires loading all page
+    // objects, which takes long for documents with many pages (esp. if the objects
+    // are compressed), so for those the first page's size is used for all pages
+    // until the actual sizes are needed or have been resolved in the background
+    lazyMediaboxes = pageCount >= MIN_PAGES_FOR_LAZY_MEDIABOXES;
 
-    int nPages = doc->rev_page_count;
-    if (nPages != pageCount) {
-        fz_warn(ctx, "mismatch between fz_count_pages() and doc->rev_page_count");
-        return false;
+    // unless they're known from the last time the document was loaded
+    bool fromLayoutCache = LoadLayoutCache();
+    if (fromLayoutCache) {
+        lazyMediaboxes = false;
     }
 
-    _pages.AppendBlanks(pageCount);
+    int nPages = pageCount;
+    bool loadPageTreeFailed = false;
+    if (!lazyMediaboxes && !fromLayoutCache) {
+        fz_try(ctx) {
+            pdf_load_page_tree(ctx, doc);
+        }
+        fz_catch(ctx) {
+            fz_warn(ctx, "pdf_load_page_tree() failed");
+            loadPageTreeFailed = true;
+        }
 
-    if (loadPageTreeFailed) {
+        nPages = doc->rev_page_count;
+        if (nPages != pageCount) {
+            fz_warn(ctx, "mismatch between fz_count_pages() and doc->rev_page_count");
+            return false;
+        }
+    }
+
+    if (fromLayoutCache) {
+        // _pages have already been set up
+    } else if (lazyMediaboxes) {
+        _pages.AppendBlanks(pageCount);
+        RectF estimate = LoadMediabox(1);
+        for (int pageNo = 1; pageNo <= pageCount; pageNo++) {
+            FzPageInfo* pageInfo = &_pages[pageNo - 1];
+            pageInfo->pageNo = pageNo;
+            pageInfo->mediabox = estimate;
+            pageInfo->mediaboxIsEstimate = pageNo > 1;
+        }
+    } else if (loadPageTreeFailed) {
+        _pages.AppendBlanks(pageCount);
         for (int pageNo = 0; pageNo < nPages; pageNo++) {
             FzPageInfo* pageInfo = &_pages[pageNo];
             pageInfo->pageNo = pageNo + 1;
@@ -840,6 +908,7 @@ bool EnginePdf::FinishLoading() {
             pageInfo->mediabox = ToRectFl(mbox);
         }
     } else {
+        _pages.AppendBlanks(pageCount);
         // this does the job of pdf_bound_page but without doing pdf_load_page()
         pdf_rev_page_map* map = doc->rev_page_map;
         for (int i = 0; i < nPages; i++) {
@@ -937,7 +1006,7 @@ bool EnginePdf::FinishLoading() {
 
     fz_try(ctx) {
         pdf_obj* pageLabels = pdf_dict_getp(ctx, pdf_trailer(ctx, doc), "Root/PageLabels");
-        if (pageLabels) {
+        if (pageLabels && !fromLayoutCache) {
             _pageLabels = BuildPageLabelVec(ctx, pageLabels, PageCount());
         }
     }
@@ -1229,6 +1298,10 @@ FzPageInfo* EnginePdf::GetFzPageInfo(int pageNo, bool loadQuick) {
         }
         fz_catch(ctx) {
         }
+        // this is the last chance before the file might change on disk
+        if (pageInfo->page && fingerprintPages) {
+            pageInfo->fingerprint = GetPageFingerprint(pageInfo);
+        }
     }
 
     fz_page* page = pageInfo->page;
@@ -1248,10 +1321,14 @@ FzPageInfo* EnginePdf::GetFzPageInfo(int pageNo, bool loadQuick) {
     fz_var(stext);
     fz_stext_options opts{};
     opts.flags = FZ_STEXT_PRESERVE_IMAGES;
-    fz_try(ctx) {
-        stext = fz_new_stext_page_from_page(ctx, page, &opts);
-    }
-    fz_catch(ctx) {
+    fz_display_list* list = GetDisplayList(pageInfo, "View");
+    if (list) {
+        fz_try(ctx) {
+            stext = fz_new_stext_page_from_display_list(ctx, list, &opts);
+        }
+        fz_catch(ctx) {
+        }
+        fz_drop_display_list(ctx, list);
     }
 
     auto links = fz_load_links(ctx, page);
@@ -1270,48 +1347,228 @@ FzPageInfo* EnginePdf::GetFzPageInfo(int pageNo, bool loadQuick) {
 
 RectF EnginePdf::PageMediabox(int pageNo) {
     FzPageInfo* pi = &_pages[pageNo - 1];
+    if (!lazyMediaboxes) {
+        return pi->mediabox;
+    }
+    {
+        ScopedCritSec scope(&mediaboxesAccess);
+        if (!pi->mediaboxIsEstimate) {
+            return pi->mediabox;
+        }
+    }
+    RectF mediabox = LoadMediabox(pageNo);
+    SetResolvedMediabox(pi, mediabox);
+    return mediabox;
+}
+
+RectF EnginePdf::PageMediaboxOrEstimate(int pageNo, bool* isEstimate) {
+    FzPageInfo* pi = &_pages[pageNo - 1];
+    ScopedCritSec scope(&mediaboxesAccess);
+    *isEstimate = pi->mediaboxIsEstimate;
     return pi->mediabox;
 }
 
-RectF EnginePdf::PageContentBox(int pageNo, RenderTarget target) {
+// same as FinishLoading but looks up the page object
+// without having to load the whole page tree first
+RectF EnginePdf::LoadMediabox(int pageNo) {
+    ScopedCritSec scope(ctxAccess);
+
+    pdf_document* doc = (pdf_document*)_doc;
+    fz_rect mbox{};
+    fz_matrix page_ctm{};
+    fz_try(ctx) {
+        pdf_obj* pageref = pdf_lookup_page_obj(ctx, doc, pageNo - 1);
+        pdf_page_obj_transform(ctx, pageref, &mbox, &page_ctm);
+        mbox = fz_transform_rect(mbox, page_ctm);
+    }
+    fz_catch(ctx) {
+    }
+    if (fz_is_empty_rect(mbox)) {
+        fz_warn(ctx, "cannot find page size for page %d", pageNo - 1);
+        mbox.x0 = 0;
+        mbox.y0 = 0;
+        mbox.x1 = 612;
+        mbox.y1 = 792;
+    }
+    return ToRectFl(mbox);
+}
+
+void EnginePdf::SetResolvedMediabox(FzPageInfo* pageInfo, RectF mediabox) {
+    ScopedCritSec scope(&mediaboxesAccess);
+    if (!pageInfo->mediaboxIsEstimate) {
+        return;
+    }
+    if (pageInfo->mediabox != mediabox) {
+        pageSizesChanged = true;
+    }
+    pageInfo->mediabox = mediabox;
+    pageInfo->mediaboxIsEstimate = false;
+}
+
+void EnginePdf::SetPageSizesChangedCb(const std::function<void()>& cb) {
+    ScopedCritSec scope(&mediaboxesAccess);
+    pageSizesChangedCb = cb;
+    // only resolve all page sizes if somebody is interested in them
+    // (otherwise they're resolved as needed by PageMediabox)
+    if (cb && lazyMediaboxes && !mediaboxesThread) {
+        mediaboxesThread = CreateThread(nullptr, 0, ResolveMediaboxesThread, this, 0, nullptr);
+    }
+}
+
+// the page count, all page sizes and page labels
+std::span<u8> EnginePdf::GetLayoutCache() {
+    if (pageCount < MIN_PAGES_FOR_LAYOUT_CACHE) {
+        return {};
+    }
+    ByteWriterLE w(12 + pageCount * 16);
+    w.Write32(PDF_LAYOUT_CACHE_TAG);
+    w.Write32((u32)pageCount);
+    w.Write32(_pageLabels ? (u32)pageCount : 0);
+    {
+        ScopedCritSec scope(&mediaboxesAccess);
+        for (FzPageInfo& pi : _pages) {
+            if (pi.mediaboxIsEstimate) {
+                // don't cache estimates
+                return {};
+            }
+            float coords[4] = {pi.mediabox.x, pi.mediabox.y, pi.mediabox.dx, pi.mediabox.dy};
+            for (float f : coords) {
+                u32 v;
+                memcpy(&v, &f, sizeof(v));
+                w.Write32(v);
+            }
+        }
+    }
+    for (int i = 0; _pageLabels && i < pageCount; i++) {
+        const WCHAR* label = _pageLabels->at(i);
+        size_t len = str::Len(label);
+        w.Write32((u32)len);
+        for (size_t j = 0; j < len; j++) {
+            w.Write16((u16)label[j]);
+        }
+    }
+    size_t size = w.Size();
+    return {(u8*)w.d.StealData(), size};
+}
+
+// the cached data is only used if the page count still matches
+// (the caller is responsible for making sure that the document is unchanged)
+bool EnginePdf::LoadLayoutCache() {
+    ByteReader r(layoutCache);
+    size_t len = layoutCache.size();
+    if (len < 12 || r.DWordLE(0) != PDF_LAYOUT_CACHE_TAG || r.DWordLE(4) != (u32)pageCount) {
+        return false;
+    }
+    u32 nLabels = r.DWordLE(8);
+    size_t off = 12;
+    if ((nLabels != 0 && nLabels != (u32)pageCount) || (len - off) / 16 < (size_t)pageCount) {
+        return false;
+    }
+
+    Vec<RectF> mediaboxes;
+    for (int i = 0; i < pageCount; i++, off += 16) {
+        float coords[4];
+        for (int j = 0; j < 4; j++) {
+            u32 v = r.DWordLE(off + j * 4);
+            memcpy(&coords[j], &v, sizeof(v));
+        }
+        mediaboxes.Append(RectF(coords[0], coords[1], coords[2], coords[3]));
+    }
+    WStrVec* labels = nLabels > 0 ? new WStrVec() : nullptr;
+    for (u32 i = 0; i < nLabels; i++) {
+        size_t labelLen = off + 4 <= len ? r.DWordLE(off) : 0;
+        off += 4;
+        if (off > len || labelLen > (len - off) / 2) {
+            delete labels;
+            return false;
+        }
+        WCHAR* label = AllocArray<WCHAR>(labelLen + 1);
+        for (size_t j = 0; j < labelLen; j++, off += 2) {
+            label[j] = (WCHAR)r.WordLE(off);
+        }
+        labels->Append(label);
+    }
+
+    _pages.AppendBlanks(pageCount);
+    for (int pageNo = 1; pageNo <= pageCount; pageNo++) {
+        FzPageInfo* pageInfo = &_pages[pageNo - 1];
+        pageInfo->pageNo = pageNo;
+        pageInfo->mediabox = mediaboxes[pageNo - 1];
+    }
+    _pageLabels = labels;
+    return true;
+}
+
+DWORD WINAPI EnginePdf::ResolveMediaboxesThread(void* data) {
+    EnginePdf* e = (EnginePdf*)data;
+    auto lastNotification = TimeGet();
+    for (int pageNo = 1; pageNo <= e->pageCount; pageNo++) {
+        if (InterlockedAdd(&e->mediaboxesCancelled, 0) > 0) {
+            break;
+        }
+        FzPageInfo* pageInfo = &e->_pages[pageNo - 1];
+        bool isEstimate = false;
+        {
+            ScopedCritSec scope(&e->mediaboxesAccess);
+            isEstimate = pageInfo->mediaboxIsEstimate;
+        }
+        if (isEstimate) {
+            e->SetResolvedMediabox(pageInfo, e->LoadMediabox(pageNo));
+        }
+        // batch changes so that the pages don't have to be laid out too often
+        if (pageNo < e->pageCount && TimeSinceInMs(lastNotification) < PAGE_SIZES_CHANGED_INTERVAL_MS) {
+            continue;
+        }
+        std::function<void()> cb;
+        {
+            ScopedCritSec scope(&e->mediaboxesAccess);
+            if (e->pageSizesChanged) {
+                cb = e->pageSizesChangedCb;
+                e->pageSizesChanged = false;
+            }
+        }
+        if (cb) {
+            cb();
+        }
+        lastNotification = TimeGet();
+    }
+    return 0;
+}
+
+RectF EnginePdf::PageContentBox(int pageNo, [[maybe_unused]] RenderTarget target) {
     FzPageInfo* pageInfo = GetFzPageInfo(pageNo, false);
+    if (!pageInfo) {
+        return PageMediabox(pageNo);
+    }
+    RectF mediabox = PageMediabox(pageNo);
 
     ScopedCritSec scope(ctxAccess);
 
+    fz_display_list* list = GetDisplayList(pageInfo, "View");
+    if (!list) {
+        return mediabox;
+    }
+
     fz_cookie fzcookie = {};
     fz_rect rect = fz_empty_rect;
     fz_device* dev = nullptr;
-    fz_display_list* list = nullptr;
-
-    fz_rect pagerect = fz_bound_page(ctx, pageInfo->page);
+    fz_rect pagerect = fz_bound_display_list(ctx, list);
 
     fz_var(dev);
-    fz_var(list);
-
-    RectF mediabox = pageInfo->mediabox;
 
     fz_try(ctx) {
-        list = fz_new_display_list_from_page(ctx, pageInfo->page);
-        if (list) {
-            dev = fz_new_bbox_device(ctx, &rect);
-            fz_run_display_list(ctx, list, dev, fz_identity, pagerect, &fzcookie);
-            fz_close_device(ctx, dev);
-        }
+        dev = fz_new_bbox_device(ctx, &rect);
+        fz_run_display_list(ctx, list, dev, fz_identity, pagerect, &fzcookie);
+        fz_close_device(ctx, dev);
     }
     fz_always(ctx) {
         fz_drop_device(ctx, dev);
-        if (list) {
-            fz_drop_display_list(ctx, list);
-        }
+        fz_drop_display_list(ctx, list);
     }
     fz_catch(ctx) {
         return mediabox;
     }
 
-    if (!list) {
-        return mediabox;
-    }
-
     if (fz_is_infinite_rect(rect)) {
         return mediabox;
     }
@@ -1340,6 +1597,402 @@ RectF EnginePdf::Transform(const RectF& rect, int pageNo, float zoom, int rotati
     return ToRectFl(rect2);
 }
 
+// returns true if annotations on the page were added, removed or got a new
+// appearance since the last call i.e. a recorded display list is stale
+// Note: make sure to only call with ctxAccess
+static bool PageAnnotsChanged(fz_context* ctx, pdf_page* page, int* annotsCountInOut) {
+    bool changed = false;
+    int n = 0;
+    for (pdf_annot* annot = pdf_first_annot(ctx, page); annot; annot = pdf_next_annot(ctx, annot)) {
+        changed |= (annot->has_new_ap != 0);
+        annot->has_new_ap = 0;
+        n++;
+    }
+    for (pdf_widget* widget = pdf_first_widget(ctx, page); widget; widget = pdf_next_widget(ctx, widget)) {
+        changed |= (widget->has_new_ap != 0);
+        widget->has_new_ap = 0;
+        n++;
+    }
+    changed |= (n != *annotsCountInOut);
+    *annotsCountInOut = n;
+    return changed;
+}
+
+// returns a display list of the page that the caller must fz_drop_display_list()
+// lists for usage "View" are cached in pageInfo, others are recorded every time
+// Note: make sure to only call with ctxAccess
+fz_display_list* EnginePdf::GetDisplayList(FzPageInfo* pageInfo, const char* usage) {
+    fz_page* page = pageInfo->page;
+    pdf_page* pdfpage = pdf_page_from_fz_page(ctx, page);
+    bool cacheable = str::Eq(usage, "View");
+
+    if (PageAnnotsChanged(ctx, pdfpage, &pageInfo->listAnnotsCount)) {
+        DropDisplayList(pageInfo);
+    }
+    if (cacheable && pageInfo->list) {
+        // move to the end of the LRU list
+        pagesWithList.Remove(pageInfo);
+        pagesWithList.Append(pageInfo);
+        return fz_keep_display_list(ctx, pageInfo->list);
+    }
+
+    fz_display_list* list = nullptr;
+    fz_device* dev = nullptr;
+    fz_var(list);
+    fz_var(dev);
+    fz_try(ctx) {
+        list = fz_new_display_list(ctx, fz_bound_page(ctx, page));
+        dev = fz_new_list_device(ctx, list);
+        pdf_document* doc = pdf_document_from_fz_document(ctx, _doc);
+        pdf_run_page_with_usage(ctx, doc, pdfpage, dev, fz_identity, usage, nullptr);
+        fz_close_device(ctx, dev);
+    }
+    fz_always(ctx) {
+        fz_drop_device(ctx, dev);
+    }
+    fz_catch(ctx) {
+        fz_drop_display_list(ctx, list);
+        return nullptr;
+    }
+
+    if (cacheable) {
+        CacheDisplayList(pageInfo, list);
+    }
+    return list;
+}
+
+// Note: make sure to only call with ctxAccess
+void EnginePdf::CacheDisplayList(FzPageInfo* pageInfo, fz_display_list* list) {
+    pageInfo->list = fz_keep_display_list(ctx, list);
+    pageInfo->listSize = fz_display_list_size(ctx, list);
+    pagesWithList.Append(pageInfo);
+    listsMemory += pageInfo->listSize;
+
+    // if the store had to evict items since then, the lists (which keep fonts and
+    // images alive in the store) give up half of their memory
+    size_t maxMemory = MAX_PAGE_RUN_MEMORY;
+    int scavenges = fz_store_scavenges(ctx);
+    if (scavenges != storeScavenges) {
+        storeScavenges = scavenges;
+        maxMemory = std::min(maxMemory, listsMemory / 2);
+    }
+
+    // evict least recently used lists but always keep the one just added
+    while (pagesWithList.size() > 1 && listsMemory > maxMemory) {
+        DropDisplayList(pagesWithList.at(0));
+    }
+}
+
+// Note: make sure to only call with ctxAccess
+void EnginePdf::DropDisplayList(FzPageInfo* pageInfo) {
+    if (!pageInfo->list) {
+        return;
+    }
+    // renders in progress keep their own reference
+    fz_drop_display_list(ctx, pageInfo->list);
+    pageInfo->list = nullptr;
+    listsMemory -= pageInfo->listSize;
+    pageInfo->listSize = 0;
+    pagesWithList.Remove(pageInfo);
+}
+
+// the lowest bit of a fingerprint is set if Type3 fonts are used. Their glyphs are
+// drawn from the document, so a display list using them mustn't outlive it
+constexpr u64 kFingerprintType3 = 1;
+// marks objects whose fingerprint is still being computed (i.e. reference cycles)
+constexpr u64 kFingerprintPending = 2;
+// stands in for references to pages (e.g. by links) and invalid objects
+constexpr u64 kFingerprintOpaque = 4;
+constexpr int kFingerprintMaxDepth = 64;
+
+static u64 FingerprintFromMd5(fz_md5* md5, u64 flags) {
+    u8 digest[16];
+    fz_md5_final(md5, digest);
+    u64 fp;
+    memcpy(&fp, digest, sizeof(fp));
+    // the constant bit keeps fingerprints distinct from 0 and the values above
+    return (fp & ~(u64)7) | kFingerprintOpaque | flags;
+}
+
+static void Md5UpdateObj(fz_context* ctx, pdf_document* doc, fz_md5* md5, pdf_obj* obj, Vec<u64>& memo,
+                         u64* flags, int depth);
+
+static u64 IndirectObjFingerprint(fz_context* ctx, pdf_document* doc, pdf_obj* ref, Vec<u64>& memo, int depth) {
+    int num = pdf_to_num(ctx, ref);
+    if (num <= 0 || num >= memo.isize()) {
+        return kFingerprintOpaque;
+    }
+    if (memo.at(num) != 0) {
+        return memo.at(num);
+    }
+    pdf_obj* obj = pdf_resolve_indirect_chain(ctx, ref);
+    if (pdf_name_eq(ctx, pdf_dict_get(ctx, obj, PDF_NAME(Type)), PDF_NAME(Page))) {
+        return kFingerprintOpaque;
+    }
+
+    memo.at(num) = kFingerprintPending;
+    fz_md5 md5;
+    fz_md5_init(&md5);
+    u64 flags = 0;
+    Md5UpdateObj(ctx, doc, &md5, obj, memo, &flags, depth + 1);
+    if (pdf_is_stream(ctx, ref)) {
+        // hashing the data as stored is enough and cheaper than decoding it
+        fz_buffer* buf = pdf_load_raw_stream_number(ctx, doc, num);
+        fz_md5_update(&md5, buf->data, buf->len);
+        fz_drop_buffer(ctx, buf);
+    }
+    u64 fp = FingerprintFromMd5(&md5, flags);
+    memo.at(num) = fp;
+    return fp;
+}
+
+static void Md5UpdateObj(fz_context* ctx, pdf_document* doc, fz_md5* md5, pdf_obj* obj, Vec<u64>& memo,
+                         u64* flags, int depth) {
+    if (depth > kFingerprintMaxDepth) {
+        fz_throw(ctx, FZ_ERROR_GENERIC, "objects nested too deeply");
+    }
+    if (pdf_is_indirect(ctx, obj) && !pdf_is_dict(ctx, obj) && !pdf_is_array(ctx, obj)) {
+        // hash values (such as a stream's /Length) the same whether they're stored directly or not
+        Md5UpdateObj(ctx, doc, md5, pdf_resolve_indirect_chain(ctx, obj), memo, flags, depth + 1);
+    } else if (pdf_is_indirect(ctx, obj)) {
+        u64 fp = IndirectObjFingerprint(ctx, doc, obj, memo, depth);
+        *flags |= fp & kFingerprintType3;
+        fz_md5_update(md5, (u8*)&fp, sizeof(fp));
+    } else if (pdf_is_dict(ctx, obj)) {
+        fz_md5_update(md5, (u8*)"<<", 2);
+        int n = pdf_dict_len(ctx, obj);
+        for (int i = 0; i < n; i++) {
+            pdf_obj* key = pdf_dict_get_key(ctx, obj, i);
+            pdf_obj* val = pdf_dict_get_val(ctx, obj, i);
+            // the page tree resp. the field hierarchy also covers other pages
+            if (pdf_name_eq(ctx, key, PDF_NAME(Parent))) {
+                continue;
+            }
+            if (pdf_name_eq(ctx, key, PDF_NAME(Subtype)) && pdf_name_eq(ctx, val, PDF_NAME(Type3))) {
+                *flags |= kFingerprintType3;
+            }
+            Md5UpdateObj(ctx, doc, md5, key, memo, flags, depth + 1);
+            Md5UpdateObj(ctx, doc, md5, val, memo, flags, depth + 1);
+        }
+        fz_md5_update(md5, (u8*)">>", 2);
+    } else if (pdf_is_array(ctx, obj)) {
+        fz_md5_update(md5, (u8*)"[", 1);
+        int n = pdf_array_len(ctx, obj);
+        for (int i = 0; i < n; i++) {
+            Md5UpdateObj(ctx, doc, md5, pdf_array_get(ctx, obj, i), memo, flags, depth + 1);
+        }
+        fz_md5_update(md5, (u8*)"]", 1);
+    } else if (pdf_is_name(ctx, obj)) {
+        const char* name = pdf_to_name(ctx, obj);
+        fz_md5_update(md5, (u8*)"/", 1);
+        fz_md5_update(md5, (u8*)name, str::Len(name) + 1);
+    } else if (pdf_is_string(ctx, obj)) {
+        size_t len = 0;
+        const char* s = pdf_to_string(ctx, obj, &len);
+        fz_md5_update(md5, (u8*)"(", 1);
+        fz_md5_update(md5, (u8*)&len, sizeof(len));
+        fz_md5_update(md5, (u8*)s, len);
+    } else if (pdf_is_number(ctx, obj)) {
+        // e.g. 0 and 0.0 are the same
+        double d = pdf_is_int(ctx, obj) ? (double)pdf_to_int64(ctx, obj) : (double)pdf_to_real(ctx, obj);
+        fz_md5_update(md5, (u8*)"#", 1);
+        fz_md5_update(md5, (u8*)&d, sizeof(d));
+    } else if (pdf_is_bool(ctx, obj)) {
+        fz_md5_update(md5, pdf_to_bool(ctx, obj) ? (u8*)"t" : (u8*)"f", 1);
+    } else {
+        fz_md5_update(md5, (u8*)"n", 1);
+    }
+}
+
+// hashes the page object with everything it refers to (except for other pages),
+// objects shared between pages (such as fonts) are only hashed once
+// Note: make sure to only call with ctxAccess
+u64 EnginePdf::GetPageFingerprint(FzPageInfo* pageInfo) {
+    pdf_document* doc = pdf_document_from_fz_document(ctx, _doc);
+    pdf_obj* pageObj = pdf_page_from_fz_page(ctx, pageInfo->page)->obj;
+    int nObjs = pdf_xref_len(ctx, doc);
+    if (objFingerprints.isize() != nObjs) {
+        objFingerprints.Reset();
+        objFingerprints.AppendBlanks(nObjs);
+    }
+
+    u64 fp = 0;
+    fz_var(fp);
+    fz_try(ctx) {
+        fz_md5 md5;
+        fz_md5_init(&md5);
+        u64 flags = 0;
+        Md5UpdateObj(ctx, doc, &md5, pdf_resolve_indirect(ctx, pageObj), objFingerprints, &flags, 0);
+        // inherited attributes are skipped along with /Parent above
+        pdf_obj* inheritable[] = {PDF_NAME(Resources), PDF_NAME(MediaBox), PDF_NAME(CropBox), PDF_NAME(Rotate)};
+        for (pdf_obj* key : inheritable) {
+            pdf_obj* val = pdf_dict_get_inheritable(ctx, pageObj, key);
+            Md5UpdateObj(ctx, doc, &md5, val, objFingerprints, &flags, 0);
+        }
+        // which optional content is visible is decided for the whole document
+        pdf_obj* ocProps = pdf_dict_getp(ctx, pdf_trailer(ctx, doc), "Root/OCProperties");
+        Md5UpdateObj(ctx, doc, &md5, ocProps, objFingerprints, &flags, 0);
+        fp = FingerprintFromMd5(&md5, flags);
+    }
+    fz_catch(ctx) {
+        // some objects might have been left pending
+        objFingerprints.Reset();
+        fz_warn(ctx, "couldn't fingerprint page %d", pageInfo->pageNo);
+        fp = 0;
+    }
+    return fp;
+}
+
+u64 EnginePdf::PageFingerprint(int pageNo, bool load) {
+    FzPageInfo* pageInfo = nullptr;
+    if (load) {
+        pageInfo = GetFzPageInfo(pageNo, true);
+    } else {
+        ScopedCritSec scope(&pagesAccess);
+        pageInfo = &_pages[pageNo - 1];
+        if (!pageInfo->page) {
+            pageInfo = nullptr;
+        }
+    }
+    if (!pageInfo) {
+        return 0;
+    }
+    ScopedCritSec scope(ctxAccess);
+    // the fingerprint doesn't reflect changes made since (e.g. to annotations)
+    pdf_document* doc = pdf_document_from_fz_document(ctx, _doc);
+    if (pdf_has_unsaved_changes(ctx, doc)) {
+        return 0;
+    }
+    return pageInfo->fingerprint;
+}
+
+void EnginePdf::KeepCachedPage(EngineBase* prev, int prevPageNo, int pageNo) {
+    if (prev->kind != kind) {
+        return;
+    }
+    EnginePdf* prevPdf = (EnginePdf*)prev;
+    fz_display_list* list = nullptr;
+    {
+        ScopedCritSec scope(prevPdf->ctxAccess);
+        FzPageInfo* prevInfo = &prevPdf->_pages[prevPageNo - 1];
+        if (!(prevInfo->fingerprint & kFingerprintType3)) {
+            list = fz_keep_display_list(ctx, prevInfo->list);
+        }
+    }
+    if (!list) {
+        return;
+    }
+
+    FzPageInfo* pageInfo = GetFzPageInfo(pageNo, true);
+    ScopedCritSec scope(ctxAccess);
+    if (pageInfo && !pageInfo->list) {
+        // the list already shows the annotations of the page
+        pdf_page* pdfpage = pdf_page_from_fz_page(ctx, pageInfo->page);
+        PageAnnotsChanged(ctx, pdfpage, &pageInfo->listAnnotsCount);
+        CacheDisplayList(pageInfo, list);
+    }
+    fz_drop_display_list(ctx, list);
+}
+
+static bool IsSlowToRender(FzPageInfo* pageInfo) {
+    return pageInfo->renderMs > PROGRESSIVE_RESULT_INTERVAL_MS || pageInfo->listSize > PROGRESSIVE_MIN_LIST_SIZE;
+}
+
+// decoded images are only cached for the area requested or for the whole image,
+// so decode the whole images once instead of (the visible part) for every band
+static void PreloadImage(fz_context* ctx, fz_image* image, fz_matrix ctm) {
+    // scalable images are never cached and decoded ones needn't be
+    if (image->w == 0 || image->h == 0 || image->scalable || image->decoded) {
+        return;
+    }
+    fz_try(ctx) {
+        fz_drop_pixmap(ctx, fz_get_pixmap_from_image(ctx, image, nullptr, &ctm, nullptr, nullptr));
+    }
+    fz_catch(ctx) {
+        // drawing the image will fail as well
+    }
+}
+
+static void PreloadFillImage(fz_context* ctx, fz_device*, fz_image* image, fz_matrix ctm, float, fz_color_params) {
+    PreloadImage(ctx, image, ctm);
+}
+
+static void PreloadFillImageMask(fz_context* ctx, fz_device*, fz_image* image, fz_matrix ctm, fz_colorspace*,
+                                 const float*, float, fz_color_params) {
+    PreloadImage(ctx, image, ctm);
+}
+
+static void PreloadClipImageMask(fz_context* ctx, fz_device*, fz_image* image, fz_matrix ctm, fz_rect) {
+    PreloadImage(ctx, image, ctm);
+}
+
+static void PreloadImages(fz_context* ctx, fz_display_list* list, fz_matrix ctm, fz_rect cliprect, fz_cookie* cookie) {
+    fz_device* dev = fz_new_device_of_size(ctx, sizeof(fz_device));
+    dev->fill_image = PreloadFillImage;
+    dev->fill_image_mask = PreloadFillImageMask;
+    dev->clip_image_mask = PreloadClipImageMask;
+    fz_try(ctx) {
+        fz_run_display_list(ctx, list, dev, ctm, cliprect, cookie);
+        fz_close_device(ctx, dev);
+    }
+    fz_always(ctx) {
+        fz_drop_device(ctx, dev);
+    }
+    fz_catch(ctx) {
+        fz_rethrow(ctx);
+    }
+}
+
+// renders list into pix in horizontal bands from top to bottom and passes the
+// bands rendered so far to progressCb every now and then. Every band gets its
+// own draw device clipped to it, so that no object is drawn twice
+static void RunDisplayListProgressive(fz_context* ctx, fz_display_list* list, fz_pixmap* pix, fz_matrix ctm,
+                                      fz_cookie* cookie, RenderingCallback* progressCb) {
+    fz_irect bbox = fz_pixmap_bbox(ctx, pix);
+    int dy = bbox.y1 - bbox.y0;
+    int nBands = std::clamp(dy / PROGRESSIVE_BAND_MIN_DY, 1, PROGRESSIVE_MAX_BANDS);
+    fz_cookie localCookie = {};
+    if (!cookie) {
+        cookie = &localCookie;
+    }
+    if (nBands > 1) {
+        PreloadImages(ctx, list, ctm, fz_rect_from_irect(bbox), cookie);
+    }
+
+    auto timeStart = TimeGet();
+    double lastResultMs = 0;
+    for (int i = 0; i < nBands && !cookie->abort; i++) {
+        fz_irect band = bbox;
+        band.y0 = bbox.y0 + dy * i / nBands;
+        band.y1 = bbox.y0 + dy * (i + 1) / nBands;
+        fz_device* dev = fz_new_draw_device_with_bbox(ctx, fz_identity, pix, &band);
+        fz_try(ctx) {
+            fz_run_display_list(ctx, list, dev, ctm, fz_rect_from_irect(band), cookie);
+            fz_close_device(ctx, dev);
+        }
+        fz_always(ctx) {
+            fz_drop_device(ctx, dev);
+        }
+        fz_catch(ctx) {
+            fz_rethrow(ctx);
+        }
+
+        double elapsedMs = TimeSinceInMs(timeStart);
+        bool isLast = i == nBands - 1;
+        if (isLast || cookie->abort || elapsedMs - lastResultMs < PROGRESSIVE_RESULT_INTERVAL_MS) {
+            continue;
+        }
+        // the cookie's progress has reached progress_max for all bands run so
+        // far, the rest of the display list is still to be run for every other band
+        float completion = (i + (float)cookie->progress / std::max(cookie->progress_max, (size_t)1)) / nBands;
+        RenderedBitmap* partial = new_rendered_fz_pixmap(ctx, pix);
+        if (partial) {
+            progressCb->Progress(partial, completion);
+        }
+        lastResultMs = elapsedMs;
+    }
+}
+
 RenderedBitmap* EnginePdf::RenderPage(RenderPageArgs& args) {
     auto pageNo = args.pageNo;
 
@@ -1347,8 +2000,6 @@ RenderedBitmap* EnginePdf::RenderPage(RenderPageArgs& args) {
     if (!pageInfo || !pageInfo->page) {
         return nullptr;
     }
-    fz_page* page = pageInfo->page;
-    pdf_page* pdfpage = pdf_page_from_fz_page(ctx, page);
 
     fz_cookie* fzcookie = nullptr;
     FitzAbortCookie* cookie = nullptr;
@@ -1358,23 +2009,45 @@ RenderedBitmap* EnginePdf::RenderPage(RenderPageArgs& args) {
         fzcookie = &cookie->cookie;
     }
 
-    // TODO(port): I don't see why this lock is needed
-    ScopedCritSec cs(ctxAccess);
+    const char* usage = "View";
+    switch (args.target) {
+        case RenderTarget::Print:
+            usage = "Print";
+            break;
+    }
+
+    // only recording the page needs access to the document. Replaying
+    // the display list is done on a cloned context without holding ctxAccess
+    // so that pages (and tiles of the same page) render concurrently
+    fz_display_list* list = nullptr;
+    fz_context* rctx = nullptr;
+    bool progressive = false;
+    {
+        ScopedCritSec cs(ctxAccess);
+        list = GetDisplayList(pageInfo, usage);
+        if (list) {
+            rctx = fz_clone_context(ctx);
+        }
+        // quick pages are rendered in a single pass
+        progressive = args.progressCb && IsSlowToRender(pageInfo);
+    }
+    if (!rctx) {
+        fz_drop_display_list(ctx, list);
+        return nullptr;
+    }
 
     auto pageRect = args.pageRect;
     auto zoom = args.zoom;
     auto rotation = args.rotation;
-    fz_rect pRect;
+    fz_rect pagebounds = fz_bound_display_list(rctx, list);
+    fz_rect pRect = pagebounds;
     if (pageRect) {
         pRect = To_fz_rect(*pageRect);
-    } else {
-        // TODO(port): use pageInfo->mediabox?
-        pRect = fz_bound_page(ctx, page);
     }
-    fz_matrix ctm = viewctm(page, zoom, rotation);
+    fz_matrix ctm = fz_create_view_ctm(pagebounds, zoom, rotation);
     fz_irect bbox = fz_round_rect(fz_transform_rect(pRect, ctm));
 
-    fz_colorspace* colorspace = fz_device_rgb(ctx);
+    fz_colorspace* colorspace = fz_device_rgb(rctx);
     fz_irect ibounds = bbox;
     fz_rect cliprect = fz_rect_from_irect(bbox);
 
@@ -1386,35 +2059,33 @@ RenderedBitmap* EnginePdf::RenderPage(RenderPageArgs& args) {
     fz_var(pix);
     fz_var(bitmap);
 
-    const char* usage = "View";
-    switch (args.target) {
-        case RenderTarget::Print:
-            usage = "Print";
-            break;
-    }
-
-    fz_try(ctx) {
-        pix = fz_new_pixmap_with_bbox(ctx, colorspace, ibounds, nullptr, 1);
+    fz_try(rctx) {
+        pix = fz_new_pixmap_with_bbox(rctx, colorspace, ibounds, nullptr, 1);
         // initialize with white background
-        fz_clear_pixmap_with_value(ctx, pix, 0xff);
-        // TODO: in printing different style. old code use pdf_run_page_with_usage(), with usage ="View"
-        // or "Print". "Export" is not used
-        dev = fz_new_draw_device(ctx, fz_identity, pix);
-        pdf_document* doc = pdf_document_from_fz_document(ctx, _doc);
-        pdf_run_page_with_usage(ctx, doc, pdfpage, dev, ctm, usage, fzcookie);
-        bitmap = new_rendered_fz_pixmap(ctx, pix);
-        fz_close_device(ctx, dev);
-    }
-    fz_always(ctx) {
-        if (dev) {
-            fz_drop_device(ctx, dev);
+        fz_clear_pixmap_with_value(rctx, pix, 0xff);
+        auto timeStart = TimeGet();
+        if (progressive) {
+            RunDisplayListProgressive(rctx, list, pix, ctm, fzcookie, args.progressCb);
+        } else {
+            dev = fz_new_draw_device(rctx, fz_identity, pix);
+            fz_run_display_list(rctx, list, dev, ctm, cliprect, fzcookie);
+            fz_close_device(rctx, dev);
         }
-        fz_drop_pixmap(ctx, pix);
+        if (!fzcookie || !fzcookie->abort) {
+            InterlockedExchange(&pageInfo->renderMs, (LONG)TimeSinceInMs(timeStart));
+        }
+        bitmap = new_rendered_fz_pixmap(rctx, pix);
     }
-    fz_catch(ctx) {
+    fz_always(rctx) {
+        fz_drop_device(rctx, dev);
+        fz_drop_pixmap(rctx, pix);
+        fz_drop_display_list(rctx, list);
+    }
+    fz_catch(rctx) {
         delete bitmap;
-        return nullptr;
+        bitmap = nullptr;
     }
+    fz_drop_context(rctx);
     return bitmap;
 }
 
@@ -1455,10 +2126,6 @@ fz_matrix EnginePdf::viewctm(int pageNo, float zoom, int rotation) {
     return fz_create_view_ctm(tmpRc, zoom, rotation);
 }
 
-fz_matrix EnginePdf::viewctm(fz_page* page, float zoom, int rotation) {
-    return fz_create_view_ctm(fz_bound_page(ctx, page), zoom, rotation);
-}
-
 RenderedBitmap* EnginePdf::GetPageImage(int pageNo, RectF rect, int imageIdx) {
     FzPageInfo* pageInfo = GetFzPageInfo(pageNo, false);
     if (!pageInfo->page) {
@@ -1508,23 +2175,39 @@ PageText EnginePdf::ExtractPageText(int pageNo) {
         return {};
     }
 
-    ScopedCritSec scope(ctxAccess);
+    // like in RenderPage, only getting the display list needs ctxAccess
+    fz_display_list* list = nullptr;
+    fz_context* tctx = nullptr;
+    {
+        ScopedCritSec scope(ctxAccess);
+        list = GetDisplayList(pageInfo, "View");
+        if (list) {
+            tctx = fz_clone_context(ctx);
+        }
+    }
+    if (!tctx) {
+        fz_drop_display_list(ctx, list);
+        return {};
+    }
 
     fz_stext_page* stext = nullptr;
     fz_var(stext);
     fz_stext_options opts{};
-    fz_try(ctx) {
-        stext = fz_new_stext_page_from_page(ctx, pageInfo->page, &opts);
+    fz_try(tctx) {
+        stext = fz_new_stext_page_from_display_list(tctx, list, &opts);
     }
-    fz_catch(ctx) {
+    fz_catch(tctx) {
     }
+    fz_drop_display_list(tctx, list);
     if (!stext) {
+        fz_drop_context(tctx);
         return {};
     }
     PageText res;
     // TODO: convert to return PageText
     WCHAR* text = fz_text_page_to_str(stext, &res.coords);
-    fz_drop_stext_page(ctx, stext);
+    fz_drop_stext_page(tctx, stext);
+    fz_drop_context(tctx);
     res.text = text;
     res.len = (int)str::Len(text);
     return res;
@@ -1957,12 +2640,15 @@ int EnginePdf::GetAnnotations(Vec<Annotation*>* annotsOut) {
     return nAnnots;
 }
 
-EngineBase* EnginePdf::CreateFromFile(const WCHAR* path, PasswordUI* pwdUI) {
+EngineBase* EnginePdf::CreateFromFile(const WCHAR* path, PasswordUI* pwdUI, std::span<u8> layoutCache) {
     if (str::IsEmpty(path)) {
         return nullptr;
     }
     EnginePdf* engine = new EnginePdf();
-    if (!engine->Load(path, pwdUI)) {
+    engine->layoutCache = layoutCache;
+    bool ok = engine->Load(path, pwdUI);
+    engine->layoutCache = {};
+    if (!ok) {
         delete engine;
         return nullptr;
     }
@@ -1982,8 +2668,8 @@ bool IsPdfEngineSupportedFileType(Kind kind) {
     return kind == kindFilePDF;
 }
 
-EngineBase* CreateEnginePdfFromFile(const WCHAR* path, PasswordUI* pwdUI) {
-    return EnginePdf::CreateFromFile(path, pwdUI);
+EngineBase* CreateEnginePdfFromFile(const WCHAR* path, PasswordUI* pwdUI, std::span<u8> layoutCache) {
+    return EnginePdf::CreateFromFile(path, pwdUI, layoutCache);
 }
 
 EngineBase* CreateEnginePdfFromStream(IStream* stream, PasswordUI* pwdUI) {
@@ -2081,6 +2767,11 @@ static bool IsAllowedAnnot(AnnotationType tp, AnnotationType* allowed) {
     return false;
 }
 
+void EnginePdfGetLockWaitStats(i64* nWaits, double* waitMs, i64* nAllocWaits, double* allocWaitMs) {
+    FzGetLockWaitStats(-1, nWaits, waitMs);
+    FzGetLockWaitStats(FZ_LOCK_ALLOC, nAllocWaits, allocWaitMs);
+}
+
 Annotation* EnginePdfGetAnnotationAtPos(EngineBase* engine, int pageNo, PointF pos, AnnotationType* allowedAnnots) {
     if (!engine || engine->kind != kindEnginePdf) {
         return nullptr;
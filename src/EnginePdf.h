@@ -2,7 +2,7 @@
    License: GPLv3 */
 
 bool IsPdfEngineSupportedFileType(Kind);
-EngineBase* CreateEnginePdfFromFile(const WCHAR* path, PasswordUI* pwdUI = nullptr);
+EngineBase* CreateEnginePdfFromFile(const WCHAR* path, PasswordUI* pwdUI = nullptr, std::span<u8> layoutCache = {});
 EngineBase* CreateEnginePdfFromStream(IStream* stream, PasswordUI* pwdUI = nullptr);
 
 std::span<u8> LoadEmbeddedPDFFile(const WCHAR* path);
@@ -11,4 +11,7 @@ Annotation* EnginePdfCreateAnnotation(EngineBase* engine, AnnotationType type, i
 int EnginePdfGetAnnotations(EngineBase*, Vec<Annotation*>*);
 bool EnginePdfHasUnsavedAnnotations(EngineBase* engine);
 bool EnginePdfSaveUpdated(EngineBase* engine, std::string_view path);
+// for profiling contention between threads rendering documents (cf. FzGetLockWaitStats)
+// (all of them and only those for allocations and reference counting)
+void EnginePdfGetLockWaitStats(i64* nWaits, double* waitMs, i64* nAllocWaits, double* allocWaitMs);
 Annotation* EnginePdfGetAnnotationAtPos(EngineBase* engine, int pageNo, PointF pos, AnnotationType* allowedAnnots);
@@ -353,6 +353,7 @@ class EnginePs : public EngineBase {
         }
 
         preferredLayout = pdfEngine->preferredLayout;
+        allowsConcurrentRendering = pdfEngine->allowsConcurrentRendering;
         fileDPI = pdfEngine->GetFileDPI();
         allowsPrinting = pdfEngine->AllowsPrinting();
         allowsCopyingText = pdfEngine->AllowsCopyingText();
@@ -231,10 +231,10 @@ class EngineXps : public EngineBase {
     // protected critical section in order to avoid deadlocks
     CRITICAL_SECTION* ctxAccess;
     CRITICAL_SECTION pagesAccess;
-    CRITICAL_SECTION mutexes[FZ_LOCK_MAX];
+    // what ctxAccess points to
+    CRITICAL_SECTION docAccess;
 
     fz_context* ctx = nullptr;
-    fz_locks_context fz_locks_ctx;
     fz_document* _doc = nullptr;
     fz_stream* _docStream = nullptr;
     Vec<FzPageInfo*> _pages;
@@ -266,16 +266,6 @@ class EngineXps : public EngineBase {
     WCHAR* ExtractFontList();
 };
 
-static void fz_lock_context_cs(void* user, int lock) {
-    EngineXps* e = (EngineXps*)user;
-    EnterCriticalSection(&e->mutexes[lock]);
-}
-
-static void fz_unlock_context_cs(void* user, int lock) {
-    EngineXps* e = (EngineXps*)user;
-    LeaveCriticalSection(&e->mutexes[lock]);
-}
-
 static void fz_print_cb(void* user, const char* msg) {
     log(msg);
 }
@@ -290,16 +280,11 @@ EngineXps::EngineXps() {
     defaultFileExt = L".xps";
     fileDPI = 72.0f;
 
-    for (size_t i = 0; i < dimof(mutexes); i++) {
-        InitializeCriticalSection(&mutexes[i]);
-    }
+    InitializeCriticalSection(&docAccess);
     InitializeCriticalSection(&pagesAccess);
-    ctxAccess = &mutexes[FZ_LOCK_ALLOC];
+    ctxAccess = &docAccess;
 
-    fz_locks_ctx.user = this;
-    fz_locks_ctx.lock = fz_lock_context_cs;
-    fz_locks_ctx.unlock = fz_unlock_context_cs;
-    ctx = fz_new_context(nullptr, &fz_locks_ctx, FZ_STORE_DEFAULT);
+    ctx = NewEngineFzContext(FZ_STORE_DEFAULT);
     installFitzErrorCallbacks(ctx);
 }
 
@@ -329,12 +314,10 @@ EngineXps::~EngineXps() {
     }
 
     fz_drop_document(ctx, _doc);
-    fz_drop_context(ctx);
+    DropEngineFzContext(ctx);
 
-    for (size_t i = 0; i < dimof(mutexes); i++) {
-        LeaveCriticalSection(&mutexes[i]);
-        DeleteCriticalSection(&mutexes[i]);
-    }
+    LeaveCriticalSection(ctxAccess);
+    DeleteCriticalSection(ctxAccess);
     LeaveCriticalSection(&pagesAccess);
     DeleteCriticalSection(&pagesAccess);
 }
@@ -20,9 +20,18 @@
 #include "FileThumbnails.h"
 
 #define THUMBNAILS_DIR_NAME L"sumatrapdfcache"
+// only keep the most recently used search indexes
+#define MAX_SEARCH_INDEXES_CACHED 32
+#define MAX_LAYOUT_CACHES_CACHED 64
+
+#define LAYOUT_CACHE_MAGIC 0x4c435553 // "SUCL"
+#define LAYOUT_CACHE_VERSION 1
+// the document's content is identified by the hash of its start and end
+// (which is where e.g. a PDF's trailer and incremental updates are)
+#define LAYOUT_CACHE_HASHED_SIZE (64 * 1024)
 
 // TODO: create in TEMP directory instead?
-static WCHAR* GetThumbnailPath(const WCHAR* filePath) {
+static WCHAR* GetCachePathForFile(const WCHAR* filePath, const WCHAR* ext) {
     // create a fingerprint of a (normalized) path for the file name
     // I'd have liked to also include the file's last modification time
     // in the fingerprint (much quicker than hashing the entire file's
@@ -48,7 +57,201 @@ static WCHAR* GetThumbnailPath(const WCHAR* filePath) {
     }
     AutoFreeWstr fname(strconv::FromAnsi(fingerPrint));
 
-    return str::Format(L"%s\\%s.png", thumbsPath.Get(), fname.Get());
+    return str::Format(L"%s\\%s.%s", thumbsPath.Get(), fname.Get(), ext);
+}
+
+static WCHAR* GetThumbnailPath(const WCHAR* filePath) {
+    return GetCachePathForFile(filePath, L"png");
+}
+
+static WCHAR* GetSearchIndexPath(const u8 digest[16]) {
+    AutoFreeWstr thumbsPath(AppGenDataFilename(THUMBNAILS_DIR_NAME));
+    if (!thumbsPath) {
+        return nullptr;
+    }
+    AutoFree fingerPrint(str::MemToHex(digest, 16));
+    AutoFreeWstr fname(strconv::FromAnsi(fingerPrint));
+    return str::Format(L"%s\\%s.idx", thumbsPath.Get(), fname.Get());
+}
+
+static int CmpFindDataByTime(const WIN32_FIND_DATA* a, const WIN32_FIND_DATA* b) {
+    // most recently used first
+    return -CompareFileTime(&a->ftLastWriteTime, &b->ftLastWriteTime);
+}
+
+// removes all but the maxCount most recently used files matching pattern
+// (used for search indexes and layout caches)
+static void CleanUpCachedFiles(const WCHAR* thumbsPath, const WCHAR* filePattern, size_t maxCount) {
+    AutoFreeWstr pattern(path::Join(thumbsPath, filePattern));
+
+    Vec<WIN32_FIND_DATA> files;
+    WIN32_FIND_DATA fdata;
+    HANDLE hfind = FindFirstFile(pattern, &fdata);
+    if (INVALID_HANDLE_VALUE == hfind) {
+        return;
+    }
+    do {
+        if (!(fdata.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+            files.Append(fdata);
+        }
+    } while (FindNextFile(hfind, &fdata));
+    FindClose(hfind);
+
+    files.SortTyped(CmpFindDataByTime);
+    for (size_t i = maxCount; i < files.size(); i++) {
+        AutoFreeWstr cachedPath(path::Join(thumbsPath, files.at(i).cFileName));
+        file::Delete(cachedPath);
+    }
+}
+
+static void MarkAsRecentlyUsed(const WCHAR* cachedPath) {
+    // for CleanUpCachedFiles
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    file::SetModificationTime(cachedPath, now);
+}
+
+std::span<u8> LoadSearchIndex(const u8 digest[16]) {
+    AutoFreeWstr idxPath(GetSearchIndexPath(digest));
+    if (!idxPath) {
+        return {};
+    }
+    std::span<u8> data = file::ReadFile(idxPath);
+    if (!data.empty()) {
+        MarkAsRecentlyUsed(idxPath);
+    }
+    return data;
+}
+
+void SaveSearchIndex(const u8 digest[16], std::span<u8> data) {
+    AutoFreeWstr idxPath(GetSearchIndexPath(digest));
+    if (!idxPath) {
+        return;
+    }
+    AutoFreeWstr thumbsPath(path::GetDir(idxPath));
+    if (dir::Create(thumbsPath)) {
+        file::WriteFile(idxPath, data);
+    }
+}
+
+// fills in everything but dataSize for the file's current state
+static bool InitLayoutCacheHeader(const WCHAR* filePath, LayoutCacheHeader& hdr) {
+    ZeroMemory(&hdr, sizeof(hdr));
+    hdr.magic = LAYOUT_CACHE_MAGIC;
+    hdr.version = LAYOUT_CACHE_VERSION;
+
+    AutoCloseHandle h(file::OpenReadOnly(filePath));
+    LARGE_INTEGER size;
+    if (!h.IsValid() || !GetFileSizeEx(h, &size) || !GetFileTime(h, nullptr, nullptr, &hdr.fileTime)) {
+        return false;
+    }
+    hdr.fileSize = (u64)size.QuadPart;
+
+    u64 toRead = std::min(hdr.fileSize, (u64)LAYOUT_CACHE_HASHED_SIZE * 2);
+    AutoFree buf(AllocArray<char>((size_t)toRead));
+    DWORD headLen = (DWORD)std::min(toRead, (u64)LAYOUT_CACHE_HASHED_SIZE);
+    DWORD tailLen = (DWORD)(toRead - headLen);
+    DWORD read = 0;
+    if (!buf || !ReadFile(h, buf.Get(), headLen, &read, nullptr) || read != headLen) {
+        return false;
+    }
+    if (tailLen > 0) {
+        LARGE_INTEGER off;
+        off.QuadPart = (i64)(hdr.fileSize - tailLen);
+        if (!SetFilePointerEx(h, off, nullptr, FILE_BEGIN) ||
+            !ReadFile(h, buf.Get() + headLen, tailLen, &read, nullptr) || read != tailLen) {
+            return false;
+        }
+    }
+    CalcMD5Digest((u8*)buf.Get(), (size_t)toRead, hdr.contentDigest);
+    return true;
+}
+
+bool CalcSearchIndexDigest(const WCHAR* filePath, u8 digest[16]) {
+    LayoutCacheHeader hdr;
+    if (!InitLayoutCacheHeader(filePath, hdr)) {
+        return false;
+    }
+    // a new layout cache version doesn't invalidate search indexes
+    hdr.magic = 0;
+    hdr.version = 0;
+    CalcMD5Digest((u8*)&hdr, sizeof(hdr), digest);
+    return true;
+}
+
+LayoutCacheFile::LayoutCacheFile(const WCHAR* filePath) {
+    cachePath = GetCachePathForFile(filePath, L"lay");
+    hasHeader = cachePath && InitLayoutCacheHeader(filePath, header);
+    if (!hasHeader) {
+        return;
+    }
+
+    hFile = file::OpenReadOnly(cachePath);
+    LARGE_INTEGER size;
+    if (hFile == INVALID_HANDLE_VALUE || !GetFileSizeEx(hFile, &size) ||
+        size.QuadPart < (i64)sizeof(LayoutCacheHeader)) {
+        return;
+    }
+    hMap = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!hMap) {
+        return;
+    }
+    view = (u8*)MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        return;
+    }
+
+    LayoutCacheHeader hdr;
+    memcpy(&hdr, view, sizeof(hdr));
+    u32 dataSize = hdr.dataSize;
+    hdr.dataSize = 0;
+    // the cache is outdated if the document has changed in any way
+    if (memcmp(&hdr, &header, sizeof(hdr)) != 0 || (u64)dataSize > (u64)size.QuadPart - sizeof(hdr)) {
+        return;
+    }
+    data = {view + sizeof(hdr), dataSize};
+    isUpToDate = true;
+}
+
+LayoutCacheFile::~LayoutCacheFile() {
+    Close();
+    str::Free(cachePath);
+}
+
+void LayoutCacheFile::Close() {
+    data = {};
+    if (view) {
+        UnmapViewOfFile(view);
+        view = nullptr;
+    }
+    if (hMap) {
+        CloseHandle(hMap);
+        hMap = nullptr;
+    }
+    if (hFile != INVALID_HANDLE_VALUE) {
+        CloseHandle(hFile);
+        hFile = INVALID_HANDLE_VALUE;
+        if (isUpToDate) {
+            MarkAsRecentlyUsed(cachePath);
+        }
+    }
+}
+
+void LayoutCacheFile::Save(std::span<u8> newData) {
+    Close();
+    if (!hasHeader || isUpToDate || newData.empty()) {
+        return;
+    }
+    AutoFreeWstr thumbsPath(path::GetDir(cachePath));
+    if (!dir::Create(thumbsPath)) {
+        return;
+    }
+    LayoutCacheHeader hdr = header;
+    hdr.dataSize = (u32)newData.size();
+    str::Str content(sizeof(hdr) + newData.size());
+    content.Append((const char*)&hdr, sizeof(hdr));
+    content.Append((const char*)newData.data(), newData.size());
+    isUpToDate = file::WriteFile(cachePath, content.AsSpan());
 }
 
 // removes thumbnails that don't belong to any frequently used item in file history
@@ -57,6 +260,9 @@ void CleanUpThumbnailCache(const FileHistory& fileHistory) {
     if (!thumbsPath) {
         return;
     }
+    CleanUpCachedFiles(thumbsPath, L"*.idx", MAX_SEARCH_INDEXES_CACHED);
+    CleanUpCachedFiles(thumbsPath, L"*.lay", MAX_LAYOUT_CACHES_CACHED);
+
     AutoFreeWstr pattern(path::Join(thumbsPath, L"*.png"));
 
     WStrVec files;
@@ -13,3 +13,46 @@ bool HasThumbnail(DisplayState& ds);
 void SetThumbnail(DisplayState* ds, RenderedBitmap* bmp);
 void SaveThumbnail(DisplayState& ds);
 void RemoveThumbnail(DisplayState& ds);
+
+// search indexes are cached by the same key as layout caches (the document's size,
+// modification time and the hash of its start and end), cf. CalcSearchIndexDigest
+bool CalcSearchIndexDigest(const WCHAR* filePath, u8 digest[16]);
+std::span<u8> LoadSearchIndex(const u8 digest[16]);
+void SaveSearchIndex(const u8 digest[16], std::span<u8> data);
+
+struct LayoutCacheHeader {
+    u32 magic;
+    u32 version;
+    u64 fileSize;
+    FILETIME fileTime;
+    u8 contentDigest[16];
+    u32 dataSize;
+    u32 reserved;
+};
+
+// layout caches (cf. EngineBase::GetLayoutCache) are stored by the document's path
+// and are only used as long as the document's size, modification time and the
+// hash of its start and end haven't changed
+class LayoutCacheFile {
+    WCHAR* cachePath = nullptr;
+    // the document's state when this was created
+    LayoutCacheHeader header{};
+    bool hasHeader = false;
+    bool isUpToDate = false;
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+    HANDLE hMap = nullptr;
+    u8* view = nullptr;
+
+  public:
+    // the memory-mapped cached data (empty if there's none or it's outdated)
+    std::span<u8> data;
+
+    explicit LayoutCacheFile(const WCHAR* filePath);
+    ~LayoutCacheFile();
+
+    // unmaps data (once the engine has been loaded)
+    void Close();
+    // saves newData for the document's state at the time it was loaded (unless
+    // it was up-to-date), so that data for a modified document is never saved
+    void Save(std::span<u8> newData);
+};
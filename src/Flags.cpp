@@ -60,6 +60,7 @@ static const char* argNames =
     "manga-mode\0"
     "autoupdate\0"
     "extract-text\0"
+    "bench-layout\0"
     "install\0"
     "uninstall\0"
     "regress\0"
@@ -125,6 +126,7 @@ enum {
     MangaMode,
     AutoUpdate,
     ExtractText,
+    ArgBenchLayout, // BenchLayout conflicts with BenchLayout() in StressTesting.h
     Install,
     Uninstall,
     Regress,
@@ -436,6 +438,9 @@ void ParseCommandLine(const WCHAR* cmdLine, Flags& i) {
         } else if (is_arg_with_param(ExtractText)) {
             handle_int_param(i.pageNumber);
             i.testExtractPage = true;
+        } else if (is_arg_with_param(ArgBenchLayout)) {
+            handle_int_param(i.benchLayoutPages);
+            i.exitImmediately = true;
         } else if (Install == arg) {
             i.install = true;
         } else if (Uninstall == arg) {
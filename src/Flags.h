@@ -58,6 +58,8 @@ struct Flags {
     bool testRenderPage = false;
     bool testExtractPage = false;
     int testPageNo = 0;
+    // number of pages of the synthetic document to benchmark layout and scrolling with
+    int benchLayoutPages = 0;
     bool testApp = false;
 
     bool crashOnOpen = false;
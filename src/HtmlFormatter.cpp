@@ -96,6 +96,15 @@ DrawInstr DrawInstr::Image(char* data, size_t len, RectF bbox) {
     return di;
 }
 
+DrawInstr DrawInstr::ImageRef(ImageDataLoader* loader, size_t id, RectF bbox) {
+    DrawInstr di(DrawInstrType::Image);
+    di.isImageRef = true;
+    di.imgRef.loader = loader;
+    di.imgRef.id = id;
+    di.bbox = bbox;
+    return di;
+}
+
 DrawInstr DrawInstr::LinkStart(const char* s, size_t len) {
     DrawInstr di(DrawInstrType::LinkStart);
     di.str.s = s;
@@ -164,7 +173,7 @@ HtmlFormatter::HtmlFormatter(HtmlFormatterArgs* args)
     currReparseIdx = args->reparseIdx;
     htmlParser = new HtmlPullParser((const char*)args->htmlStr.data(), args->htmlStr.size());
     htmlParser->SetCurrPosOff(currReparseIdx);
-    CrashIf(!ValidReparseIdx(currReparseIdx, htmlParser));
+    CrashIf(!ValidReparseIdx(currReparseIdx - htmlOffset, htmlParser));
 
     gfx = mui::AllocGraphicsForMeasureText();
     textMeasure = CreateTextRender(args->textRenderMethod, gfx, 10, 10);
@@ -199,11 +208,17 @@ HtmlFormatter::~HtmlFormatter() {
     delete htmlParser;
 }
 
+void HtmlFormatter::SetHtml(std::span<u8> html, ptrdiff_t offset) {
+    delete htmlParser;
+    htmlParser = new HtmlPullParser(html);
+    htmlOffset = offset;
+}
+
 void HtmlFormatter::AppendInstr(DrawInstr di) {
     currLineInstr.Append(di);
     if (-1 == currLineReparseIdx) {
         currLineReparseIdx = currReparseIdx;
-        CrashIf(!ValidReparseIdx(currReparseIdx, htmlParser));
+        CrashIf(!ValidReparseIdx(currReparseIdx - htmlOffset, htmlParser));
     }
 }
 
@@ -593,7 +608,7 @@ static bool HasPreviousLineSingleImage(Vec<DrawInstr>& instrs) {
     return imageY != -1;
 }
 
-bool HtmlFormatter::EmitImage(ImageData* img) {
+bool HtmlFormatter::EmitImage(ImageData* img, ImageDataLoader* loader, size_t imageId) {
     CrashIf(!img->data);
     Size imgSize = BitmapSizeFromData(img->AsSpan());
     if (imgSize.IsEmpty()) {
@@ -628,7 +643,11 @@ bool HtmlFormatter::EmitImage(ImageData* img) {
     }
 
     RectF bbox(PointF(currX, 0), newSize);
-    AppendInstr(DrawInstr::Image(img->data, img->len, bbox));
+    if (loader) {
+        AppendInstr(DrawInstr::ImageRef(loader, imageId, bbox));
+    } else {
+        AppendInstr(DrawInstr::Image(img->data, img->len, bbox));
+    }
     currX += bbox.dx;
 
     return true;
@@ -708,8 +727,8 @@ static bool CanBreakWordOnChar(WCHAR c) {
 
 // a text run is a string of consecutive text with uniform style
 void HtmlFormatter::EmitTextRun(const char* s, const char* end) {
-    currReparseIdx = s - htmlParser->Start();
-    CrashIf(!ValidReparseIdx(currReparseIdx, htmlParser));
+    currReparseIdx = htmlOffset + (s - htmlParser->Start());
+    CrashIf(!ValidReparseIdx(currReparseIdx - htmlOffset, htmlParser));
     CrashIf(IsSpaceOnly(s, end) && !preFormatted);
     const char* tmp = ResolveHtmlEntities(s, end, textAllocator);
     bool resolved = tmp != s;
@@ -721,7 +740,7 @@ void HtmlFormatter::EmitTextRun(const char* s, const char* end) {
     while (s < end) {
         // don't update the reparseIdx if s doesn't point into the original source
         if (!resolved) {
-            currReparseIdx = s - htmlParser->Start();
+            currReparseIdx = htmlOffset + (s - htmlParser->Start());
         }
 
         size_t strLen = strconv::Utf8ToWcharBuf(s, end - s, buf, dimof(buf));
@@ -1264,7 +1283,7 @@ void HtmlFormatter::HandleText(const char* s, size_t sLen) {
         // don't collapse whitespace and respect text newlines
         while (curr < end) {
             const char* text = curr;
-            currReparseIdx = curr - htmlParser->Start();
+            currReparseIdx = htmlOffset + (curr - htmlParser->Start());
             // skip to the next newline
             for (; curr < end && *curr != '\n'; curr++) {
                 ;
@@ -1285,14 +1304,14 @@ void HtmlFormatter::HandleText(const char* s, size_t sLen) {
     // whitespace or all non-whitespace
     while (curr < end) {
         // collapse multiple, consecutive white-spaces into a single space
-        currReparseIdx = curr - htmlParser->Start();
+        currReparseIdx = htmlOffset + (curr - htmlParser->Start());
         bool skipped = SkipWs(curr, end);
         if (skipped) {
             EmitElasticSpace();
         }
 
         const char* text = curr;
-        currReparseIdx = curr - htmlParser->Start();
+        currReparseIdx = htmlOffset + (curr - htmlParser->Start());
         skipped = SkipNonWs(curr, end);
         if (skipped) {
             EmitTextRun(text, curr);
@@ -1359,12 +1378,15 @@ HtmlPage* HtmlFormatter::Next(bool skipEmptyPages) {
             return nullptr;
         }
         HtmlToken* t = htmlParser->Next();
+        if (!t && LoadNextHtml()) {
+            continue;
+        }
         if (!t || t->IsError()) {
             break;
         }
 
-        currReparseIdx = t->GetReparsePoint() - htmlParser->Start();
-        CrashIf(!ValidReparseIdx(currReparseIdx, htmlParser));
+        currReparseIdx = htmlOffset + (t->GetReparsePoint() - htmlParser->Start());
+        CrashIf(!ValidReparseIdx(currReparseIdx - htmlOffset, htmlParser));
         if (t->IsTag()) {
             HandleHtmlTag(t);
         } else if (!IgnoreText()) {
@@ -1392,6 +1414,15 @@ Vec<HtmlPage*>* HtmlFormatter::FormatAllPages(bool skipEmptyPages) {
     return pages;
 }
 
+std::span<u8> GetInstrImageData(const DrawInstr& i, AutoFree& loaded) {
+    CrashIf(i.type != DrawInstrType::Image);
+    if (!i.isImageRef) {
+        return i.img.AsSpan();
+    }
+    loaded.Set(i.imgRef.loader->LoadImageData(i.imgRef.id));
+    return loaded.AsSpan();
+}
+
 // TODO: draw link in the appropriate format (blue text, underlined, should show hand cursor when
 // mouse is over a link. There's a slight complication here: we only get explicit information about
 // strings, not about the whitespace and we should underline the whitespace as well. Also the text
@@ -1451,7 +1482,8 @@ void DrawHtmlPage(Graphics* g, mui::ITextRender* textDraw, Vec<DrawInstr>* drawI
             CrashIf(status != Ok);
         } else if (DrawInstrType::Image == i.type) {
             // TODO: cache the bitmap somewhere (?)
-            Bitmap* bmp = BitmapFromData(i.img.AsSpan());
+            AutoFree loaded;
+            Bitmap* bmp = BitmapFromData(GetInstrImageData(i, loaded));
             if (bmp) {
                 status = g->DrawImage(bmp, ToGdipRectF(bbox), 0, 0, (float)bmp->GetWidth(), (float)bmp->GetHeight(),
                                       UnitPixel);
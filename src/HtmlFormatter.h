@@ -76,6 +76,8 @@ enum class DrawInstrType {
 
 struct DrawInstr {
     DrawInstrType type{DrawInstrType::Unknown};
+    // InstrImage: the image is referenced through imgRef instead of img
+    bool isImageRef{false};
     union {
         // info specific to a given instruction
         // InstrString, InstrLinkStart, InstrAnchor, InstrRtlString
@@ -85,6 +87,10 @@ struct DrawInstr {
         } str{nullptr, 0};
         mui::CachedFont* font; // InstrSetFont
         ImageData img;         // InstrImage
+        struct {
+            ImageDataLoader* loader;
+            size_t id;
+        } imgRef; // InstrImage (if isImageRef)
     };
     RectF bbox{}; // common to most instructions
 
@@ -97,6 +103,7 @@ struct DrawInstr {
     // helper constructors for instructions that need additional arguments
     static DrawInstr Str(const char* s, size_t len, RectF bbox, bool rtl = false);
     static DrawInstr Image(char* data, size_t len, RectF bbox);
+    static DrawInstr ImageRef(ImageDataLoader* loader, size_t id, RectF bbox);
     static DrawInstr SetFont(mui::CachedFont* font);
     static DrawInstr FixedSpace(float dx);
     static DrawInstr LinkStart(const char* s, size_t len);
@@ -205,6 +212,12 @@ class HtmlFormatter {
     }
     virtual void HandleTagLink([[maybe_unused]] HtmlToken* t) {
     }
+    // for html split into several documents: switches to the next one
+    // (with SetHtml) once the current one has been parsed
+    virtual bool LoadNextHtml() {
+        return false;
+    }
+    void SetHtml(std::span<u8> html, ptrdiff_t offset);
 
     float CurrLineDx();
     float CurrLineDy();
@@ -215,7 +228,9 @@ class HtmlFormatter {
     bool FlushCurrLine(bool isParagraphBreak);
     void UpdateLinkBboxes(HtmlPage* page);
 
-    bool EmitImage(ImageData* img);
+    // if loader is set, img is only used for the image's size (so that
+    // its header suffices) and the image is loaded again for drawing
+    bool EmitImage(ImageData* img, ImageDataLoader* loader = nullptr, size_t imageId = 0);
     void EmitHr();
     void EmitTextRun(const char* s, const char* end);
     void EmitElasticSpace();
@@ -293,6 +308,8 @@ class HtmlFormatter {
     ptrdiff_t currReparseIdx{0};
 
     HtmlPullParser* htmlParser{nullptr};
+    // offset of htmlParser's html within the whole html (cf. LoadNextHtml)
+    ptrdiff_t htmlOffset{0};
 
     // list of pages that we've created but haven't yet sent to client
     Vec<HtmlPage*> pagesToSend;
@@ -316,6 +333,8 @@ class HtmlFormatter {
 
 void DrawHtmlPage(Graphics* g, mui::ITextRender* textDraw, Vec<DrawInstr>* drawInstructions, float offX, float offY,
                   bool showBbox, Color textColor, bool* abortCookie = nullptr);
+// images loaded on demand are owned by loaded
+std::span<u8> GetInstrImageData(const DrawInstr& i, AutoFree& loaded);
 
 mui::TextRenderMethod GetTextRenderMethod();
 void SetTextRenderMethod(mui::TextRenderMethod method);
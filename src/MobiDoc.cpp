@@ -815,7 +815,8 @@ static size_t GetRealRecordSize(const u8* recData, size_t recLen, size_t trailer
 
 // Load a given record of a document into strOut, uncompressing if necessary.
 // Returns false if error.
-bool MobiDoc::LoadDocRecordIntoBuffer(size_t recNo, str::Str& strOut) {
+// Note: can be called from several threads at once as long as each uses its own dec
+bool MobiDoc::LoadDocRecordIntoBuffer(size_t recNo, str::Str& strOut, HuffDicDecompressor* dec) const {
     std::span<u8> rec = pdbReader->GetRecord(recNo);
     u8* recData = rec.data();
     if (nullptr == recData) {
@@ -837,8 +838,8 @@ bool MobiDoc::LoadDocRecordIntoBuffer(size_t recNo, str::Str& strOut) {
         }
         return ok;
     }
-    if (COMPRESSION_HUFF == compressionType && huffDic) {
-        bool ok = huffDic->Decompress((u8*)recData, recSize, strOut);
+    if (COMPRESSION_HUFF == compressionType && dec) {
+        bool ok = dec->Decompress((u8*)recData, recSize, strOut);
         if (!ok) {
             logf("HuffDic decompression failed\n");
         }
@@ -856,6 +857,52 @@ bool MobiDoc::LoadDocRecordIntoBuffer(size_t recNo, str::Str& strOut) {
     return false;
 }
 
+// decoding a record only takes a few microseconds, so it's only worth
+// starting another thread if it has enough records to decode
+#define MIN_DOC_RECORDS_PER_THREAD 64
+#define MAX_DOC_DECODING_THREADS 8
+
+// records are compressed independently of each other, so they're decoded
+// in parallel into separate buffers which are then concatenated in order
+struct DocRecordsDecoder {
+    const MobiDoc* mobiDoc = nullptr;
+    HuffDicDecompressor* huffDic = nullptr;
+    size_t recCount = 0;
+    // recs[i] contains the data for record i + 1 once done[i] is set
+    str::Str* recs = nullptr;
+    LONG* done = nullptr;
+    LONG nextRec = 0;
+    LONG nFailed = 0;
+
+    // returns false if there are no more records left to decode
+    bool DecodeNext(HuffDicDecompressor* dec) {
+        LONG i = InterlockedIncrement(&nextRec) - 1;
+        if ((size_t)i >= recCount) {
+            return false;
+        }
+        if (!mobiDoc->LoadDocRecordIntoBuffer((size_t)i + 1, recs[i], dec)) {
+            InterlockedIncrement(&nFailed);
+        }
+        InterlockedExchange(&done[i], 1);
+        return true;
+    }
+
+    // each thread needs its own decompressor state (huffDic itself is never modified)
+    HuffDicDecompressor* NewDecompressor() const {
+        return huffDic ? new HuffDicDecompressor(*huffDic) : nullptr;
+    }
+
+    static DWORD WINAPI ThreadProc(LPVOID data) {
+        DocRecordsDecoder* decoder = (DocRecordsDecoder*)data;
+        HuffDicDecompressor* dec = decoder->NewDecompressor();
+        while (decoder->DecodeNext(dec)) {
+            // keep going
+        }
+        delete dec;
+        return 0;
+    }
+};
+
 bool MobiDoc::LoadDocument(PdbReader* pdbReader) {
     logToDebugger = true;
     this->pdbReader = pdbReader;
@@ -865,12 +912,54 @@ bool MobiDoc::LoadDocument(PdbReader* pdbReader) {
 
     CrashIf(doc != nullptr);
     doc = new str::Str(docUncompressedSize);
-    size_t nFailed = 0;
-    for (size_t i = 1; i <= docRecCount; i++) {
-        if (!LoadDocRecordIntoBuffer(i, *doc)) {
-            nFailed++;
+
+    DocRecordsDecoder decoder;
+    decoder.mobiDoc = this;
+    decoder.huffDic = huffDic;
+    decoder.recCount = docRecCount;
+    decoder.recs = new str::Str[docRecCount];
+    decoder.done = AllocArray<LONG>(docRecCount);
+
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    int nThreads = std::min((int)si.dwNumberOfProcessors, MAX_DOC_DECODING_THREADS);
+    nThreads = std::min(nThreads, (int)(docRecCount / MIN_DOC_RECORDS_PER_THREAD));
+    Vec<HANDLE> threads;
+    // this thread decodes as well
+    for (int i = 1; i < nThreads; i++) {
+        HANDLE h = CreateThread(nullptr, 0, DocRecordsDecoder::ThreadProc, &decoder, 0, 0);
+        if (h) {
+            threads.Append(h);
+        }
+    }
+
+    // append records as soon as all the previous ones have been decoded
+    // (instead of waiting for all of them)
+    size_t nAppended = 0;
+    auto appendDone = [&]() {
+        while (nAppended < docRecCount && InterlockedAdd(&decoder.done[nAppended], 0)) {
+            str::Str& rec = decoder.recs[nAppended];
+            doc->Append(rec.Get(), rec.size());
+            rec.Reset();
+            nAppended++;
+        }
+    };
+    HuffDicDecompressor* dec = decoder.NewDecompressor();
+    while (decoder.DecodeNext(dec)) {
+        appendDone();
+    }
+    delete dec;
+    if (threads.size() > 0) {
+        WaitForMultipleObjects((DWORD)threads.size(), threads.LendData(), TRUE, INFINITE);
+        for (HANDLE h : threads) {
+            CloseHandle(h);
         }
     }
+    appendDone();
+    CrashIf(nAppended != docRecCount);
+    size_t nFailed = (size_t)decoder.nFailed;
+    delete[] decoder.recs;
+    free(decoder.done);
 
     // TODO: this is a heuristic for https://github.com/sumatrapdfreader/sumatrapdf/issues/1314
     // It has 29 records that fail to decompress because infinite recursion
@@ -5,6 +5,9 @@ class HuffDicDecompressor;
 class PdbReader;
 
 class MobiDoc {
+    // decodes the text records on multiple threads (cf. LoadDocument)
+    friend struct DocRecordsDecoder;
+
     WCHAR* fileName = nullptr;
 
     PdbReader* pdbReader = nullptr;
@@ -34,7 +37,7 @@ class MobiDoc {
     explicit MobiDoc(const WCHAR* filePath);
 
     bool ParseHeader();
-    bool LoadDocRecordIntoBuffer(size_t recNo, str::Str& strOut);
+    bool LoadDocRecordIntoBuffer(size_t recNo, str::Str& strOut, HuffDicDecompressor* dec) const;
     void LoadImages();
     bool LoadImage(size_t imageNo);
     bool LoadDocument(PdbReader* pdbReader);
@@ -16,6 +16,7 @@ extern "C" {
 #include "Annotation.h"
 #include "EngineBase.h"
 #include "EngineFzUtil.h"
+#include "BatchRender.h"
 #include "PdfCreator.h"
 
 // using namespace Gdiplus;
@@ -382,14 +383,19 @@ bool PdfCreator::SaveToFile(const char* filePath) {
     return true;
 }
 
-bool PdfCreator::RenderToFile(const char* pdfFileName, EngineBase* engine, int dpi) {
+bool PdfCreator::RenderToFile(const char* pdfFileName, EngineBase* engine, int dpi, int nThreads) {
     PdfCreator* c = new PdfCreator();
     bool ok = true;
-    // render all pages to images
+    // render all pages to images (the following pages are rendered
+    // while the previous ones are added to the PDF document)
     float zoom = dpi / engine->GetFileDPI();
+    BatchRenderer renderer(engine, nThreads);
+    for (int i = 1; i <= engine->PageCount(); i++) {
+        renderer.Add(RenderPageArgs(i, zoom, 0, nullptr, RenderTarget::Export));
+    }
+    renderer.Start();
     for (int i = 1; ok && i <= engine->PageCount(); i++) {
-        RenderPageArgs args(i, zoom, 0, nullptr, RenderTarget::Export);
-        RenderedBitmap* bmp = engine->RenderPage(args);
+        RenderedBitmap* bmp = renderer.Next();
         ok = false;
         if (bmp) {
             ok = AddPageFromHBITMAP(c, bmp->GetBitmap(), bmp->Size(), dpi);
@@ -26,5 +26,6 @@ class PdfCreator {
     static void SetProducerName(const WCHAR* name);
 
     // creates a simple PDF with all pages rendered as a single image
-    static bool RenderToFile(const char* pdfFileName, EngineBase* engine, int dpi = 150);
+    // (rendered on nThreads threads, cf. BatchRenderer)
+    static bool RenderToFile(const char* pdfFileName, EngineBase* engine, int dpi = 150, int nThreads = 0);
 };
@@ -13,6 +13,7 @@
 #include "Annotation.h"
 #include "EngineBase.h"
 #include "EngineCreate.h"
+#include "BatchRender.h"
 
 #include "DisplayMode.h"
 #include "SettingsStructs.h"
@@ -75,6 +76,8 @@ class AbortCookieManager {
 
   public:
     AbortCookie* cookie = nullptr;
+    // the renderer for the pages being printed (if any)
+    BatchRenderer* renderer = nullptr;
 
     AbortCookieManager() {
         InitializeCriticalSection(&cookieAccess);
@@ -89,9 +92,17 @@ class AbortCookieManager {
         if (cookie) {
             cookie->Abort();
         }
+        if (renderer) {
+            renderer->Abort();
+        }
         Clear();
     }
 
+    void SetRenderer(BatchRenderer* newRenderer) {
+        ScopedCritSec scope(&cookieAccess);
+        renderer = newRenderer;
+    }
+
     void Clear() {
         ScopedCritSec scope(&cookieAccess);
         if (cookie) {
@@ -101,6 +112,59 @@ class AbortCookieManager {
     }
 };
 
+// makes AbortCookieManager::Abort also abort a BatchRenderer while it's in use
+class ScopedAbortRenderer {
+    AbortCookieManager* abortCookie;
+
+  public:
+    ScopedAbortRenderer(AbortCookieManager* abortCookie, BatchRenderer* renderer) : abortCookie(abortCookie) {
+        if (abortCookie) {
+            abortCookie->SetRenderer(renderer);
+        }
+    }
+    ~ScopedAbortRenderer() {
+        if (abortCookie) {
+            abortCookie->SetRenderer(nullptr);
+        }
+    }
+};
+
+// a page (or a selection on a page) and where to print it
+struct PrintPagePart {
+    RenderPageArgs args;
+    Point offset;
+};
+
+// prints a rendered part (rendering it again at lower resolutions
+// if that fails, e.g. because the bitmap is too large for the printer)
+static bool PrintPart(HDC hdc, BatchRenderer& renderer, const PrintPagePart& part, ProgressUpdateUI* progressUI,
+                      AbortCookieManager* abortCookie) {
+    RenderedBitmap* bmp = renderer.Next();
+    bool ok = false;
+    short shrink = 1;
+    for (;;) {
+        if (bmp && bmp->GetBitmap()) {
+            auto size = bmp->Size();
+            Rect rc(part.offset.x, part.offset.y, size.dx * shrink, size.dy * shrink);
+            ok = bmp->StretchDIBits(hdc, rc);
+        }
+        delete bmp;
+        shrink *= 2;
+        if (ok || shrink >= 32 || (progressUI && progressUI->WasCanceled())) {
+            return ok;
+        }
+        RenderPageArgs args = part.args;
+        args.zoom /= shrink;
+        if (abortCookie) {
+            args.cookie_out = &abortCookie->cookie;
+        }
+        bmp = renderer.RenderNow(args);
+        if (abortCookie) {
+            abortCookie->Clear();
+        }
+    }
+}
+
 static RectF BoundSelectionOnPage(const Vec<SelectionOnPage>& sel, int pageNo) {
     RectF bounds;
     for (size_t i = 0; i < sel.size(); i++) {
@@ -191,6 +255,13 @@ static bool PrintToDevice(const PrintData& pd, ProgressUpdateUI* progressUI = nu
         bPrintPortrait = false;
     }
 
+    BatchRenderer renderer(&engine);
+    ScopedAbortRenderer abortRenderer(abortCookie, &renderer);
+
+    // determine where every page goes first, so that the following pages
+    // can be rendered while the previous ones are being spooled
+    Vec<PrintPagePart> parts;
+
     if (pd.sel.size() > 0) {
         for (int pageNo = 1; pageNo <= engine.PageCount(); pageNo++) {
             RectF bounds = BoundSelectionOnPage(pd.sel, pageNo);
@@ -198,12 +269,6 @@ static bool PrintToDevice(const PrintData& pd, ProgressUpdateUI* progressUI = nu
                 continue;
             }
 
-            if (progressUI) {
-                progressUI->UpdateProgress(current, total);
-            }
-
-            StartPage(hdc);
-
             SizeF bSize = bounds.Size();
             float zoom = std::min((float)printable.dx / bSize.dx, (float)printable.dy / bSize.dy);
             // use the correct zoom values, if the page fits otherwise
@@ -227,25 +292,27 @@ static bool PrintToDevice(const PrintData& pd, ProgressUpdateUI* progressUI = nu
                     offset.y += (int)(printable.dy - bSize.dy * zoom) / 2;
                 }
 
-                bool ok = false;
-                short shrink = 1;
-                do {
-                    RenderPageArgs args(pd.sel.at(i).pageNo, zoom / shrink, pd.rotation, clipRegion,
-                                        RenderTarget::Print);
-                    if (abortCookie) {
-                        args.cookie_out = &abortCookie->cookie;
-                    }
-                    RenderedBitmap* bmp = engine.RenderPage(args);
-                    if (abortCookie) {
-                        abortCookie->Clear();
-                    }
-                    if (bmp && bmp->GetBitmap()) {
-                        Rect rc(offset.x, offset.y, bmp->Size().dx * shrink, bmp->Size().dy * shrink);
-                        ok = bmp->StretchDIBits(hdc, rc);
-                    }
-                    delete bmp;
-                    shrink *= 2;
-                } while (!ok && shrink < 32 && !(progressUI && progressUI->WasCanceled()));
+                RenderPageArgs args(pd.sel.at(i).pageNo, zoom, pd.rotation, clipRegion, RenderTarget::Print);
+                parts.Append({args, offset});
+            }
+        }
+
+        for (PrintPagePart& part : parts) {
+            renderer.Add(part.args);
+        }
+        renderer.Start();
+
+        // all parts of a page are printed on the same sheet
+        for (size_t i = 0; i < parts.size();) {
+            if (progressUI) {
+                progressUI->UpdateProgress(current, total);
+            }
+
+            StartPage(hdc);
+
+            int pageNo = parts.at(i).args.pageNo;
+            for (; i < parts.size() && parts.at(i).args.pageNo == pageNo; i++) {
+                PrintPart(hdc, renderer, parts.at(i), progressUI, abortCookie);
             }
             // TODO: abort if !ok?
 
@@ -268,11 +335,6 @@ static bool PrintToDevice(const PrintData& pd, ProgressUpdateUI* progressUI = nu
                 (PrintRangeAdv::Odd == pd.advData.range && pageNo % 2 == 0)) {
                 continue;
             }
-            if (progressUI) {
-                progressUI->UpdateProgress(current, total);
-            }
-
-            StartPage(hdc);
 
             SizeF pSize = engine.PageMediabox(pageNo).Size();
             int rotation = 0;
@@ -331,33 +393,31 @@ static bool PrintToDevice(const PrintData& pd, ProgressUpdateUI* progressUI = nu
                 }
             }
 
-            bool ok = false;
-            short shrink = 1;
-            do {
-                RenderPageArgs args(pageNo, zoom / shrink, rotation, nullptr, RenderTarget::Print);
-                if (abortCookie) {
-                    args.cookie_out = &abortCookie->cookie;
-                }
-                RenderedBitmap* bmp = engine.RenderPage(args);
-                if (abortCookie) {
-                    abortCookie->Clear();
-                }
-                if (bmp && bmp->GetBitmap()) {
-                    auto size = bmp->Size();
-                    Rect rc(offset.x, offset.y, size.dx * shrink, size.dy * shrink);
-                    ok = bmp->StretchDIBits(hdc, rc);
-                }
-                delete bmp;
-                shrink *= 2;
-            } while (!ok && shrink < 32 && !(progressUI && progressUI->WasCanceled()));
-            // TODO: abort if !ok?
+            RenderPageArgs args(pageNo, zoom, rotation, nullptr, RenderTarget::Print);
+            parts.Append({args, offset});
+        }
+    }
 
-            if (EndPage(hdc) <= 0 || (progressUI && progressUI->WasCanceled())) {
-                AbortDoc(hdc);
-                return false;
-            }
-            current++;
+    for (PrintPagePart& part : parts) {
+        renderer.Add(part.args);
+    }
+    renderer.Start();
+
+    for (PrintPagePart& part : parts) {
+        if (progressUI) {
+            progressUI->UpdateProgress(current, total);
+        }
+
+        StartPage(hdc);
+
+        PrintPart(hdc, renderer, part, progressUI, abortCookie);
+        // TODO: abort if !ok?
+
+        if (EndPage(hdc) <= 0 || (progressUI && progressUI->WasCanceled())) {
+            AbortDoc(hdc);
+            return false;
         }
+        current++;
     }
 
     EndDoc(hdc);
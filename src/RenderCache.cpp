@@ -33,6 +33,9 @@
 
 bool gShowTileLayout = false;
 
+// initial number of buckets in RenderCache.cacheIndex (must be a power of 2)
+#define CACHE_INDEX_MIN_SIZE 256
+
 RenderCache::RenderCache() : maxTileSize({GetSystemMetrics(SM_CXSCREEN), GetSystemMetrics(SM_CYSCREEN)}) {
     // enable when debugging RenderCache logic
     // gEnableDbgLog = true;
@@ -41,21 +44,34 @@ RenderCache::RenderCache() : maxTileSize({GetSystemMetrics(SM_CXSCREEN), GetSyst
     textColor = WIN_COL_BLACK;
     backgroundColor = WIN_COL_WHITE;
 
+    maxCacheSize = IsProcess64() ? MAX_BITMAPS_CACHED_SIZE_64 : MAX_BITMAPS_CACHED_SIZE_32;
+    cacheIndex.AppendBlanks(CACHE_INDEX_MIN_SIZE);
+
     InitializeCriticalSection(&cacheAccess);
     InitializeCriticalSection(&requestAccess);
 
     startRendering = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-    renderThread = CreateThread(nullptr, 0, RenderCacheThread, this, 0, 0);
-    CrashIf(nullptr == renderThread);
+
+    // leave one core for the UI thread
+    SYSTEM_INFO si{};
+    GetSystemInfo(&si);
+    int nThreads = std::clamp((int)si.dwNumberOfProcessors - 1, 1, MAX_RENDER_THREADS);
+    for (int i = 0; i < nThreads; i++) {
+        HANDLE hThread = CreateThread(nullptr, 0, RenderCacheThread, this, 0, 0);
+        CrashIf(nullptr == hThread);
+        renderThreads.Append(hThread);
+    }
 }
 
 RenderCache::~RenderCache() {
     EnterCriticalSection(&requestAccess);
     EnterCriticalSection(&cacheAccess);
 
-    CloseHandle(renderThread);
+    for (HANDLE hThread : renderThreads) {
+        CloseHandle(hThread);
+    }
     CloseHandle(startRendering);
-    CrashIf(curReq || 0 != requestCount || 0 != cacheCount);
+    CrashIf(0 != curReqs.size() || 0 != requests.size() || 0 != cache.size());
 
     LeaveCriticalSection(&cacheAccess);
     DeleteCriticalSection(&cacheAccess);
@@ -63,30 +79,91 @@ RenderCache::~RenderCache() {
     DeleteCriticalSection(&requestAccess);
 }
 
+static size_t GetCacheIndexBucket(DisplayModel* dm, int pageNo, size_t nBuckets) {
+    u64 h = (u64)(uintptr_t)dm;
+    h = h * 31 + (u32)pageNo;
+    // finalizer from MurmurHash3
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return (size_t)(h & (nBuckets - 1));
+}
+
+// Note: make sure to only call with cacheAccess
+void RenderCache::AddToIndex(BitmapCacheEntry* entry) {
+    size_t nBuckets = cacheIndex.size();
+    if (cache.size() <= nBuckets) {
+        size_t idx = GetCacheIndexBucket(entry->dm, entry->pageNo, nBuckets);
+        entry->hashNext = cacheIndex.at(idx);
+        cacheIndex.at(idx) = entry;
+        return;
+    }
+
+    // grow the index and re-insert all entries (including the new one)
+    nBuckets *= 2;
+    cacheIndex.Reset();
+    cacheIndex.AppendBlanks(nBuckets);
+    for (BitmapCacheEntry* e : cache) {
+        size_t idx = GetCacheIndexBucket(e->dm, e->pageNo, nBuckets);
+        e->hashNext = cacheIndex.at(idx);
+        cacheIndex.at(idx) = e;
+    }
+}
+
+// Note: make sure to only call with cacheAccess
+void RenderCache::RemoveFromIndex(BitmapCacheEntry* entry) {
+    size_t idx = GetCacheIndexBucket(entry->dm, entry->pageNo, cacheIndex.size());
+    BitmapCacheEntry** slot = &cacheIndex.at(idx);
+    while (*slot && *slot != entry) {
+        slot = &(*slot)->hashNext;
+    }
+    CrashIf(!*slot);
+    if (*slot) {
+        *slot = entry->hashNext;
+    }
+    entry->hashNext = nullptr;
+}
+
+// how expensive it is to re-render a bitmap relative to the memory it takes
+static double GetRenderCost(BitmapCacheEntry* entry) {
+    if (entry->outOfDate || entry->completion < 1.f) {
+        return 0;
+    }
+    return (entry->renderTime + 1.0) * 1024 * 1024 / (entry->size + 1.0);
+}
+
 /* Find a bitmap for a page defined by <dm> and <pageNo> and optionally also
    <rotation> and <zoom> in the cache - call DropCacheEntry when you
    no longer need a found entry. */
 BitmapCacheEntry* RenderCache::Find(DisplayModel* dm, int pageNo, int rotation, float zoom, TilePosition* tile) {
     ScopedCritSec scope(&cacheAccess);
     rotation = NormalizeRotation(rotation);
-    for (int i = 0; i < cacheCount; i++) {
-        BitmapCacheEntry* e = cache[i];
+    BitmapCacheEntry* found = nullptr;
+    // without a tile, any tile of the page will do
+    size_t idx = GetCacheIndexBucket(dm, pageNo, cacheIndex.size());
+    for (BitmapCacheEntry* e = cacheIndex.at(idx); e && !found; e = e->hashNext) {
         if ((dm == e->dm) && (pageNo == e->pageNo) && (rotation == e->rotation) &&
             (INVALID_ZOOM == zoom || zoom == e->zoom) && (!tile || e->tile == *tile)) {
-            e->refs++;
-            CrashIf(i != e->cacheIdx);
-            return e;
+            found = e;
         }
     }
-    return nullptr;
+    if (!found) {
+        return nullptr;
+    }
+    CrashIf(found != cache.at(found->cacheIdx));
+    found->refs++;
+    found->keepValue = evictionClock + GetRenderCost(found);
+    return found;
 }
 
+// partially rendered bitmaps don't count
 bool RenderCache::Exists(DisplayModel* dm, int pageNo, int rotation, float zoom, TilePosition* tile) {
     BitmapCacheEntry* entry = Find(dm, pageNo, rotation, zoom, tile);
+    bool exists = entry && entry->completion >= 1.f;
     if (entry) {
         DropCacheEntry(entry);
     }
-    return entry != nullptr;
+    return exists;
 }
 
 bool RenderCache::DropCacheEntry(BitmapCacheEntry* entry) {
@@ -96,6 +173,7 @@ bool RenderCache::DropCacheEntry(BitmapCacheEntry* entry) {
         return false;
     }
     int idx = entry->cacheIdx;
+    int cacheCount = (int)cache.size();
     CrashIf(idx < 0);
     CrashIf(idx >= cacheCount);
     if ((idx < 0) || (idx >= cacheCount)) {
@@ -107,80 +185,142 @@ bool RenderCache::DropCacheEntry(BitmapCacheEntry* entry) {
         return false;
     }
     CrashIf(entry->refs != 0);
-    CrashIf(cache[idx] != entry);
+    CrashIf(cache.at(idx) != entry);
     dbglogf("RenderCache::DropCacheEntry: pageNo: %d, rotation: %d, zoom: %.2f\n", entry->pageNo, entry->rotation,
             entry->zoom);
 
+    RemoveFromIndex(entry);
+    CrashIf(cacheSize < entry->size);
+    cacheSize -= entry->size;
     delete entry;
 
     // fast removal by replacing freed item with the item at the end
-    cache[idx] = nullptr;
-    int lastIdx = cacheCount - 1;
-    if ((lastIdx >= 0) && (idx != lastIdx)) {
-        cache[idx] = cache[lastIdx];
-        cache[idx]->cacheIdx = idx;
-        cache[lastIdx] = nullptr;
-    }
-    cacheCount--;
-    CrashIf(cacheCount < 0);
+    cache.RemoveAtFast(idx);
+    if (idx < (int)cache.size()) {
+        cache.at(idx)->cacheIdx = idx;
+    }
     return true;
 }
 
-static bool FreeIfFull(RenderCache* rc, const PageRenderRequest& req) {
-    int n = rc->cacheCount;
-    if (n < MAX_BITMAPS_CACHED) {
-        return true;
+static size_t GetBitmapSize(RenderedBitmap* bmp) {
+    HBITMAP hbmp = bmp ? bmp->GetBitmap() : nullptr;
+    BITMAP info{};
+    if (!hbmp || !GetObject(hbmp, sizeof(info), &info)) {
+        return 0;
     }
+    return (size_t)info.bmWidthBytes * info.bmHeight;
+}
 
-    DisplayModel* dm = req.dm;
-    // free an invisible page of the same DisplayModel ...
-    for (int i = 0; i < n; i++) {
-        auto entry = rc->cache[i];
-        if (entry->dm == dm && !dm->PageVisibleNearby(entry->pageNo)) {
-            bool didDrop = rc->DropCacheEntry(entry);
-            if (didDrop) {
-                return true;
-            }
-        }
+struct EvictionCandidate {
+    BitmapCacheEntry* entry;
+    bool visible;
+};
+
+// for the std heap functions: the candidate to evict first is the "largest"
+static bool EvictsLater(const EvictionCandidate& a, const EvictionCandidate& b) {
+    if (a.visible != b.visible) {
+        return a.visible;
+    }
+    return a.entry->keepValue > b.entry->keepValue;
+}
+
+/* Free cached bitmaps until there's room for another <sizeNeeded> bytes.
+   Bitmaps of invisible pages go first, then those of other documents
+   (visible pages of <dm> are never freed as it leads to flicker).
+   Among those, bitmaps that are cheap to re-render for the memory they take
+   and that haven't been used recently are freed first (GreedyDual-Size). */
+// Note: make sure to only call with cacheAccess
+void RenderCache::EvictEntries(DisplayModel* dm, size_t sizeNeeded) {
+    auto isOverLimit = [&]() {
+        return cache.size() > 0 && (cacheSize + sizeNeeded > maxCacheSize || cache.size() >= MAX_BITMAPS_CACHED);
+    };
+    if (!isOverLimit()) {
+        return;
     }
 
-    // ... or just the oldest cached page
-    for (int i = 0; i < n; i++) {
-        auto entry = rc->cache[i];
-        if (entry->dm == dm) {
-            // don't free pages from the document we're currently displaying
-            // as it leads to flicker
+    // visibility and keepValue don't change during an eviction pass, so the
+    // candidates are only looked at once and then evicted in heap order
+    Vec<EvictionCandidate> candidates;
+    for (BitmapCacheEntry* e : cache) {
+        if (e->refs > 1) {
+            // currently being painted
+            continue;
+        }
+        bool visible = e->dm->PageVisibleNearby(e->pageNo);
+        if (visible && e->dm == dm) {
             // TODO: it can still flicker if the dm is from a visible tab
             // in a different window, but it's harder to detect
             continue;
         }
-        bool didDrop = rc->DropCacheEntry(entry);
-        if (didDrop) {
-            return true;
-        }
+        candidates.Append({e, visible});
+    }
+    std::make_heap(candidates.begin(), candidates.end(), EvictsLater);
+
+    // if we run out of candidates, we'll temporarily be over the limit
+    while (isOverLimit() && candidates.size() > 0) {
+        std::pop_heap(candidates.begin(), candidates.end(), EvictsLater);
+        BitmapCacheEntry* victim = candidates.Pop().entry;
+        evictionClock = std::max(evictionClock, victim->keepValue);
+        stats.evictions++;
+        DropCacheEntry(victim);
     }
-    return false;
 }
 
-void RenderCache::Add(PageRenderRequest& req, RenderedBitmap* bmp) {
+void RenderCache::Add(PageRenderRequest& req, RenderedBitmap* bmp, float renderTime, float completion) {
     ScopedCritSec scope(&cacheAccess);
     CrashIf(!req.dm);
 
     req.rotation = NormalizeRotation(req.rotation);
-    CrashIf(cacheCount > MAX_BITMAPS_CACHED);
 
     /* It's possible there still is a cached bitmap with different zoom/rotation */
     FreePage(req.dm, req.pageNo, &req.tile);
 
-    bool hasSpace = FreeIfFull(this, req);
-    CrashIf(!hasSpace); // TODO: FreeIfFull() might actually fail to free
-    CrashIf(cacheCount > MAX_BITMAPS_CACHED);
+    size_t size = GetBitmapSize(bmp);
+    EvictEntries(req.dm, size);
 
     // Copy the PageRenderRequest as it will be reused
     auto entry = new BitmapCacheEntry(req.dm, req.pageNo, req.rotation, req.zoom, req.tile, bmp);
-    entry->cacheIdx = cacheCount;
-    cache[cacheCount] = entry;
-    cacheCount++;
+    entry->size = size;
+    entry->renderTime = renderTime;
+    entry->completion = completion;
+    entry->keepValue = evictionClock + GetRenderCost(entry);
+    entry->cacheIdx = (int)cache.size();
+    cache.Append(entry);
+    AddToIndex(entry);
+    cacheSize += size;
+}
+
+// replaces a previous partial result for the same tile, but not a complete bitmap rendered
+// at a different zoom level (which looks better while scaled than a partial one)
+// returns false if bmp hasn't been added (and has been deleted)
+bool RenderCache::AddPartial(PageRenderRequest& req, RenderedBitmap* bmp, float completion) {
+    ScopedCritSec scope(&cacheAccess);
+    BitmapCacheEntry* entry = Find(req.dm, req.pageNo, req.rotation, INVALID_ZOOM, &req.tile);
+    bool isReplacement = entry && entry->completion >= 1.f;
+    if (entry) {
+        DropCacheEntry(entry);
+    }
+    if (isReplacement) {
+        delete bmp;
+        return false;
+    }
+    Add(req, bmp, 0.f, completion);
+    return true;
+}
+
+void RenderCache::SetMaxCacheSize(size_t maxSize) {
+    ScopedCritSec scope(&cacheAccess);
+    maxCacheSize = maxSize;
+    EvictEntries(nullptr, 0);
+}
+
+RenderCacheStats RenderCache::GetStats() {
+    ScopedCritSec scope(&cacheAccess);
+    RenderCacheStats res = stats;
+    res.size = cacheSize;
+    res.maxSize = maxCacheSize;
+    res.count = (int)cache.size();
+    return res;
 }
 
 static RectF GetTileRect(RectF pagerect, TilePosition tile) {
@@ -226,7 +366,7 @@ static bool IsTileVisible(DisplayModel* dm, int pageNo, TilePosition tile, float
     }
     int rotation = dm->GetRotation();
     float zoom = dm->GetZoomReal(pageNo);
-    Rect r = pageInfo->pageOnScreen;
+    Rect r = dm->PageOnScreen(pageNo);
     Rect tileOnScreen = GetTileOnScreen(engine, pageNo, rotation, zoom, tile, r);
     // consider nearby tiles visible depending on the fuzz factor
     tileOnScreen.x -= (int)(tileOnScreen.dx * fuzz * 0.5);
@@ -243,13 +383,14 @@ void RenderCache::FreePage(DisplayModel* dm, int pageNo, TilePosition* tile) {
     dbglogf("RenderCache::FreePage: dm: 0x%p, pageNo: %d\n", dm, pageNo);
     ScopedCritSec scope(&cacheAccess);
 
-    // must go from end becaues freeing changes the cache
-    for (int i = cacheCount - 1; i >= 0; i--) {
-        BitmapCacheEntry* entry = cache[i];
-        bool shouldFree;
-        if (dm && pageNo != INVALID_PAGE_NO) {
-            // a specific page
-            shouldFree = (entry->dm == dm) && (entry->pageNo == pageNo);
+    if (dm && pageNo != INVALID_PAGE_NO) {
+        // a specific page (all of its tiles are in the same cacheIndex bucket)
+        size_t idx = GetCacheIndexBucket(dm, pageNo, cacheIndex.size());
+        BitmapCacheEntry* next = nullptr;
+        for (BitmapCacheEntry* entry = cacheIndex.at(idx); entry; entry = next) {
+            // freeing only unlinks entry itself from the bucket
+            next = entry->hashNext;
+            bool shouldFree = (entry->dm == dm) && (entry->pageNo == pageNo);
             if (tile) {
                 // a given tile of the page or all tiles not rendered at a given resolution
                 // (and at resolution 0 for quick zoom previews)
@@ -258,7 +399,18 @@ void RenderCache::FreePage(DisplayModel* dm, int pageNo, TilePosition* tile) {
                                    tile->row == (USHORT)-1 && entry->tile.res > 0 && entry->tile.res != tile->res ||
                                    tile->row == (USHORT)-1 && entry->tile.res == 0 && entry->outOfDate);
             }
-        } else if (dm) {
+            if (shouldFree) {
+                DropCacheEntry(entry);
+            }
+        }
+        return;
+    }
+
+    // must go from end becaues freeing changes the cache
+    for (int i = (int)cache.size() - 1; i >= 0; i--) {
+        BitmapCacheEntry* entry = cache.at(i);
+        bool shouldFree;
+        if (dm) {
             // all pages of this DisplayModel
             shouldFree = (entry->dm == dm);
         } else {
@@ -284,19 +436,33 @@ void RenderCache::FreeNotVisible() {
 
 // keep the cached bitmaps for visible pages to avoid flickering during a reload.
 // mark invisible pages as out-of-date to prevent inconsistencies
-void RenderCache::KeepForDisplayModel(DisplayModel* oldDm, DisplayModel* newDm) {
+// bitmaps of unchanged pages (cf. DisplayModel::KeepUnchangedPages) are kept as they are
+void RenderCache::KeepForDisplayModel(DisplayModel* oldDm, DisplayModel* newDm, Vec<int>* unchangedPages) {
     ScopedCritSec scope(&cacheAccess);
-    for (int i = 0; i < cacheCount; i++) {
-        BitmapCacheEntry* entry = cache[i];
+    for (BitmapCacheEntry* entry : cache) {
         if (entry->dm != oldDm) {
             continue;
         }
-        if (oldDm->PageVisible(entry->pageNo)) {
+        int pageNo = 0;
+        if (unchangedPages && entry->pageNo < unchangedPages->isize()) {
+            pageNo = unchangedPages->at(entry->pageNo);
+        }
+        if (pageNo != 0) {
+            RemoveFromIndex(entry);
+            entry->dm = newDm;
+            entry->pageNo = pageNo;
+            AddToIndex(entry);
+            continue;
+        }
+        if (oldDm != newDm && oldDm->PageVisible(entry->pageNo)) {
+            RemoveFromIndex(entry);
             entry->dm = newDm;
+            AddToIndex(entry);
         }
         // make sure that the page is rerendered eventually
         entry->zoom = INVALID_ZOOM;
         entry->outOfDate = true;
+        entry->keepValue = evictionClock;
     }
 }
 
@@ -305,18 +471,16 @@ void RenderCache::Invalidate(DisplayModel* dm, int pageNo, RectF rect) {
     ScopedCritSec scopeReq(&requestAccess);
 
     ClearQueueForDisplayModel(dm, pageNo);
-    if (curReq && curReq->dm == dm && curReq->pageNo == pageNo) {
-        AbortCurrentRequest();
-    }
+    AbortCurrentRequests(dm, pageNo);
 
     ScopedCritSec scopeCache(&cacheAccess);
 
     RectF mediabox = dm->GetEngine()->PageMediabox(pageNo);
-    for (int i = 0; i < cacheCount; i++) {
-        auto e = cache[i];
+    for (BitmapCacheEntry* e : cache) {
         if (e->dm == dm && e->pageNo == pageNo && !GetTileRect(mediabox, e->tile).Intersect(rect).IsEmpty()) {
             e->zoom = INVALID_ZOOM;
             e->outOfDate = true;
+            e->keepValue = evictionClock;
         }
     }
 }
@@ -358,8 +522,7 @@ USHORT RenderCache::GetTileRes(DisplayModel* dm, int pageNo) {
 USHORT RenderCache::GetMaxTileRes(DisplayModel* dm, int pageNo, int rotation) {
     ScopedCritSec scope(&cacheAccess);
     USHORT maxRes = 0;
-    for (int i = 0; i < cacheCount; i++) {
-        auto e = cache[i];
+    for (BitmapCacheEntry* e : cache) {
         if (e->dm == dm && e->pageNo == pageNo && e->rotation == rotation) {
             maxRes = std::max(e->tile.res, maxRes);
         }
@@ -384,13 +547,13 @@ bool RenderCache::ReduceTileSize() {
     }
 
     // invalidate all rendered bitmaps and all requests
-    while (cacheCount > 0) {
-        FreeForDisplayModel(cache[0]->dm);
+    while (cache.size() > 0) {
+        FreeForDisplayModel(cache.at(0)->dm);
     }
-    while (requestCount > 0) {
-        ClearQueueForDisplayModel(requests[0].dm);
+    while (requests.size() > 0) {
+        ClearQueueForDisplayModel(requests.at(0)->dm);
     }
-    AbortCurrentRequest();
+    AbortCurrentRequests();
 
     return true;
 }
@@ -403,17 +566,20 @@ void RenderCache::RequestRendering(DisplayModel* dm, int pageNo) {
         return;
     }
 
-    RequestRendering(dm, pageNo, tile);
+    // pages next to the visible ones are rendered ahead of time
+    RenderPriority priority = dm->PageVisible(pageNo) ? RenderPriority::Visible : RenderPriority::Prefetch;
+    RequestRendering(dm, pageNo, tile, true, priority);
     // render both tiles of the first row when splitting a page in four
     // (which always happens on larger displays for Fit Width)
     if (tile.res == 1 && !IsRenderQueueFull()) {
         tile.col = 1;
-        RequestRendering(dm, pageNo, tile, false);
+        RequestRendering(dm, pageNo, tile, false, priority);
     }
 }
 
 /* Render a bitmap for page <pageNo> in <dm>. */
-void RenderCache::RequestRendering(DisplayModel* dm, int pageNo, TilePosition tile, bool clearQueueForPage) {
+void RenderCache::RequestRendering(DisplayModel* dm, int pageNo, TilePosition tile, bool clearQueueForPage,
+                                   RenderPriority priority) {
     dbglogf("RenderCache::RequestRendering(): pageNo %d\n", pageNo);
     ScopedCritSec scope(&requestAccess);
     CrashIf(!dm);
@@ -424,14 +590,20 @@ void RenderCache::RequestRendering(DisplayModel* dm, int pageNo, TilePosition ti
     int rotation = NormalizeRotation(dm->GetRotation());
     float zoom = dm->GetZoomReal(pageNo);
 
-    if (curReq && (curReq->pageNo == pageNo) && (curReq->dm == dm) && (curReq->tile == tile)) {
-        if ((curReq->zoom == zoom) && (curReq->rotation == rotation)) {
+    for (PageRenderRequest* req : curReqs) {
+        if ((req->pageNo != pageNo) || (req->dm != dm) || !(req->tile == tile) || req->abort) {
+            continue;
+        }
+        if ((req->zoom == zoom) && (req->rotation == rotation)) {
             /* we're already rendering exactly the same page */
             return;
         }
         /* Currently rendered page is for the same page but with different zoom
         or rotation, so abort it */
-        AbortCurrentRequest();
+        if (req->abortCookie) {
+            req->abortCookie->Abort();
+        }
+        req->abort = true;
     }
 
     // clear requests for tiles of different resolution and invisible tiles
@@ -439,23 +611,23 @@ void RenderCache::RequestRendering(DisplayModel* dm, int pageNo, TilePosition ti
         ClearQueueForDisplayModel(dm, pageNo, &tile);
     }
 
-    for (int i = 0; i < requestCount; i++) {
-        PageRenderRequest* req = &(requests[i]);
+    for (size_t i = 0; i < requests.size(); i++) {
+        PageRenderRequest* req = requests.at(i);
         if ((req->pageNo == pageNo) && (req->dm == dm) && (req->tile == tile)) {
             if ((req->zoom == zoom) && (req->rotation == rotation)) {
                 /* Request with exactly the same parameters already queued for
-                   rendering. Move it to the top of the queue so that it'll
+                   rendering. Move it to the end of the queue so that it'll
                    be rendered faster. */
-                PageRenderRequest tmp;
-                tmp = requests[requestCount - 1];
-                requests[requestCount - 1] = *req;
-                *req = tmp;
+                requests.RemoveAt(i);
+                requests.Append(req);
             } else {
                 /* There was a request queued for the same page but with different
                    zoom or rotation, so only replace this request */
                 req->zoom = zoom;
                 req->rotation = rotation;
+                req->pageRect = GetTileRectUser(dm->GetEngine(), pageNo, rotation, zoom, tile);
             }
+            req->priority = std::min(req->priority, priority);
             return;
         }
     }
@@ -466,19 +638,19 @@ void RenderCache::RequestRendering(DisplayModel* dm, int pageNo, TilePosition ti
         return;
     }
 
-    Render(dm, pageNo, rotation, zoom, &tile);
+    Render(dm, pageNo, rotation, zoom, &tile, nullptr, nullptr, priority);
 }
 
 void RenderCache::Render(DisplayModel* dm, int pageNo, int rotation, float zoom, RectF pageRect,
                          RenderingCallback& callback) {
-    bool ok = Render(dm, pageNo, rotation, zoom, nullptr, &pageRect, &callback);
+    bool ok = Render(dm, pageNo, rotation, zoom, nullptr, &pageRect, &callback, RenderPriority::Thumbnail);
     if (!ok) {
         callback.Callback();
     }
 }
 
 bool RenderCache::Render(DisplayModel* dm, int pageNo, int rotation, float zoom, TilePosition* tile, RectF* pageRect,
-                         RenderingCallback* renderCb) {
+                         RenderingCallback* renderCb, RenderPriority priority) {
     dbglogf("RenderCache::Render(): pageNo %d\n", pageNo);
     CrashIf(!dm);
     if (!dm || dm->dontRenderFlag) {
@@ -491,22 +663,25 @@ bool RenderCache::Render(DisplayModel* dm, int pageNo, int rotation, float zoom,
     }
 
     ScopedCritSec scope(&requestAccess);
-    PageRenderRequest* newRequest;
 
-    /* add request to the queue */
-    if (requestCount == MAX_PAGE_REQUESTS) {
-        /* queue is full -> remove the oldest items on the queue */
-        if (requests[0].renderCb) {
-            requests[0].renderCb->Callback();
+    if (requests.size() >= MAX_PAGE_REQUESTS) {
+        /* queue is full -> remove the oldest of the least important requests */
+        size_t idx = 0;
+        for (size_t i = 1; i < requests.size(); i++) {
+            if (requests.at(i)->priority > requests.at(idx)->priority) {
+                idx = i;
+            }
         }
-        memmove(&(requests[0]), &(requests[1]), sizeof(PageRenderRequest) * (MAX_PAGE_REQUESTS - 1));
-        newRequest = &(requests[MAX_PAGE_REQUESTS - 1]);
-    } else {
-        newRequest = &(requests[requestCount]);
-        requestCount++;
+        PageRenderRequest* req = requests.at(idx);
+        if (req->renderCb) {
+            req->renderCb->Callback();
+        }
+        requests.RemoveAt(idx);
+        delete req;
     }
-    CrashIf(requestCount > MAX_PAGE_REQUESTS);
 
+    /* add request to the queue */
+    auto newRequest = new PageRenderRequest();
     newRequest->dm = dm;
     newRequest->pageNo = pageNo;
     newRequest->rotation = rotation;
@@ -525,6 +700,8 @@ bool RenderCache::Render(DisplayModel* dm, int pageNo, int rotation, float zoom,
     newRequest->abortCookie = nullptr;
     newRequest->timestamp = GetTickCount();
     newRequest->renderCb = renderCb;
+    newRequest->priority = priority;
+    requests.Append(newRequest);
 
     SetEvent(startRendering);
 
@@ -534,46 +711,75 @@ bool RenderCache::Render(DisplayModel* dm, int pageNo, int rotation, float zoom,
 int RenderCache::GetRenderDelay(DisplayModel* dm, int pageNo, TilePosition tile) {
     ScopedCritSec scope(&requestAccess);
 
-    if (curReq && curReq->pageNo == pageNo && curReq->dm == dm && curReq->tile == tile) {
-        return GetTickCount() - curReq->timestamp;
+    for (PageRenderRequest* req : curReqs) {
+        if (req->pageNo == pageNo && req->dm == dm && req->tile == tile) {
+            return GetTickCount() - req->timestamp;
+        }
     }
 
-    for (int i = 0; i < requestCount; i++) {
-        if (requests[i].pageNo == pageNo && requests[i].dm == dm && requests[i].tile == tile) {
-            return GetTickCount() - requests[i].timestamp;
+    for (PageRenderRequest* req : requests) {
+        if (req->pageNo == pageNo && req->dm == dm && req->tile == tile) {
+            return GetTickCount() - req->timestamp;
         }
     }
 
     return RENDER_DELAY_UNDEFINED;
 }
 
-bool RenderCache::GetNextRequest(PageRenderRequest* req) {
+// engines that don't support concurrent rendering only render one page at a time
+// Note: make sure to only call with requestAccess
+bool RenderCache::CanRenderNow(PageRenderRequest* req) {
+    EngineBase* engine = req->dm->GetEngine();
+    if (engine->allowsConcurrentRendering) {
+        return true;
+    }
+    for (PageRenderRequest* cur : curReqs) {
+        if (cur->dm->GetEngine() == engine) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// returns the most recent of the most important requests
+// (or nullptr if there's nothing to render right now)
+PageRenderRequest* RenderCache::GetNextRequest() {
     ScopedCritSec scope(&requestAccess);
 
-    if (requestCount == 0) {
-        return false;
+    int nextIdx = -1;
+    for (int i = (int)requests.size() - 1; i >= 0; i--) {
+        PageRenderRequest* req = requests.at(i);
+        if (nextIdx != -1 && req->priority >= requests.at(nextIdx)->priority) {
+            continue;
+        }
+        if (CanRenderNow(req)) {
+            nextIdx = i;
+        }
+    }
+    if (nextIdx == -1) {
+        return nullptr;
     }
 
-    CrashIf(requestCount < 0);
-    CrashIf(requestCount > MAX_PAGE_REQUESTS);
-    requestCount--;
-    *req = requests[requestCount];
-    curReq = req;
-    CrashIf(requestCount < 0);
+    PageRenderRequest* req = requests.at(nextIdx);
+    requests.RemoveAt(nextIdx);
     CrashIf(req->abort);
-
-    return true;
+    curReqs.Append(req);
+    if (requests.size() > 0) {
+        // let another thread pick up the next request
+        SetEvent(startRendering);
+    }
+    return req;
 }
 
-bool RenderCache::ClearCurrentRequest() {
+void RenderCache::ClearCurrentRequest(PageRenderRequest* req) {
     ScopedCritSec scope(&requestAccess);
-    if (curReq) {
-        delete curReq->abortCookie;
+    curReqs.Remove(req);
+    delete req->abortCookie;
+    delete req;
+    if (requests.size() > 0) {
+        // requests might have been waiting for req's engine
+        SetEvent(startRendering);
     }
-    curReq = nullptr;
-
-    bool isQueueEmpty = requestCount == 0;
-    return isQueueEmpty;
 }
 
 /* Wait until rendering of a page beloging to <dm> has finished. */
@@ -584,14 +790,18 @@ void RenderCache::CancelRendering(DisplayModel* dm) {
 
     for (;;) {
         EnterCriticalSection(&requestAccess);
-        if (!curReq || (curReq->dm != dm)) {
+        bool isRendering = false;
+        for (PageRenderRequest* req : curReqs) {
+            isRendering = isRendering || req->dm == dm;
+        }
+        if (!isRendering) {
             // to be on the safe side
             ClearQueueForDisplayModel(dm);
             LeaveCriticalSection(&requestAccess);
             return;
         }
 
-        AbortCurrentRequest();
+        AbortCurrentRequests(dm);
         LeaveCriticalSection(&requestAccess);
 
         /* TODO: busy loop is not good, but I don't have a better idea */
@@ -599,99 +809,136 @@ void RenderCache::CancelRendering(DisplayModel* dm) {
     }
 }
 
+// calls update (which e.g. replaces the pages of <dm>) while no render thread accesses <dm>
+void RenderCache::UpdateDisplayModel(DisplayModel* dm, const std::function<void()>& update) {
+    CancelRendering(dm);
+    // no request can be started and EvictEntries and FreePage (which look at
+    // the pages of all documents with cached bitmaps) have to wait
+    ScopedCritSec scope1(&requestAccess);
+    ScopedCritSec scope2(&cacheAccess);
+    update();
+}
+
 void RenderCache::ClearQueueForDisplayModel(DisplayModel* dm, int pageNo, TilePosition* tile) {
     ScopedCritSec scope(&requestAccess);
-    int reqCount = requestCount;
-    int curPos = 0;
-    for (int i = 0; i < reqCount; i++) {
-        PageRenderRequest* req = &(requests[i]);
+    for (int i = (int)requests.size() - 1; i >= 0; i--) {
+        PageRenderRequest* req = requests.at(i);
         bool shouldRemove = req->dm == dm && (pageNo == INVALID_PAGE_NO || req->pageNo == pageNo) &&
                             (!tile || req->tile.res != tile->res || !IsTileVisible(dm, req->pageNo, *tile, 0.5));
-        if (i != curPos) {
-            requests[curPos] = requests[i];
+        if (!shouldRemove) {
+            continue;
         }
-        if (shouldRemove) {
-            if (req->renderCb) {
-                req->renderCb->Callback();
-            }
-            requestCount--;
-        } else {
-            curPos++;
+        if (req->renderCb) {
+            req->renderCb->Callback();
         }
+        requests.RemoveAt(i);
+        delete req;
     }
 }
 
-void RenderCache::AbortCurrentRequest() {
+// aborts requests being rendered for <dm> (and <pageNo>) or all of them
+void RenderCache::AbortCurrentRequests(DisplayModel* dm, int pageNo) {
     ScopedCritSec scope(&requestAccess);
-    if (!curReq) {
-        return;
-    }
-    if (curReq->abortCookie) {
-        curReq->abortCookie->Abort();
+    for (PageRenderRequest* req : curReqs) {
+        if ((dm && req->dm != dm) || (pageNo != INVALID_PAGE_NO && req->pageNo != pageNo)) {
+            continue;
+        }
+        if (req->abortCookie) {
+            req->abortCookie->Abort();
+        }
+        req->abort = true;
     }
-    curReq->abort = true;
 }
 
-DWORD WINAPI RenderCache::RenderCacheThread(LPVOID data) {
-    RenderCache* cache = (RenderCache*)data;
-    PageRenderRequest req;
-    RenderedBitmap* bmp;
+// shows the parts of a tile rendered so far, so that
+// pages which take long to render don't stay blank until done
+class TileProgressCallback : public RenderingCallback {
+    RenderCache* cache = nullptr;
+    PageRenderRequest* req = nullptr;
 
-    for (;;) {
-        if (cache->ClearCurrentRequest()) {
-            DWORD waitResult = WaitForSingleObject(cache->startRendering, INFINITE);
-            // Is it not a page render request?
-            if (WAIT_OBJECT_0 != waitResult) {
-                continue;
-            }
+  public:
+    TileProgressCallback(RenderCache* cache, PageRenderRequest* req) : cache(cache), req(req) {
+    }
+    void Callback(RenderedBitmap* bmp) override {
+        delete bmp;
+    }
+    void Progress(RenderedBitmap* bmp, float completion) override {
+        if (req->abort) {
+            delete bmp;
+            return;
         }
-
-        if (!cache->GetNextRequest(&req)) {
-            continue;
+        if (!req->dm->GetEngine()->IsImageCollection()) {
+            UpdateBitmapColors(bmp->GetBitmap(), cache->textColor, cache->backgroundColor);
         }
-
-        if (!req.dm->PageVisibleNearby(req.pageNo) && !req.renderCb) {
-            continue;
+        if (cache->AddPartial(*req, bmp, completion)) {
+            req->dm->RepaintDisplay();
         }
+    }
+};
 
-        if (req.dm->dontRenderFlag) {
-            if (req.renderCb) {
-                req.renderCb->Callback();
-            }
-            continue;
+static void RenderRequest(RenderCache* cache, PageRenderRequest& req) {
+    if (!req.dm->PageVisibleNearby(req.pageNo) && !req.renderCb) {
+        return;
+    }
+
+    if (req.dm->dontRenderFlag) {
+        if (req.renderCb) {
+            req.renderCb->Callback();
         }
+        return;
+    }
+
+    // make sure that we have extracted page text for
+    // all rendered pages to allow text selection and
+    // searching without any further delays
+    if (!req.dm->textCache->HasTextForPage(req.pageNo)) {
+        req.dm->textCache->GetTextForPage(req.pageNo);
+    }
 
-        // make sure that we have extracted page text for
-        // all rendered pages to allow text selection and
-        // searching without any further delays
-        if (!req.dm->textCache->HasTextForPage(req.pageNo)) {
-            req.dm->textCache->GetTextForPage(req.pageNo);
+    CrashIf(req.abortCookie != nullptr);
+    EngineBase* engine = req.dm->GetEngine();
+    RenderPageArgs args(req.pageNo, req.zoom, req.rotation, &req.pageRect, RenderTarget::View, &req.abortCookie);
+    TileProgressCallback progressCb(cache, &req);
+    if (!req.renderCb) {
+        args.progressCb = &progressCb;
+    }
+    auto timeStart = TimeGet();
+    RenderedBitmap* bmp = engine->RenderPage(args);
+    float renderTime = (float)TimeSinceInMs(timeStart);
+    if (req.abort) {
+        delete bmp;
+        if (req.renderCb) {
+            req.renderCb->Callback(nullptr);
         }
+        return;
+    }
 
-        CrashIf(req.abortCookie != nullptr);
-        EngineBase* engine = req.dm->GetEngine();
-        RenderPageArgs args(req.pageNo, req.zoom, req.rotation, &req.pageRect, RenderTarget::View, &req.abortCookie);
-        bmp = engine->RenderPage(args);
-        if (req.abort) {
-            delete bmp;
-            if (req.renderCb) {
-                req.renderCb->Callback(nullptr);
-            }
-            continue;
+    if (req.renderCb) {
+        // the callback must free the RenderedBitmap
+        req.renderCb->Callback(bmp);
+        req.renderCb = (RenderingCallback*)1; // will crash if accessed again, which should not happen
+    } else {
+        // don't replace colors for individual images
+        if (bmp && !engine->IsImageCollection()) {
+            UpdateBitmapColors(bmp->GetBitmap(), cache->textColor, cache->backgroundColor);
         }
+        cache->Add(req, bmp, renderTime);
+        req.dm->RepaintDisplay();
+    }
+}
 
-        if (req.renderCb) {
-            // the callback must free the RenderedBitmap
-            req.renderCb->Callback(bmp);
-            req.renderCb = (RenderingCallback*)1; // will crash if accessed again, which should not happen
-        } else {
-            // don't replace colors for individual images
-            if (bmp && !engine->IsImageCollection()) {
-                UpdateBitmapColors(bmp->GetBitmap(), cache->textColor, cache->backgroundColor);
-            }
-            cache->Add(req, bmp);
-            req.dm->RepaintDisplay();
+// there are several rendering threads which all pick requests from the same queue
+DWORD WINAPI RenderCache::RenderCacheThread(LPVOID data) {
+    RenderCache* cache = (RenderCache*)data;
+
+    for (;;) {
+        PageRenderRequest* req = cache->GetNextRequest();
+        if (!req) {
+            WaitForSingleObject(cache->startRendering, INFINITE);
+            continue;
         }
+        RenderRequest(cache, *req);
+        cache->ClearCurrentRequest(req);
     }
 }
 
@@ -702,6 +949,14 @@ int RenderCache::PaintTile(HDC hdc, Rect bounds, DisplayModel* dm, int pageNo, T
     float zoom = dm->GetZoomReal(pageNo);
     BitmapCacheEntry* entry = Find(dm, pageNo, dm->GetRotation(), zoom, &tile);
     int renderDelay = 0;
+    {
+        ScopedCritSec scope(&cacheAccess);
+        if (entry) {
+            stats.hits++;
+        } else {
+            stats.misses++;
+        }
+    }
 
     if (!entry) {
         if (!isRemoteSession) {
@@ -714,6 +969,15 @@ int RenderCache::PaintTile(HDC hdc, Rect bounds, DisplayModel* dm, int pageNo, T
         if (renderMissing && RENDER_DELAY_UNDEFINED == renderDelay && !IsRenderQueueFull()) {
             RequestRendering(dm, pageNo, tile);
         }
+    } else if (entry->completion < 1.f) {
+        // keep the tiles of other resolutions showing through the parts still being rendered
+        if (renderedReplacement) {
+            *renderedReplacement = true;
+        }
+        // rendering might have been aborted before completion
+        if (renderMissing && GetRenderDelay(dm, pageNo, tile) == RENDER_DELAY_UNDEFINED && !IsRenderQueueFull()) {
+            RequestRendering(dm, pageNo, tile);
+        }
     }
     RenderedBitmap* renderedBmp = entry ? entry->bitmap : nullptr;
     HBITMAP hbmp = renderedBmp ? renderedBmp->GetBitmap() : nullptr;
@@ -731,7 +995,13 @@ int RenderCache::PaintTile(HDC hdc, Rect bounds, DisplayModel* dm, int pageNo, T
         return renderDelay;
     }
 
-    HDC bmpDC = CreateCompatibleDC(hdc);
+    if (entry->completion < 1.f) {
+        // only paint the part rendered so far
+        int renderedDy = (int)(tileOnScreen.dy * entry->completion);
+        bounds.dy = std::min(bounds.dy, tileOnScreen.y + renderedDy - bounds.y);
+    }
+
+    HDC bmpDC = bounds.dy > 0 ? CreateCompatibleDC(hdc) : nullptr;
     if (bmpDC) {
         Size bmpSize = renderedBmp->Size();
         int xSrc = -std::min(tileOnScreen.x, 0);
@@ -793,13 +1063,14 @@ int RenderCache::Paint(HDC hdc, Rect bounds, DisplayModel* dm, int pageNo, PageI
     };
 #endif
 
+    Rect pageOnScreen = dm->PageOnScreen(pageNo);
     if (!dm->ShouldCacheRendering(pageNo)) {
         int rotation = dm->GetRotation();
         float zoom = dm->GetZoomReal(pageNo);
-        bounds = pageInfo->pageOnScreen.Intersect(bounds);
+        bounds = pageOnScreen.Intersect(bounds);
 
         RectF area = ToRectFl(bounds);
-        area.Offset(-pageInfo->pageOnScreen.x, -pageInfo->pageOnScreen.y);
+        area.Offset(-pageOnScreen.x, -pageOnScreen.y);
         area = dm->GetEngine()->Transform(area, pageNo, zoom, rotation, true);
 
         RenderPageArgs args(pageNo, zoom, rotation, &area);
@@ -825,13 +1096,13 @@ int RenderCache::Paint(HDC hdc, Rect bounds, DisplayModel* dm, int pageNo, PageI
 
     while (queue.size() > 0) {
         TilePosition tile = queue.PopAt(0);
-        Rect tileOnScreen = GetTileOnScreen(dm->GetEngine(), pageNo, rotation, zoom, tile, pageInfo->pageOnScreen);
+        Rect tileOnScreen = GetTileOnScreen(dm->GetEngine(), pageNo, rotation, zoom, tile, pageOnScreen);
         if (tileOnScreen.IsEmpty()) {
             // display an error message when only empty tiles should be drawn (i.e. on page loading errors)
             renderDelayMin = std::min(RENDER_DELAY_FAILED, renderDelayMin);
             continue;
         }
-        tileOnScreen = pageInfo->pageOnScreen.Intersect(tileOnScreen);
+        tileOnScreen = pageOnScreen.Intersect(tileOnScreen);
         Rect isect = bounds.Intersect(tileOnScreen);
         if (isect.IsEmpty()) {
             continue;
@@ -6,19 +6,16 @@ constexpr int RENDER_DELAY_UNDEFINED = std::numeric_limits<int>::max() - 2;
 
 #define INVALID_TILE_RES ((USHORT)-1)
 
-#define MAX_PAGE_REQUESTS 8
-// keep this value reasonably low, else we'll run out of
-// GDI resources/memory when caching many larger bitmaps
-// TODO: this should be based on amount of memory taken by rendered pages
-// i.e. one big page can use as much memory as lots of small pages
-#define MAX_BITMAPS_CACHED 64
-
-class RenderingCallback {
-  public:
-    virtual void Callback(RenderedBitmap* bmp = nullptr) = 0;
-    virtual ~RenderingCallback() {
-    }
-};
+#define MAX_PAGE_REQUESTS 32
+// upper limit for the number of rendering threads
+#define MAX_RENDER_THREADS 8
+// the cache is limited by the amount of memory taken by rendered bitmaps
+// (one big page can use as much memory as lots of small tiles)
+#define MAX_BITMAPS_CACHED_SIZE_32 (128 * 1024 * 1024)
+#define MAX_BITMAPS_CACHED_SIZE_64 (512 * 1024 * 1024)
+// but also keep the number of bitmaps reasonably low, else we'll
+// run out of GDI resources when caching many small bitmaps
+#define MAX_BITMAPS_CACHED 1024
 
 /* A page is split into tiles of at most TILE_MAX_W x TILE_MAX_H pixels.
    A given tile starts at (col / 2^res * page_width, row / 2^res * page_height). */
@@ -48,12 +45,25 @@ struct BitmapCacheEntry {
     float zoom = 0.f;
     TilePosition tile;
     int cacheIdx = -1; // index within RenderCache.cache
+    // next entry in the same RenderCache.cacheIndex bucket
+    BitmapCacheEntry* hashNext = nullptr;
 
     // owned by the BitmapCacheEntry
     RenderedBitmap* bitmap = nullptr;
     bool outOfDate = false;
+    // the top part of bitmap that has been rendered so far
+    // (less than 1 while the tile is still being rendered progressively)
+    float completion = 1.f;
     int refs = 1;
 
+    // memory used by bitmap
+    size_t size = 0;
+    // how long it took to render bitmap (in ms)
+    float renderTime = 0.f;
+    // entries with the lowest value are evicted first
+    // (see RenderCache::EvictEntries)
+    double keepValue = 0;
+
     BitmapCacheEntry(DisplayModel* dm, int pageNo, int rotation, float zoom, TilePosition tile,
                      RenderedBitmap* bitmap) {
         this->dm = dm;
@@ -68,15 +78,24 @@ struct BitmapCacheEntry {
     }
 };
 
+// queued requests with a higher priority (lower value) are rendered first
+enum class RenderPriority {
+    Visible = 0,
+    Prefetch,
+    Thumbnail,
+};
+
 /* Even though this looks a lot like a BitmapCacheEntry, we keep it
-   separate for clarity in the code (PageRenderRequests are reused,
-   while BitmapCacheEntries are ref-counted) */
+   separate for clarity in the code (PageRenderRequests are owned
+   by the queue resp. the rendering thread, while BitmapCacheEntries
+   are ref-counted) */
 struct PageRenderRequest {
     DisplayModel* dm = nullptr;
     int pageNo = 0;
     int rotation = 0;
     float zoom = 0.f;
     TilePosition tile;
+    RenderPriority priority = RenderPriority::Visible;
 
     RectF pageRect; // calculated from TilePosition
     bool abort = false;
@@ -87,19 +106,39 @@ struct PageRenderRequest {
     RenderingCallback* renderCb = nullptr;
 };
 
+struct RenderCacheStats {
+    i64 hits = 0;
+    i64 misses = 0;
+    i64 evictions = 0;
+    // memory currently used by cached bitmaps
+    size_t size = 0;
+    size_t maxSize = 0;
+    int count = 0;
+};
+
 class RenderCache {
   public:
-    BitmapCacheEntry* cache[MAX_BITMAPS_CACHED]{};
-    int cacheCount = 0;
+    Vec<BitmapCacheEntry*> cache;
+    // hash index over cache keyed by (dm, pageNo) i.e. all tiles
+    // of a page are in the same bucket
+    Vec<BitmapCacheEntry*> cacheIndex;
+    // memory used by all cached bitmaps and the upper limit for it
+    size_t cacheSize = 0;
+    size_t maxCacheSize = 0;
+    // increases with every eviction so that entries not used
+    // for a long time eventually get evicted
+    double evictionClock = 0;
+    RenderCacheStats stats;
     // make sure to never ask for requestAccess in a cacheAccess
     // protected critical section in order to avoid deadlocks
     CRITICAL_SECTION cacheAccess;
 
-    PageRenderRequest requests[MAX_PAGE_REQUESTS]{};
-    int requestCount = 0;
-    PageRenderRequest* curReq = nullptr;
+    // queued requests, the most recent ones at the end
+    Vec<PageRenderRequest*> requests;
+    // requests currently being rendered (at most one per rendering thread)
+    Vec<PageRenderRequest*> curReqs;
     CRITICAL_SECTION requestAccess;
-    HANDLE renderThread = nullptr;
+    Vec<HANDLE> renderThreads;
 
     Size maxTileSize{};
     bool isRemoteSession = false;
@@ -118,38 +157,49 @@ class RenderCache {
     void RequestRendering(DisplayModel* dm, int pageNo);
     void Render(DisplayModel* dm, int pageNo, int rotation, float zoom, RectF pageRect, RenderingCallback& callback);
     void CancelRendering(DisplayModel* dm);
+    void UpdateDisplayModel(DisplayModel* dm, const std::function<void()>& update);
     bool Exists(DisplayModel* dm, int pageNo, int rotation, float zoom = INVALID_ZOOM, TilePosition* tile = nullptr);
     void FreeForDisplayModel(DisplayModel* dm);
-    void KeepForDisplayModel(DisplayModel* oldDm, DisplayModel* newDm);
+    void KeepForDisplayModel(DisplayModel* oldDm, DisplayModel* newDm, Vec<int>* unchangedPages = nullptr);
     void Invalidate(DisplayModel* dm, int pageNo, RectF rect);
     // returns how much time in ms has past since the most recent rendering
     // request for the visible part of the page if nothing at all could be
     // painted, 0 if something has been painted and RENDER_DELAY_FAILED on failure
     int Paint(HDC hdc, Rect bounds, DisplayModel* dm, int pageNo, PageInfo* pageInfo, bool* renderOutOfDateCue);
 
-    bool ClearCurrentRequest();
-    bool GetNextRequest(PageRenderRequest* req);
-    void Add(PageRenderRequest& req, RenderedBitmap* bmp);
+    void SetMaxCacheSize(size_t maxSize);
+    RenderCacheStats GetStats();
+
+    void ClearCurrentRequest(PageRenderRequest* req);
+    PageRenderRequest* GetNextRequest();
+    void Add(PageRenderRequest& req, RenderedBitmap* bmp, float renderTime = 0.f, float completion = 1.f);
+    bool AddPartial(PageRenderRequest& req, RenderedBitmap* bmp, float completion);
 
     USHORT GetTileRes(DisplayModel* dm, int pageNo);
     USHORT GetMaxTileRes(DisplayModel* dm, int pageNo, int rotation);
     bool ReduceTileSize();
 
     bool IsRenderQueueFull() const {
-        return requestCount == MAX_PAGE_REQUESTS;
+        return requests.size() >= MAX_PAGE_REQUESTS;
     }
     int GetRenderDelay(DisplayModel* dm, int pageNo, TilePosition tile);
-    void RequestRendering(DisplayModel* dm, int pageNo, TilePosition tile, bool clearQueueForPage = true);
+    void RequestRendering(DisplayModel* dm, int pageNo, TilePosition tile, bool clearQueueForPage = true,
+                          RenderPriority priority = RenderPriority::Visible);
     bool Render(DisplayModel* dm, int pageNo, int rotation, float zoom, TilePosition* tile = nullptr,
-                RectF* pageRect = nullptr, RenderingCallback* renderCb = nullptr);
+                RectF* pageRect = nullptr, RenderingCallback* renderCb = nullptr,
+                RenderPriority priority = RenderPriority::Visible);
     void ClearQueueForDisplayModel(DisplayModel* dm, int pageNo = INVALID_PAGE_NO, TilePosition* tile = nullptr);
-    void AbortCurrentRequest();
+    bool CanRenderNow(PageRenderRequest* req);
+    void AbortCurrentRequests(DisplayModel* dm = nullptr, int pageNo = INVALID_PAGE_NO);
 
     static DWORD WINAPI RenderCacheThread(LPVOID data);
 
     BitmapCacheEntry* Find(DisplayModel* dm, int pageNo, int rotation, float zoom = INVALID_ZOOM,
                            TilePosition* tile = nullptr);
     bool DropCacheEntry(BitmapCacheEntry* entry);
+    void AddToIndex(BitmapCacheEntry* entry);
+    void RemoveFromIndex(BitmapCacheEntry* entry);
+    void EvictEntries(DisplayModel* dm, size_t sizeNeeded);
     void FreePage(DisplayModel* dm = nullptr, int pageNo = -1, TilePosition* tile = nullptr);
     void FreeNotVisible();
 
@@ -60,7 +60,7 @@ Vec<SelectionOnPage>* SelectionOnPage::FromRectangle(DisplayModel* dm, Rect rect
             continue;
         }
 
-        Rect intersect = rect.Intersect(pageInfo->pageOnScreen);
+        Rect intersect = rect.Intersect(dm->PageOnScreen(pageNo));
         if (intersect.IsEmpty()) {
             continue;
         }
@@ -237,7 +237,7 @@ void ZoomToSelection(WindowInfo* win, float factor, bool scrollToFit, bool relat
             int page = dm->FirstVisiblePageNo();
             PageInfo* pageInfo = dm->GetPageInfo(page);
             if (pageInfo) {
-                Rect visible = pageInfo->pageOnScreen.Intersect(win->canvasRc);
+                Rect visible = dm->PageOnScreen(page).Intersect(win->canvasRc);
                 pt = visible.TL();
 
                 int pageNo = dm->GetPageNoByPoint(pt);
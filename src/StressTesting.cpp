@@ -87,6 +87,55 @@ static void BenchLoadRender(EngineBase* engine, int pagenum) {
     logf(L"pagerender %3d: %.2f ms", pagenum, timeMs);
 }
 
+struct BenchRenderThreadData {
+    EngineBase* engine = nullptr;
+    Vec<int>* pages = nullptr;
+    LONG nextIdx = -1;
+};
+
+static DWORD WINAPI BenchRenderThread(void* data) {
+    auto* d = (BenchRenderThreadData*)data;
+    int n = d->pages->isize();
+    for (int i = InterlockedIncrement(&d->nextIdx); i < n; i = InterlockedIncrement(&d->nextIdx)) {
+        RenderPageArgs args(d->pages->at(i), 1.0, 0);
+        delete d->engine->RenderPage(args);
+    }
+    return 0;
+}
+
+// returns the time it took to render the pages with nThreads threads
+static double RenderWithThreads(EngineBase* engine, Vec<int>& pages, int nThreads) {
+    BenchRenderThreadData data;
+    data.engine = engine;
+    data.pages = &pages;
+    HANDLE threads[8];
+    auto t = TimeGet();
+    for (int i = 0; i < nThreads; i++) {
+        threads[i] = CreateThread(nullptr, 0, BenchRenderThread, &data, 0, 0);
+    }
+    WaitForMultipleObjects(nThreads, threads, TRUE, INFINITE);
+    double timeMs = TimeSinceInMs(t);
+    for (int i = 0; i < nThreads; i++) {
+        CloseHandle(threads[i]);
+    }
+    return timeMs;
+}
+
+// renders the pages with 1, 2, 4 and 8 threads to show how
+// well the engine scales when rendering concurrently
+static void BenchRenderThreads(EngineBase* engine, Vec<int>& pages) {
+    if (pages.size() == 0) {
+        return;
+    }
+    for (int nThreads = 1; nThreads <= 8; nThreads *= 2) {
+        // an untimed pass first, so that all runs start with equally warm caches
+        RenderWithThreads(engine, pages, nThreads);
+        double timeMs = RenderWithThreads(engine, pages, nThreads);
+        double pagesPerSec = (double)pages.size() * 1000.0 / timeMs;
+        logf(L"render threads %d: %.2f ms, %.2f pages/sec", nThreads, timeMs, pagesPerSec);
+    }
+}
+
 static int FormatWholeDoc(Doc& doc) {
     int PAGE_DX = 640;
     int PAGE_DY = 520;
@@ -206,9 +255,11 @@ static void BenchFile(const WCHAR* filePath, const WCHAR* pagesSpec) {
     int pages = engine->PageCount();
     logf(L"page count: %d", pages);
 
+    Vec<int> benchedPages;
     if (nullptr == pagesSpec) {
         for (int i = 1; i <= pages; i++) {
             BenchLoadRender(engine, i);
+            benchedPages.Append(i);
         }
     }
 
@@ -219,11 +270,14 @@ static void BenchFile(const WCHAR* filePath, const WCHAR* pagesSpec) {
             for (int j = ranges.at(i).start; j <= ranges.at(i).end; j++) {
                 if (1 <= j && j <= pages) {
                     BenchLoadRender(engine, j);
+                    benchedPages.Append(j);
                 }
             }
         }
     }
 
+    BenchRenderThreads(engine, benchedPages);
+
     delete engine;
 
     logf(L"Finished (in %.2f ms): %s", TimeSinceInMs(total), filePath);
@@ -273,6 +327,130 @@ void BenchFileOrDir(WStrVec& pathsToBench) {
     }
 }
 
+static Kind kindEngineLayoutBench = "engineLayoutBench";
+
+// a document with many pages of a few different sizes, for benchmarking
+// the layout independently of the time it takes to load a document
+class EngineLayoutBench : public EngineBase {
+  public:
+    explicit EngineLayoutBench(int nPages) {
+        kind = kindEngineLayoutBench;
+        pageCount = nPages;
+        fileDPI = 72.0f;
+    }
+    EngineBase* Clone() override {
+        return new EngineLayoutBench(pageCount);
+    }
+    RectF PageMediabox(int pageNo) override {
+        if (pageNo % 10 == 0) {
+            return RectF(0, 0, 792, 612);
+        }
+        if (pageNo % 7 == 0) {
+            return RectF(0, 0, 595, 842);
+        }
+        return RectF(0, 0, 612, 792);
+    }
+    RenderedBitmap* RenderPage([[maybe_unused]] RenderPageArgs& args) override {
+        return nullptr;
+    }
+    // the benchmark doesn't rotate pages
+    RectF Transform(const RectF& rect, [[maybe_unused]] int pageNo, float zoom, [[maybe_unused]] int rotation,
+                    bool inverse) override {
+        float scale = inverse ? 1.0f / zoom : zoom;
+        return RectF(rect.x * scale, rect.y * scale, rect.dx * scale, rect.dy * scale);
+    }
+    std::span<u8> GetFileData() override {
+        return {};
+    }
+    bool SaveFileAs([[maybe_unused]] const char* copyFileName, [[maybe_unused]] bool includeUserAnnots) override {
+        return false;
+    }
+    PageText ExtractPageText([[maybe_unused]] int pageNo) override {
+        return {};
+    }
+    bool HasClipOptimizations([[maybe_unused]] int pageNo) override {
+        return true;
+    }
+    WCHAR* GetProperty([[maybe_unused]] DocumentProperty prop) override {
+        return nullptr;
+    }
+    Vec<IPageElement*>* GetElements([[maybe_unused]] int pageNo) override {
+        return nullptr;
+    }
+    IPageElement* GetElementAtPos([[maybe_unused]] int pageNo, [[maybe_unused]] PointF pt) override {
+        return nullptr;
+    }
+    bool BenchLoadPage([[maybe_unused]] int pageNo) override {
+        return true;
+    }
+};
+
+struct LayoutBenchCallback : ControllerCallback {
+    void PageNoChanged(Controller*, int) override {
+    }
+    void GotoLink(PageDestination*) override {
+    }
+    void Repaint() override {
+    }
+    void UpdateScrollbars(Size) override {
+    }
+    void RequestRendering(int) override {
+    }
+    void CleanUp(DisplayModel*) override {
+    }
+    void RenderThumbnail(DisplayModel*, Size, const onBitmapRenderedCb&) override {
+    }
+    void HandleLayoutFinished(DisplayModel*) override {
+    }
+    void HandlePageSizesChanged(DisplayModel*) override {
+    }
+    void FocusFrame(bool) override {
+    }
+    void SaveDownload(const WCHAR*, std::span<u8>) override {
+    }
+    void HandleLayoutedPages(EbookController*, EbookFormattingData*) override {
+    }
+    void RequestDelayedLayout(int) override {
+    }
+};
+
+// times laying out, scrolling through and hit-testing a synthetic document
+// with pageCount pages (without any rendering)
+void BenchLayout(int pageCount) {
+    logToStderr = true;
+    logf(L"Starting: layout of %d pages", pageCount);
+
+    LayoutBenchCallback cb;
+    auto t = TimeGet();
+    DisplayModel* dm = new DisplayModel(new EngineLayoutBench(pageCount), &cb);
+    dm->SetInitialViewSettings(DisplayMode::Continuous, 1, Size(1200, 900), 96);
+    dm->SetZoomVirtual(ZOOM_FIT_WIDTH, nullptr);
+    logf(L"layout: %.2f ms", TimeSinceInMs(t));
+
+    t = TimeGet();
+    dm->SetZoomVirtual(100.0f, nullptr);
+    logf(L"relayout: %.2f ms", TimeSinceInMs(t));
+
+    const int nScrolls = 10000;
+    Rect viewPort = dm->GetViewPort();
+    Point center(viewPort.dx / 2, viewPort.dy / 2);
+    int scrollRange = dm->GetCanvasSize().dy - viewPort.dy;
+    int hits = 0;
+    t = TimeGet();
+    for (int i = 0; i <= nScrolls; i++) {
+        dm->ScrollYTo((int)((i64)scrollRange * i / nScrolls));
+        if (dm->GetPageNoByPoint(center) > 0) {
+            hits++;
+        }
+        dm->CvtFromScreen(Point(0, 0));
+    }
+    double timeMs = TimeSinceInMs(t);
+    logf(L"scrolling: %.2f ms for %d scroll positions (%.3f ms each, %d hits)", timeMs, nScrolls + 1,
+         timeMs / (nScrolls + 1), hits);
+
+    delete dm;
+}
+
 static bool IsStressTestSupportedFile(const WCHAR* filePath, const WCHAR* filter) {
     if (filter && !path::Match(path::GetBaseNameNoFree(filePath), filter)) {
         return false;
@@ -581,6 +759,10 @@ void StressTest::Finished(bool success) {
         win->ShowNotification(s, NOS_PERSIST, NG_STRESS_TEST_SUMMARY);
     }
 
+    RenderCacheStats stats = gRenderCache.GetStats();
+    logf("render cache: %d hits, %d misses, %d evictions, %d bitmaps using %d of %d KB\n", (int)stats.hits,
+         (int)stats.misses, (int)stats.evictions, stats.count, (int)(stats.size / 1024), (int)(stats.maxSize / 1024));
+
     CloseWindow(win, exitWhenDone && MayCloseWindow(win));
     delete this;
 }
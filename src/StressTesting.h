@@ -4,6 +4,7 @@
 bool IsValidPageRange(const WCHAR* ranges);
 bool IsBenchPagesInfo(const WCHAR* s);
 void BenchFileOrDir(WStrVec& pathsToBench);
+void BenchLayout(int pageCount);
 bool IsStressTesting();
 void BenchEbookLayout(WCHAR* filePath);
 
@@ -439,6 +439,21 @@ WindowInfo* FindWindowInfoByController(Controller* ctrl) {
     return nullptr;
 }
 
+// for tasks posted from other threads, as a closed tab's DisplayModel
+// might have been replaced by a new one at the same address
+static WindowInfo* FindWindowInfoByDisplayModelId(LONG dmId, DisplayModel** dmOut) {
+    for (auto& win : gWindows) {
+        for (auto& tab : win->tabs) {
+            DisplayModel* dm = tab->ctrl ? tab->ctrl->AsFixed() : nullptr;
+            if (dm && dm->id == dmId) {
+                *dmOut = dm;
+                return win;
+            }
+        }
+    }
+    return nullptr;
+}
+
 class HwndPasswordUI : public PasswordUI {
     HWND hwnd;
     size_t pwdIdx;
@@ -707,6 +722,8 @@ struct ControllerCallbackHandler : ControllerCallback {
     void RequestRendering(int pageNo) override;
     void CleanUp(DisplayModel* dm) override;
     void RenderThumbnail(DisplayModel* dm, Size size, const onBitmapRenderedCb&) override;
+    void HandleLayoutFinished(DisplayModel* dm) override;
+    void HandlePageSizesChanged(DisplayModel* dm) override;
     void GotoLink(PageDestination* dest) override {
         win->linkHandler->GotoLink(dest);
     }
@@ -791,6 +808,15 @@ void ControllerCallbackHandler::RequestRendering(int pageNo) {
 void ControllerCallbackHandler::CleanUp(DisplayModel* dm) {
     gRenderCache.CancelRendering(dm);
     gRenderCache.FreeForDisplayModel(dm);
+
+    // remember page sizes etc. for the next time the document is loaded
+    // (but don't leave traces of protected documents)
+    EngineBase* engine = dm->GetEngine();
+    if (dm->layoutCache && !engine->IsPasswordProtected()) {
+        std::span<u8> data = engine->GetLayoutCache();
+        dm->layoutCache->Save(data);
+        str::Free(data.data());
+    }
 }
 
 void ControllerCallbackHandler::FocusFrame(bool always) {
@@ -980,12 +1006,34 @@ static Controller* CreateControllerForFile(const WCHAR* path, PasswordUI* pwdUI,
     bool chmInFixedUI = gGlobalPrefs->chmUI.useFixedPageUI;
     bool ebookInFixedUI = gGlobalPrefs->ebookUI.useFixedPageUI;
 
+    // skip the expensive parts of loading recently used documents
+    // (only EnginePdf has a layout cache, so don't hash or map anything for other files)
+    LayoutCacheFile* layoutCache = nullptr;
+    bool isPdf = IsPdfEngineSupportedFileType(GuessFileTypeFromName(path));
+    if (isPdf && gGlobalPrefs->rememberOpenedFiles && HasPermission(Perm_SavePreferences)) {
+        layoutCache = new LayoutCacheFile(path);
+    }
+    std::span<u8> layoutData = layoutCache ? layoutCache->data : std::span<u8>();
+
     // TODO: sniff file content only once
-    EngineBase* engine = CreateEngine(path, pwdUI, chmInFixedUI, ebookInFixedUI);
+    EngineBase* engine = CreateEngine(path, pwdUI, chmInFixedUI, ebookInFixedUI, true, layoutData);
+    if (layoutCache) {
+        layoutCache->Close();
+    }
+    // a misnamed file might have been opened by a different engine
+    if (layoutCache && (!engine || engine->kind != kindEnginePdf)) {
+        delete layoutCache;
+        layoutCache = nullptr;
+    }
+    // the document will be watched for changes (cf. LoadDocument)
+    if (engine && gGlobalPrefs->reloadModifiedDocuments) {
+        engine->fingerprintPages = true;
+    }
 
     if (engine) {
         ctrl = new DisplayModel(engine, win->cbHandler);
         CrashIf(!ctrl || !ctrl->AsFixed() || ctrl->AsChm() || ctrl->AsEbook());
+        ctrl->AsFixed()->layoutCache = layoutCache;
         VerifyController(ctrl, path);
         return ctrl;
     }
@@ -1081,6 +1129,54 @@ static bool showTocByDefault(const WCHAR* path) {
     return showByDefault;
 }
 
+void ControllerCallbackHandler::HandleLayoutFinished(DisplayModel* layoutDm) {
+    LONG dmId = layoutDm->id;
+    uitask::Post([=] {
+        DisplayModel* dm = nullptr;
+        WindowInfo* win = FindWindowInfoByDisplayModelId(dmId, &dm);
+        if (!win) {
+            return;
+        }
+        bool isCurrent = win->ctrl == dm;
+        if (isCurrent) {
+            // the search and the selection depend on the page count
+            AbortFinding(win, true);
+            DeleteOldSelectionInfo(win, true);
+        }
+        ScrollState ss = dm->GetScrollState();
+        gRenderCache.UpdateDisplayModel(dm, [dm] { dm->UpdatePageCount(); });
+        ss.page = std::min(ss.page, dm->PageCount());
+        dm->Relayout(dm->GetZoomVirtual(), dm->GetRotation());
+        dm->SetScrollState(ss);
+        dm->RepaintDisplay();
+        if (!isCurrent) {
+            return;
+        }
+        UpdateToolbarPageText(win, dm->PageCount(), true);
+        OnMenuFindMatchCase(win);
+        // the ToC only becomes available now (cf. LoadDocIntoCurrentTab)
+        DisplayState* state = nullptr;
+        if (gGlobalPrefs->rememberStatePerDocument) {
+            state = gFileHistory.Find(dm->FilePath(), nullptr);
+        }
+        bool showToc = state && !state->useDefaultState ? state->showToc : showTocByDefault(dm->FilePath());
+        if (showToc && !win->tocVisible && !win->presentation) {
+            SetSidebarVisibility(win, true, gGlobalPrefs->showFavorites);
+        }
+    });
+}
+
+void ControllerCallbackHandler::HandlePageSizesChanged(DisplayModel* changedDm) {
+    LONG dmId = changedDm->id;
+    uitask::Post([=] {
+        DisplayModel* dm = nullptr;
+        WindowInfo* win = FindWindowInfoByDisplayModelId(dmId, &dm);
+        if (win) {
+            dm->UpdatePageSizes();
+        }
+    });
+}
+
 // meaning of the internal values of LoadArgs:
 // isNewWindow : if true then 'win' refers to a newly created window that needs
 //   to be resized and placed
@@ -1162,7 +1258,9 @@ static void LoadDocIntoCurrentTab(const LoadArgs& args, Controller* ctrl, Displa
                 dm->SetDisplayR2L(state ? state->displayR2L : gGlobalPrefs->comicBookUI.cbxMangaMode);
             }
             if (prevCtrl && prevCtrl->AsFixed() && str::Eq(win->ctrl->FilePath(), prevCtrl->FilePath())) {
-                gRenderCache.KeepForDisplayModel(prevCtrl->AsFixed(), dm);
+                Vec<int> unchangedPages;
+                dm->KeepUnchangedPages(*prevCtrl->AsFixed(), unchangedPages);
+                gRenderCache.KeepForDisplayModel(prevCtrl->AsFixed(), dm, &unchangedPages);
                 dm->CopyNavHistory(*prevCtrl->AsFixed());
             }
             // tell UI Automation about content change
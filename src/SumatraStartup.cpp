@@ -744,6 +744,7 @@ static void testLogf() {
 
 // in mupdf_load_system_font.c
 extern "C" void destroy_system_font_list();
+extern "C" void pdf_set_system_font_index_path(const WCHAR* path);
 
 // in MemLeakDetect.cpp
 extern bool MemLeakInit();
@@ -938,6 +939,12 @@ int APIENTRY WinMain(HINSTANCE hInstance, [[maybe_unused]] HINSTANCE hPrevInstan
     UpdateGlobalPrefs(i);
     SetCurrentLang(i.lang ? i.lang : gGlobalPrefs->uiLanguage);
 
+    if (HasPermission(Perm_SavePreferences)) {
+        // saves parsing all system fonts when the first document needing them is loaded
+        AutoFreeWstr fontIndexPath(AppGenDataFilename(L"fontindex.dat"));
+        pdf_set_system_font_index_path(fontIndexPath);
+    }
+
     // This allows ad-hoc comparison of gdi, gdi+ and gdi+ quick when used
     // in layout
 #if 0
@@ -964,6 +971,13 @@ int APIENTRY WinMain(HINSTANCE hInstance, [[maybe_unused]] HINSTANCE hPrevInstan
         }
     }
 
+    if (i.benchLayoutPages > 0) {
+        BenchLayout(i.benchLayoutPages);
+        if (i.showConsole) {
+            system("pause");
+        }
+    }
+
     if (i.exitImmediately) {
         goto Exit;
     }
@@ -3,11 +3,18 @@
 
 #include "utils/BaseUtil.h"
 #include "utils/ScopedWin.h"
+#include "utils/CaseFold.h"
+#include "utils/CryptoUtil.h"
+#include "utils/SearchIndex.h"
 
 #include "wingui/TreeModel.h"
 
 #include "Annotation.h"
 #include "EngineBase.h"
+#include "DisplayMode.h"
+#include "SettingsStructs.h"
+#include "GlobalPrefs.h"
+#include "FileThumbnails.h"
 #include "ProgressUpdateUI.h"
 #include "TextSelection.h"
 #include "TextSearch.h"
@@ -17,6 +24,9 @@
 // cf. http://code.google.com/p/sumatrapdf/issues/detail?id=959
 #define isnoncjkwordchar(c) (isWordChar(c) && (unsigned short)(c) < 0x2E80)
 
+// searching small documents is fast enough without an index
+#define MIN_PAGES_FOR_SEARCH_INDEX 16
+
 static void markAllPagesNonSkip(Vec<bool>& pagesToSkip) {
     for (size_t i = 0; i < pagesToSkip.size(); i++) {
         pagesToSkip[i] = false;
@@ -26,14 +36,26 @@ TextSearch::TextSearch(EngineBase* engine, DocumentTextCache* textCache) : TextS
     nPages = engine->PageCount();
     pagesToSkip.SetSize(nPages);
     markAllPagesNonSkip(pagesToSkip);
+    InitializeCriticalSection(&indexAccess);
 }
 
 TextSearch::~TextSearch() {
+    EnterCriticalSection(&indexAccess);
+    stopIndexing = true;
+    LeaveCriticalSection(&indexAccess);
+    if (indexThread) {
+        WaitForSingleObject(indexThread, INFINITE);
+        CloseHandle(indexThread);
+    }
+    delete searchIndex;
+    DeleteCriticalSection(&indexAccess);
+
     Clear();
 }
 
 void TextSearch::Reset() {
     pageText = nullptr;
+    pageTextLen = 0;
     TextSelection::Reset();
 }
 
@@ -74,6 +96,12 @@ void TextSearch::SetText(const WCHAR* text) {
     } else {
         anchor = str::DupN(text, 1);
     }
+    if (anchor) {
+        // fold once instead of for every comparison
+        anchorLen = str::Len(anchor);
+        anchorFolded = str::DupN(anchor, anchorLen);
+        FoldCase(anchorFolded, anchorLen);
+    }
 
     if (str::Len(this->findText) >= INT_MAX) {
         this->findText[(unsigned)INT_MAX - 1] = '\0';
@@ -119,30 +147,10 @@ void TextSearch::SetLastResult(TextSelection* sel) {
 
     searchHitStartAt = findPage = std::min(startPage, endPage);
     findIndex = (findPage == startPage ? startGlyph : endGlyph) + (int)str::Len(findText);
-    pageText = textCache->GetTextForPage(findPage);
+    pageText = textCache->GetTextForPage(findPage, &pageTextLen);
     forward = true;
 }
 
-static WCHAR CharToLower2(WCHAR c) {
-    WCHAR buf[1] = {c};
-    CharLowerBuffW(buf, 1);
-    return buf[0];
-}
-
-static inline WCHAR CharToLower(WCHAR c) {
-    // fast path that hopefully will be inlined
-    if (c >= 'a' && c <= 'z') {
-        return c;
-    }
-    if (c >= '0' && c <= '9') {
-        return c;
-    }
-    if (c >= 'A' && c <= 'Z') {
-        return c + 32;
-    }
-    return CharToLower2(c);
-}
-
 // try to match "findText" from "start" with whitespace tolerance
 // (ignore all whitespace except after alphanumeric characters)
 TextSearch::PageAndOffset TextSearch::MatchEnd(const WCHAR* start) const {
@@ -170,9 +178,7 @@ TextSearch::PageAndOffset TextSearch::MatchEnd(const WCHAR* start) const {
         if (caseSensitive) {
             isMatch = *match == *end;
         } else {
-            WCHAR matchLower = CharToLower(*match);
-            WCHAR matchEnd = CharToLower(*end);
-            isMatch = matchLower == matchEnd;
+            isMatch = FoldCase(*match) == FoldCase(*end);
         }
         if (isMatch) {
             /* characters are identical */;
@@ -255,12 +261,12 @@ bool TextSearch::FindTextInPage(int pageNo, TextSearch::PageAndOffset* finalGlyp
         } else if (forward) {
             const WCHAR* s = pageText + findIndex;
             if (caseSensitive) {
-                found = StrStr(s, anchor);
+                found = FindExact(s, pageText + pageTextLen, anchor, anchorLen);
             } else {
-                found = StrStrI(s, anchor);
+                found = FindFolded(s, pageText + pageTextLen, anchorFolded, anchorLen);
             }
         } else {
-            found = StrRStrI(pageText, pageText + findIndex, anchor);
+            found = FindFoldedLast(pageText, pageText + pageTextLen, pageText + findIndex, anchorFolded, anchorLen);
         }
         if (!found) {
             return false;
@@ -304,17 +310,15 @@ bool TextSearch::FindStartingAtPage(int pageNo, ProgressUpdateUI* tracker) {
 
         Reset();
 
-        pageText = textCache->GetTextForPage(pageNo, &findIndex);
+        pageText = textCache->GetTextForPage(pageNo, &pageTextLen);
         if (pageText) {
-            if (forward) {
-                findIndex = 0;
-            }
+            findIndex = forward ? 0 : pageTextLen;
             PageAndOffset r;
             if (FindTextInPage(pageNo, &r)) {
                 if (forward) {
                     if (findPage != r.page) {
                         findPage = r.page;
-                        pageText = textCache->GetTextForPage(findPage);
+                        pageText = textCache->GetTextForPage(findPage, &pageTextLen);
                     }
                     findIndex = r.offset;
                 }
@@ -334,6 +338,8 @@ bool TextSearch::FindStartingAtPage(int pageNo, ProgressUpdateUI* tracker) {
 
 TextSel* TextSearch::FindFirst(int page, const WCHAR* text, ProgressUpdateUI* tracker) {
     SetText(text);
+    StartIndexing();
+    SkipPagesNotInIndex();
 
     if (FindStartingAtPage(page, tracker)) {
         return &result;
@@ -359,7 +365,7 @@ TextSel* TextSearch::FindNext(ProgressUpdateUI* tracker) {
         if (forward) {
             findPage = finalGlyph.page;
             findIndex = finalGlyph.offset;
-            pageText = textCache->GetTextForPage(findPage);
+            pageText = textCache->GetTextForPage(findPage, &pageTextLen);
         }
         return &result;
     }
@@ -370,3 +376,91 @@ TextSel* TextSearch::FindNext(ProgressUpdateUI* tracker) {
     }
     return nullptr;
 }
+
+// marks pages which (according to the search index) don't contain the anchor
+// as to be skipped, so that their text doesn't even have to be extracted
+void TextSearch::SkipPagesNotInIndex() {
+    ScopedCritSec scope(&indexAccess);
+    if (!searchIndex || !anchor || searchIndex->PageCount() != nPages) {
+        return;
+    }
+    Vec<bool> pages;
+    if (!searchIndex->FindPages(anchor, pages)) {
+        return;
+    }
+    for (int i = 0; i < nPages; i++) {
+        if (!pages[i]) {
+            pagesToSkip[i] = true;
+        }
+    }
+}
+
+void TextSearch::StartIndexing() {
+    if (indexThread || nPages < MIN_PAGES_FOR_SEARCH_INDEX) {
+        return;
+    }
+    indexThread = CreateThread(nullptr, 0, IndexThread, this, 0, 0);
+}
+
+// the index is cached by the document's size, modification time and the hash of its
+// start and end (and not by its path), so that it remains valid when the document is
+// moved (and is rebuilt when it's modified) without having to hash the whole file
+SearchIndex* TextSearch::LoadOrBuildIndex() {
+    // don't leave traces of protected or not to be remembered documents
+    const WCHAR* filePath = engine->FileName();
+    bool canCache = filePath && gGlobalPrefs->rememberOpenedFiles && !engine->IsPasswordProtected();
+    u8 digest[16];
+    if (canCache) {
+        canCache = CalcSearchIndexDigest(filePath, digest);
+    }
+    if (canCache) {
+        std::span<u8> data = LoadSearchIndex(digest);
+        SearchIndex* index = SearchIndex::Create(data, FoldCase);
+        if (index && index->PageCount() == nPages) {
+            return index;
+        }
+        if (index) {
+            delete index;
+        } else {
+            str::Free(data.data());
+        }
+    }
+
+    SearchIndexBuilder builder(FoldCase);
+    for (int pageNo = 1; pageNo <= nPages; pageNo++) {
+        {
+            ScopedCritSec scope(&indexAccess);
+            if (stopIndexing) {
+                return nullptr;
+            }
+        }
+        // don't extract the text again for pages already searched
+        if (textCache->HasTextForPage(pageNo)) {
+            int len;
+            const WCHAR* text = textCache->GetTextForPage(pageNo, &len);
+            builder.AddPage(pageNo, text, len);
+            continue;
+        }
+        PageText pageText = engine->ExtractPageText(pageNo);
+        builder.AddPage(pageNo, pageText.text, pageText.len);
+        FreePageText(&pageText);
+    }
+
+    std::span<u8> data = builder.Serialize(nPages);
+    if (canCache && !data.empty()) {
+        SaveSearchIndex(digest, data);
+    }
+    SearchIndex* index = SearchIndex::Create(data, FoldCase);
+    if (!index) {
+        str::Free(data.data());
+    }
+    return index;
+}
+
+DWORD WINAPI TextSearch::IndexThread(LPVOID data) {
+    TextSearch* ts = (TextSearch*)data;
+    SearchIndex* index = ts->LoadOrBuildIndex();
+    ScopedCritSec scope(&ts->indexAccess);
+    ts->searchIndex = index;
+    return 0;
+}
@@ -3,6 +3,8 @@
 
 enum class TextSearchDirection : bool { Backward = false, Forward = true };
 
+class SearchIndex;
+
 class TextSearch : public TextSelection {
   public:
     TextSearch(EngineBase* engine, DocumentTextCache* textCache);
@@ -14,6 +16,10 @@ class TextSearch : public TextSelection {
     TextSel* FindFirst(int page, const WCHAR* text, ProgressUpdateUI* tracker = nullptr);
     TextSel* FindNext(ProgressUpdateUI* tracker = nullptr);
 
+    // builds (or loads a cached) search index on a background thread
+    // so that later searches can skip pages not containing the search text
+    void StartIndexing();
+
     // note: the result might not be a valid page number!
     int GetCurrentPageNo() const {
         return findPage;
@@ -33,6 +39,9 @@ class TextSearch : public TextSelection {
 
     WCHAR* findText = nullptr;
     WCHAR* anchor = nullptr;
+    // anchor folded with FoldCase
+    WCHAR* anchorFolded = nullptr;
+    size_t anchorLen = 0;
     int findPage = 0;
     int searchHitStartAt = 0; // when text found spans several pages, searchHitStartAt < findPage
     bool forward = true;
@@ -51,6 +60,8 @@ class TextSearch : public TextSelection {
     void Clear() {
         str::ReplacePtr(&findText, nullptr);
         str::ReplacePtr(&anchor, nullptr);
+        str::ReplacePtr(&anchorFolded, nullptr);
+        anchorLen = 0;
         str::ReplacePtr(&lastText, nullptr);
         Reset();
     }
@@ -58,9 +69,19 @@ class TextSearch : public TextSelection {
 
   private:
     const WCHAR* pageText = nullptr;
+    int pageTextLen = 0;
     int findIndex = 0;
 
     WCHAR* lastText = nullptr;
     int nPages = 0;
     Vec<bool> pagesToSkip;
+
+    SearchIndex* searchIndex = nullptr;
+    CRITICAL_SECTION indexAccess;
+    HANDLE indexThread = nullptr;
+    bool stopIndexing = false;
+
+    void SkipPagesNotInIndex();
+    SearchIndex* LoadOrBuildIndex();
+    static DWORD WINAPI IndexThread(LPVOID data);
 };
@@ -49,18 +49,31 @@ bool DocumentTextCache::HasTextForPage(int pageNo) {
 const WCHAR* DocumentTextCache::GetTextForPage(int pageNo, int* lenOut, Rect** coordsOut) {
     CrashIf(pageNo < 1 || pageNo > nPages);
 
-    ScopedCritSec scope(&access);
     PageText* pageText = &pagesText[pageNo - 1];
+    bool hasText;
+    {
+        ScopedCritSec scope(&access);
+        hasText = pageText->text != nullptr;
+    }
 
-    if (!pageText->text) {
-        *pageText = engine->ExtractPageText(pageNo);
-        if (!pageText->text) {
-            pageText->text = str::Dup(L"");
-            pageText->len = 0;
+    if (!hasText) {
+        // extract outside of access so that threads rendering different
+        // pages don't wait for each other (the first result is kept)
+        PageText extracted = engine->ExtractPageText(pageNo);
+        if (!extracted.text) {
+            extracted.text = str::Dup(L"");
+            extracted.len = 0;
+        }
+        ScopedCritSec scope(&access);
+        if (pageText->text) {
+            FreePageText(&extracted);
+        } else {
+            *pageText = extracted;
+            debugSize += (pageText->len + 1) * (int)(sizeof(WCHAR) + sizeof(Rect));
         }
-        debugSize += (pageText->len + 1) * (int)(sizeof(WCHAR) + sizeof(Rect));
     }
 
+    ScopedCritSec scope(&access);
     if (lenOut) {
         *lenOut = pageText->len;
     }
@@ -70,6 +83,31 @@ const WCHAR* DocumentTextCache::GetTextForPage(int pageNo, int* lenOut, Rect** c
     return pageText->text;
 }
 
+void DocumentTextCache::TakeTextForPage(int pageNo, DocumentTextCache* src, int srcPageNo) {
+    CrashIf(pageNo < 1 || pageNo > nPages);
+    CrashIf(srcPageNo < 1 || srcPageNo > src->nPages);
+
+    PageText taken;
+    {
+        ScopedCritSec scope(&src->access);
+        PageText* srcText = &src->pagesText[srcPageNo - 1];
+        taken = *srcText;
+        *srcText = {};
+    }
+    if (!taken.text) {
+        return;
+    }
+
+    ScopedCritSec scope(&access);
+    PageText* pageText = &pagesText[pageNo - 1];
+    if (pageText->text) {
+        FreePageText(&taken);
+        return;
+    }
+    *pageText = taken;
+    debugSize += (pageText->len + 1) * (int)(sizeof(WCHAR) + sizeof(Rect));
+}
+
 TextSelection::TextSelection(EngineBase* engine, DocumentTextCache* textCache) : engine(engine), textCache(textCache) {
 }
 
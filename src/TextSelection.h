@@ -14,6 +14,8 @@ struct DocumentTextCache {
 
     bool HasTextForPage(int pageNo);
     const WCHAR* GetTextForPage(int pageNo, int* lenOut = nullptr, Rect** coordsOut = nullptr);
+    // takes over the text of page srcPageNo of src (e.g. for a previous version of the document)
+    void TakeTextForPage(int pageNo, DocumentTextCache* src, int srcPageNo);
 };
 
 // TODO: replace with Vec<TextSel>
@@ -15,6 +15,8 @@ extern void SvgPath_UnitTests();
 
 extern void BaseUtilTest();
 extern void ByteOrderTests();
+extern void CaseFoldBenchmark();
+extern void CaseFoldTest();
 extern void CmdLineParserTest();
 extern void CryptoUtilTest();
 extern void CssParser_UnitTests();
@@ -23,6 +25,7 @@ extern void FileUtilTest();
 extern void HtmlPrettyPrintTest();
 extern void HtmlPullParser_UnitTests();
 extern void JsonTest();
+extern void SearchIndexTest();
 extern void SettingsUtilTest();
 extern void SimpleLogTest();
 extern void SquareTreeTest();
@@ -34,11 +37,19 @@ extern void VecTest();
 extern void WinUtilTest();
 extern void StrFormatTest();
 
-int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv) {
+int main(int argc, char** argv) {
+    // -bench runs the (slow) benchmarks instead of the unit tests
+    if (argc > 1 && str::Eq(argv[1], "-bench")) {
+        InitDynCalls();
+        CaseFoldBenchmark();
+        return utassert_print_results();
+    }
+
     printf("Running unit tests\n");
     InitDynCalls();
     BaseUtilTest();
     ByteOrderTests();
+    CaseFoldTest();
     CmdLineParserTest();
     CryptoUtilTest();
     CssParser_UnitTests();
@@ -47,6 +58,7 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv) {
     HtmlPrettyPrintTest();
     HtmlPullParser_UnitTests();
     JsonTest();
+    SearchIndexTest();
     SettingsUtilTest();
     SimpleLogTest();
     SquareTreeTest();
@@ -61,27 +61,58 @@ bool MultiFormatArchive::Open(ar_stream* data, const char* archivePath) {
         i->fileId = fileId;
         i->fileSizeUncompressed = ar_entry_get_size(ar_);
         i->filePos = ar_entry_get_offset(ar_);
+        i->solidStart = ar_entry_get_solid_start(ar_);
         i->fileTime = ar_entry_get_filetime(ar_);
         i->name = Allocator::AllocString(&allocator_, name);
         fileInfos_.Append(i);
+        isSolid_ |= i->solidStart != i->filePos;
 
         fileId++;
     }
+    BuildFileIndex();
     return true;
 }
 
+static void CloseUnrarHandle(void* hArc);
+
 MultiFormatArchive::~MultiFormatArchive() {
+    for (auto& cf : cache_) {
+        free(cf.data.data());
+    }
+    CloseUnrarHandle(unrarHandle_);
     ar_close_archive(ar_);
     ar_close(data_);
 }
 
-size_t getFileIdByName(Vec<MultiFormatArchive::FileInfo*>& fileInfos, const char* name) {
-    for (auto fileInfo : fileInfos) {
-        if (str::EqI(fileInfo->name.data(), name)) {
-            return fileInfo->fileId;
+// FNV-1a over the name with ASCII letters lowercased (matching str::EqI)
+static u32 HashFileName(const char* s) {
+    u32 h = 2166136261u;
+    for (; *s; s++) {
+        u8 c = (u8)*s;
+        if (c >= 'A' && c <= 'Z') {
+            c += 'a' - 'A';
         }
+        h = (h ^ c) * 16777619u;
+    }
+    return h;
+}
+
+// same layout as the index in mupdf's unzip.c: open addressing with linear
+// probing, at most half full. For duplicate names, the first one is found first
+void MultiFormatArchive::BuildFileIndex() {
+    size_t size = 16;
+    while (size / 2 < fileInfos_.size()) {
+        size *= 2;
+    }
+    fileIndex_.Reset();
+    fileIndex_.AppendBlanks(size);
+    for (auto fileInfo : fileInfos_) {
+        size_t slot = HashFileName(fileInfo->name.data()) & (size - 1);
+        while (fileIndex_[slot] != 0) {
+            slot = (slot + 1) & (size - 1);
+        }
+        fileIndex_[slot] = (u32)fileInfo->fileId + 1;
     }
-    return (size_t)-1;
 }
 
 Vec<MultiFormatArchive::FileInfo*> const& MultiFormatArchive::GetFileInfos() {
@@ -89,7 +120,18 @@ Vec<MultiFormatArchive::FileInfo*> const& MultiFormatArchive::GetFileInfos() {
 }
 
 size_t MultiFormatArchive::GetFileId(const char* fileName) {
-    return getFileIdByName(fileInfos_, fileName);
+    size_t size = fileIndex_.size();
+    if (size == 0 || !fileName) {
+        return (size_t)-1;
+    }
+    size_t slot = HashFileName(fileName) & (size - 1);
+    for (u32 id = fileIndex_[slot]; id != 0; id = fileIndex_[slot]) {
+        if (str::EqI(fileInfos_[(size_t)id - 1]->name.data(), fileName)) {
+            return (size_t)id - 1;
+        }
+        slot = (slot + 1) & (size - 1);
+    }
+    return (size_t)-1;
 }
 
 #if OS_WIN
@@ -100,16 +142,91 @@ std::span<u8> MultiFormatArchive::GetFileDataByName(const WCHAR* fileName) {
 #endif
 
 std::span<u8> MultiFormatArchive::GetFileDataByName(const char* fileName) {
-    size_t fileId = getFileIdByName(fileInfos_, fileName);
+    size_t fileId = GetFileId(fileName);
     return GetFileDataById(fileId);
 }
 
+static std::span<u8> DupWithPadding(std::span<u8> d) {
+    u8* data = AllocArray<u8>(d.size() + ZERO_PADDING_COUNT);
+    if (!data) {
+        return {};
+    }
+    memcpy(data, d.data(), d.size());
+    return {data, d.size()};
+}
+
 std::span<u8> MultiFormatArchive::GetFileDataById(size_t fileId) {
     if (fileId == (size_t)-1) {
         return {};
     }
     CrashIf(fileId >= fileInfos_.size());
 
+    int n = cache_.isize();
+    for (int i = 0; i < n; i++) {
+        CachedFile cf = cache_[i];
+        if (cf.fileId != fileId) {
+            continue;
+        }
+        if (i > 0) {
+            cache_.RemoveAt(i);
+            cache_.InsertAt(0, cf);
+        }
+        return DupWithPadding(cf.data);
+    }
+
+    auto data = ReadFileData(fileId, (size_t)-1);
+    if (data.data() && cacheLimit_ > 0) {
+        AddToCache(fileId, DupWithPadding(data));
+    }
+    return data;
+}
+
+std::span<u8> MultiFormatArchive::GetFileDataPartById(size_t fileId, size_t maxSize) {
+    if (fileId == (size_t)-1) {
+        return {};
+    }
+    CrashIf(fileId >= fileInfos_.size());
+    // a partially uncompressed file would break the chain of uncompressed files
+    if (isSolid_) {
+        return GetFileDataById(fileId);
+    }
+    for (auto& cf : cache_) {
+        if (cf.fileId == fileId) {
+            return DupWithPadding({cf.data.data(), std::min(cf.data.size(), maxSize)});
+        }
+    }
+    return ReadFileData(fileId, maxSize);
+}
+
+void MultiFormatArchive::SetCacheLimit(size_t maxBytes) {
+    cacheLimit_ = maxBytes;
+    AddToCache((size_t)-1, {});
+}
+
+bool MultiFormatArchive::IsCached(size_t fileId) const {
+    for (auto& cf : cache_) {
+        if (cf.fileId == fileId) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// takes ownership of data. Evicts least recently used files
+// until the cache fits into cacheLimit_
+void MultiFormatArchive::AddToCache(size_t fileId, std::span<u8> data) {
+    if (data.data()) {
+        cache_.InsertAt(0, {fileId, data});
+        cacheSize_ += data.size();
+    }
+    while (cache_.size() > 0 && cacheSize_ > cacheLimit_) {
+        CachedFile cf = cache_.Pop();
+        cacheSize_ -= cf.data.size();
+        free(cf.data.data());
+    }
+}
+
+std::span<u8> MultiFormatArchive::ReadFileData(size_t fileId, size_t maxSize) {
     if (LoadedUsingUnrarDll()) {
         return GetFileDataByIdUnarrDll(fileId);
     }
@@ -117,6 +234,9 @@ std::span<u8> MultiFormatArchive::GetFileDataById(size_t fileId) {
     if (!ar_) {
         return {};
     }
+    if (isSolid_) {
+        return ReadSolidFileData(fileId);
+    }
 
     auto* fileInfo = fileInfos_[fileId];
     CrashIf(fileInfo->fileId != fileId);
@@ -125,7 +245,11 @@ std::span<u8> MultiFormatArchive::GetFileDataById(size_t fileId) {
     if (!ar_parse_entry_at(ar_, filePos)) {
         return {};
     }
-    size_t size = fileInfo->fileSizeUncompressed;
+    size_t size = std::min(fileInfo->fileSizeUncompressed, maxSize);
+    return UncompressCurrentEntry(size);
+}
+
+std::span<u8> MultiFormatArchive::UncompressCurrentEntry(size_t size) {
     if (addOverflows<size_t>(size, ZERO_PADDING_COUNT)) {
         return {};
     }
@@ -134,12 +258,56 @@ std::span<u8> MultiFormatArchive::GetFileDataById(size_t fileId) {
         return {};
     }
     if (!ar_entry_uncompress(ar_, data, size)) {
+        free(data);
         return {};
     }
-
     return {data, size};
 }
 
+// unarr can only uncompress a file in a solid archive after all the files before
+// it (starting at solidStart), so it'd start over for every file not read in
+// archive order. Instead, we continue after the most recently uncompressed file if
+// possible and add the files uncompressed on the way to the cache, so that reading
+// all files in any order costs about one pass over the archive (if they fit the cache)
+std::span<u8> MultiFormatArchive::ReadSolidFileData(size_t fileId) {
+    auto* fileInfo = fileInfos_[fileId];
+    CrashIf(fileInfo->fileId != fileId);
+
+    size_t id = fileId;
+    bool resume = lastSolidId_ < fileId && fileInfos_[lastSolidId_]->solidStart == fileInfo->solidStart;
+    if (resume) {
+        id = lastSolidId_ + 1;
+    } else {
+        while (id > 0 && fileInfos_[id - 1]->filePos >= fileInfo->solidStart) {
+            id--;
+        }
+    }
+
+    lastSolidId_ = (size_t)-1;
+    for (; id <= fileId; id++) {
+        auto* fi = fileInfos_[id];
+        bool ok = resume ? ar_parse_entry(ar_) : ar_parse_entry_at(ar_, fi->filePos);
+        if (!ok || ar_entry_get_offset(ar_) != fi->filePos) {
+            return {};
+        }
+        resume = true;
+        auto data = UncompressCurrentEntry(fi->fileSizeUncompressed);
+        if (!data.data()) {
+            return {};
+        }
+        lastSolidId_ = id;
+        if (id == fileId) {
+            return data;
+        }
+        if (cacheLimit_ > 0 && !IsCached(id)) {
+            AddToCache(id, data);
+        } else {
+            free(data.data());
+        }
+    }
+    return {};
+}
+
 std::string_view MultiFormatArchive::GetComment() {
     if (!ar_) {
         return {};
@@ -305,18 +473,97 @@ static bool FindFile(HANDLE hArc, RARHeaderDataEx* rarHeader, const WCHAR* fileN
     }
 }
 
+static void CloseUnrarHandle(void* hArc) {
+    if (hArc) {
+        RARCloseArchive((HANDLE)hArc);
+    }
+}
+
+// extracts the file whose header has just been read with RARReadHeaderEx
+static std::span<u8> ExtractCurrentFile(HANDLE hArc, RARHeaderDataEx* rarHeader, size_t size) {
+    // don't support files whose uncompressed size is greater than 4GB
+    if (rarHeader->UnpSizeHigh != 0 || size != rarHeader->UnpSize || addOverflows<size_t>(size, ZERO_PADDING_COUNT)) {
+        return {};
+    }
+    char* data = AllocArray<char>(size + ZERO_PADDING_COUNT);
+    if (!data) {
+        return {};
+    }
+    str::Slice uncompressedBuf;
+    uncompressedBuf.Set(data, size);
+    RARSetCallback(hArc, unrarCallback, (LPARAM)&uncompressedBuf);
+    int res = RARProcessFile(hArc, RAR_TEST, nullptr, nullptr);
+    RARSetCallback(hArc, nullptr, 0);
+    if (res != 0 || uncompressedBuf.Left() != 0) {
+        free(data);
+        return {};
+    }
+    return {(u8*)data, size};
+}
+
+// unrar.dll has to uncompress all files before the one asked for in a solid
+// archive, so keep the archive open and add those files to the cache on the
+// way (cf. ReadSolidFileData)
+std::span<u8> MultiFormatArchive::GetSolidFileDataByIdUnarrDll(size_t fileId) {
+    size_t id = lastSolidId_ + 1;
+    if (!unrarHandle_ || lastSolidId_ >= fileId) {
+        CloseUnrarHandle(unrarHandle_);
+        unrarHandle_ = nullptr;
+        AutoFreeWstr rarPath = strconv::Utf8ToWstr(rarFilePath_);
+        RAROpenArchiveDataEx arcData = {0};
+        arcData.ArcNameW = rarPath.Get();
+        arcData.OpenMode = RAR_OM_EXTRACT;
+        HANDLE hArc = RAROpenArchiveEx(&arcData);
+        if (!hArc || arcData.OpenResult != 0) {
+            CloseUnrarHandle(hArc);
+            return {};
+        }
+        unrarHandle_ = hArc;
+        id = 0;
+    }
+
+    lastSolidId_ = (size_t)-1;
+    HANDLE hArc = (HANDLE)unrarHandle_;
+    for (; id <= fileId; id++) {
+        auto* fi = fileInfos_[id];
+        RARHeaderDataEx rarHeader = {0};
+        if (RARReadHeaderEx(hArc, &rarHeader) != 0) {
+            return {};
+        }
+        // directories have to be skipped (they're listed in fileInfos_ as well)
+        std::span<u8> data;
+        if ((rarHeader.Flags & RHDF_DIRECTORY) != 0) {
+            RARProcessFile(hArc, RAR_SKIP, nullptr, nullptr);
+        } else {
+            data = ExtractCurrentFile(hArc, &rarHeader, fi->fileSizeUncompressed);
+            if (!data.data()) {
+                return {};
+            }
+        }
+        lastSolidId_ = id;
+        if (id == fileId) {
+            return data;
+        }
+        if (data.data() && cacheLimit_ > 0 && !IsCached(id)) {
+            AddToCache(id, data);
+        } else {
+            free(data.data());
+        }
+    }
+    return {};
+}
+
 std::span<u8> MultiFormatArchive::GetFileDataByIdUnarrDll(size_t fileId) {
     CrashIf(!rarFilePath_);
+    if (isSolid_) {
+        return GetSolidFileDataByIdUnarrDll(fileId);
+    }
 
     AutoFreeWstr rarPath = strconv::Utf8ToWstr(rarFilePath_);
 
-    str::Slice uncompressedBuf;
-
     RAROpenArchiveDataEx arcData = {0};
     arcData.ArcNameW = rarPath.Get();
     arcData.OpenMode = RAR_OM_EXTRACT;
-    arcData.Callback = unrarCallback;
-    arcData.UserData = (LPARAM)&uncompressedBuf;
 
     HANDLE hArc = RAROpenArchiveEx(&arcData);
     if (!hArc || arcData.OpenResult != 0) {
@@ -326,38 +573,14 @@ std::span<u8> MultiFormatArchive::GetFileDataByIdUnarrDll(size_t fileId) {
     auto* fileInfo = fileInfos_[fileId];
     CrashIf(fileInfo->fileId != fileId);
 
-    char* data = nullptr;
-    size_t size = 0;
+    std::span<u8> data;
     AutoFreeWstr fileName = strconv::Utf8ToWstr(fileInfo->name.data());
     RARHeaderDataEx rarHeader = {0};
-    int res;
-    bool ok = FindFile(hArc, &rarHeader, fileName.Get());
-    if (!ok) {
-        goto Exit;
-    }
-    size = fileInfo->fileSizeUncompressed;
-    CrashIf(size != rarHeader.UnpSize);
-    if (addOverflows<size_t>(size, ZERO_PADDING_COUNT)) {
-        ok = false;
-        goto Exit;
+    if (FindFile(hArc, &rarHeader, fileName.Get())) {
+        data = ExtractCurrentFile(hArc, &rarHeader, fileInfo->fileSizeUncompressed);
     }
-
-    data = AllocArray<char>(size + ZERO_PADDING_COUNT);
-    if (!data) {
-        ok = false;
-        goto Exit;
-    }
-    uncompressedBuf.Set(data, size);
-    res = RARProcessFile(hArc, RAR_TEST, nullptr, nullptr);
-    ok = (res == 0) && (uncompressedBuf.Left() == 0);
-
-Exit:
     RARCloseArchive(hArc);
-    if (!ok) {
-        free(data);
-        return {};
-    }
-    return {(u8*)data, size};
+    return data;
 }
 
 // asan build crashes in UnRAR code
@@ -377,6 +600,7 @@ bool MultiFormatArchive::OpenUnrarFallback(const char* rarPathUtf) {
     if (!hArc || arcData.OpenResult != 0) {
         return false;
     }
+    isSolid_ = (arcData.Flags & ROADF_SOLID) != 0;
 
     size_t fileId = 0;
     while (true) {
@@ -393,6 +617,7 @@ bool MultiFormatArchive::OpenUnrarFallback(const char* rarPathUtf) {
         i->fileId = fileId;
         i->fileSizeUncompressed = (size_t)rarHeader.UnpSize;
         i->filePos = 0;
+        i->solidStart = 0;
         i->fileTime = (i64)rarHeader.FileTime;
         i->name = Allocator::AllocString(&allocator_, name.Get());
         fileInfos_.Append(i);
@@ -403,6 +628,7 @@ bool MultiFormatArchive::OpenUnrarFallback(const char* rarPathUtf) {
     }
 
     RARCloseArchive(hArc);
+    BuildFileIndex();
 
     auto tmp = Allocator::AllocString(&allocator_, rarPathUtf);
     rarFilePath_ = tmp.data();
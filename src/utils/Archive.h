@@ -20,6 +20,8 @@ class MultiFormatArchive {
 
         // internal use
         i64 filePos;
+        // filePos of the first file to uncompress before this one (in solid archives)
+        i64 solidStart;
 
 #if OS_WIN
         FILETIME GetWinFileTime() const;
@@ -35,6 +37,11 @@ class MultiFormatArchive {
 
     Vec<FileInfo*> const& GetFileInfos();
 
+    // in solid archives, files are best read in archive order (i.e. by fileId)
+    bool IsSolid() const {
+        return isSolid_;
+    }
+
     size_t GetFileId(const char* fileName);
 
 #if OS_WIN
@@ -42,6 +49,14 @@ class MultiFormatArchive {
 #endif
     std::span<u8> GetFileDataByName(const char* filename);
     std::span<u8> GetFileDataById(size_t fileId);
+    // decompresses at most maxSize bytes from the start of the file
+    // e.g. to read image headers without inflating the whole image
+    // might return more data if the format doesn't support partial reads
+    std::span<u8> GetFileDataPartById(size_t fileId, size_t maxSize);
+
+    // on-demand mode: keep data of the most recently read files (up to
+    // maxBytes) so that reading them again doesn't decompress them again
+    void SetCacheLimit(size_t maxBytes);
 
     std::string_view GetComment();
 
@@ -49,6 +64,8 @@ class MultiFormatArchive {
     // used for allocating strings that are referenced by ArchFileInfo::name
     PoolAllocator allocator_;
     Vec<FileInfo*> fileInfos_;
+    // case-insensitive hash index into fileInfos_ (fileId + 1, 0 for empty slots)
+    Vec<u32> fileIndex_;
 
     archive_opener_t opener_ = nullptr;
     ar_stream* data_ = nullptr;
@@ -57,8 +74,32 @@ class MultiFormatArchive {
     // only set when we loaded file infos using unrar.dll fallback
     const char* rarFilePath_ = nullptr;
 
+    bool isSolid_ = false;
+    // the most recently uncompressed file of a solid archive (while ar_ or
+    // unrarHandle_ is positioned right after it, so that the next one can be uncompressed)
+    size_t lastSolidId_ = (size_t)-1;
+    // kept open between reads from solid archives using unrar.dll fallback
+    void* unrarHandle_ = nullptr;
+
+    struct CachedFile {
+        size_t fileId;
+        std::span<u8> data;
+    };
+    // most recently used first
+    Vec<CachedFile> cache_;
+    size_t cacheLimit_ = 0;
+    size_t cacheSize_ = 0;
+
+    std::span<u8> ReadFileData(size_t fileId, size_t maxSize);
+    std::span<u8> ReadSolidFileData(size_t fileId);
+    std::span<u8> UncompressCurrentEntry(size_t size);
+    bool IsCached(size_t fileId) const;
+    void AddToCache(size_t fileId, std::span<u8> data);
+    void BuildFileIndex();
+
     bool OpenUnrarFallback(const char* rarPathUtf);
     std::span<u8> GetFileDataByIdUnarrDll(size_t fileId);
+    std::span<u8> GetSolidFileDataByIdUnarrDll(size_t fileId);
     bool LoadedUsingUnrarDll() const {
         return rarFilePath_ != nullptr;
     }
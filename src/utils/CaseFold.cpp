@@ -0,0 +1,300 @@
+/* Copyright 2021 the SumatraPDF project authors (see AUTHORS file).
+   License: Simplified BSD (see COPYING.BSD) */
+
+#include "utils/BaseUtil.h"
+#include "utils/CaseFold.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define CASE_FOLD_SIMD 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+/*
+Searching works in two steps: vector compares find the candidate positions
+(all characters folding to the needle's first character, of which there are
+only a few), which are then verified one by one with FoldCase. This is much
+faster than folding every character of the text and is as fast as reading
+the text for needles with a rare first character.
+*/
+
+void FoldCase(WCHAR* s, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        s[i] = FoldCase(s[i]);
+    }
+}
+
+// the characters a match can start with
+struct FirstChars {
+    // padded by repeating c[0] so that all of them can always be compared
+    WCHAR c[CASE_FOLD_MAX_PREIMAGES + 1];
+};
+
+static void GetFirstChars(WCHAR first, bool exact, FirstChars& fc) {
+    int n = 0;
+    fc.c[n++] = first;
+    if (!exact) {
+        // binary search for the first character folding to first
+        int lo = 0, hi = gCaseFoldPreimagesCount;
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+            if (gCaseFoldPreimages[mid][0] < first) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        for (int i = lo; i < gCaseFoldPreimagesCount && gCaseFoldPreimages[i][0] == first; i++) {
+            CrashIf(n >= (int)dimof(fc.c));
+            fc.c[n++] = gCaseFoldPreimages[i][1];
+        }
+    }
+    for (; n < (int)dimof(fc.c); n++) {
+        fc.c[n] = first;
+    }
+}
+
+static inline bool IsFirstChar(WCHAR c, const FirstChars& fc) {
+    return c == fc.c[0] || c == fc.c[1] || c == fc.c[2] || c == fc.c[3];
+}
+
+// s[0] is already known to match needle[0]
+static inline bool MatchesAt(const WCHAR* s, const WCHAR* needle, size_t needleLen, bool exact) {
+    for (size_t i = 1; i < needleLen; i++) {
+        WCHAR c = exact ? s[i] : FoldCase(s[i]);
+        if (c != needle[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#if defined(CASE_FOLD_SIMD)
+
+static inline int LowestBit(u32 mask) {
+#if defined(_MSC_VER)
+    unsigned long idx;
+    _BitScanForward(&idx, mask);
+    return (int)idx;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+static inline int HighestBit(u32 mask) {
+#if defined(_MSC_VER)
+    unsigned long idx;
+    _BitScanReverse(&idx, mask);
+    return (int)idx;
+#else
+    return 31 - __builtin_clz(mask);
+#endif
+}
+
+static bool DetectAvx2() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    // the OS must save the AVX registers (OSXSAVE and AVX)
+    const int osxsaveAndAvx = (1 << 27) | (1 << 28);
+    if ((info[2] & osxsaveAndAvx) != osxsaveAndAvx || (_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static bool HasAvx2() {
+    // benign race: all threads compute the same value
+    static int hasAvx2 = -1;
+    if (hasAvx2 < 0) {
+        hasAvx2 = DetectAvx2() ? 1 : 0;
+    }
+    return hasAvx2 == 1;
+}
+
+// the mask has two bits set for every matching 16-bit lane
+static const WCHAR* FindForwardSse2(const WCHAR* s, const WCHAR* stop, const FirstChars& fc, const WCHAR* needle,
+                                    size_t needleLen, bool exact) {
+    __m128i v0 = _mm_set1_epi16((short)fc.c[0]);
+    __m128i v1 = _mm_set1_epi16((short)fc.c[1]);
+    __m128i v2 = _mm_set1_epi16((short)fc.c[2]);
+    __m128i v3 = _mm_set1_epi16((short)fc.c[3]);
+    for (; stop - s >= 8; s += 8) {
+        __m128i d = _mm_loadu_si128((const __m128i*)s);
+        __m128i eq = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi16(d, v0), _mm_cmpeq_epi16(d, v1)),
+                                  _mm_or_si128(_mm_cmpeq_epi16(d, v2), _mm_cmpeq_epi16(d, v3)));
+        u32 mask = (u32)_mm_movemask_epi8(eq);
+        while (mask) {
+            int i = LowestBit(mask) / 2;
+            if (MatchesAt(s + i, needle, needleLen, exact)) {
+                return s + i;
+            }
+            mask &= ~(3u << (i * 2));
+        }
+    }
+    for (; s < stop; s++) {
+        if (IsFirstChar(*s, fc) && MatchesAt(s, needle, needleLen, exact)) {
+            return s;
+        }
+    }
+    return nullptr;
+}
+
+TARGET_AVX2
+static const WCHAR* FindForwardAvx2(const WCHAR* s, const WCHAR* stop, const FirstChars& fc, const WCHAR* needle,
+                                    size_t needleLen, bool exact) {
+    __m256i v0 = _mm256_set1_epi16((short)fc.c[0]);
+    __m256i v1 = _mm256_set1_epi16((short)fc.c[1]);
+    __m256i v2 = _mm256_set1_epi16((short)fc.c[2]);
+    __m256i v3 = _mm256_set1_epi16((short)fc.c[3]);
+    for (; stop - s >= 16; s += 16) {
+        __m256i d = _mm256_loadu_si256((const __m256i*)s);
+        __m256i eq = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi16(d, v0), _mm256_cmpeq_epi16(d, v1)),
+                                     _mm256_or_si256(_mm256_cmpeq_epi16(d, v2), _mm256_cmpeq_epi16(d, v3)));
+        u32 mask = (u32)_mm256_movemask_epi8(eq);
+        while (mask) {
+            int i = LowestBit(mask) / 2;
+            if (MatchesAt(s + i, needle, needleLen, exact)) {
+                return s + i;
+            }
+            mask &= ~(3u << (i * 2));
+        }
+    }
+    // the remaining (less than 16) characters
+    return FindForwardSse2(s, stop, fc, needle, needleLen, exact);
+}
+
+static const WCHAR* FindBackwardSse2(const WCHAR* s, const WCHAR* stop, const FirstChars& fc, const WCHAR* needle,
+                                     size_t needleLen) {
+    __m128i v0 = _mm_set1_epi16((short)fc.c[0]);
+    __m128i v1 = _mm_set1_epi16((short)fc.c[1]);
+    __m128i v2 = _mm_set1_epi16((short)fc.c[2]);
+    __m128i v3 = _mm_set1_epi16((short)fc.c[3]);
+    for (; stop - s >= 8; stop -= 8) {
+        __m128i d = _mm_loadu_si128((const __m128i*)(stop - 8));
+        __m128i eq = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi16(d, v0), _mm_cmpeq_epi16(d, v1)),
+                                  _mm_or_si128(_mm_cmpeq_epi16(d, v2), _mm_cmpeq_epi16(d, v3)));
+        u32 mask = (u32)_mm_movemask_epi8(eq);
+        while (mask) {
+            int i = HighestBit(mask) / 2;
+            if (MatchesAt(stop - 8 + i, needle, needleLen, false)) {
+                return stop - 8 + i;
+            }
+            mask &= ~(3u << (i * 2));
+        }
+    }
+    while (stop > s) {
+        stop--;
+        if (IsFirstChar(*stop, fc) && MatchesAt(stop, needle, needleLen, false)) {
+            return stop;
+        }
+    }
+    return nullptr;
+}
+
+TARGET_AVX2
+static const WCHAR* FindBackwardAvx2(const WCHAR* s, const WCHAR* stop, const FirstChars& fc, const WCHAR* needle,
+                                     size_t needleLen) {
+    __m256i v0 = _mm256_set1_epi16((short)fc.c[0]);
+    __m256i v1 = _mm256_set1_epi16((short)fc.c[1]);
+    __m256i v2 = _mm256_set1_epi16((short)fc.c[2]);
+    __m256i v3 = _mm256_set1_epi16((short)fc.c[3]);
+    for (; stop - s >= 16; stop -= 16) {
+        __m256i d = _mm256_loadu_si256((const __m256i*)(stop - 16));
+        __m256i eq = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi16(d, v0), _mm256_cmpeq_epi16(d, v1)),
+                                     _mm256_or_si256(_mm256_cmpeq_epi16(d, v2), _mm256_cmpeq_epi16(d, v3)));
+        u32 mask = (u32)_mm256_movemask_epi8(eq);
+        while (mask) {
+            int i = HighestBit(mask) / 2;
+            if (MatchesAt(stop - 16 + i, needle, needleLen, false)) {
+                return stop - 16 + i;
+            }
+            mask &= ~(3u << (i * 2));
+        }
+    }
+    return FindBackwardSse2(s, stop, fc, needle, needleLen);
+}
+
+#endif
+
+// finds the first match starting in [s, stop)
+static const WCHAR* FindForward(const WCHAR* s, const WCHAR* stop, const WCHAR* needle, size_t needleLen, bool exact) {
+    FirstChars fc;
+    GetFirstChars(needle[0], exact, fc);
+#if defined(CASE_FOLD_SIMD)
+    if (HasAvx2()) {
+        return FindForwardAvx2(s, stop, fc, needle, needleLen, exact);
+    }
+    return FindForwardSse2(s, stop, fc, needle, needleLen, exact);
+#else
+    for (; s < stop; s++) {
+        if (IsFirstChar(*s, fc) && MatchesAt(s, needle, needleLen, exact)) {
+            return s;
+        }
+    }
+    return nullptr;
+#endif
+}
+
+const WCHAR* FindFolded(const WCHAR* s, const WCHAR* end, const WCHAR* needle, size_t needleLen) {
+    CrashIf(needleLen == 0);
+    if (!s || end < s || (size_t)(end - s) < needleLen) {
+        return nullptr;
+    }
+    return FindForward(s, end - needleLen + 1, needle, needleLen, false);
+}
+
+const WCHAR* FindExact(const WCHAR* s, const WCHAR* end, const WCHAR* needle, size_t needleLen) {
+    CrashIf(needleLen == 0);
+    if (!s || end < s || (size_t)(end - s) < needleLen) {
+        return nullptr;
+    }
+    return FindForward(s, end - needleLen + 1, needle, needleLen, true);
+}
+
+const WCHAR* FindFoldedLast(const WCHAR* s, const WCHAR* end, const WCHAR* last, const WCHAR* needle,
+                            size_t needleLen) {
+    CrashIf(needleLen == 0);
+    if (!s || end < s || (size_t)(end - s) < needleLen) {
+        return nullptr;
+    }
+    const WCHAR* stop = end - needleLen + 1;
+    if (last < stop) {
+        stop = last;
+    }
+    if (stop <= s) {
+        return nullptr;
+    }
+    FirstChars fc;
+    GetFirstChars(needle[0], false, fc);
+#if defined(CASE_FOLD_SIMD)
+    if (HasAvx2()) {
+        return FindBackwardAvx2(s, stop, fc, needle, needleLen);
+    }
+    return FindBackwardSse2(s, stop, fc, needle, needleLen);
+#else
+    while (stop > s) {
+        stop--;
+        if (IsFirstChar(*stop, fc) && MatchesAt(stop, needle, needleLen, false)) {
+            return stop;
+        }
+    }
+    return nullptr;
+#endif
+}
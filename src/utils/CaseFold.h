@@ -0,0 +1,29 @@
+/* Copyright 2021 the SumatraPDF project authors (see AUTHORS file).
+   License: Simplified BSD (see COPYING.BSD) */
+
+// Unicode-aware case folding of UTF-16 text (to the simple lowercase
+// equivalent) and substring search on top of it (vectorized where possible).
+// The tables are generated by scripts/gen_casefold.py
+
+// max. number of characters other than itself that fold to a character
+#define CASE_FOLD_MAX_PREIMAGES 3
+
+extern const u8 gCaseFoldBlocks[256];
+extern const u16 gCaseFoldDeltas[][256];
+extern const WCHAR gCaseFoldPreimages[][2];
+extern const int gCaseFoldPreimagesCount;
+
+inline WCHAR FoldCase(WCHAR c) {
+    return (WCHAR)(c + gCaseFoldDeltas[gCaseFoldBlocks[c >> 8]][c & 0xff]);
+}
+
+void FoldCase(WCHAR* s, size_t len);
+
+// the needle must already have been folded with FoldCase and not be empty
+// returns the first position in [s, end) where needle starts (nullptr if there's none)
+const WCHAR* FindFolded(const WCHAR* s, const WCHAR* end, const WCHAR* needle, size_t needleLen);
+// returns the last position before last where needle starts (the match may extend beyond last)
+const WCHAR* FindFoldedLast(const WCHAR* s, const WCHAR* end, const WCHAR* last, const WCHAR* needle,
+                            size_t needleLen);
+// same as FindFolded but case-sensitive (so needle doesn't have to be folded)
+const WCHAR* FindExact(const WCHAR* s, const WCHAR* end, const WCHAR* needle, size_t needleLen);
@@ -8,7 +8,9 @@ extern "C" {
 #endif
 
 #include "utils/BaseUtil.h"
+#include "utils/ScopedWin.h"
 #include "utils/CryptoUtil.h"
+#include "utils/FileUtil.h"
 
 #ifndef DWORD_MAX
 #define DWORD_MAX 0xffffffffUL
@@ -28,6 +30,32 @@ void CalcMD5Digest(const u8* data, size_t byteCount, u8 digest[16]) {
     fz_md5_final(&md5, digest);
 }
 
+bool CalcMD5DigestFile(const WCHAR* filePath, u8 digest[16]) {
+    AutoCloseHandle h(file::OpenReadOnly(filePath));
+    if (!h.IsValid()) {
+        return false;
+    }
+    const DWORD chunkSize = 1024 * 1024;
+    AutoFree buf(AllocArray<char>(chunkSize));
+    if (!buf) {
+        return false;
+    }
+    fz_md5 md5;
+    fz_md5_init(&md5);
+    for (;;) {
+        DWORD read = 0;
+        if (!ReadFile(h, buf.Get(), chunkSize, &read, nullptr)) {
+            return false;
+        }
+        if (read == 0) {
+            break;
+        }
+        fz_md5_update(&md5, (u8*)buf.Get(), read);
+    }
+    fz_md5_final(&md5, digest);
+    return true;
+}
+
 void CalcSHA2Digest(const u8* data, size_t byteCount, u8 digest[32]) {
     fz_sha256 sha2;
     fz_sha256_init(&sha2);
@@ -46,6 +74,16 @@ void CalcMD5Digest(const u8* data, size_t byteCount, u8 digest[16]) {
     CalcMD5DigestWin(data, byteCount, digest);
 }
 
+bool CalcMD5DigestFile(const WCHAR* filePath, u8 digest[16]) {
+    std::span<u8> data = file::ReadFile(filePath);
+    if (data.empty()) {
+        return false;
+    }
+    CalcMD5DigestWin(data.data(), data.size(), digest);
+    str::Free(data.data());
+    return true;
+}
+
 void CalcSHA2Digest(const u8* data, size_t byteCount, u8 digest[32]) {
     CalcSha2DigestWin(data, byteCount, digest);
 }
@@ -2,6 +2,8 @@
    License: Simplified BSD (see COPYING.BSD) */
 
 void CalcMD5Digest(const u8* data, size_t byteCount, u8 digest[16]);
+// reads the file in chunks instead of all at once
+bool CalcMD5DigestFile(const WCHAR* filePath, u8 digest[16]);
 void CalcSHA1Digest(const u8* data, size_t byteCount, u8 digest[20]);
 void CalcSHA2Digest(const u8* data, size_t byteCount, u8 digest[32]);
 
@@ -47,6 +47,15 @@ struct ImageData {
     std::span<u8> AsSpan() const;
 };
 
+// for documents which don't keep all their images in memory:
+// images are referenced by id and loaded again when needed
+class ImageDataLoader {
+  public:
+    virtual ~ImageDataLoader() = default;
+    // caller must free the returned data
+    virtual std::span<u8> LoadImageData(size_t imageId) = 0;
+};
+
 struct ImageData2 {
     ImageData base;
     // path by which content refers to this image
@@ -0,0 +1,306 @@
+/* Copyright 2021 the SumatraPDF project authors (see AUTHORS file).
+   License: Simplified BSD (see COPYING.BSD) */
+
+#include "utils/BaseUtil.h"
+#include "utils/ByteReader.h"
+#include "utils/ByteWriter.h"
+#include "utils/SearchIndex.h"
+
+/*
+Serialized format (all values little-endian):
+
+u32 magic ('SIDX'), u32 version, u32 number of pages, u32 number of keys
+u64 keys[number of keys] (sorted)
+u32 offsets[number of keys + 1] (into postings)
+u8 postings[] (for each key, varint-encoded deltas of increasing page numbers)
+
+A key is either a single character or (with bit 48 set) three consecutive
+characters not containing whitespace.
+*/
+
+#define SEARCH_INDEX_MAGIC 0x58444953 // 'SIDX'
+#define SEARCH_INDEX_VERSION 2
+#define SEARCH_INDEX_HEADER_SIZE 16
+#define TRIGRAM_KEY_FLAG (1ULL << 48)
+
+struct SearchIndexEntry {
+    u64 key = 0;
+    int lastPage = 0;
+    str::Str postings;
+};
+
+WCHAR SearchIndexFoldAscii(WCHAR c) {
+    if (c >= 'A' && c <= 'Z') {
+        return c + 32;
+    }
+    return c;
+}
+
+static inline u64 TrigramKey(WCHAR c1, WCHAR c2, WCHAR c3) {
+    return TRIGRAM_KEY_FLAG | ((u64)(u16)c1 << 32) | ((u64)(u16)c2 << 16) | (u16)c3;
+}
+
+static inline size_t HashKey(u64 key) {
+    // finalizer from MurmurHash3
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return (size_t)key;
+}
+
+static void AppendVarint(str::Str& s, u32 val) {
+    while (val >= 0x80) {
+        s.AppendChar((char)(val | 0x80));
+        val >>= 7;
+    }
+    s.AppendChar((char)val);
+}
+
+static bool ReadVarint(const u8*& s, const u8* end, u32* valOut) {
+    u32 val = 0;
+    for (int shift = 0; s < end && shift < 35; shift += 7) {
+        u8 b = *s++;
+        val |= (u32)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *valOut = val;
+            return true;
+        }
+    }
+    return false;
+}
+
+SearchIndexBuilder::SearchIndexBuilder(SearchIndexFoldFunc fold) : fold(fold ? fold : SearchIndexFoldAscii) {
+    table.AppendBlanks(1024);
+}
+
+SearchIndexBuilder::~SearchIndexBuilder() {
+    for (SearchIndexEntry* e : table) {
+        delete e;
+    }
+}
+
+void SearchIndexBuilder::AddKey(u64 key, int pageNo) {
+    if (nEntries * 2 >= table.size()) {
+        // grow the table (open addressing with linear probing)
+        Vec<SearchIndexEntry*> old = table;
+        table.Reset();
+        table.AppendBlanks(old.size() * 2);
+        size_t mask = table.size() - 1;
+        for (SearchIndexEntry* e : old) {
+            if (!e) {
+                continue;
+            }
+            size_t i = HashKey(e->key) & mask;
+            while (table.at(i)) {
+                i = (i + 1) & mask;
+            }
+            table.at(i) = e;
+        }
+    }
+
+    size_t mask = table.size() - 1;
+    size_t i = HashKey(key) & mask;
+    while (table.at(i) && table.at(i)->key != key) {
+        i = (i + 1) & mask;
+    }
+    SearchIndexEntry* e = table.at(i);
+    if (!e) {
+        e = new SearchIndexEntry();
+        e->key = key;
+        table.at(i) = e;
+        nEntries++;
+    }
+    if (e->lastPage == pageNo) {
+        return;
+    }
+    CrashIf(e->lastPage > pageNo);
+    AppendVarint(e->postings, (u32)(pageNo - e->lastPage));
+    e->lastPage = pageNo;
+}
+
+void SearchIndexBuilder::AddPage(int pageNo, const WCHAR* text, size_t len) {
+    CrashIf(pageNo < 1);
+    WCHAR c1 = 0, c2 = 0;
+    for (size_t i = 0; i < len; i++) {
+        WCHAR c = text[i];
+        if (str::IsWs(c)) {
+            c1 = c2 = 0;
+            continue;
+        }
+        c = fold(c);
+        AddKey((u16)c, pageNo);
+        if (c1) {
+            AddKey(TrigramKey(c1, c2, c), pageNo);
+        }
+        c1 = c2;
+        c2 = c;
+    }
+}
+
+static int CmpEntries(SearchIndexEntry* const* a, SearchIndexEntry* const* b) {
+    u64 k1 = (*a)->key, k2 = (*b)->key;
+    return k1 < k2 ? -1 : k1 > k2 ? 1 : 0;
+}
+
+std::span<u8> SearchIndexBuilder::Serialize(int nPages) {
+    Vec<SearchIndexEntry*> entries;
+    size_t postingsLen = 0;
+    for (SearchIndexEntry* e : table) {
+        if (e) {
+            entries.Append(e);
+            postingsLen += e->postings.size();
+        }
+    }
+    entries.SortTyped(CmpEntries);
+
+    size_t n = entries.size();
+    size_t size = SEARCH_INDEX_HEADER_SIZE + n * sizeof(u64) + (n + 1) * sizeof(u32) + postingsLen;
+    if (postingsLen > UINT_MAX) {
+        return {};
+    }
+    ByteWriterLE w(size);
+    w.Write32(SEARCH_INDEX_MAGIC);
+    w.Write32(SEARCH_INDEX_VERSION);
+    w.Write32((u32)nPages);
+    w.Write32((u32)n);
+    for (SearchIndexEntry* e : entries) {
+        w.Write64(e->key);
+    }
+    u32 off = 0;
+    for (SearchIndexEntry* e : entries) {
+        w.Write32(off);
+        off += (u32)e->postings.size();
+    }
+    w.Write32(off);
+    for (SearchIndexEntry* e : entries) {
+        w.d.Append(e->postings.Get(), e->postings.size());
+    }
+    CrashIf(w.Size() != size);
+
+    size_t len = w.Size();
+    return {(u8*)w.d.StealData(), len};
+}
+
+SearchIndex::~SearchIndex() {
+    free(data.data());
+}
+
+SearchIndex* SearchIndex::Create(std::span<u8> data, SearchIndexFoldFunc fold) {
+    ByteReader r(data);
+    if (data.size() < SEARCH_INDEX_HEADER_SIZE || r.DWordLE(0) != SEARCH_INDEX_MAGIC ||
+        r.DWordLE(4) != SEARCH_INDEX_VERSION) {
+        return nullptr;
+    }
+    u32 nPages = r.DWordLE(8);
+    u32 nKeys = r.DWordLE(12);
+    size_t tablesSize = (size_t)nKeys * sizeof(u64) + ((size_t)nKeys + 1) * sizeof(u32);
+    if (nPages > INT_MAX || tablesSize > data.size() - SEARCH_INDEX_HEADER_SIZE) {
+        return nullptr;
+    }
+    const u8* keys = data.data() + SEARCH_INDEX_HEADER_SIZE;
+    const u8* offsets = keys + (size_t)nKeys * sizeof(u64);
+    size_t postingsLen = data.size() - SEARCH_INDEX_HEADER_SIZE - tablesSize;
+    if (r.DWordLE(offsets - data.data() + (size_t)nKeys * sizeof(u32)) != postingsLen) {
+        return nullptr;
+    }
+
+    auto res = new SearchIndex();
+    res->data = data;
+    res->fold = fold ? fold : SearchIndexFoldAscii;
+    res->nPages = (int)nPages;
+    res->nKeys = nKeys;
+    res->keys = keys;
+    res->offsets = offsets;
+    res->postings = offsets + ((size_t)nKeys + 1) * sizeof(u32);
+    res->postingsLen = postingsLen;
+    return res;
+}
+
+// sets pages[pageNo - 1] to true for all pages containing key
+bool SearchIndex::GetPages(u64 key, Vec<bool>& pages) const {
+    ByteReader r(data);
+    size_t keysOff = keys - data.data();
+    size_t offsetsOff = offsets - data.data();
+
+    // binary search for the key
+    u32 lo = 0, hi = nKeys;
+    while (lo < hi) {
+        u32 mid = lo + (hi - lo) / 2;
+        if (r.QWordLE(keysOff + (size_t)mid * sizeof(u64)) < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == nKeys || r.QWordLE(keysOff + (size_t)lo * sizeof(u64)) != key) {
+        return true;
+    }
+
+    u32 start = r.DWordLE(offsetsOff + (size_t)lo * sizeof(u32));
+    u32 end = r.DWordLE(offsetsOff + ((size_t)lo + 1) * sizeof(u32));
+    if (start > end || end > postingsLen) {
+        return false;
+    }
+    const u8* s = postings + start;
+    const u8* e = postings + end;
+    u32 pageNo = 0;
+    while (s < e) {
+        u32 delta;
+        if (!ReadVarint(s, e, &delta) || delta == 0 || delta > (u32)nPages - pageNo) {
+            return false;
+        }
+        pageNo += delta;
+        pages[pageNo - 1] = true;
+    }
+    return true;
+}
+
+bool SearchIndex::FindPages(const WCHAR* word, Vec<bool>& pages) const {
+    size_t len = str::Len(word);
+    if (len == 0 || nPages == 0) {
+        return false;
+    }
+
+    Vec<u64> keysToFind;
+    WCHAR c1 = 0, c2 = 0;
+    for (size_t i = 0; i < len; i++) {
+        WCHAR c = word[i];
+        if (str::IsWs(c)) {
+            c1 = c2 = 0;
+            continue;
+        }
+        c = fold(c);
+        if (c1) {
+            keysToFind.Append(TrigramKey(c1, c2, c));
+        }
+        c1 = c2;
+        c2 = c;
+    }
+    if (keysToFind.size() == 0) {
+        // too short for trigrams, so look for the individual characters instead
+        for (size_t i = 0; i < len; i++) {
+            if (!str::IsWs(word[i])) {
+                keysToFind.Append((u16)fold(word[i]));
+            }
+        }
+    }
+    if (keysToFind.size() == 0) {
+        return false;
+    }
+
+    // a page might contain the word only if it contains all its keys
+    pages.Reset();
+    pages.AppendBlanks(nPages);
+    Vec<bool> keyPages;
+    for (size_t i = 0; i < keysToFind.size(); i++) {
+        keyPages.Reset();
+        keyPages.AppendBlanks(nPages);
+        if (!GetPages(keysToFind.at(i), keyPages)) {
+            return false;
+        }
+        for (int j = 0; j < nPages; j++) {
+            pages[j] = (i == 0 || pages[j]) && keyPages[j];
+        }
+    }
+    return true;
+}
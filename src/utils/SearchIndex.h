@@ -0,0 +1,65 @@
+/* Copyright 2021 the SumatraPDF project authors (see AUTHORS file).
+   License: Simplified BSD (see COPYING.BSD) */
+
+// An inverted index mapping the characters and character trigrams of
+// (case-folded) page text to the pages they appear on. It's meant for
+// quickly finding the pages which might contain a given word (the actual
+// matching is still up to the caller) and can be serialized for caching.
+
+// all text is case-folded with the same function when building and querying
+using SearchIndexFoldFunc = WCHAR (*)(WCHAR c);
+
+WCHAR SearchIndexFoldAscii(WCHAR c);
+
+struct SearchIndexEntry;
+
+class SearchIndexBuilder {
+  public:
+    explicit SearchIndexBuilder(SearchIndexFoldFunc fold = nullptr);
+    SearchIndexBuilder(SearchIndexBuilder const&) = delete;
+    SearchIndexBuilder& operator=(SearchIndexBuilder const&) = delete;
+    ~SearchIndexBuilder();
+
+    // pages must be added in increasing order
+    void AddPage(int pageNo, const WCHAR* text, size_t len);
+    // caller must free() the result
+    std::span<u8> Serialize(int nPages);
+
+  private:
+    SearchIndexFoldFunc fold = nullptr;
+    Vec<SearchIndexEntry*> table;
+    size_t nEntries = 0;
+
+    void AddKey(u64 key, int pageNo);
+};
+
+class SearchIndex {
+  public:
+    SearchIndex(SearchIndex const&) = delete;
+    SearchIndex& operator=(SearchIndex const&) = delete;
+    ~SearchIndex();
+
+    // takes ownership of data on success, returns nullptr for invalid data
+    static SearchIndex* Create(std::span<u8> data, SearchIndexFoldFunc fold = nullptr);
+
+    int PageCount() const {
+        return nPages;
+    }
+    // sets pages[pageNo - 1] to whether the page might contain word
+    // returns false if the index can't tell (e.g. for an empty word)
+    bool FindPages(const WCHAR* word, Vec<bool>& pages) const;
+
+  private:
+    SearchIndex() = default;
+
+    std::span<u8> data;
+    SearchIndexFoldFunc fold = nullptr;
+    int nPages = 0;
+    u32 nKeys = 0;
+    const u8* keys = nullptr;
+    const u8* offsets = nullptr;
+    const u8* postings = nullptr;
+    size_t postingsLen = 0;
+
+    bool GetPages(u64 key, Vec<bool>& pages) const;
+};
@@ -0,0 +1,148 @@
+/* Copyright 2021 the SumatraPDF project authors (see AUTHORS file).
+   License: Simplified BSD (see COPYING.BSD) */
+
+#include "utils/BaseUtil.h"
+#include "utils/CaseFold.h"
+#include "utils/Timer.h"
+
+// must be last due to assert() over-write
+#include "utils/UtAssert.h"
+
+static const WCHAR* FindFoldedSlow(const WCHAR* s, const WCHAR* end, const WCHAR* needle, size_t needleLen,
+                                   bool exact, bool backward, const WCHAR* last) {
+    const WCHAR* found = nullptr;
+    for (const WCHAR* p = s; p + needleLen <= end && (!backward || p < last); p++) {
+        size_t i = 0;
+        while (i < needleLen && (exact ? p[i] : FoldCase(p[i])) == needle[i]) {
+            i++;
+        }
+        if (i == needleLen) {
+            found = p;
+            if (!backward) {
+                break;
+            }
+        }
+    }
+    return found;
+}
+
+static void CaseFoldFoldTest() {
+    utassert(FoldCase(L'A') == L'a');
+    utassert(FoldCase(L'z') == L'z');
+    utassert(FoldCase(L'1') == L'1');
+    utassert(FoldCase(0xc4) == 0xe4);       // A WITH DIAERESIS
+    utassert(FoldCase(0x130) == L'i');      // CAPITAL I WITH DOT ABOVE
+    utassert(FoldCase(0x212a) == L'k');     // KELVIN SIGN
+    utassert(FoldCase(0x3a3) == 0x3c3);     // GREEK CAPITAL SIGMA
+    utassert(FoldCase(0x410) == 0x430);     // CYRILLIC CAPITAL A
+    utassert(FoldCase(0xff21) == 0xff41);   // FULLWIDTH CAPITAL A
+    utassert(FoldCase(0xd800) == 0xd800);   // surrogates are left alone
+    utassert(FoldCase(0x2014) == 0x2014);   // EM DASH
+    for (int c = 0; c < 0x10000; c++) {
+        WCHAR folded = FoldCase((WCHAR)c);
+        utassert(FoldCase(folded) == folded);
+    }
+}
+
+static void CaseFoldFindTest() {
+    // characters with several case variants (incl. ones folding to ASCII)
+    static const WCHAR chars[] = {L'a', L'A', L'k', L'K', 0x212a, L'i', L'I', 0x130, L' ', 0x3c3, 0x3a3, 0x2019};
+    u32 seed = 1;
+    for (int round = 0; round < 200; round++) {
+        WCHAR text[80];
+        size_t len = round % dimof(text);
+        for (size_t i = 0; i < len; i++) {
+            seed = seed * 1103515245 + 12345;
+            text[i] = chars[(seed >> 16) % dimof(chars)];
+        }
+        for (size_t needleLen = 1; needleLen <= 3; needleLen++) {
+            for (size_t start = 0; start + needleLen <= len; start += 7) {
+                WCHAR needle[4];
+                memcpy(needle, text + start, needleLen * sizeof(WCHAR));
+                const WCHAR* end = text + len;
+
+                const WCHAR* found = FindExact(text, end, needle, needleLen);
+                utassert(found == FindFoldedSlow(text, end, needle, needleLen, true, false, nullptr));
+
+                FoldCase(needle, needleLen);
+                found = FindFolded(text, end, needle, needleLen);
+                utassert(found == FindFoldedSlow(text, end, needle, needleLen, false, false, nullptr));
+                utassert(found && found <= text + start);
+
+                for (size_t last = 0; last <= len; last += 5) {
+                    found = FindFoldedLast(text, end, text + last, needle, needleLen);
+                    utassert(found == FindFoldedSlow(text, end, needle, needleLen, false, true, text + last));
+                }
+            }
+        }
+    }
+
+    const WCHAR* s = L"Kelvin: \x212a, K, k";
+    const WCHAR* end = s + str::Len(s);
+    utassert(FindFolded(s, end, L"k", 1) == s);
+    utassert(FindFolded(s + 1, end, L"k", 1) == s + 8);
+    utassert(FindExact(s + 1, end, L"K", 1) == s + 11);
+    utassert(FindFoldedLast(s, end, end, L"k,", 2) == s + 11);
+    utassert(!FindFolded(s, end, L"kelvin!", 7));
+    utassert(!FindFolded(s, s, L"k", 1));
+}
+
+// "Lorem ipsum ..." text of about len characters, ending in "Sumatra"
+static WCHAR* MakeLongText(size_t len, const WCHAR** end) {
+    WCHAR* text = AllocArray<WCHAR>(len + 1);
+    const WCHAR* words[] = {L"Lorem ", L"ipsum ", L"dolor ", L"sit ", L"amet, ", L"consectetur\n"};
+    size_t n = 0;
+    for (size_t i = 0; n + 16 < len; i++) {
+        const WCHAR* word = words[i % dimof(words)];
+        size_t wordLen = str::Len(word);
+        memcpy(text + n, word, wordLen * sizeof(WCHAR));
+        n += wordLen;
+    }
+    memcpy(text + n, L"Sumatra", 7 * sizeof(WCHAR));
+    n += 7;
+    *end = text + n;
+    return text;
+}
+
+// a match at the end of a long text (i.e. after many vectorized blocks)
+static void CaseFoldLongTextTest() {
+    const WCHAR* end = nullptr;
+    WCHAR* text = MakeLongText(1 << 16, &end);
+    utassert(FindFolded(text, end, L"sumatra", 7) == end - 7);
+    utassert(FindFoldedLast(text, end, end, L"sumatra", 7) == end - 7);
+    utassert(!FindFolded(text, end - 1, L"sumatra", 7));
+    free(text);
+}
+
+// compares the vectorized search with StrStrI (which TextSearch used before)
+// not part of CaseFoldTest(), run with test_util.exe -bench
+void CaseFoldBenchmark() {
+    const WCHAR* end = nullptr;
+    WCHAR* text = MakeLongText(1 << 20, &end);
+
+    const int iterations = 10;
+    const WCHAR* found = nullptr;
+    auto t = TimeGet();
+    for (int i = 0; i < iterations; i++) {
+        found = StrStrI(text, L"sumatra");
+    }
+    double strStrIMs = TimeSinceInMs(t) / iterations;
+    utassert(found == end - 7);
+
+    t = TimeGet();
+    for (int i = 0; i < iterations; i++) {
+        found = FindFolded(text, end, L"sumatra", 7);
+    }
+    double foldedMs = TimeSinceInMs(t) / iterations;
+    utassert(found == end - 7);
+
+    printf("CaseFold: searching %d KB: StrStrI %.2f ms, FindFolded %.2f ms\n",
+           (int)((end - text) * sizeof(WCHAR) / 1024), strStrIMs, foldedMs);
+    free(text);
+}
+
+void CaseFoldTest() {
+    CaseFoldFoldTest();
+    CaseFoldFindTest();
+    CaseFoldLongTextTest();
+}
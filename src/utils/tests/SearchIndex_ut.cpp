@@ -0,0 +1,60 @@
+/* Copyright 2021 the SumatraPDF project authors (see AUTHORS file).
+   License: Simplified BSD (see COPYING.BSD) */
+
+#include "utils/BaseUtil.h"
+#include "utils/SearchIndex.h"
+
+// must be last due to assert() over-write
+#include "utils/UtAssert.h"
+
+static const WCHAR* gPages[] = {
+    L"The quick brown fox",
+    L"jumps over\nthe lazy dog",
+    L"",
+    L"QUICK thinking",
+    L"a b c",
+};
+
+static bool HasPages(SearchIndex* index, const WCHAR* word, const char* expected) {
+    Vec<bool> pages;
+    if (!index->FindPages(word, pages)) {
+        return false;
+    }
+    for (int i = 0; i < index->PageCount(); i++) {
+        if (pages[i] != (expected[i] == '1')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SearchIndexTest() {
+    int nPages = (int)dimof(gPages);
+    SearchIndexBuilder builder;
+    for (int i = 0; i < nPages; i++) {
+        builder.AddPage(i + 1, gPages[i], str::Len(gPages[i]));
+    }
+    std::span<u8> data = builder.Serialize(nPages);
+    utassert(!data.empty());
+
+    SearchIndex* index = SearchIndex::Create(data);
+    utassert(index);
+    utassert(index->PageCount() == nPages);
+
+    utassert(HasPages(index, L"quick", "10010"));
+    utassert(HasPages(index, L"Quick", "10010"));
+    utassert(HasPages(index, L"the", "11000"));
+    utassert(HasPages(index, L"lazy", "01000"));
+    utassert(HasPages(index, L"zebra", "00000"));
+    // words shorter than 3 characters are looked up by character
+    utassert(HasPages(index, L"b", "10001"));
+    utassert(HasPages(index, L"ab", "00001"));
+    // trigrams don't span whitespace
+    utassert(HasPages(index, L"erthe", "00000"));
+    utassert(!HasPages(index, L"", ""));
+    delete index;
+
+    // invalid data is rejected
+    u8 invalid[] = {'S', 'I', 'D', 'X', 1, 0, 0, 0, 1, 0, 0, 0, 0xff, 0xff, 0xff, 0xff};
+    utassert(!SearchIndex::Create({invalid, sizeof(invalid)}));
+}
@@ -0,0 +1,303 @@
+/* Copyright 2021 the SumatraPDF project authors (see AUTHORS file).
+   License: GPLv3 */
+
+/*
+Headless benchmark of plain mupdf, so that performance regressions in the
+mupdf code paths the engines depend on can be caught on a Linux build machine.
+
+This doesn't go through EnginePdf, EngineMupdf or EngineDump (they are
+Windows-only), so it doesn't measure their caches, locking or threading.
+It calls mupdf directly and imitates what EnginePdf does: every page is recorded
+into a display list once, which is then used for rendering, text extraction and
+search. This works for all formats mupdf opens (PDF, XPS, EPUB, FB2, CBZ, images).
+
+Usage:
+  test_unix [-zoom <zoom>] [-pages <n>] [-repeat <n>] [-search <text>] <file>...
+
+Prints a JSON object with timings (total, mean, p50, p95, max in ms) per phase
+(page load, display list, render, text, search) for every document as well as
+pages/sec and the peak RSS. Exits with 1 if a document couldn't be opened.
+*/
+
+#include <mupdf/fitz.h>
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// same as MAX_CONTEXT_MEMORY in src/EngineFzUtil.h
+#define MAX_CONTEXT_MEMORY (256 * 1024 * 1024)
+// max. number of search hits counted per page
+#define MAX_SEARCH_HITS 512
+
+struct BenchArgs {
+    float zoom = 1.f;
+    // 0 for all pages
+    int maxPages = 0;
+    // how often every page is rendered
+    int repeat = 1;
+    const char* search = "the";
+    std::vector<const char*> files;
+};
+
+struct Timings {
+    std::vector<double> ms;
+
+    void Add(double t) {
+        ms.push_back(t);
+    }
+    double Total() const;
+    double Percentile(double p) const;
+};
+
+struct DocResult {
+    const char* filePath = nullptr;
+    std::string error;
+    int pageCount = 0;
+    int pagesDone = 0;
+    int pageErrors = 0;
+    int searchHits = 0;
+    double loadMs = 0;
+    double totalMs = 0;
+    Timings pageLoad;
+    Timings list;
+    Timings render;
+    Timings text;
+    Timings search;
+};
+
+using Clock = std::chrono::steady_clock;
+
+static double MsSince(Clock::time_point start) {
+    std::chrono::duration<double, std::milli> d = Clock::now() - start;
+    return d.count();
+}
+
+double Timings::Total() const {
+    double total = 0;
+    for (double t : ms) {
+        total += t;
+    }
+    return total;
+}
+
+// nearest-rank percentile, p in [0, 100]
+double Timings::Percentile(double p) const {
+    if (ms.empty()) {
+        return 0;
+    }
+    std::vector<double> sorted = ms;
+    std::sort(sorted.begin(), sorted.end());
+    size_t rank = (size_t)std::ceil(p / 100.0 * (double)sorted.size());
+    rank = std::clamp(rank, (size_t)1, sorted.size());
+    return sorted[rank - 1];
+}
+
+static void BenchPage(fz_context* ctx, fz_document* doc, int pageIdx, const BenchArgs& args, DocResult& res) {
+    fz_page* page = nullptr;
+    fz_display_list* list = nullptr;
+    fz_stext_page* stext = nullptr;
+    fz_var(page);
+    fz_var(list);
+    fz_var(stext);
+
+    fz_try(ctx) {
+        auto t = Clock::now();
+        page = fz_load_page(ctx, doc, pageIdx);
+        res.pageLoad.Add(MsSince(t));
+
+        t = Clock::now();
+        list = fz_new_display_list_from_page(ctx, page);
+        res.list.Add(MsSince(t));
+
+        fz_matrix ctm = fz_scale(args.zoom, args.zoom);
+        for (int i = 0; i < args.repeat; i++) {
+            t = Clock::now();
+            fz_pixmap* pix = fz_new_pixmap_from_display_list(ctx, list, ctm, fz_device_rgb(ctx), 0);
+            res.render.Add(MsSince(t));
+            fz_drop_pixmap(ctx, pix);
+        }
+
+        t = Clock::now();
+        fz_stext_options opts{};
+        stext = fz_new_stext_page_from_display_list(ctx, list, &opts);
+        res.text.Add(MsSince(t));
+
+        if (args.search && *args.search) {
+            fz_quad hits[MAX_SEARCH_HITS];
+            t = Clock::now();
+            res.searchHits += fz_search_stext_page(ctx, stext, args.search, hits, MAX_SEARCH_HITS);
+            res.search.Add(MsSince(t));
+        }
+        res.pagesDone++;
+    }
+    fz_always(ctx) {
+        fz_drop_stext_page(ctx, stext);
+        fz_drop_display_list(ctx, list);
+        fz_drop_page(ctx, page);
+    }
+    fz_catch(ctx) {
+        fz_warn(ctx, "page %d: %s", pageIdx + 1, fz_caught_message(ctx));
+        res.pageErrors++;
+    }
+}
+
+static void BenchDocument(fz_context* ctx, const char* filePath, const BenchArgs& args, DocResult& res) {
+    res.filePath = filePath;
+    fz_document* doc = nullptr;
+    fz_var(doc);
+
+    auto start = Clock::now();
+    fz_try(ctx) {
+        doc = fz_open_document(ctx, filePath);
+        if (fz_needs_password(ctx, doc)) {
+            fz_throw(ctx, FZ_ERROR_GENERIC, "document is password protected");
+        }
+        res.pageCount = fz_count_pages(ctx, doc);
+    }
+    fz_catch(ctx) {
+        fz_drop_document(ctx, doc);
+        res.error = fz_caught_message(ctx);
+        return;
+    }
+    res.loadMs = MsSince(start);
+
+    int nPages = res.pageCount;
+    if (args.maxPages > 0) {
+        nPages = std::min(nPages, args.maxPages);
+    }
+    auto pagesStart = Clock::now();
+    for (int i = 0; i < nPages; i++) {
+        BenchPage(ctx, doc, i, args, res);
+    }
+    res.totalMs = MsSince(pagesStart);
+    fz_drop_document(ctx, doc);
+}
+
+static void PrintJsonStr(const char* s) {
+    putchar('"');
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            printf("\\%c", c);
+        } else if (c < 0x20) {
+            printf("\\u%04x", c);
+        } else {
+            putchar(c);
+        }
+    }
+    putchar('"');
+}
+
+static void PrintTimings(const char* name, const Timings& t, bool last = false) {
+    double total = t.Total();
+    double mean = t.ms.empty() ? 0 : total / (double)t.ms.size();
+    printf("      \"%s\": {\"count\": %d, \"totalMs\": %.3f, \"meanMs\": %.3f, \"p50Ms\": %.3f, ", name, (int)t.ms.size(),
+           total, mean, t.Percentile(50));
+    printf("\"p95Ms\": %.3f, \"maxMs\": %.3f}%s\n", t.Percentile(95), t.Percentile(100), last ? "" : ",");
+}
+
+static void PrintDocResult(const DocResult& res, bool last) {
+    printf("    {\n      \"file\": ");
+    PrintJsonStr(res.filePath);
+    if (!res.error.empty()) {
+        printf(",\n      \"error\": ");
+        PrintJsonStr(res.error.c_str());
+        printf("\n    }%s\n", last ? "" : ",");
+        return;
+    }
+    double pagesPerSec = res.totalMs > 0 ? res.pagesDone * 1000.0 / res.totalMs : 0;
+    printf(",\n      \"pageCount\": %d,\n", res.pageCount);
+    printf("      \"pagesDone\": %d,\n", res.pagesDone);
+    printf("      \"pageErrors\": %d,\n", res.pageErrors);
+    printf("      \"loadMs\": %.3f,\n", res.loadMs);
+    printf("      \"totalMs\": %.3f,\n", res.totalMs);
+    printf("      \"pagesPerSec\": %.2f,\n", pagesPerSec);
+    printf("      \"searchHits\": %d,\n", res.searchHits);
+    PrintTimings("pageLoad", res.pageLoad);
+    PrintTimings("displayList", res.list);
+    PrintTimings("render", res.render);
+    PrintTimings("text", res.text);
+    PrintTimings("search", res.search, true);
+    printf("    }%s\n", last ? "" : ",");
+}
+
+static long PeakRssKb() {
+    struct rusage ru {};
+    getrusage(RUSAGE_SELF, &ru);
+    // in kilobytes on Linux (but in bytes on macOS)
+#if defined(__APPLE__)
+    return ru.ru_maxrss / 1024;
+#else
+    return ru.ru_maxrss;
+#endif
+}
+
+static void Usage() {
+    fprintf(stderr,
+            "usage: test_unix [-zoom <zoom>] [-pages <n>] [-repeat <n>] [-search <text>] <file>...\n"
+            "  -zoom    render at this zoom level (default: 1)\n"
+            "  -pages   only benchmark the first n pages of every document\n"
+            "  -repeat  render every page n times (default: 1)\n"
+            "  -search  text to search for on every page (default: \"the\")\n");
+}
+
+static bool ParseArgs(int argc, char** argv, BenchArgs& args) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool hasParam = i + 1 < argc;
+        if (strcmp(arg, "-zoom") == 0 && hasParam) {
+            args.zoom = (float)atof(argv[++i]);
+        } else if (strcmp(arg, "-pages") == 0 && hasParam) {
+            args.maxPages = atoi(argv[++i]);
+        } else if (strcmp(arg, "-repeat") == 0 && hasParam) {
+            args.repeat = atoi(argv[++i]);
+        } else if (strcmp(arg, "-search") == 0 && hasParam) {
+            args.search = argv[++i];
+        } else if (arg[0] == '-') {
+            return false;
+        } else {
+            args.files.push_back(arg);
+        }
+    }
+    return !args.files.empty() && args.zoom > 0 && args.repeat > 0;
+}
+
+int main(int argc, char** argv) {
+    BenchArgs args;
+    if (!ParseArgs(argc, argv, args)) {
+        Usage();
+        return 2;
+    }
+
+    fz_context* ctx = fz_new_context(nullptr, nullptr, MAX_CONTEXT_MEMORY);
+    if (!ctx) {
+        fprintf(stderr, "failed to create a mupdf context\n");
+        return 1;
+    }
+    fz_register_document_handlers(ctx);
+
+    std::vector<DocResult> results(args.files.size());
+    bool ok = true;
+    for (size_t i = 0; i < args.files.size(); i++) {
+        BenchDocument(ctx, args.files[i], args, results[i]);
+        ok = ok && results[i].error.empty();
+    }
+    fz_drop_context(ctx);
+
+    printf("{\n  \"zoom\": %.3f,\n  \"repeat\": %d,\n  \"search\": ", args.zoom, args.repeat);
+    PrintJsonStr(args.search);
+    printf(",\n  \"documents\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        PrintDocResult(results[i], i + 1 == results.size());
+    }
+    printf("  ],\n  \"peakRssKb\": %ld\n}\n", PeakRssKb());
+    return ok ? 0 : 1;
+}